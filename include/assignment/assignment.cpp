@@ -0,0 +1,100 @@
+#include "assignment.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+using namespace uvdar;
+
+std::vector<int> assignment::solve(const e::MatrixXd &cost){
+  std::vector<int> output(cost.rows(), -1);
+  if ((cost.rows() == 0) || (cost.cols() == 0)){
+    return output;
+  }
+
+  // the method below assigns every row, so it is run on the orientation with fewer rows
+  bool transposed = (cost.rows() > cost.cols());
+  e::MatrixXd a = transposed?e::MatrixXd(cost.transpose()):cost;
+  int n = (int)(a.rows());
+  int m = (int)(a.cols());
+
+  // forbidden entries are replaced by a cost higher than that of any assignment of allowed entries
+  double range = 0;
+  for (int i=0; i<n; i++){
+    for (int j=0; j<m; j++){
+      if (std::isfinite(a(i,j))){
+        range = std::max(range, std::abs(a(i,j)));
+      }
+    }
+  }
+  double forbidden = (2.0*range + 1.0)*(n+1);
+  for (int i=0; i<n; i++){
+    for (int j=0; j<m; j++){
+      if (!std::isfinite(a(i,j))){
+        a(i,j) = forbidden;
+      }
+    }
+  }
+
+  const double inf = std::numeric_limits<double>::infinity();
+  std::vector<double> u(n+1, 0), v(m+1, 0);
+  std::vector<int> p(m+1, 0), way(m+1, 0); //p[j] is the row (1-based) assigned to column j, column 0 is auxiliary
+  for (int i=1; i<=n; i++){
+    p[0] = i;
+    int j0 = 0;
+    std::vector<double> minv(m+1, inf);
+    std::vector<bool> used(m+1, false);
+    do {
+      used[j0] = true;
+      int i0 = p[j0];
+      int j1 = 0;
+      double delta = inf;
+      for (int j=1; j<=m; j++){
+        if (!used[j]){
+          double current = a(i0-1,j-1) - u[i0] - v[j];
+          if (current < minv[j]){
+            minv[j] = current;
+            way[j] = j0;
+          }
+          if (minv[j] < delta){
+            delta = minv[j];
+            j1 = j;
+          }
+        }
+      }
+      for (int j=0; j<=m; j++){
+        if (used[j]){
+          u[p[j]] += delta;
+          v[j] -= delta;
+        }
+        else {
+          minv[j] -= delta;
+        }
+      }
+      j0 = j1;
+    } while (p[j0] != 0);
+    do { //augment along the alternating path
+      int j1 = way[j0];
+      p[j0] = p[j1];
+      j0 = j1;
+    } while (j0 != 0);
+  }
+
+  for (int j=1; j<=m; j++){
+    if (p[j] == 0){
+      continue;
+    }
+    int row = p[j]-1;
+    int col = j-1;
+    if (!std::isfinite(transposed?cost(col,row):cost(row,col))){
+      continue;
+    }
+    if (transposed){
+      output[col] = row;
+    }
+    else {
+      output[row] = col;
+    }
+  }
+  return output;
+}
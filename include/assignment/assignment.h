@@ -0,0 +1,25 @@
+#ifndef _ASSIGNMENT_H_
+#define _ASSIGNMENT_H_
+#include <vector>
+#include <Eigen/Core>
+
+namespace uvdar {
+
+  namespace e = Eigen;
+
+  namespace assignment {
+
+    /**
+     * @brief Solves the rectangular linear assignment problem using the Hungarian method with potentials [H. W. Kuhn, "The Hungarian method for the assignment problem" (1955)], in O(n^2 m) for n = min(rows, cols) and m = max(rows, cols)
+     *
+     * @param cost The cost of assigning each row to each column. Entries that are not finite are forbidden - the assignment first maximizes the count of allowed pairs, and then minimizes their total cost.
+     *
+     * @return For each row, the index of the assigned column, or -1 if the row was left unassigned or could only be assigned through a forbidden entry
+     */
+    std::vector<int> solve(const e::MatrixXd &cost);
+
+  } //assignment
+
+} //uvdar
+
+#endif // _ASSIGNMENT_H_
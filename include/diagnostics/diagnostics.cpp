@@ -0,0 +1,70 @@
+#include "diagnostics.h"
+
+#include <algorithm>
+
+using namespace uvdar;
+
+diagnostics::Publisher::Publisher(ros::NodeHandle &nh, const std::string &component) : aggregator_(component){
+  double period;
+  nh.param("diagnostics_period", period, double(DIAGNOSTICS_DEFAULT_PERIOD));
+  pub_ = nh.advertise<uvdar_core::RuntimeDiagnostics>("diagnostics", 1);
+  last_publish_ = ros::Time::now();
+  timer_ = nh.createTimer(ros::Duration(period), &Publisher::publish, this);
+}
+
+void diagnostics::Aggregator::add(std::string_view name, uint8_t type, double value){
+  std::scoped_lock lock(mutex_);
+  auto it = entries_.find(name);
+  if (it == entries_.end()){
+    it = entries_.emplace(std::string(name), Entry{type}).first;
+  }
+  Entry &entry = it->second;
+  if (entry.count == 0){
+    entry.max = value;
+  }
+  entry.count += (type == uvdar_core::DiagnosticValue::COUNTER)?(uint64_t)(value):1;
+  entry.sum += value;
+  entry.last = value;
+  entry.max = std::max(entry.max, value);
+}
+
+uvdar_core::RuntimeDiagnostics diagnostics::Aggregator::aggregate(double period){
+  uvdar_core::RuntimeDiagnostics msg;
+  msg.component = component_;
+  msg.period = period;
+
+  std::scoped_lock lock(mutex_);
+  for (auto &[name, entry] : entries_){
+    uvdar_core::DiagnosticValue value;
+    value.name = name;
+    value.type = entry.type;
+    value.count = entry.count;
+    if (entry.type == uvdar_core::DiagnosticValue::COUNTER){
+      value.rate = (period > 0)?((double)(entry.count)/period):0;
+    }
+    else if (entry.count > 0){
+      value.last = entry.last;
+      value.mean = entry.sum/(double)(entry.count);
+      value.max = entry.max;
+    }
+    msg.values.push_back(value);
+    entry = Entry{entry.type};
+  }
+  return msg;
+}
+
+void diagnostics::Publisher::publish([[maybe_unused]] const ros::TimerEvent &te){
+  ros::Time now = ros::Time::now();
+  double period = (now - last_publish_).toSec();
+  last_publish_ = now;
+
+  bool was_active = active();
+  active_.store(pub_.getNumSubscribers() > 0, std::memory_order_relaxed);
+  if (!was_active){ //nothing was recorded in this period
+    return;
+  }
+
+  auto msg = aggregator_.aggregate(period);
+  msg.stamp = now;
+  pub_.publish(msg);
+}
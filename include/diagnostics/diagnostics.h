@@ -0,0 +1,122 @@
+#ifndef _DIAGNOSTICS_H_
+#define _DIAGNOSTICS_H_
+#include <ros/ros.h>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <uvdar_core/RuntimeDiagnostics.h>
+
+#define DIAGNOSTICS_DEFAULT_PERIOD 1.0 //seconds
+
+namespace uvdar {
+
+  /**
+   * @brief Periodic runtime diagnostics shared by the UVDAR nodes and nodelets
+   */
+  namespace diagnostics {
+
+    /**
+     * @brief Accumulates counters and gauges between two reports. Thread-safe, and independent of the node handle, so that it is usable without a running ROS master.
+     */
+    class Aggregator {
+      public:
+        /**
+         * @brief Constructor
+         *
+         * @param component Name of the component reported in the messages
+         */
+        Aggregator(const std::string &component) : component_(component) {}
+
+        /**
+         * @brief Records a value
+         *
+         * @param name Name of the counter or gauge
+         * @param type uvdar_core::DiagnosticValue::COUNTER or uvdar_core::DiagnosticValue::GAUGE
+         * @param value The increment of a counter, or the sample of a gauge
+         */
+        void add(std::string_view name, uint8_t type, double value);
+
+        /**
+         * @brief Builds the message from the values recorded since the last call and resets them. Names are kept, so that quantities with no events in a period are still reported.
+         *
+         * @param period The time covered by the values in seconds
+         *
+         * @return The message
+         */
+        uvdar_core::RuntimeDiagnostics aggregate(double period);
+
+      private:
+        struct Entry {
+          uint8_t type;
+          uint64_t count = 0;
+          double sum = 0;
+          double last = 0;
+          double max = 0;
+        };
+
+        std::string component_;
+        std::mutex mutex_;
+        std::map<std::string, Entry, std::less<>> entries_;
+    };
+
+    /**
+     * @brief Aggregates counters and gauges of a single component and periodically publishes them on the "diagnostics" topic of the given node handle, with the period given by its "diagnostics_period" parameter. While nobody subscribes, the values are neither recorded nor published, and recording costs a single relaxed atomic load.
+     */
+    class Publisher {
+      public:
+        /**
+         * @brief Constructor
+         *
+         * @param nh The node handle under which the topic is advertised
+         * @param component Name of the component reported in the messages
+         */
+        Publisher(ros::NodeHandle &nh, const std::string &component);
+
+        /**
+         * @brief Retrieves whether the values are currently being recorded. Callers may use this to skip computing values that are expensive to obtain.
+         */
+        bool active() const {
+          return active_.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Adds to a counter of events
+         *
+         * @param name Name of the counter
+         * @param increment Count of the new events
+         */
+        void count(std::string_view name, uint64_t increment = 1){
+          if (active()){
+            aggregator_.add(name, uvdar_core::DiagnosticValue::COUNTER, (double)(increment));
+          }
+        }
+
+        /**
+         * @brief Adds a sample to a gauge
+         *
+         * @param name Name of the gauge
+         * @param value The current value of the quantity
+         */
+        void gauge(std::string_view name, double value){
+          if (active()){
+            aggregator_.add(name, uvdar_core::DiagnosticValue::GAUGE, value);
+          }
+        }
+
+      private:
+        void publish(const ros::TimerEvent &te);
+
+        Aggregator aggregator_;
+        ros::Publisher pub_;
+        ros::Timer timer_;
+        ros::Time last_publish_;
+        std::atomic<bool> active_ = false;
+    };
+
+  } //diagnostics
+
+} //uvdar
+
+#endif // _DIAGNOSTICS_H_
@@ -0,0 +1,21 @@
+#include "lazy_publisher.h"
+
+#include <chrono>
+
+using namespace uvdar;
+
+lazy_publisher::Throttle::Throttle(double min_period) :
+  min_period_((min_period > 0.0)?(int64_t)(min_period*1e9):0){
+}
+
+bool lazy_publisher::Throttle::claim(uint32_t subscribers){
+  if (subscribers == 0){
+    return false;
+  }
+  int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  if ((last_ != 0) && ((now - last_) < min_period_)){
+    return false;
+  }
+  last_ = now;
+  return true;
+}
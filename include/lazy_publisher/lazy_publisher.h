@@ -0,0 +1,94 @@
+#ifndef _LAZY_PUBLISHER_H_
+#define _LAZY_PUBLISHER_H_
+#include <cstdint>
+#include <utility>
+
+namespace uvdar {
+
+  /**
+   * @brief Publishing of optional debugging and logging outputs shared by the UVDAR nodes and nodelets. The message of such an output is only built if somebody subscribes to its topic and if its minimum period has elapsed since it was last published.
+   */
+  namespace lazy_publisher {
+
+    /**
+     * @brief Decides whether an output is due, given its subscriber count and its minimum period
+     */
+    class Throttle {
+      public:
+        /**
+         * @brief Constructor
+         *
+         * @param min_period The minimum time between two publications in seconds. Non-positive values disable throttling.
+         */
+        Throttle(double min_period = 0.0);
+
+        /**
+         * @brief Retrieves whether the output is due. If it is, the caller is expected to publish it and the minimum period starts anew.
+         *
+         * @param subscribers The current number of subscribers of the output
+         */
+        bool claim(uint32_t subscribers);
+
+      private:
+        int64_t min_period_;
+        int64_t last_ = 0;
+    };
+
+    /**
+     * @brief Wraps a publisher (ros::Publisher or image_transport::Publisher) of an optional output. Each instance is meant to be used from a single thread.
+     */
+    template <class P>
+    class Publisher {
+      public:
+        Publisher() = default;
+
+        /**
+         * @brief Constructor
+         *
+         * @param pub The advertised publisher
+         * @param min_period The minimum time between two publications in seconds. Non-positive values disable throttling.
+         */
+        Publisher(const P &pub, double min_period = 0.0) : pub_(pub), throttle_(min_period){
+        }
+
+        /**
+         * @brief Retrieves whether the message should be built now. If it is, the caller is expected to publish it.
+         */
+        bool wanted(){
+          return throttle_.claim(pub_ ? pub_.getNumSubscribers() : 0);
+        }
+
+        /**
+         * @brief Publishes the message unconditionally
+         */
+        template <class M>
+        void publish(const M &msg){
+          pub_.publish(msg);
+        }
+
+        /**
+         * @brief Builds and publishes the message only if it is wanted
+         *
+         * @param build Callable returning the message
+         *
+         * @return Whether the message was built and published
+         */
+        template <class F>
+        bool publishLazy(F &&build){
+          if (!wanted()){
+            return false;
+          }
+          pub_.publish(std::forward<F>(build)());
+          return true;
+        }
+
+      private:
+        P pub_;
+        Throttle throttle_;
+    };
+
+  } //lazy_publisher
+
+} //uvdar
+
+#endif // _LAZY_PUBLISHER_H_
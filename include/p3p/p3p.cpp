@@ -0,0 +1,132 @@
+#include "p3p.h"
+
+#include <cmath>
+#include <Eigen/Dense>
+
+using namespace uvdar;
+
+#define P3P_IMAG_TOLERANCE 1e-6
+#define P3P_NEWTON_STEPS 2
+
+#define sqr(X) ((X) * (X))
+
+/**
+ * @brief Returns the real roots of a polynomial c[0]*x^n + ... + c[n], using the eigenvalues of its companion matrix
+ */
+static std::vector<double> realPolynomialRoots(std::vector<double> c){
+  while ((c.size() > 1) && (std::abs(c.front()) < 1e-12)){
+    c.erase(c.begin());
+  }
+  int n = (int)(c.size())-1;
+  if (n < 1){
+    return {};
+  }
+
+  e::MatrixXd companion = e::MatrixXd::Zero(n,n);
+  for (int i=0; i<n; i++){
+    companion(0,i) = -c[i+1]/c[0];
+  }
+  for (int i=1; i<n; i++){
+    companion(i,i-1) = 1.0;
+  }
+
+  e::EigenSolver<e::MatrixXd> es(companion, false);
+  std::vector<double> output;
+  for (int i=0; i<n; i++){
+    std::complex<double> root = es.eigenvalues()(i);
+    if (std::abs(root.imag()) > (P3P_IMAG_TOLERANCE*std::max(1.0,std::abs(root.real())))){
+      continue;
+    }
+    double x = root.real();
+    for (int k=0; k<P3P_NEWTON_STEPS; k++){ //polish, since the eigenvalue solver is not particularly precise for clustered roots
+      double f = c[0], df = 0;
+      for (int j=1; j<=n; j++){
+        df = df*x + f;
+        f = f*x + c[j];
+      }
+      if (std::abs(df) < 1e-12){
+        break;
+      }
+      x -= f/df;
+    }
+    output.push_back(x);
+  }
+  return output;
+}
+
+p3p::solution p3p::alignPoints(const std::array<e::Vector3d,3> &object_points, const std::array<e::Vector3d,3> &camera_points){
+  e::Vector3d object_centroid = (object_points[0]+object_points[1]+object_points[2])/3.0;
+  e::Vector3d camera_centroid = (camera_points[0]+camera_points[1]+camera_points[2])/3.0;
+
+  e::Matrix3d H = e::Matrix3d::Zero();
+  for (int i=0; i<3; i++){
+    H += (object_points[i]-object_centroid)*((camera_points[i]-camera_centroid).transpose());
+  }
+
+  e::JacobiSVD<e::Matrix3d> svd(H, e::ComputeFullU | e::ComputeFullV);
+  e::Matrix3d V = svd.matrixV();
+  e::Matrix3d U = svd.matrixU();
+  if ((V*U.transpose()).determinant() < 0){ //reflection
+    V.col(2) *= -1.0;
+  }
+
+  solution output;
+  output.R = V*U.transpose();
+  output.t = camera_centroid - output.R*object_centroid;
+  return output;
+}
+
+std::vector<p3p::solution> p3p::solve(const std::array<e::Vector3d,3> &object_points, const std::array<e::Vector3d,3> &bearings){
+  std::vector<solution> output;
+
+  const e::Vector3d j1 = bearings[0].normalized();
+  const e::Vector3d j2 = bearings[1].normalized();
+  const e::Vector3d j3 = bearings[2].normalized();
+
+  const double a2 = (object_points[1]-object_points[2]).squaredNorm();
+  const double b2 = (object_points[0]-object_points[2]).squaredNorm();
+  const double c2 = (object_points[0]-object_points[1]).squaredNorm();
+
+  if ((a2 < 1e-12) || (b2 < 1e-12) || (c2 < 1e-12)){
+    return output;
+  }
+
+  const double cos_alpha = j2.dot(j3);
+  const double cos_beta  = j1.dot(j3);
+  const double cos_gamma = j1.dot(j2);
+
+  const double amc = (a2-c2)/b2;
+  const double apc = (a2+c2)/b2;
+
+  // quartic in v = s3/s1, coefficients as given by Haralick et al.
+  const double A4 = sqr(amc-1.0) - (4.0*c2/b2)*cos_alpha*cos_alpha;
+  const double A3 = 4.0*( amc*(1.0-amc)*cos_beta - (1.0-apc)*cos_alpha*cos_gamma + 2.0*(c2/b2)*cos_alpha*cos_alpha*cos_beta );
+  const double A2 = 2.0*( amc*amc - 1.0 + 2.0*amc*amc*cos_beta*cos_beta + 2.0*((b2-c2)/b2)*cos_alpha*cos_alpha - 4.0*apc*cos_alpha*cos_beta*cos_gamma + 2.0*((b2-a2)/b2)*cos_gamma*cos_gamma );
+  const double A1 = 4.0*( -amc*(1.0+amc)*cos_beta + (2.0*a2/b2)*cos_gamma*cos_gamma*cos_beta - (1.0-apc)*cos_alpha*cos_gamma );
+  const double A0 = sqr(1.0+amc) - (4.0*a2/b2)*cos_gamma*cos_gamma;
+
+  for (auto v : realPolynomialRoots({A4, A3, A2, A1, A0})){
+    if (v <= 0){
+      continue;
+    }
+    double denominator = 2.0*(cos_gamma - v*cos_alpha);
+    if (std::abs(denominator) < 1e-12){
+      continue;
+    }
+    double u = ((-1.0+amc)*v*v - 2.0*amc*cos_beta*v + 1.0 + amc)/denominator;
+    if (u <= 0){
+      continue;
+    }
+
+    double s1_sq = b2/(1.0 + v*v - 2.0*v*cos_beta);
+    if (s1_sq <= 0){
+      continue;
+    }
+    double s1 = std::sqrt(s1_sq);
+
+    std::array<e::Vector3d,3> camera_points = {s1*j1, u*s1*j2, v*s1*j3};
+    output.push_back(alignPoints(object_points, camera_points));
+  }
+
+  return output;
+}
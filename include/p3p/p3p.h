@@ -0,0 +1,46 @@
+#ifndef _P3P_H_
+#define _P3P_H_
+#include <vector>
+#include <array>
+#include <Eigen/Core>
+
+namespace uvdar {
+
+  namespace e = Eigen;
+
+  namespace p3p {
+
+    /**
+     * @brief A single candidate pose of an object w.r.t. a camera, such that a point X in the object frame appears at R*X+t in the camera frame
+     */
+    struct solution {
+      e::Matrix3d R;
+      e::Vector3d t;
+    };
+
+    /**
+     * @brief Solves the perspective-three-point problem using the formulation of Grunert, as reviewed in [R. M. Haralick et al. "Review and analysis of solutions of the three point perspective pose estimation problem" (IJCV 1994)]. Since only bearing vectors are used, this works with any central camera model, including OCamCalib fisheye lenses.
+     *
+     * @param object_points Three non-collinear points in the object frame
+     * @param bearings Three bearing vectors in the camera frame, pointing towards the corresponding object points (need not be normalized)
+     *
+     * @return Up to four candidate poses. Solutions placing any of the points behind the camera center are discarded.
+     */
+    std::vector<solution> solve(const std::array<e::Vector3d,3> &object_points, const std::array<e::Vector3d,3> &bearings);
+
+    /**
+     * @brief Retrieves the rigid transformation best aligning three object points onto three points in the camera frame (absolute orientation by SVD)
+     *
+     * @param object_points Points in the object frame
+     * @param camera_points Corresponding points in the camera frame
+     *
+     * @return The transformation such that camera_points[i] ~ R*object_points[i]+t
+     */
+    solution alignPoints(const std::array<e::Vector3d,3> &object_points, const std::array<e::Vector3d,3> &camera_points);
+
+  } //p3p
+
+} //uvdar
+
+
+#endif // _P3P_H_
@@ -0,0 +1,73 @@
+#ifndef _PACKED_POINTS_H_
+#define _PACKED_POINTS_H_
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <boost/make_shared.hpp>
+#include <uvdar_core/ImagePointsWithFloatStamped.h>
+#include <uvdar_core/ImagePointsPackedStamped.h>
+
+#define PACKED_POINTS_SUFFIX "/packed" //the compact variant of a point topic is published on the topic with this suffix
+
+namespace uvdar {
+
+  /**
+   * @brief Conversions between the point-array messages and their compact variant
+   */
+  namespace packed_points {
+
+    inline int16_t toInt16(double value){
+      return (int16_t)(std::floor(std::clamp(value, (double)(std::numeric_limits<int16_t>::min()), (double)(std::numeric_limits<int16_t>::max())) + 0.5));
+    }
+
+    /**
+     * @brief Converts a point-array message to its compact variant. The coordinates and values are rounded to the nearest integer.
+     *
+     * @param msg The input message
+     *
+     * @return The compact message
+     */
+    inline uvdar_core::ImagePointsPackedStampedPtr pack(const uvdar_core::ImagePointsWithFloatStamped &msg){
+      auto output = boost::make_shared<uvdar_core::ImagePointsPackedStamped>();
+      output->stamp = msg.stamp;
+      output->image_height = msg.image_height;
+      output->image_width = msg.image_width;
+      size_t count = msg.points.size();
+      output->x.resize(count);
+      output->y.resize(count);
+      output->value.resize(count);
+      for (size_t i = 0; i < count; i++){
+        output->x[i] = toInt16(msg.points[i].x);
+        output->y[i] = toInt16(msg.points[i].y);
+        output->value[i] = toInt16(msg.points[i].value);
+      }
+      return output;
+    }
+
+    /**
+     * @brief Converts a compact point-array message to the original variant
+     *
+     * @param msg The compact message
+     *
+     * @return The point-array message
+     */
+    inline uvdar_core::ImagePointsWithFloatStampedPtr unpack(const uvdar_core::ImagePointsPackedStamped &msg){
+      auto output = boost::make_shared<uvdar_core::ImagePointsWithFloatStamped>();
+      output->stamp = msg.stamp;
+      output->image_height = msg.image_height;
+      output->image_width = msg.image_width;
+      size_t count = std::min({msg.x.size(), msg.y.size(), msg.value.size()});
+      output->points.resize(count);
+      for (size_t i = 0; i < count; i++){
+        output->points[i].x = msg.x[i];
+        output->points[i].y = msg.y[i];
+        output->points[i].value = msg.value[i];
+      }
+      return output;
+    }
+
+  } //packed_points
+
+} //uvdar
+
+#endif // _PACKED_POINTS_H_
@@ -0,0 +1,828 @@
+#include "hypotheses.h"
+
+#include <cmath>
+#include <set>
+#include <array>
+#include <atomic>
+#include <random>
+#include <limits>
+#include <cstdlib>
+#include <algorithm>
+
+using namespace uvdar;
+
+#define sqr(X) ((X) * (X))
+#define deg2rad(X) ((X)*0.01745329251)
+
+#define DIRECTIONAL_LED_VIEW_ANGLE (deg2rad(120))
+
+#define ERROR_THRESHOLD_INITIAL(camera) sqr((camera).width()/50.0)
+#define ERROR_THRESHOLD_MUTATION_1(camera) sqr((camera).width()/75.0)
+#define ERROR_THRESHOLD_MUTATION_2(camera) sqr((camera).width()/100.0)
+#define ERROR_THRESHOLD_MUTATION_3(camera) sqr((camera).width()/150.0)
+
+#define PF_REPROJECT_THRESHOLD_VERIFIED(camera) sqr((camera).width()/150.0)
+#define PF_REPROJECT_THRESHOLD_UNFIT(camera) sqr((camera).width()/50.0)
+
+#define MUTATION_POSITION_MAX_STEP 5.0//m per second
+#define MUTATION_ORIENTATION_MAX_STEP 3.14//rad per second
+#define MUTATION_VELOCITY_MAX_STEP 1.0//m per second^2
+
+#define MAX_INITIAL_VELOCITY 1.0//m per second
+
+#define MAX_HYPOTHESIS_COUNT 1000
+#define MIN_HYPOTHESIS_COUNT 100
+#define KLD_ERROR_BOUND 0.05
+#define KLD_QUANTILE 2.326 // upper 0.01 quantile of the standard normal distribution
+#define KLD_BIN_POSITION 0.2 //m
+#define KLD_BIN_ANGLE (deg2rad(15))
+#define RESAMPLING_TEMPERATURE 0.2 // the resampling weight drops e times with every increase of the fitness error by this fraction of the verification threshold
+
+#define INITIAL_ROUGH_HYPOTHESIS_COUNT 200
+#define INITIAL_HYPOTHESIS_COUNT 10
+
+#define MAX_HYPOTHESIS_AGE 1.5
+#define MAX_FIT_QUALITY_AGE 0.5 //s - older fitness checks are not trusted to show that a target is tracked
+
+#define MAX_INIT_ITERATIONS 10000
+#define MAX_P3P_CORRESPONDENCES 64
+#define MAX_MUTATION_REFINE_ITERATIONS 1000
+
+#define UVDAR_RANGE(camera) ((camera).width()/50.0)
+
+#define EDGE_DETECTION_MARGIN 10
+
+#define SINGLETON_COVARIANCE 0.5
+
+/**
+ * @brief Retrieves a random number uniformly distributed in [0,1), from a generator local to the calling thread. Unlike rand(), this may be called by several threads at once
+ */
+static double uniformRandom(){
+  thread_local std::mt19937 generator(std::random_device{}());
+  thread_local std::uniform_real_distribution<double> distribution(0.0, 1.0);
+  return distribution(generator);
+}
+
+/**
+ * @brief Retrieves a random number uniformly distributed in [0,1], from rand()
+ */
+static double randomScale(){
+  return static_cast <double> (rand()) / static_cast <double> (RAND_MAX);
+}
+
+/* Hypothesis and AssociatedHypotheses //{ */
+int pose_core::Hypothesis::newUniqueId(){
+  static std::atomic<unsigned int> counter(0);
+  return (int)(counter++ & 0x7fffffffu);
+}
+
+pose_core::AssociatedHypotheses::AssociatedHypotheses(const std::vector<Hypothesis> &hs, int target_i){
+  hypotheses.insert(hypotheses.end(), hs.begin(), hs.end());
+  target = target_i;
+  for (auto &h :hypotheses){
+    if (h.flag == verified){
+      verified_count++;
+    }
+  }
+}
+
+std::list<pose_core::Hypothesis>::iterator pose_core::AssociatedHypotheses::at(int index){
+  return std::next(hypotheses.begin(), index);
+}
+
+std::vector<pose_core::Hypothesis> pose_core::AssociatedHypotheses::getVerified() const {
+  std::vector<Hypothesis> output;
+  for (auto &h : hypotheses){
+    if (h.flag == verified){
+      output.push_back(h);
+    }
+  }
+  return output;
+}
+
+std::list<pose_core::Hypothesis>::iterator pose_core::AssociatedHypotheses::removeHypothesis(std::list<Hypothesis>::iterator it){
+  if (hypotheses.empty()){
+    return it;
+  }
+  if (it->flag == verified){
+    verified_count--;
+  }
+  return hypotheses.erase(it);
+}
+
+void pose_core::AssociatedHypotheses::removeUnfit(){
+  hypotheses.remove_if([](const Hypothesis &h){return h.flag == unfit;});
+}
+
+void pose_core::AssociatedHypotheses::addHypothesis(const Hypothesis &h){
+  hypotheses.push_back(h);
+  if (h.flag == verified){
+    verified_count++;
+  }
+}
+
+void pose_core::AssociatedHypotheses::addHypotheses(const std::vector<Hypothesis> &hs){
+  for (auto &h :hs){
+    if (h.flag == verified){
+      verified_count++;
+    }
+  }
+  hypotheses.insert(hypotheses.end(), hs.begin(), hs.end());
+}
+
+void pose_core::AssociatedHypotheses::setVerified(std::list<Hypothesis>::iterator it){
+  if (it->flag != verified){
+    verified_count++;
+  }
+  it->flag = verified;
+}
+
+void pose_core::AssociatedHypotheses::setUnfit(std::list<Hypothesis>::iterator it){
+  if (it->flag == verified){
+    verified_count--;
+  }
+  it->flag = unfit;
+}
+
+void pose_core::AssociatedHypotheses::setNeutral(std::list<Hypothesis>::iterator it){
+  if (it->flag == verified){
+    verified_count--;
+  }
+  it->flag = neutral;
+}
+//}
+
+/* visibleDiameters //{ */
+static bool areSimultaneouslyVisible(const pose_core::Marker &a, const pose_core::Marker &b){
+  if ((a.type == 0) && (b.type == 0)){
+    return (a.pose.orientation.angularDistance(b.pose.orientation) < DIRECTIONAL_LED_VIEW_ANGLE);
+  }
+  return false; // non-directional markers are not yet implemented
+}
+
+std::pair<double,double> pose_core::visibleDiameters(const std::vector<Marker> &markers, const std::vector<std::vector<int>> &groups){
+  if ((int)(groups.size()) == 0){
+    return {-1,-1};
+  }
+
+  if ((int)(groups.size()) == 1){
+    return {std::numeric_limits<double>::max(), 0};
+  }
+
+  double max_dist = 0;
+  double min_dist = std::numeric_limits<double>::max();
+  for (int i=0; i<((int)(groups.size())-1); i++){
+    for (int j=i+1; j<(int)(groups.size()); j++){
+      if (areSimultaneouslyVisible(markers[groups[i][0]],markers[groups[j][0]])){
+        double tent_dist = (markers[groups[i][0]].pose.position - markers[groups[j][0]].pose.position).norm();
+        max_dist = std::max(max_dist, tent_dist);
+        min_dist = std::min(min_dist, tent_dist);
+      }
+    }
+  }
+  return {max_dist,min_dist};
+}
+//}
+
+/* initialization //{ */
+static double largestAngle(const std::vector<e::Vector3d> &directions){
+  double max_angle = 0;
+  for (int i = 0; i < ((int)(directions.size()) - 1); i++){
+    for (int j = i+1; j < (int)(directions.size()); j++){
+      max_angle = std::max(max_angle, acos(directions[i].normalized().dot(directions[j].normalized())));
+    }
+  }
+  return max_angle;
+}
+
+/**
+ * @brief Retrieves the furthest position at which the target may be, given the directions to its observed markers - the distance at which the largest visible diameter of the model spans the largest angle between them
+ */
+static e::Vector3d roughInit(const std::vector<e::Vector3d> &v_w, double max_diameter, const pose_core::CameraModel &camera){
+  e::Vector3d v_avg = {0,0,0};
+  for (auto& v: v_w){
+    v_avg += v;
+  }
+  v_avg = v_avg.normalized();
+  double l_max = UVDAR_RANGE(camera);
+  if ((int)(v_w.size()) > 1){
+    double alpha_max = largestAngle(v_w);
+    l_max = (max_diameter/2.0)/tan(alpha_max/2.0);
+  }
+  return v_avg*l_max*1.25;
+}
+
+static bool avgIsNearEdge(const std::vector<pose_core::ObservedPoint> &points, int margin, const pose_core::CameraModel &camera){
+  e::Vector2d mean(0,0);
+  for (auto &point : points){
+    mean += point.position;
+  }
+  mean /= (int)(points.size());
+  return (
+      (mean.x() < margin) ||
+      (mean.y() < margin) ||
+      (mean.x() > (camera.width()-margin)) ||
+      (mean.y() > (camera.height()-margin))
+      );
+}
+
+static pose_core::Hypothesis newHypothesis(const pose_core::Observation &observation, const pose_core::Pose &pose){
+  pose_core::Hypothesis output;
+  output.index = observation.target;
+  output.pose = pose;
+  output.flag = pose_core::neutral;
+  output.observed = observation.time;
+  output.propagated = observation.time;
+  return output;
+}
+
+static double hypothesisError(const pose_core::Reprojection &reprojection, const pose_core::Observation &observation, const pose_core::Hypothesis &hypothesis, double error_bound){
+  return reprojection.hypothesisError(*observation.markers, hypothesis.pose, observation.tocam, observation.points, error_bound);
+}
+
+/**
+ * @brief Samples random poses along the viewing direction up to the furthest possible position, and keeps the ones that explain the observation well enough
+ */
+static std::vector<pose_core::Hypothesis> viableInitialHypotheses(const pose_core::Reprojection &reprojection, const pose_core::Observation &observation, const e::Vector3d &furthest_position, double max_diameter, int initial_hypothesis_count){
+  e::Vector3d side_shift_init = furthest_position.unitOrthogonal()*max_diameter; // any direction in the null space of the view direction will do, since it gets rotated around it randomly
+
+  double threshold = (int)(observation.points.size())*ERROR_THRESHOLD_INITIAL(reprojection.camera());
+
+  std::vector<pose_core::Hypothesis> initial_hypotheses;
+  int iter = 0;
+  while ((int)(initial_hypotheses.size()) < initial_hypothesis_count){
+    double d = randomScale();
+    double sidestep_direction = randomScale();
+    double sidestep_distance = randomScale();
+
+    e::Vector3d side_shift_local = (e::AngleAxisd(2.0*M_PI*sidestep_direction,furthest_position.normalized())*side_shift_init)*sidestep_distance;
+    e::Vector3d current_position = (furthest_position*d) + (side_shift_local);
+
+    double a = randomScale();
+    e::Quaterniond current_orientation(e::AngleAxisd(a*2.0*M_PI, e::Vector3d::Random().normalized()));
+
+    auto hypo_new = newHypothesis(observation, {.position=observation.fromcam.orientation*current_position + observation.fromcam.position, .orientation=current_orientation});
+    if (hypothesisError(reprojection, observation, hypo_new, threshold) < threshold){
+      initial_hypotheses.push_back(hypo_new);
+    }
+    iter++;
+    if (iter > MAX_INIT_ITERATIONS){
+      break;
+    }
+  }
+  return initial_hypotheses;
+}
+
+static std::vector<pose_core::Hypothesis> refineByMutation(const pose_core::Reprojection &reprojection, const pose_core::Observation &observation, const std::vector<pose_core::Hypothesis> &hypotheses, double threshold_local, double position_max_step, double angle_max_step, unsigned int desired_count){
+  std::vector<pose_core::Hypothesis> output;
+  double threshold = (int)(observation.points.size())*threshold_local;
+
+  for (auto &h : hypotheses){
+    if (hypothesisError(reprojection, observation, h, threshold) < threshold){
+      output.push_back(h);
+      output.back().flag = pose_core::neutral;
+    }
+  }
+
+  int iter = 0;
+  while ((unsigned int)(output.size()) < desired_count){
+    for (auto &h : hypotheses){
+      for (auto &hm : pose_core::generateMutations(h, 1, position_max_step, angle_max_step)){
+        if (hypothesisError(reprojection, observation, hm, threshold) < threshold){
+          output.push_back(hm);
+          output.back().flag = pose_core::neutral;
+        }
+      }
+    }
+    iter++;
+    if (iter > MAX_MUTATION_REFINE_ITERATIONS){
+      break;
+    }
+  }
+  return output;
+}
+
+/**
+ * @brief Refines hypotheses by random mutation under progressively tighter error thresholds, adjusting the number of desired hypotheses in each step by the ratio of successfully refined ones in the previous step
+ */
+static std::vector<pose_core::Hypothesis> refineByMutationCascade(const pose_core::Reprojection &reprojection, const pose_core::Observation &observation, const std::vector<pose_core::Hypothesis> &hypotheses, int desired_count){
+  const auto &camera = reprojection.camera();
+  auto hypotheses_refined = refineByMutation(reprojection, observation, hypotheses, ERROR_THRESHOLD_MUTATION_1(camera), 1.0, 1.0, desired_count);
+  if (hypotheses_refined.size() == 0){
+    return hypotheses_refined;
+  }
+  double ratio_found_2 = (double)(hypotheses_refined.size()) / std::max(desired_count,1);
+  int desired_count_2 = (int)(ratio_found_2*desired_count);
+  hypotheses_refined = refineByMutation(reprojection, observation, hypotheses_refined, ERROR_THRESHOLD_MUTATION_2(camera), 1.0, 1.0, desired_count_2);
+  if (hypotheses_refined.size() == 0){
+    return hypotheses_refined;
+  }
+  double ratio_found_3 = (double)(hypotheses_refined.size()) / std::max(desired_count_2,1);
+  int desired_count_3 = (int)(ratio_found_3*desired_count_2);
+  return refineByMutation(reprojection, observation, hypotheses_refined, ERROR_THRESHOLD_MUTATION_3(camera), 1.0, 1.0, desired_count_3);
+}
+
+std::vector<pose_core::Hypothesis> pose_core::initialHypotheses(const Reprojection &reprojection, const Observation &observation, const std::vector<std::vector<int>> &groups, double max_diameter, bool p3p_initialization, bool lm_refinement, const StageCallback &stage_finished){
+  auto stage = [&stage_finished](const std::string &name){
+    if (stage_finished){
+      stage_finished(name);
+    }
+  };
+  const auto &camera = reprojection.camera();
+  const auto &points = observation.points;
+  if (points.empty()){
+    return {};
+  }
+
+  double alpha_max = 0;
+  std::vector<e::Vector3d> v_w;
+  e::Vector3d furthest_position;
+  if (points.size() != 1){
+    for (auto& point: points){
+      v_w.push_back(camera.direction(point.position));
+    }
+    alpha_max = largestAngle(v_w);
+  }
+  const bool near_edge = avgIsNearEdge(points, EDGE_DETECTION_MARGIN, camera);
+  if ((points.size() == 1) || (alpha_max < 0.01) || near_edge){
+    furthest_position = camera.direction(points.front().position)*UVDAR_RANGE(camera); //max range
+  }
+  else {
+    furthest_position = roughInit(v_w, max_diameter, camera);
+  }
+  stage("Rough initialization");
+
+  std::vector<Hypothesis> hypotheses_init;
+  bool p3p_seeded = false;
+  if (p3p_initialization && (points.size() >= 3) && (alpha_max >= 0.01) && (!near_edge)){
+    double threshold = (int)(points.size())*ERROR_THRESHOLD_INITIAL(camera);
+    for (auto &[pose, error_total] : reprojection.p3pPoses(*observation.markers, groups, points, observation.fromcam, observation.tocam, threshold, MAX_P3P_CORRESPONDENCES)){
+      hypotheses_init.push_back(newHypothesis(observation, pose));
+    }
+    p3p_seeded = (hypotheses_init.size() > 0);
+    stage("P3P seeding");
+  }
+
+  if (!p3p_seeded){ //random sampling is kept as a fallback for when there are too few markers or the minimal solver found no fitting pose
+    hypotheses_init = viableInitialHypotheses(reprojection, observation, furthest_position, max_diameter, INITIAL_ROUGH_HYPOTHESIS_COUNT);
+    stage("InitialHypotheses");
+  }
+  double init_hypothesis_count = (double)(hypotheses_init.size());
+  double ratio_found = init_hypothesis_count / (double)(INITIAL_ROUGH_HYPOTHESIS_COUNT);
+
+  int desired_count = (p3p_seeded?INITIAL_HYPOTHESIS_COUNT:(int)(ratio_found*INITIAL_HYPOTHESIS_COUNT)); // P3P seeds are exact, so we only need to spread them out a little
+
+  std::vector<Hypothesis> hypotheses_refined;
+  if (lm_refinement && (hypotheses_init.size() > 0)){
+    double threshold = (int)(points.size())*ERROR_THRESHOLD_MUTATION_3(camera);
+    std::vector<Hypothesis> hypotheses_converged, hypotheses_diverged;
+    for (auto &h : hypotheses_init){
+      auto pose = reprojection.refine(*observation.markers, h.pose, observation.tocam, points, threshold);
+      if (pose){
+        Hypothesis h_refined = h;
+        h_refined.pose = pose.value();
+        h_refined.flag = neutral;
+        hypotheses_converged.push_back(h_refined);
+      }
+      else {
+        hypotheses_diverged.push_back(h);
+      }
+    }
+    hypotheses_init = hypotheses_diverged;
+    stage("LM refinement");
+    int desired_count_diverged = (int)(desired_count*((double)(hypotheses_init.size())/init_hypothesis_count)); // the seeds for which the solver diverged are left to the full mutation search
+    if (hypotheses_converged.size() > 0){ // the converged seeds already fit, so they only need to be spread out at the final threshold
+      hypotheses_refined = refineByMutation(reprojection, observation, hypotheses_converged, ERROR_THRESHOLD_MUTATION_3(camera), 1.0, 1.0, std::max(desired_count - desired_count_diverged, 0));
+      stage("LM spreading");
+    }
+    desired_count = desired_count_diverged;
+  }
+
+  if (hypotheses_init.size() > 0){
+    auto hypotheses_mutated = refineByMutationCascade(reprojection, observation, hypotheses_init, desired_count);
+    stage("Mutation refinement");
+    hypotheses_refined.insert(hypotheses_refined.end(), hypotheses_mutated.begin(), hypotheses_mutated.end());
+  }
+
+  if (hypotheses_refined.size() == 0){
+    stage("Viable initial hypotheses");
+    return hypotheses_refined;
+  }
+
+  int static_hypothesis_count = (int)(hypotheses_refined.size());
+  for (int i=0; i<static_hypothesis_count; i++){
+    auto new_mutations = generateVelocityMutations(hypotheses_refined.at(i), 5, neutral, 1.0);
+    hypotheses_refined.insert(hypotheses_refined.end(),new_mutations.begin(),new_mutations.end());
+  }
+  stage("Initial Velocity Mutation");
+
+  for (auto &h : hypotheses_refined){
+    h.twist.linear = (e::Vector3d::Random().normalized())*randomScale()*MAX_INITIAL_VELOCITY;
+  }
+  stage("Viable initial hypotheses");
+
+  return hypotheses_refined;
+}
+//}
+
+/* mutation //{ */
+std::vector<pose_core::Hypothesis> pose_core::generateMutations(const Hypothesis &hin, int count, double position_max_step, double angle_max_step){
+  std::vector<Hypothesis> output;
+  if (position_max_step < 0)
+    position_max_step = MUTATION_POSITION_MAX_STEP*SCATTER_TIME_STEP;//m
+  if (angle_max_step < 0)
+    angle_max_step = MUTATION_ORIENTATION_MAX_STEP*SCATTER_TIME_STEP;//rad
+
+  Hypothesis current_mutation;
+  current_mutation.index=hin.index;
+  current_mutation.flag=neutral;
+  current_mutation.observed=hin.observed;
+  current_mutation.propagated=hin.propagated;
+  current_mutation.twist.linear = hin.twist.linear;
+
+  for (int i = 0; i < count; i++) {
+    e::Vector3d offset_position = (e::Vector3d::Random().normalized())*randomScale()*position_max_step;
+    current_mutation.pose.position = hin.pose.position+offset_position;
+
+    auto offset_rotation = e::AngleAxisd(randomScale()*angle_max_step, e::Vector3d::Random().normalized());
+    current_mutation.pose.orientation = offset_rotation*hin.pose.orientation;
+
+    current_mutation.unique_id = Hypothesis::newUniqueId();
+    output.push_back(current_mutation);
+  }
+  return output;
+}
+
+std::vector<pose_core::Hypothesis> pose_core::generateVelocityMutations(const Hypothesis &hin, int count, HypothesisFlag flag, double velocity_max_step){
+  std::vector<Hypothesis> output;
+  if (velocity_max_step < 0)
+    velocity_max_step = MUTATION_VELOCITY_MAX_STEP*SCATTER_TIME_STEP;//m
+
+  Hypothesis current_mutation;
+  current_mutation.index=hin.index;
+  current_mutation.flag=flag;
+  current_mutation.observed=hin.observed;
+  current_mutation.propagated=hin.propagated;
+  current_mutation.pose = hin.pose;
+
+  for (int i = 0; i < count; i++) {
+    e::Vector3d offset_velocity = (e::Vector3d::Random().normalized())*randomScale()*velocity_max_step;
+    current_mutation.twist.linear = hin.twist.linear+offset_velocity;
+    current_mutation.unique_id = Hypothesis::newUniqueId();
+    output.push_back(current_mutation);
+  }
+  return output;
+}
+
+std::vector<pose_core::Hypothesis> pose_core::mutateHypotheses(const AssociatedHypotheses &hypotheses, int count){
+  if (std::none_of(hypotheses.hypotheses.begin(), hypotheses.hypotheses.end(), [](const Hypothesis &h){return h.flag != unfit;})){
+    return {}; // only unfit parents would be drawn
+  }
+
+  std::vector<Hypothesis> mutations;
+  for (int i = 0; i < count; i++){
+    int parent_index = rand() % (int)(hypotheses.hypotheses.size());
+    const auto &selected = *std::next(hypotheses.hypotheses.begin(), parent_index);
+
+    if (selected.flag == verified){
+      auto new_mutations = generateVelocityMutations(selected, 10, neutral, 1.0);//verification from current image only checks if they fit in the current moment - the target may have been moving differently than the hypothesis
+      mutations.insert(mutations.end(),new_mutations.begin(),new_mutations.end());
+
+      new_mutations = generateMutations(selected, 10, 1.0, 1.0);
+      mutations.insert(mutations.end(),new_mutations.begin(),new_mutations.end());
+    }
+    else if (selected.flag == neutral){
+      auto new_mutations = generateMutations(selected, 1, 1.0, 1.0);//consider them as old as the parent if the parent wasn't verified
+      mutations.insert(mutations.end(),new_mutations.begin(),new_mutations.end());
+    }
+    else{
+      i--;
+    }
+  }
+  return mutations;
+}
+//}
+
+/* fitness //{ */
+static bool isInView(const pose_core::Hypothesis &h, const pose_core::CameraModel &camera, const pose_core::Pose &tocam){
+  auto projected = camera.project(tocam.orientation*h.pose.position + tocam.position);
+  return (
+      (projected.x() >= 0) &&
+      (projected.y() >= 0) &&
+      (projected.x() < camera.width()) &&
+      (projected.y() < camera.height())
+      );
+}
+
+pose_core::FitnessStatistics pose_core::checkHypothesisFitness(AssociatedHypotheses &hypotheses, const Reprojection &reprojection, const Observation &observation, int camera_index){
+  FitnessStatistics output;
+  const auto &camera = reprojection.camera();
+  const int observed_count = (int)(observation.points.size());
+  const double threshold_scaled_unfit = observed_count*PF_REPROJECT_THRESHOLD_UNFIT(camera);
+  const double threshold_scaled_verified = observed_count*PF_REPROJECT_THRESHOLD_VERIFIED(camera);
+
+  double best_error = std::numeric_limits<double>::max();
+  for (auto hit = hypotheses.hypotheses.begin(); hit!=hypotheses.hypotheses.end(); hit++){
+    if (!isInView(*hit, camera, observation.tocam)){
+      continue;
+    }
+    ErrorOutcome outcome;
+    double error_total = reprojection.hypothesisError(*observation.markers, hit->pose, observation.tocam, observation.points, threshold_scaled_unfit, false, nullptr, &outcome);
+    output.evaluations++;
+    if (outcome == ErrorOutcome::outside_view){
+      output.outside_view++;
+    }
+    else if (outcome == ErrorOutcome::early_exit){
+      output.early_exits++;
+    }
+    best_error = std::min(best_error, error_total/observed_count);
+    hit->fitness_error = error_total/threshold_scaled_verified;
+
+    if (error_total > threshold_scaled_unfit){
+      hypotheses.setUnfit(hit);
+      output.unfit++;
+    }
+    else if (error_total < threshold_scaled_verified) {
+      hypotheses.setVerified(hit);
+      hit->observed = observation.time;
+      output.verified++;
+    }
+    else {
+      hypotheses.setNeutral(hit);
+    }
+  }
+  hypotheses.fit_quality[camera_index] = {best_error, observed_count, observation.time};
+  return output;
+}
+
+bool pose_core::isTargetTracked(const AssociatedHypotheses &hypotheses, const CameraModel &camera, int camera_index, int observed_count, double time, double reinitialization_period){
+  if ((time - hypotheses.last_initialization) > reinitialization_period){
+    return false;
+  }
+  if (hypotheses.verified_count == 0){
+    return false;
+  }
+  auto fit = hypotheses.fit_quality.find(camera_index);
+  if (fit == hypotheses.fit_quality.end()){
+    return false;
+  }
+  if ((time - fit->second.time) > MAX_FIT_QUALITY_AGE){
+    return false;
+  }
+  if (fit->second.observed_count < observed_count){
+    return false;
+  }
+  return (fit->second.best_error < PF_REPROJECT_THRESHOLD_VERIFIED(camera));
+}
+//}
+
+/* culling //{ */
+void pose_core::removeOldHypotheses(AssociatedHypotheses &hypotheses, double time){
+  for (auto hit = hypotheses.hypotheses.begin(); hit!=hypotheses.hypotheses.end();){
+    if ((time - hit->observed) > MAX_HYPOTHESIS_AGE){
+      hit = hypotheses.removeHypothesis(hit);
+    }
+    else {
+      hit++;
+    }
+  }
+}
+
+int pose_core::adaptiveHypothesisCount(const AssociatedHypotheses &hypotheses){
+  if (hypotheses.verified_count == 0){
+    return MAX_HYPOTHESIS_COUNT;
+  }
+
+  std::set<std::array<int,6>> occupied_bins;
+  for (auto &h : hypotheses.hypotheses){
+    e::AngleAxisd rotation(h.pose.orientation);
+    e::Vector3d rotation_vector = rotation.angle()*rotation.axis();
+    occupied_bins.insert({
+        (int)(std::floor(h.pose.position.x()/KLD_BIN_POSITION)),
+        (int)(std::floor(h.pose.position.y()/KLD_BIN_POSITION)),
+        (int)(std::floor(h.pose.position.z()/KLD_BIN_POSITION)),
+        (int)(std::floor(rotation_vector.x()/KLD_BIN_ANGLE)),
+        (int)(std::floor(rotation_vector.y()/KLD_BIN_ANGLE)),
+        (int)(std::floor(rotation_vector.z()/KLD_BIN_ANGLE))
+        });
+  }
+
+  int k = (int)(occupied_bins.size());
+  if (k < 2){
+    return MIN_HYPOTHESIS_COUNT;
+  }
+  double a = 2.0/(9.0*(k-1));
+  double count = ((k-1)/(2.0*KLD_ERROR_BOUND))*pow(1.0 - a + sqrt(a)*KLD_QUANTILE, 3);
+  return std::clamp((int)(std::ceil(count)), MIN_HYPOTHESIS_COUNT, MAX_HYPOTHESIS_COUNT);
+}
+
+int pose_core::maxHypothesisCount(){
+  return MAX_HYPOTHESIS_COUNT;
+}
+
+void pose_core::systematicResampling(const std::vector<double> &weights, int count, double offset, std::vector<int> &copies){
+  double weight_sum = 0;
+  int last_positive = -1; // rounding must not let the draws run past the last entry that can be drawn
+  for (int i = 0; i < (int)(weights.size()); i++){
+    if (weights[i] > 0){
+      last_positive = i;
+      weight_sum += weights[i];
+    }
+  }
+  if ((count <= 0) || (last_positive < 0)){
+    return;
+  }
+
+  const double step = weight_sum/count;
+  double pointer = step*offset;
+  double cumulative_weight = 0;
+  int j = 0;
+  for (int i = 0; i < count; i++){
+    while ((j < last_positive) && ((weights[j] <= 0) || ((cumulative_weight + weights[j]) <= pointer))){
+      cumulative_weight += std::max(weights[j], 0.0);
+      j++;
+    }
+    copies[j]++;
+    pointer += step;
+  }
+}
+
+void pose_core::resampleHypotheses(AssociatedHypotheses &hypotheses, int count){
+  thread_local std::vector<double> weights; // kept between calls, so that their capacity is reused
+  thread_local std::vector<int> copies;
+  const int hypothesis_count = (int)(hypotheses.hypotheses.size());
+  weights.assign(hypothesis_count, 0.0);
+  copies.assign(hypothesis_count, 0);
+
+  const bool verified_only = (hypotheses.verified_count >= count);
+  const int draw_count = (verified_only?count:(count - hypotheses.verified_count));
+
+  // the weights are relative to the best hypothesis of the pool, so that they do not all underflow if the errors are large
+  double min_fitness_error = std::numeric_limits<double>::max();
+  for (auto &h : hypotheses.hypotheses){
+    if (((h.flag == verified) == verified_only) && (h.fitness_error >= 0)){
+      min_fitness_error = std::min(min_fitness_error, h.fitness_error);
+    }
+  }
+
+  double checked_weight_sum = 0;
+  int checked_count = 0;
+  int k = 0;
+  for (auto &h : hypotheses.hypotheses){
+    if ((h.flag == verified) != verified_only){
+      copies[k] = (verified_only?0:1); // verified hypotheses outside of the pool are kept as they are
+    }
+    else if (h.fitness_error < 0){
+      weights[k] = -1; // assigned below, once the mean is known
+    }
+    else {
+      weights[k] = exp(-(h.fitness_error - min_fitness_error)/RESAMPLING_TEMPERATURE);
+      checked_weight_sum += weights[k];
+      checked_count++;
+    }
+    k++;
+  }
+  const double unchecked_weight = ((checked_count > 0)?(checked_weight_sum/checked_count):1.0);
+  for (auto &w : weights){
+    if (w < 0){
+      w = unchecked_weight;
+    }
+  }
+
+  systematicResampling(weights, draw_count, uniformRandom(), copies);
+
+  k = 0;
+  hypotheses.verified_count = 0;
+  for (auto hit = hypotheses.hypotheses.begin(); hit != hypotheses.hypotheses.end(); k++){
+    if (copies[k] == 0){
+      hit = hypotheses.hypotheses.erase(hit);
+      continue;
+    }
+    auto next = std::next(hit);
+    for (int c = 1; c < copies[k]; c++){
+      auto copy = hypotheses.hypotheses.insert(next, *hit);
+      copy->unique_id = Hypothesis::newUniqueId(); //copies need to be distinguishable, e.g. for the warm start of the enclosing ellipsoids
+    }
+    if (hit->flag == verified){
+      hypotheses.verified_count += copies[k];
+    }
+    hit = next;
+  }
+}
+
+void pose_core::removeExtraHypotheses(AssociatedHypotheses &hypotheses, double time, bool adaptive_count, bool weighted_resampling){
+  removeOldHypotheses(hypotheses, time);
+
+  int hypothesis_limit = (adaptive_count?adaptiveHypothesisCount(hypotheses):MAX_HYPOTHESIS_COUNT);
+
+  if (weighted_resampling){
+    if ((int)(hypotheses.hypotheses.size()) > hypothesis_limit){
+      resampleHypotheses(hypotheses, hypothesis_limit);
+    }
+    return;
+  }
+
+  std::vector<std::list<Hypothesis>::iterator> nonverified_hypotheses;
+  for (auto hit = hypotheses.hypotheses.begin(); hit!=hypotheses.hypotheses.end(); hit++){
+    if (hit->flag != verified){
+      nonverified_hypotheses.push_back(hit);
+    }
+  }
+  while (((int)(hypotheses.hypotheses.size()) > hypothesis_limit) && (nonverified_hypotheses.size() > 0) ){ //first, let's try to remove the unverified only...
+    int cull_index_selection = rand() % (int)(nonverified_hypotheses.size());
+    hypotheses.removeHypothesis(nonverified_hypotheses.at(cull_index_selection));
+    nonverified_hypotheses.erase(nonverified_hypotheses.begin()+cull_index_selection);
+  }
+  while ((int)(hypotheses.hypotheses.size()) > hypothesis_limit){
+    hypotheses.removeHypothesis(hypotheses.at(rand() % (int)(hypotheses.hypotheses.size())));
+  }
+}
+//}
+
+void pose_core::propagateHypotheses(AssociatedHypotheses &hypotheses, double time){
+  for (auto &h : hypotheses.hypotheses){
+    h.pose.position += h.twist.linear*(time-h.propagated);
+    h.propagated = time;
+  }
+}
+
+/* fuseHypotheses //{ */
+std::optional<std::pair<pose_core::Pose,pose_core::Matrix6d>> pose_core::fuseHypotheses(AssociatedHypotheses &meas){
+  if ((meas.hypotheses.size() < 1) || (meas.verified_count < 1)){
+    return std::nullopt;
+  }
+
+  if (meas.verified_count == 1){
+    Pose singleton;
+    for (auto &h : meas.hypotheses){
+      if (h.flag == verified){
+        singleton = h.pose;
+      }
+    }
+    Matrix6d C = Matrix6d::Zero();
+    C.topLeftCorner(3,3) = SINGLETON_COVARIANCE*e::Matrix3d::Identity();
+    C.bottomRightCorner(3,3) = SINGLETON_COVARIANCE*e::Matrix3d::Identity();
+    return std::pair<Pose,Matrix6d>(singleton, C);
+  }
+
+  // position
+  e::Vector3d mean_pos(0.0,0.0,0.0);
+  for (auto &m : meas.hypotheses){
+    if (m.flag == verified){
+      mean_pos += m.pose.position;
+    }
+  }
+  mean_pos /= ((double)(meas.hypotheses.size()));
+
+  // orientation
+  std::vector<e::Quaterniond> meas_rot;
+  for (auto &m : meas.hypotheses){
+    if (m.flag == verified){
+      meas_rot.push_back(m.pose.orientation);
+    }
+  }
+  e::Quaterniond mean_rot = averageOrientation(meas_rot);
+
+  std::vector<e::Vector3d> meas_pos_diff, meas_rpy_diff;
+  std::vector<int> meas_ids;
+  std::vector<double> pos_weights, rpy_weights;
+  for (auto &m : meas.hypotheses){
+    if (m.flag == verified){
+      meas_pos_diff.push_back(m.pose.position-mean_pos);
+      meas_rpy_diff.push_back(quaternionToRPY(m.pose.orientation*mean_rot.inverse()));
+      meas_ids.push_back(m.unique_id);
+      auto pw = meas.position_hull_weights.find(m.unique_id);
+      pos_weights.push_back((pw != meas.position_hull_weights.end())?pw->second:0.0);
+      auto ow = meas.orientation_hull_weights.find(m.unique_id);
+      rpy_weights.push_back((ow != meas.orientation_hull_weights.end())?ow->second:0.0);
+    }
+  }
+
+  auto Hp = enclosingEllipsoid(meas_pos_diff, &pos_weights);
+  if ( (Hp.first.array().isNaN().any()) ||(Hp.second.array().isNaN().any()) ){
+    return std::nullopt;
+  }
+  auto Ho = enclosingEllipsoid(meas_rpy_diff, &rpy_weights);
+  if ( (Ho.first.array().isNaN().any()) ||(Ho.second.array().isNaN().any()) ){
+    return std::nullopt;
+  }
+
+  meas.position_hull_weights.clear();
+  meas.orientation_hull_weights.clear();
+  for (int i = 0; i < (int)(meas_ids.size()); i++){
+    meas.position_hull_weights[meas_ids[i]] = pos_weights[i];
+    meas.orientation_hull_weights[meas_ids[i]] = rpy_weights[i];
+  }
+
+  e::Quaterniond mean_rot_shift =
+    e::AngleAxisd(Ho.first(0), e::Vector3d::UnitX()) *
+    e::AngleAxisd(Ho.first(1), e::Vector3d::UnitY()) *
+    e::AngleAxisd(Ho.first(2), e::Vector3d::UnitZ());
+
+  Matrix6d C = Matrix6d::Zero();
+  C.topLeftCorner(3,3) = Hp.second;
+  C.bottomRightCorner(3,3) = Ho.second;
+
+  return std::pair<Pose,Matrix6d>({.position=mean_pos+Hp.first, .orientation=mean_rot*mean_rot_shift}, C);
+}
+//}
@@ -0,0 +1,260 @@
+#ifndef _POSE_CORE_HYPOTHESES_H_
+#define _POSE_CORE_HYPOTHESES_H_
+#include <vector>
+#include <list>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <optional>
+#include <functional>
+#include <unordered_map>
+#include "pose_core.h"
+
+#define SCATTER_TIME_STEP 0.1 //s - period in which the hypotheses are scattered, propagated and fused into measurements
+
+namespace uvdar {
+
+  namespace pose_core {
+
+    enum HypothesisFlag { neutral, unfit, verified };
+
+    struct Twist {
+      e::Vector3d linear = e::Vector3d::Zero();
+      e::Quaterniond angular = e::Quaterniond::Identity(); //TODO or remove
+    };
+
+    /**
+     * @brief A hypothesis of the pose of a target, as a particle of the particle filter of that target. The times are in seconds, on the clock of the observations
+     */
+    struct Hypothesis {
+      int index = -1; // the target
+      Pose pose; // in the output frame
+      Twist twist;
+      HypothesisFlag flag = neutral;
+      double observed = 0; // the last time the hypothesis was verified by an observation
+      double propagated = 0; // the time up to which the pose was propagated by the twist
+      int unique_id;
+      double fitness_error = -1; //reprojection error per point relative to the verification threshold, from the last fitness check in which the hypothesis was in view. Negative if not yet checked.
+
+      Hypothesis() : unique_id(newUniqueId()) {}
+
+      /**
+       * @brief Retrieves an identifier not yet assigned to any hypothesis. Safe to call from multiple threads, wraps around only after 2^31 hypotheses
+       */
+      static int newUniqueId();
+    };
+
+    /**
+     * @brief A single observation of a target by a camera, converted once for the evaluation of many hypotheses
+     */
+    struct Observation {
+      int target = -1;
+      const std::vector<Marker> *markers = nullptr; // the model of the target, with the signals of the target
+      Pose tocam; // from the output frame to the camera
+      Pose fromcam;
+      std::vector<ObservedPoint> points; // the points associated with the target
+      double time = 0; //s
+    };
+
+    /**
+     * @brief The hypotheses associated with a single target, with the bookkeeping the hypothesis lifecycle below relies on
+     */
+    class AssociatedHypotheses {
+      public:
+        std::list<Hypothesis> hypotheses;
+        int target;
+        int verified_count = 0;
+        std::unordered_map<int,double> position_hull_weights; //weights of the verified hypotheses in the enclosing ellipsoids of the last cycle, by unique_id, used to warm-start the next one
+        std::unordered_map<int,double> orientation_hull_weights;
+
+        /**
+         * @brief How well the hypotheses explained the observation of a camera in the last fitness check
+         */
+        struct FitQuality {
+          double best_error; //lowest reprojection error per observed point among the hypotheses in view
+          int observed_count; //number of points of the target in the observation
+          double time;
+        };
+        std::unordered_map<int,FitQuality> fit_quality; //by camera index
+        double last_initialization = 0;
+
+        std::mutex mutex; //guards the hypotheses of this target for callers processing several targets concurrently. Not used by the functions below
+
+        AssociatedHypotheses(const std::vector<Hypothesis> &hs, int target_i);
+
+        std::list<Hypothesis>::iterator at(int index);
+
+        std::vector<Hypothesis> getVerified() const;
+
+        std::list<Hypothesis>::iterator removeHypothesis(std::list<Hypothesis>::iterator it);
+
+        void removeUnfit();
+
+        void addHypothesis(const Hypothesis &h);
+
+        void addHypotheses(const std::vector<Hypothesis> &hs);
+
+        void setVerified(std::list<Hypothesis>::iterator it);
+
+        void setUnfit(std::list<Hypothesis>::iterator it);
+
+        void setNeutral(std::list<Hypothesis>::iterator it);
+    };
+
+    /**
+     * @brief Called with the name of each stage of a computation once it finishes, e.g. to profile the stages
+     */
+    typedef std::function<void (const std::string &stage)> StageCallback;
+
+    /**
+     * @brief Retrieves the largest and the smallest distance between LED groups of a model that can be seen at the same time
+     *
+     * @param markers The markers of the model
+     * @param groups The groups of co-located markers, see groupMarkers
+     *
+     * @return The largest and the smallest distance, or -1 for both if there are no groups
+     */
+    std::pair<double,double> visibleDiameters(const std::vector<Marker> &markers, const std::vector<std::vector<int>> &groups);
+
+    /**
+     * @brief Generates fresh hypotheses of the pose of a target from a single observation. If enabled and possible, they are seeded analytically by P3P, otherwise by random sampling of poses along the viewing direction. The seeds are then refined by Levenberg-Marquardt if enabled, and the rest by random mutation under progressively tighter error thresholds. Each resulting hypothesis is finally spread out into several with random velocities.
+     *
+     * @param reprojection The reprojection of the observing camera
+     * @param observation The observation of the target
+     * @param groups The groups of co-located markers of the model, see groupMarkers
+     * @param max_diameter The largest visible diameter of the model, see visibleDiameters
+     * @param p3p_initialization Whether to seed the hypotheses by P3P. If false, the random sampling is always used
+     * @param lm_refinement Whether to refine the seeds by Levenberg-Marquardt
+     * @param stage_finished If provided, is called after each stage
+     *
+     * @return The new hypotheses, neutral and observed at the time of the observation
+     */
+    std::vector<Hypothesis> initialHypotheses(const Reprojection &reprojection, const Observation &observation, const std::vector<std::vector<int>> &groups, double max_diameter, bool p3p_initialization = true, bool lm_refinement = true, const StageCallback &stage_finished = nullptr);
+
+    /**
+     * @brief Generates mutations of a hypothesis with randomly shifted and rotated poses
+     *
+     * @param position_max_step The largest shift, by default the one reachable in SCATTER_TIME_STEP
+     * @param angle_max_step The largest rotation, by default the one reachable in SCATTER_TIME_STEP
+     */
+    std::vector<Hypothesis> generateMutations(const Hypothesis &hin, int count, double position_max_step = -1.0, double angle_max_step = -1.0);
+
+    /**
+     * @brief Generates mutations of a hypothesis with the same pose and randomly changed velocities
+     *
+     * @param velocity_max_step The largest change of the velocity, by default the one reachable in SCATTER_TIME_STEP
+     */
+    std::vector<Hypothesis> generateVelocityMutations(const Hypothesis &hin, int count, HypothesisFlag flag = neutral, double velocity_max_step = -1.0);
+
+    /**
+     * @brief Draws parents from the hypotheses of a target and generates their mutations. Verified parents are spread out more, in both the pose and the velocity, since their verification only shows that they fit the current moment
+     *
+     * @param hypotheses The hypotheses of the target
+     * @param count The number of parents to draw
+     *
+     * @return The mutations, not yet added to the hypotheses
+     */
+    std::vector<Hypothesis> mutateHypotheses(const AssociatedHypotheses &hypotheses, int count);
+
+    /**
+     * @brief Statistics of a fitness check of the hypotheses of a target
+     */
+    struct FitnessStatistics {
+      int evaluations = 0; // hypotheses in view, for which the error was evaluated
+      int outside_view = 0; // of those, rejected by the view frustum
+      int early_exits = 0; // of those, terminated early by the error bound
+      int verified = 0;
+      int unfit = 0;
+    };
+
+    /**
+     * @brief Checks the hypotheses of a target in view of a camera against its observation, flags them as verified, neutral or unfit by their reprojection errors, and records how well the best one fit for isTargetTracked. The unfit ones are left in place, see AssociatedHypotheses::removeUnfit
+     *
+     * @param hypotheses The hypotheses of the target
+     * @param reprojection The reprojection of the observing camera
+     * @param observation The observation of the target by that camera
+     * @param camera_index The index of the camera, under which the fit is recorded
+     *
+     * @return Statistics of the check
+     */
+    FitnessStatistics checkHypothesisFitness(AssociatedHypotheses &hypotheses, const Reprojection &reprojection, const Observation &observation, int camera_index);
+
+    /**
+     * @brief Checks whether the existing hypotheses of a target already explain its current observation, such that generating fresh hypotheses for it would be wasted effort. This is the case if the last fitness check in this camera is recent, it covered at least as many points as are observed now, and its best hypothesis was good enough to be verified. To recover from a consistent but wrong set of hypotheses, the target is nevertheless re-initialized periodically.
+     *
+     * @param hypotheses The hypotheses of the target
+     * @param camera The observing camera
+     * @param camera_index The index of the camera
+     * @param observed_count The number of points of the target observed now
+     * @param time The time of the observation
+     * @param reinitialization_period The target is re-initialized at least this often
+     *
+     * @return True if initialization of this target can be skipped
+     */
+    bool isTargetTracked(const AssociatedHypotheses &hypotheses, const CameraModel &camera, int camera_index, int observed_count, double time, double reinitialization_period);
+
+    /**
+     * @brief Removes the hypotheses that were not verified for too long
+     */
+    void removeOldHypotheses(AssociatedHypotheses &hypotheses, double time);
+
+    /**
+     * @brief Retrieves the number of hypotheses sufficient to represent the current distribution of hypotheses for a target, using the KLD-sampling bound [D. Fox, "Adapting the sample size in particle filters through KLD-sampling" (IJRR 2003)]. The pose space is divided into bins, and the count grows with the number of bins occupied by the hypotheses. Targets without verified hypotheses are given the maximum count, since their observations have been lost.
+     *
+     * @param hypotheses The set of hypotheses associated with a target
+     *
+     * @return The number of hypotheses to keep, between MIN_HYPOTHESIS_COUNT and MAX_HYPOTHESIS_COUNT
+     */
+    int adaptiveHypothesisCount(const AssociatedHypotheses &hypotheses);
+
+    /**
+     * @brief Retrieves the fixed number of hypotheses kept per target if the count is not adapted
+     */
+    int maxHypothesisCount();
+
+    /**
+     * @brief Draws a number of samples by systematic resampling [G. Kitagawa, "Monte Carlo filter and smoother for non-Gaussian nonlinear state space models" (JCGS 1996)]. The draws are evenly spaced over the cumulative weights, with a single random offset, so that the expected number of copies of each entry is count*w_i/sum(w)
+     *
+     * @param weights The non-negative weights of the entries. Entries with zero weight are never drawn
+     * @param count The number of samples to draw
+     * @param offset The random offset in [0,1)
+     * @param copies Output - the number of copies drawn of each entry, added to the values it holds, which must be as many as the weights
+     */
+    void systematicResampling(const std::vector<double> &weights, int count, double offset, std::vector<int> &copies);
+
+    /**
+     * @brief Replaces the hypotheses of a target by a smaller set drawn by systematic resampling [G. Kitagawa, "Monte Carlo filter and smoother for non-Gaussian nonlinear state space models" (JCGS 1996)], such that the number of copies of each hypothesis is proportional to its fitness. Verified hypotheses are kept ahead of the others - if there are fewer of them than the count, all of them are kept once and only the rest is drawn from the unverified ones, otherwise only the verified ones are drawn from. Hypotheses not yet checked against an observation are weighted by the mean weight of the checked ones they are drawn with. The surviving hypotheses are kept in place and only the extra copies are inserted, in linear time in the number of hypotheses.
+     *
+     * @param hypotheses The set of hypotheses associated with a target
+     * @param count The number of hypotheses to draw
+     */
+    void resampleHypotheses(AssociatedHypotheses &hypotheses, int count);
+
+    /**
+     * @brief Removes the old hypotheses of a target, and then culls the rest down to the adaptive or the fixed count, either by resampling or by random removal of the unverified ones first
+     *
+     * @param adaptive_count Whether to use adaptiveHypothesisCount instead of maxHypothesisCount
+     * @param weighted_resampling Whether to cull by resampleHypotheses
+     */
+    void removeExtraHypotheses(AssociatedHypotheses &hypotheses, double time, bool adaptive_count = true, bool weighted_resampling = true);
+
+    /**
+     * @brief Propagates the poses of the hypotheses of a target by their velocities up to the given time
+     */
+    void propagateHypotheses(AssociatedHypotheses &hypotheses, double time);
+
+    /**
+     * @brief Fuses the verified hypotheses of a target into a single measurement of its pose, as the center and the shape of the enclosing ellipsoids of their positions and orientations. The weights of the ellipsoids are kept in the hypotheses, to warm-start the next fusion
+     *
+     * @param hypotheses The hypotheses of the target
+     *
+     * @return The pose and its covariance, or nothing if there are no verified hypotheses or the ellipsoids are degenerate
+     */
+    std::optional<std::pair<Pose,Matrix6d>> fuseHypotheses(AssociatedHypotheses &hypotheses);
+
+  } //pose_core
+
+} //uvdar
+
+
+#endif // _POSE_CORE_HYPOTHESES_H_
@@ -0,0 +1,163 @@
+#ifndef _POSE_CORE_INPUT_QUEUE_H_
+#define _POSE_CORE_INPUT_QUEUE_H_
+#include <deque>
+#include <list>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <utility>
+#include <optional>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+namespace uvdar {
+
+  namespace pose_core {
+
+    /**
+     * @brief Observations of a single camera waiting to be used by its particle filtering worker, together with the statistics of the queue. The observations are pushed by the callbacks of the camera as they arrive, and popped by the worker, which reports when it has finished each of them
+     */
+    template <class T>
+    class InputQueue {
+      public:
+        typedef std::chrono::steady_clock Clock;
+
+        struct Statistics {
+          unsigned long received_count = 0;
+          unsigned long dropped_count = 0;
+          unsigned long processed_count = 0;
+          size_t depth = 0;
+          size_t max_depth = 0;
+          double total_wait = 0; //s, from arrival to start of processing
+          double max_wait = 0; //s
+          double total_latency = 0; //s, from arrival to end of processing
+          double max_latency = 0; //s
+        };
+
+        /**
+         * @brief Adds an observation and wakes the worker. If the queue then holds more than the capacity, the oldest observations are dropped
+         *
+         * @return The number of dropped observations and the resulting depth of the queue
+         */
+        std::pair<int,size_t> push(T input, size_t capacity){
+          std::scoped_lock lock(mutex_);
+          inputs_.emplace_back(std::move(input), Clock::now());
+          statistics_.received_count++;
+          int dropped = 0;
+          while (inputs_.size() > capacity){
+            inputs_.pop_front();
+            dropped++;
+          }
+          statistics_.dropped_count += dropped;
+          statistics_.max_depth = std::max(statistics_.max_depth, inputs_.size());
+          condition_.notify_one();
+          return {dropped, inputs_.size()};
+        }
+
+        /**
+         * @brief Waits for an observation and removes the oldest one from the queue
+         *
+         * @return The observation with the time of its arrival, or nothing once the queue is stopped
+         */
+        std::optional<std::pair<T, Clock::time_point>> pop(){
+          std::unique_lock lock(mutex_);
+          condition_.wait(lock, [this]{return (!inputs_.empty()) || stopped_;});
+          if (stopped_){
+            return std::nullopt;
+          }
+          auto output = std::move(inputs_.front());
+          inputs_.pop_front();
+          double wait = std::chrono::duration<double>(Clock::now() - output.second).count();
+          statistics_.total_wait += wait;
+          statistics_.max_wait = std::max(statistics_.max_wait, wait);
+          return output;
+        }
+
+        /**
+         * @brief Records that the worker has finished processing an observation
+         *
+         * @param arrival The time of arrival of the observation, as returned by pop
+         *
+         * @return The latency of the observation from its arrival, in seconds
+         */
+        double finished(Clock::time_point arrival){
+          std::scoped_lock lock(mutex_);
+          double latency = std::chrono::duration<double>(Clock::now() - arrival).count();
+          statistics_.processed_count++;
+          statistics_.total_latency += latency;
+          statistics_.max_latency = std::max(statistics_.max_latency, latency);
+          return latency;
+        }
+
+        /**
+         * @brief Wakes the worker, and makes pop return nothing from now on
+         */
+        void stop(){
+          std::scoped_lock lock(mutex_);
+          stopped_ = true;
+          condition_.notify_all();
+        }
+
+        /**
+         * @brief Retrieves the statistics of the queue since the last reset
+         *
+         * @param reset Whether to start collecting the statistics anew
+         */
+        Statistics statistics(bool reset = false){
+          std::scoped_lock lock(mutex_);
+          auto output = statistics_;
+          output.depth = inputs_.size();
+          if (reset){
+            statistics_ = Statistics();
+            statistics_.max_depth = inputs_.size();
+          }
+          return output;
+        }
+
+      private:
+        std::deque<std::pair<T, Clock::time_point>> inputs_;
+        std::mutex mutex_;
+        std::condition_variable condition_;
+        bool stopped_ = false;
+        Statistics statistics_;
+    };
+
+    /**
+     * @brief Processes each of a set of targets under its own mutex, in the order in which the mutexes become available, so that a target currently used by another thread does not hold up the rest. Only if all of the remaining targets are busy, the first of them is waited for
+     *
+     * @param targets The targets, each with a member mutex
+     * @param process Called with each target while its mutex is held
+     * @param waited If provided, is called after each wait for a busy target, with the time at which the wait started
+     */
+    template <class Target, class F>
+    void processTargetsAsAvailable(const std::vector<std::shared_ptr<Target>> &targets, F &&process, const std::function<void (std::chrono::steady_clock::time_point)> &waited = nullptr){
+      std::list<std::shared_ptr<Target>> pending_targets(targets.begin(), targets.end());
+      while (!pending_targets.empty()){
+        auto pit = pending_targets.begin();
+        for (; pit != pending_targets.end(); pit++){
+          if ((*pit)->mutex.try_lock()){
+            break;
+          }
+        }
+        if (pit == pending_targets.end()){ // all remaining targets are busy - wait for the first one
+          auto start_wait = std::chrono::steady_clock::now();
+          pit = pending_targets.begin();
+          (*pit)->mutex.lock();
+          if (waited){
+            waited(start_wait);
+          }
+        }
+        auto target = *pit;
+        pending_targets.erase(pit);
+        std::scoped_lock lock(std::adopt_lock, target->mutex);
+        process(*target);
+      }
+    }
+
+  } //pose_core
+
+} //uvdar
+
+#endif // _POSE_CORE_INPUT_QUEUE_H_
@@ -0,0 +1,372 @@
+#include "pose_core.h"
+
+#include <cmath>
+#include <chrono>
+#include <limits>
+#include <Eigen/Dense>
+
+using namespace uvdar;
+
+#define MVEE_TOLERANCE 0.01
+#define MVEE_MAX_ITERATIONS 1000
+#define MVEE_MAX_DURATION 0.002 //s
+#define MVEE_ACTIVE_WEIGHT 0.00001
+#define MVEE_REGULARIZATION 1e-12
+#define MVEE_WARM_START_MIN_MASS 0.5
+
+#define sqr(X) ((X) * (X))
+
+/* Conversions of rotation matrices to aviation angles //{ */
+static double rotmatToYaw(const e::Matrix3d &m){
+  return atan2(m(1,0),m(0,0));
+}
+
+static double rotmatToPitch(const e::Matrix3d &m){
+  return atan2( -m(2,0), sqrt( m(2,1)*m(2,1) +m(2,2)*m(2,2) )  );
+}
+
+static double rotmatToRoll(const e::Matrix3d &m){
+  return atan2(m(2,1),m(2,2));
+}
+//}
+
+e::Vector3d pose_core::quaternionToRPY(const e::Quaterniond &q){
+  auto rotmat = q.toRotationMatrix();
+  return e::Vector3d(rotmatToRoll(rotmat), rotmatToPitch(rotmat), rotmatToYaw(rotmat));
+}
+
+/* CameraModel //{ */
+pose_core::CameraModel::CameraModel(const ocam_model &model) : model_(model){
+  const e::Vector3d zero_dir(0,0,1);
+  max_view_angle_ = 0; // the projection is radially monotonic, so the border of the image bounds the field of view
+  for (int x = 0; x <= model_.width; x += 4){
+    max_view_angle_ = std::max(max_view_angle_, acos(direction(e::Vector2d(x,0)).dot(zero_dir)));
+    max_view_angle_ = std::max(max_view_angle_, acos(direction(e::Vector2d(x,model_.height)).dot(zero_dir)));
+  }
+  for (int y = 0; y <= model_.height; y += 4){
+    max_view_angle_ = std::max(max_view_angle_, acos(direction(e::Vector2d(0,y)).dot(zero_dir)));
+    max_view_angle_ = std::max(max_view_angle_, acos(direction(e::Vector2d(model_.width,y)).dot(zero_dir)));
+  }
+}
+
+e::Vector2d pose_core::CameraModel::project(const e::Vector3d &point) const {
+  double v_w[3] = {point.y(), point.x(),-point.z()};
+  double v_i_raw[2];
+  world2cam(v_i_raw, v_w, &model_);
+  return e::Vector2d(v_i_raw[1], v_i_raw[0]);
+}
+
+e::Vector3d pose_core::CameraModel::direction(const e::Vector2d &image_point) const {
+  double v_i[2] = {image_point.y(), image_point.x()};
+  double v_w_raw[3];
+  cam2world(v_w_raw, v_i, &model_);
+  return e::Vector3d(v_w_raw[1], v_w_raw[0], -v_w_raw[2]).normalized();
+}
+
+e::Matrix<double,2,3> pose_core::CameraModel::projectionJacobian(const e::Vector3d &point) const {
+  const double X = point.y();
+  const double Y = point.x();
+  const double Z = -point.z();
+  const double norm_sq = sqr(X)+sqr(Y);
+  const double norm = sqrt(norm_sq);
+
+  e::Matrix<double,2,3> output = e::Matrix<double,2,3>::Zero();
+  if (norm < 1e-9){ //the projection is singular on the optical axis
+    return output;
+  }
+
+  const double theta = atan(Z/norm);
+  double rho = model_.invpol[0];
+  double drho = 0;
+  double t_i = 1;
+  for (int i=1; i<model_.length_invpol; i++){
+    drho += i*t_i*model_.invpol[i];
+    t_i *= theta;
+    rho += t_i*model_.invpol[i];
+  }
+
+  const e::Vector2d u(X/norm, Y/norm);
+  const double denom = norm*(norm_sq+sqr(Z));
+  const e::Vector3d dtheta(-Z*X/denom, -Z*Y/denom, norm/(norm_sq+sqr(Z)));
+
+  e::Matrix<double,2,3> d_xy;
+  d_xy.leftCols<2>() = (rho/norm)*(e::Matrix2d::Identity() - u*u.transpose());
+  d_xy.col(2).setZero();
+  d_xy += (u*drho)*dtheta.transpose();
+
+  e::Matrix2d affine; //rows of the output are swapped, since image x corresponds to the OCamCalib column
+  affine <<
+    model_.e, 1.0,
+    model_.c, model_.d;
+
+  e::Matrix3d axes; //camera frame to the OCamCalib frame
+  axes <<
+    0, 1, 0,
+    1, 0, 0,
+    0, 0, -1;
+
+  output = affine*d_xy*axes;
+  return output;
+}
+//}
+
+//based on [Nima Moshtagh (2022). Minimum Volume Enclosing Ellipsoid (https://www.mathworks.com/matlabcentral/fileexchange/9542-minimum-volume-enclosing-ellipsoid), MATLAB Central File Exchange. Retrieved May 11, 2022.]
+//
+//condition and initialization changed to one from [Michael J. Todd; E. Alper Yıldırım (2005). On Khachiyan’s Algorithm for the Computation of Minimum Volume Enclosing Ellipsoids] which seems to work much better
+//
+//the iteration may be warm-started from the weights of the previous cycle and is stopped once the tolerance is met or the deadline passes. The returned ellipsoid is scaled to enclose all points even if the tolerance was not reached, and its volume is then within (1+eps)^((d+1)/2) of the optimum [Todd, Yildirim 2005]
+//
+std::pair<e::Vector3d, e::Matrix3d> pose_core::enclosingEllipsoid(const std::vector<e::Vector3d> &Pv, std::vector<double> *weights, ellipsoid_statistics *statistics){
+  //function [A , c] = MinVolEllipse(P, tolerance)
+
+  // [A , c] = MinVolEllipse(P, tolerance)
+  // Finds the minimum volume enclosing ellipsoid (MVEE) of a set of data
+  // points stored in matrix P. The following optimization problem is solved: 
+  //
+  // minimize       log(det(A))
+  // subject to     (P_i - c)' * A * (P_i - c) <= 1
+  //                
+  // in variables A and c, where P_i is the i-th column of the matrix P. 
+  // The solver is based on Khachiyan Algorithm, and the final solution 
+  // is different from the optimal value by the pre-spesified amount of 'tolerance'.
+  //
+  // inputs:
+  //---------
+  // P : (d x N) dimnesional matrix containing N points in R^d.
+  // tolerance : error in the solution with respect to the optimal value.
+  //
+  // outputs:
+  //---------
+  // A : (d x d) matrix of the ellipse equation in the 'center form': 
+  // (x-c)' * A * (x-c) = 1 
+  // c : 'd' dimensional vector as the center of the ellipse. 
+  // 
+  // example:
+  // --------
+  //      P = rand(5,100);
+  //      [A, c] = MinVolEllipse(P, .01)
+  //
+  //      To reduce the computation time, work with the boundary points only:
+  //      
+  //      K = convhulln(P');  
+  //      K = unique(K(:));  
+  //      Q = P(:,K);
+  //      [A, c] = MinVolEllipse(Q, .01)
+  //
+  //
+  // Nima Moshtagh (nima@seas.upenn.edu)
+  // University of Pennsylvania
+  //
+  // December 2005
+  // UPDATE: Jan 2009
+  //%%%%%%%%%%%%%%%%%%%% Solving the Dual problem%%%%%%%%%%%%%%%%%%%%%%%%%%%5
+  // ---------------------------------
+  // data points 
+  // -----------------------------------
+  const int d = 3;
+  const double n = (double)(d+1);
+  const int N = (int)(Pv.size());
+
+  std::vector<e::Vector4d> Q(N);
+  for (int i = 0; i < N; i++){
+    Q[i] << Pv[i], 1.0;
+  }
+
+  auto momentMatrix = [&](const e::VectorXd &u){
+    e::Matrix4d X = e::Matrix4d::Zero();
+    for (int i = 0; i < N; i++){
+      X += u(i)*Q[i]*Q[i].transpose(); // X = \sum_i ( u_i * q_i * q_i')  is a (d+1)x(d+1) matrix
+    }
+    return X;
+  };
+
+  e::VectorXd m(N);
+  double eps_plus, eps_minus, maximum, minimum;
+  int jp, jm;
+  auto evaluate = [&](const e::Matrix4d &X, const e::VectorXd &u){
+    e::Matrix4d X_inv = (X + MVEE_REGULARIZATION*e::Matrix4d::Identity()).inverse(); // the regularization keeps degenerate (planar) sets of points finite
+    for (int i = 0; i < N; i++){
+      m(i) = Q[i].dot(X_inv*Q[i]);
+    }
+    maximum = m.maxCoeff(&jp);
+    minimum = std::numeric_limits<double>::max();
+    jm = jp;
+    for (int i = 0; i < N; i++){
+      if ((u(i) > MVEE_ACTIVE_WEIGHT) && (m(i) < minimum)){
+        minimum = m(i);
+        jm = i;
+      }
+    }
+    eps_plus = ((maximum/n) - 1.0);
+    eps_minus = (1.0 - (minimum/n));
+    return std::max(eps_plus,eps_minus);
+  };
+
+  // initializations
+  // -----------------------------------
+  e::VectorXd u = e::VectorXd::Constant(N,(1.0/((double)(N))));
+  bool initialized = false;
+
+  if ((weights != nullptr) && ((int)(weights->size()) == N)){ // warm start from the previous cycle
+    e::VectorXd u_prev = e::Map<e::VectorXd>(weights->data(), N);
+    double mass = u_prev.sum();
+    if (mass > MVEE_WARM_START_MIN_MASS){
+      u = u_prev/mass; // hypotheses new in this cycle start with zero weight and will be added by the iteration if they lie outside
+      initialized = true;
+    }
+  }
+
+  if ((!initialized) && (N > (2*d))){
+    // fast path - the uniform weights (sample covariance) already suffice for compact sets of hypotheses
+    if (evaluate(momentMatrix(u), u) > MVEE_TOLERANCE){
+      //initial volume approximation [Todd, Yildirim 2005]
+      std::vector<bool> used(N, false);
+      u = e::VectorXd::Zero(N);
+      int compliant_count = 0;
+      e::Matrix3d psi = e::Matrix3d::Zero();
+      for (int span_dim = 0; span_dim < d; span_dim++){
+        e::Vector3d direction;
+        if (span_dim == 0){
+          direction = e::Vector3d(1.0,0.0,0.0);
+        }
+        else if (span_dim == 1){
+          direction = psi.col(0).unitOrthogonal();
+        }
+        else {
+          direction = psi.col(0).cross(psi.col(1));
+          if (direction.norm() < 1e-12){
+            direction = psi.col(0).unitOrthogonal();
+          }
+          direction.normalize();
+        }
+
+        double alpha = std::numeric_limits<double>::lowest();
+        double beta = std::numeric_limits<double>::max();
+        int j_alpha = -1, j_beta = -1;
+        for (int j = 0; j < N; j++){
+          if (used[j]){ //so that we won't get duplicates
+            continue;
+          }
+          double dirtest = direction.dot(Pv[j]);
+          if (dirtest > alpha){
+            alpha = dirtest;
+            j_alpha = j;
+          }
+          if (dirtest < beta){
+            beta = dirtest;
+            j_beta = j;
+          }
+        }
+        if ((j_alpha == -1) || (j_beta == -1)){
+          break;
+        }
+        used[j_alpha] = true;
+        used[j_beta] = true;
+        if (u(j_alpha)<1){
+          compliant_count++;
+          u(j_alpha) = 1.0;
+        }
+        if (u(j_beta)<1){
+          compliant_count++;
+          u(j_beta) = 1.0;
+        }
+        e::Vector3d span_vector = (Pv[j_beta]-Pv[j_alpha]);
+        psi.col(span_dim) = (span_vector.norm() > 1e-12)?span_vector.normalized():direction;
+      }
+      u = u*(1.0/(double)(compliant_count));
+    }
+  }
+
+  // Khachiyan Algorithm with away steps [Todd, Yildirim 2005]
+  // -----------------------------------
+  e::Matrix4d X = momentMatrix(u);
+  const auto start = std::chrono::steady_clock::now();
+  int count = 0;
+  while (evaluate(X, u) > MVEE_TOLERANCE){
+    if (count >= MVEE_MAX_ITERATIONS){
+      break;
+    }
+    if (((count % 16) == 0) && (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > MVEE_MAX_DURATION)){
+      break;
+    }
+
+    double step_size;
+    if (eps_plus>=eps_minus){
+      step_size = (maximum - n)/(n*(maximum-1.0));
+      u *= (1.0 - step_size);
+      u(jp) += step_size;
+      X = (1.0 - step_size)*X + step_size*Q[jp]*Q[jp].transpose();
+    }
+    else{
+      step_size = std::min(((n - minimum)/(n*(minimum-1.0))),((u(jm))/(1.0-u(jm))));
+      u *= (1.0 + step_size);
+      u(jm) -= step_size;
+      X = (1.0 + step_size)*X - step_size*Q[jm]*Q[jm].transpose();
+    }
+    count++;
+  }
+  if (statistics != nullptr){
+    statistics->iterations = count;
+    statistics->eps = std::max(eps_plus,eps_minus);
+  }
+
+  if (weights != nullptr){
+    weights->assign(u.data(), u.data()+N);
+  }
+
+  //%%%%%%%%%%%%%%%%%% Computing the Ellipse parameters%%%%%%%%%%%%%%%%%%%%%%
+  // center of the ellipse and its shape matrix, such that (x-c)' * C^-1 * (x-c) <= 1 for all points
+  // --------------------------------------------
+  e::Vector3d c = e::Vector3d::Zero();
+  e::Matrix3d S = e::Matrix3d::Zero();
+  for (int i = 0; i < N; i++){
+    c += u(i)*Pv[i];
+    S += u(i)*Pv[i]*Pv[i].transpose();
+  }
+  e::Matrix3d C = (double)(d) * (S - c*c.transpose());
+  if (eps_plus > 0){ // m_i <= (1+eps)(d+1) corresponds to the ellipsoid inflated by 1+eps(d+1)/d
+    C *= (1.0 + eps_plus*n/((double)(d)));
+  }
+
+  return {c,C};
+}
+
+//contains code from https://gist.github.com/PeteBlackerThe3rd/f73e9d569e29f23e8bd828d7886636a0
+e::Quaterniond pose_core::averageOrientation(const std::vector<e::Quaterniond> &orientations){
+  if (orientations.size() < 1){
+    return e::Quaterniond::Identity();
+  }
+
+  // first build a 4x4 matrix which is the elementwise sum of the product of each quaternion with itself
+  e::Matrix4d A = e::Matrix4d::Zero();
+
+  for (auto &q : orientations){
+    A += q.coeffs()*q.coeffs().transpose();
+  }
+  A /= (double)(orientations.size());
+
+  // Compute the SVD of this 4x4 matrix
+  e::JacobiSVD<e::Matrix4d> svd(A, e::ComputeFullU | e::ComputeFullV);
+
+  e::Vector4d singularValues = svd.singularValues();
+  e::Matrix4d U = svd.matrixU();
+
+  // find the eigen vector corresponding to the largest eigen value
+  int largestEigenValueIndex = 0;
+  double largestEigenValue = singularValues(0);
+
+  for (int i=1; i<singularValues.rows(); ++i) {
+    if (singularValues(i) > largestEigenValue) {
+      largestEigenValue = singularValues(i);
+      largestEigenValueIndex = i;
+    }
+  }
+
+  e::Quaterniond mean_rot;
+  mean_rot.x() = U(0, largestEigenValueIndex);
+  mean_rot.y() = U(1, largestEigenValueIndex);
+  mean_rot.z() = U(2, largestEigenValueIndex);
+  mean_rot.w() = U(3, largestEigenValueIndex);
+
+  return mean_rot;
+}
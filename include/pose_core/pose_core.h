@@ -0,0 +1,256 @@
+#ifndef _POSE_CORE_H_
+#define _POSE_CORE_H_
+#include <vector>
+#include <array>
+#include <string>
+#include <utility>
+#include <optional>
+#include <limits>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include "OCamCalib/ocam_functions.h"
+
+namespace uvdar {
+
+  namespace e = Eigen;
+
+  /**
+   * @brief The numerical core of the pose estimation, independent of ROS, such that it can be used and benchmarked outside of a running node. It depends on Eigen and OCamCalib - the header of the latter also pulls in the core of OpenCV.
+   */
+  namespace pose_core {
+
+    typedef e::Matrix<double,6,6> Matrix6d;
+
+    /**
+     * @brief A rigid body pose. Also used as the transformation of a point p to orientation*p+position
+     */
+    struct Pose {
+      e::Vector3d position = e::Vector3d::Zero();
+      e::Quaterniond orientation = e::Quaterniond::Identity();
+    };
+
+    /**
+     * @brief Composes two transformations, such that compose(a,b) transforms a point first by b and then by a
+     */
+    Pose compose(const Pose &a, const Pose &b);
+
+    /**
+     * @brief An LED of a target model
+     */
+    struct Marker {
+      Pose pose; // in the frame of the target - the LED emits along the x axis of the orientation
+      int type = -1; // 0 - directional, 1 - omni ring, 2 - full omni
+      int signal = -1; // the ID of the emitted signal, in the same space as the signals of the observed points
+    };
+
+    /**
+     * @brief A marker retrieved from an image, identified by its signal
+     */
+    struct ObservedPoint {
+      int signal;
+      e::Vector2d position; // image coordinates (x,y)
+    };
+
+    /**
+     * @brief Loads an LED model from a file, with one marker per line in the format "X Y Z type pitch yaw signal_id". Lines starting with # are skipped
+     *
+     * @param file_name The model file
+     *
+     * @return The markers, with the signal of each set to its signal_id in the file, or nothing if the file could not be read
+     */
+    std::optional<std::vector<Marker>> loadModel(const std::string &file_name);
+
+    /**
+     * @brief Splits the markers of a model into groups of co-located LEDs
+     *
+     * @param markers The markers of the model
+     * @param distance Markers closer than this to the first marker of a group belong to that group
+     *
+     * @return The indices of the markers of each group
+     */
+    std::vector<std::vector<int>> groupMarkers(const std::vector<Marker> &markers, double distance);
+
+    /**
+     * @brief Projection model of a single calibrated camera. The camera frame has its z axis along the optical axis, x towards the right and y towards the bottom of the image
+     */
+    class CameraModel {
+      public:
+        /**
+         * @brief Constructor
+         *
+         * @param model The OCamCalib calibration of the camera
+         */
+        CameraModel(const ocam_model &model);
+
+        /**
+         * @brief Projects a point onto the image
+         *
+         * @param point Position of the point in the camera frame
+         *
+         * @return Image coordinates (x,y) of the projected point
+         */
+        e::Vector2d project(const e::Vector3d &point) const;
+
+        /**
+         * @brief Retrieves the direction from which an image point is observed
+         *
+         * @param image_point Image coordinates (x,y)
+         *
+         * @return Unit vector in the camera frame
+         */
+        e::Vector3d direction(const e::Vector2d &image_point) const;
+
+        /**
+         * @brief Analytic derivative of project w.r.t. the position of the point in the camera frame, following the OCamCalib projection chain (axis swap, polar angle, inverse polynomial and the affine distortion)
+         *
+         * @param point Position of the point in the camera frame
+         *
+         * @return The 2x3 Jacobian of the image coordinates (x,y) of the projected point
+         */
+        e::Matrix<double,2,3> projectionJacobian(const e::Vector3d &point) const;
+
+        /**
+         * @brief Retrieves the largest angle from the optical axis at which a point still projects into the image
+         */
+        double maxViewAngle() const {
+          return max_view_angle_;
+        }
+
+        int width() const {
+          return model_.width;
+        }
+
+        int height() const {
+          return model_.height;
+        }
+
+      private:
+        mutable ocam_model model_; // the OCamCalib functions take non-const pointers, although they do not modify the model
+        double max_view_angle_;
+    };
+
+    /**
+     * @brief How an evaluation of the reprojection error ended, for the profiling statistics
+     */
+    enum class ErrorOutcome {
+      complete,
+      outside_view, // the model lies outside of the field of view
+      early_exit // the error exceeded the bound before all terms were summed
+    };
+
+    /**
+     * @brief The reprojection error of a target model observed by a single camera, and the estimation of the poses of the target that minimize it
+     */
+    class Reprojection {
+      public:
+        /**
+         * @brief Constructor
+         *
+         * @param camera The camera observing the targets
+         * @param led_projection_coefs Coefficients of the empirical decay of the image size of an LED with distance
+         * @param view_angle_margin Margin added to the field of view of the camera when rejecting models outside of it
+         */
+        Reprojection(const CameraModel &camera, const std::array<double,3> &led_projection_coefs, double view_angle_margin);
+
+        /**
+         * @brief Returns the expected size of the image of an LED, given by the empirical model of its decay with distance and view angle. LEDs with zero intensity are not expected to be visible
+         */
+        double expectedLedIntensity(double distance, double cos_view_angle) const;
+
+        /**
+         * @brief Retrieves the reprojection error of a pose of the target w.r.t. the observed points
+         *
+         * @param markers The markers of the target model
+         * @param pose The pose of the target in the output frame
+         * @param tocam Transformation from the output frame to the camera
+         * @param observed_points The points observed in the image, associated with the target
+         * @param error_bound If the error exceeds this value, the evaluation stops early and the partial error (also exceeding the bound) is returned. Use the threshold the result will be compared against
+         * @param discrete_pixels Whether to measure the distances in whole pixels
+         * @param projections If provided, is filled with the projections of the markers expected to be visible. The evaluation is then never stopped early
+         * @param outcome If provided, is set to how the evaluation ended
+         *
+         * @return The total reprojection error
+         */
+        double hypothesisError(const std::vector<Marker> &markers, const Pose &pose, const Pose &tocam, const std::vector<ObservedPoint> &observed_points, double error_bound = std::numeric_limits<double>::max(), bool discrete_pixels = false, std::vector<ObservedPoint> *projections = nullptr, ErrorOutcome *outcome = nullptr) const;
+
+        /**
+         * @brief Generates poses of the target analytically, by solving the P3P problem for the bearing vectors of the three most spread out observed points against the matching groups of LEDs. Only the poses that explain all of the observed points well enough are returned.
+         *
+         * @param markers The markers of the target model
+         * @param groups The groups of co-located markers, see groupMarkers. A group matches an observed point if any of its members emits the observed signal
+         * @param observed_points The points observed in the image, associated with the target
+         * @param fromcam Transformation from the camera to the output frame
+         * @param tocam Transformation from the output frame to the camera
+         * @param threshold The total reprojection error a pose must stay below
+         * @param max_correspondences The maximum number of triplets of groups to try
+         * @param tested If provided, is set to the number of triplets tried
+         *
+         * @return The viable poses in the output frame, with their reprojection errors
+         */
+        std::vector<std::pair<Pose,double>> p3pPoses(const std::vector<Marker> &markers, const std::vector<std::vector<int>> &groups, const std::vector<ObservedPoint> &observed_points, const Pose &fromcam, const Pose &tocam, double threshold, int max_correspondences, int *tested = nullptr) const;
+
+        /**
+         * @brief Refines a pose of the target by Levenberg-Marquardt minimization of the squared reprojection error. Correspondences between the observed and projected markers are re-established in every iteration in the same manner as in hypothesisError, and the Jacobian of each residual is obtained analytically through the projection of the camera.
+         *
+         * @param markers The markers of the target model
+         * @param pose The initial pose of the target in the output frame
+         * @param tocam Transformation from the output frame to the camera
+         * @param observed_points The points observed in the image, associated with the target
+         * @param threshold The total reprojection error the refined pose has to reach to be considered converged
+         * @param iterations If provided, is set to the number of iterations performed
+         *
+         * @return The refined pose, or nothing if the solver diverged
+         */
+        std::optional<Pose> refine(const std::vector<Marker> &markers, const Pose &pose, const Pose &tocam, const std::vector<ObservedPoint> &observed_points, double threshold, int *iterations = nullptr) const;
+
+        const CameraModel &camera() const {
+          return camera_;
+        }
+
+      private:
+        bool inImage(const e::Vector2d &image_point) const;
+
+        CameraModel camera_;
+        std::array<double,3> led_projection_coefs_;
+        double max_view_angle_;
+    };
+
+    /**
+     * @brief Diagnostic information about the computation of an enclosing ellipsoid
+     */
+    struct ellipsoid_statistics {
+      int iterations;
+      double eps; // relative deviation from the optimality conditions at termination
+    };
+
+    /**
+     * @brief Retrieves an approximation of the minimum volume ellipsoid enclosing a set of points, using the Khachiyan algorithm with away steps [M. J. Todd and E. A. Yildirim, "On Khachiyan's algorithm for the computation of minimum-volume enclosing ellipsoids" (2007)]. The iteration may be warm-started, and is stopped once the tolerance is met or the deadline passes. The returned ellipsoid is scaled to enclose all points even if the tolerance was not reached.
+     *
+     * @param points The points to enclose
+     * @param weights If provided, the weights of the points from a previous computation are used as the initial solution if they match the points in count, and are replaced by the final weights
+     * @param statistics If provided, is filled with diagnostic information
+     *
+     * @return The center c and the shape matrix C of the ellipsoid, such that (x-c)' * C^-1 * (x-c) <= 1 for all points
+     */
+    std::pair<e::Vector3d, e::Matrix3d> enclosingEllipsoid(const std::vector<e::Vector3d> &points, std::vector<double> *weights = nullptr, ellipsoid_statistics *statistics = nullptr);
+
+    /**
+     * @brief Retrieves the average of a set of orientations, as the dominant eigenvector of the sum of the outer products of their quaternions
+     *
+     * @param orientations The orientations to average
+     *
+     * @return The average orientation, or identity if none were provided
+     */
+    e::Quaterniond averageOrientation(const std::vector<e::Quaterniond> &orientations);
+
+    /**
+     * @brief Converts an orientation to roll, pitch and yaw angles
+     */
+    e::Vector3d quaternionToRPY(const e::Quaterniond &q);
+
+  } //pose_core
+
+} //uvdar
+
+
+#endif // _POSE_CORE_H_
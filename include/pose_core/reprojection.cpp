@@ -0,0 +1,470 @@
+#include "pose_core.h"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <Eigen/Dense>
+#include <p3p/p3p.h>
+
+using namespace uvdar;
+
+#define sqr(X) ((X) * (X))
+
+#define UNMATCHED_OBSERVED_POINT_PENALTY sqr(15)
+/* #define UNMATCHED_PROJECTED_POINT_PENALTY sqr(5) */
+#define UNMATCHED_PROJECTED_POINT_PENALTY sqr(0)
+#define MERGED_MARKER_DISTANCE 3 //px - markers of the same signal closer than this are expected to merge into a single blob
+
+#define MIN_P3P_ANGLE 0.001 //rad - the triplets of bearings spread less than this are too poorly conditioned to solve
+
+#define MAX_LM_ITERATIONS 20
+#define LM_INITIAL_DAMPING 1e-3
+#define LM_CONVERGED_STEP 1e-6
+
+/**
+ * @brief Retrieves the summed penalty of the observed points whose signal is not emitted by any of the given markers. Such points stay unmatched regardless of where the markers project, so this bounds the reprojection error from below
+ */
+template <class Markers>
+static double unmatchedPenaltyBound(const Markers &markers, const std::vector<pose_core::ObservedPoint> &observed_points){
+  double output = 0;
+  for (auto &obs_point : observed_points){
+    bool matchable = std::any_of(markers.begin(), markers.end(), [&](const auto &marker){
+        return marker.signal == obs_point.signal;
+        });
+    if (!matchable){
+      output += UNMATCHED_OBSERVED_POINT_PENALTY;
+    }
+  }
+  return output;
+}
+
+pose_core::Pose pose_core::compose(const Pose &a, const Pose &b){
+  Pose output;
+  output.position = a.orientation*b.position + a.position;
+  output.orientation = a.orientation*b.orientation;
+  return output;
+}
+
+/* loadModel //{ */
+std::optional<std::vector<pose_core::Marker>> pose_core::loadModel(const std::string &file_name){
+  std::ifstream ifs(file_name);
+  if (!ifs.good()){
+    return std::nullopt;
+  }
+
+  std::vector<Marker> output;
+  std::string line;
+  while (getline(ifs, line)){
+    if (line.empty() || (line[0] == '#')){
+      continue;
+    }
+    std::stringstream iss(line);
+    double X, Y, Z, pitch, yaw;
+    Marker marker;
+    iss >> X >> Y >> Z >> marker.type >> pitch >> yaw >> marker.signal;
+    marker.pose.position = e::Vector3d(X,Y,Z);
+    marker.pose.orientation = e::AngleAxisd(yaw, e::Vector3d::UnitZ())*e::AngleAxisd(pitch, e::Vector3d::UnitY());
+    output.push_back(marker);
+  }
+  return output;
+}
+//}
+
+std::vector<std::vector<int>> pose_core::groupMarkers(const std::vector<Marker> &markers, double distance){
+  std::vector<std::vector<int>> groups;
+  for (int i = 0; i < (int)(markers.size()); i++){
+    bool found = false;
+    for (auto &group : groups){
+      if ((markers[i].pose.position - markers.at(group.at(0)).pose.position).norm() < distance){
+        group.push_back(i);
+        found = true;
+      }
+    }
+    if (!found){
+      groups.push_back(std::vector<int>(1,i));
+    }
+  }
+  return groups;
+}
+
+/* Reprojection //{ */
+pose_core::Reprojection::Reprojection(const CameraModel &camera, const std::array<double,3> &led_projection_coefs, double view_angle_margin) :
+  camera_(camera),
+  led_projection_coefs_(led_projection_coefs),
+  max_view_angle_(camera.maxViewAngle() + view_angle_margin){
+}
+
+double pose_core::Reprojection::expectedLedIntensity(double distance, double cos_view_angle) const {
+  return round(std::max(.0, cos_view_angle) * (led_projection_coefs_[0] + (led_projection_coefs_[1] / ((distance + led_projection_coefs_[2]) * (distance + led_projection_coefs_[2])))));
+}
+
+bool pose_core::Reprojection::inImage(const e::Vector2d &image_point) const {
+  return
+    (image_point.x() > -0.5) && // edge of the leftmost pixel
+    (image_point.y() > -0.5) && // edge of the topmost pixel
+    (image_point.x() < (camera_.width() + 0.5)) && // edge of the rightmost pixel
+    (image_point.y() < (camera_.height() + 0.5)); // edge of the bottommost pixel
+}
+
+/* hypothesisError //{ */
+double pose_core::Reprojection::hypothesisError(const std::vector<Marker> &markers, const Pose &pose, const Pose &tocam, const std::vector<ObservedPoint> &observed_points, double error_bound, bool discrete_pixels, std::vector<ObservedPoint> *projections, ErrorOutcome *outcome) const {
+  if (outcome){
+    *outcome = ErrorOutcome::complete;
+  }
+  const bool bounded = (projections == nullptr) && (error_bound < std::numeric_limits<double>::max());
+
+  if (projections){
+    projections->clear();
+  }
+  else { // if the bounding sphere of the model lies outside of the field of view, none of the markers can be matched
+    e::Vector3d center_cam = tocam.orientation*pose.position + tocam.position;
+    double distance = center_cam.norm();
+    double radius = 0;
+    for (auto &marker : markers){
+      radius = std::max(radius, marker.pose.position.norm());
+    }
+    if (distance > radius){
+      double view_angle = acos(std::clamp(center_cam.z()/distance, -1.0, 1.0));
+      if ((view_angle - asin(radius/distance)) > max_view_angle_){
+        if (outcome){
+          *outcome = ErrorOutcome::outside_view;
+        }
+        return (int)(observed_points.size())*UNMATCHED_OBSERVED_POINT_PENALTY;
+      }
+    }
+  }
+
+  if (bounded){ // the observed signals that the model does not emit at all are penalized regardless of the pose
+    double lower_bound = unmatchedPenaltyBound(markers, observed_points);
+    if (lower_bound > error_bound){
+      if (outcome){
+        *outcome = ErrorOutcome::early_exit;
+      }
+      return lower_bound;
+    }
+  }
+
+  struct ProjectedMarker {
+    e::Vector2d position;
+    int signal;
+  };
+  thread_local std::vector<ProjectedMarker> selected_markers; // kept between calls, so that their capacity is reused
+  selected_markers.clear();
+
+  const Pose toimage = compose(tocam, pose);
+  for (auto &marker : markers){
+    e::Vector3d cam_position = toimage.orientation*marker.pose.position + toimage.position;
+    e::Vector2d projection = camera_.project(cam_position);
+    e::Vector2d image_position(std::lrint(projection.x()), std::lrint(projection.y())); // the observed points are whole pixels
+    if (!inImage(image_position)){
+      continue;
+    }
+    e::Vector3d led_vector = toimage.orientation*(marker.pose.orientation*e::Vector3d::UnitX());
+    double cos_view_angle = -(cam_position.normalized().dot(led_vector));
+    if (expectedLedIntensity(cam_position.norm(), cos_view_angle) > 0){ // otherwise they will probably not be visible
+      selected_markers.push_back({image_position, marker.signal});
+    }
+  }
+
+  if (bounded){ // merging only moves markers of the same signal, so the observed signals without a visible marker stay unmatched
+    double lower_bound = unmatchedPenaltyBound(selected_markers, observed_points);
+    if (lower_bound > error_bound){
+      if (outcome){
+        *outcome = ErrorOutcome::early_exit;
+      }
+      return lower_bound;
+    }
+  }
+
+  for (int i = 0; i < ((int)(selected_markers.size()) - 1); i++){
+    for (int j = i+1; j < (int)(selected_markers.size()); j++){
+      if ((selected_markers[i].position-selected_markers[j].position).norm() < MERGED_MARKER_DISTANCE){
+        if (selected_markers[i].signal == selected_markers[j].signal){ // if the signals are the same, they tend to merge. Otherwise, the result varies
+          selected_markers[i].position = (selected_markers[i].position + selected_markers[j].position)/2; //average them
+          selected_markers.erase(selected_markers.begin()+j); //remove the other
+          j--; //we are not expecting many 2+ clusters, so we will not define special case for this
+        }
+      }
+    }
+  }
+
+  if (projections){
+    for (auto &pt : selected_markers){
+      projections->push_back({pt.signal, pt.position});
+    }
+  }
+
+  double total_error = 0;
+  for (auto &obs_point : observed_points){
+    double closest_distance = std::numeric_limits<double>::max();
+    bool any_match_found = false;
+    for (auto &proj_point : selected_markers){
+      if (proj_point.signal == obs_point.signal){
+        double tent_image_distance;
+        if (!discrete_pixels){
+          tent_image_distance = (proj_point.position - obs_point.position).norm();
+        }
+        else {
+          tent_image_distance = e::Vector2d((int)(proj_point.position.x() - obs_point.position.x()), (int)(proj_point.position.y() - obs_point.position.y())).norm();
+        }
+        if (tent_image_distance < closest_distance){
+          closest_distance = tent_image_distance;
+          any_match_found = true;
+        }
+      }
+    }
+    if (any_match_found){
+      total_error += sqr(closest_distance);
+    }
+    else {
+      total_error += UNMATCHED_OBSERVED_POINT_PENALTY;
+    }
+    if (total_error > error_bound){ // the remaining terms are non-negative, so the outcome of the comparison with the bound is already decided
+      if (outcome){
+        *outcome = ErrorOutcome::early_exit;
+      }
+      return total_error;
+    }
+  }
+
+  total_error += (UNMATCHED_PROJECTED_POINT_PENALTY) * std::max(0,(int)(selected_markers.size()) - (int)(observed_points.size()));
+
+  return total_error;
+}
+//}
+
+/* p3pPoses //{ */
+std::vector<std::pair<pose_core::Pose,double>> pose_core::Reprojection::p3pPoses(const std::vector<Marker> &markers, const std::vector<std::vector<int>> &groups, const std::vector<ObservedPoint> &observed_points, const Pose &fromcam, const Pose &tocam, double threshold, int max_correspondences, int *tested) const {
+  if (tested){
+    *tested = 0;
+  }
+  if ((int)(observed_points.size()) < 3){
+    return {};
+  }
+
+  std::vector<e::Vector3d> v_w;
+  for (auto &point : observed_points){
+    v_w.push_back(camera_.direction(point.position));
+  }
+
+  // select the most widely spread triplet of observations - this makes the solution better conditioned
+  std::array<int,3> sel = {-1,-1,-1};
+  double max_angle = -1;
+  for (int i = 0; i < ((int)(v_w.size()) - 1); i++){
+    for (int j = i+1; j < (int)(v_w.size()); j++){
+      double tent_angle = acos(std::clamp(v_w[i].dot(v_w[j]),-1.0,1.0));
+      if (tent_angle > max_angle){
+        max_angle = tent_angle;
+        sel[0] = i;
+        sel[1] = j;
+      }
+    }
+  }
+  double max_min_angle = -1;
+  for (int k = 0; k < (int)(v_w.size()); k++){
+    if ((k == sel[0]) || (k == sel[1])){
+      continue;
+    }
+    double tent_angle = std::min(
+        acos(std::clamp(v_w[k].dot(v_w[sel[0]]),-1.0,1.0)),
+        acos(std::clamp(v_w[k].dot(v_w[sel[1]]),-1.0,1.0))
+        );
+    if (tent_angle > max_min_angle){
+      max_min_angle = tent_angle;
+      sel[2] = k;
+    }
+  }
+  if ((sel[2] < 0) || (max_min_angle < MIN_P3P_ANGLE)){
+    return {};
+  }
+
+  // LEDs sharing a position are represented only once, to avoid duplicate correspondences
+  // A group is a candidate for an observed point if any of its members emits the observed signal
+  std::array<std::vector<int>,3> candidates;
+  for (int c = 0; c < 3; c++){
+    for (int g = 0; g < (int)(groups.size()); g++){
+      if (std::any_of(groups[g].begin(), groups[g].end(), [&](int m){
+            return markers.at(m).signal == observed_points[sel[c]].signal;
+            })){
+        candidates[c].push_back(g);
+      }
+    }
+  }
+
+  const std::array<e::Vector3d,3> bearings = {v_w[sel[0]], v_w[sel[1]], v_w[sel[2]]};
+
+  std::vector<std::pair<Pose,double>> output;
+  int correspondence_count = 0;
+  for (auto a : candidates[0]){
+    if (correspondence_count >= max_correspondences){
+      break;
+    }
+    for (auto b : candidates[1]){
+      if (correspondence_count >= max_correspondences){
+        break;
+      }
+      for (auto c : candidates[2]){
+        if ((a == b) || (b == c) || (a == c)){
+          continue;
+        }
+        if (correspondence_count >= max_correspondences){
+          break;
+        }
+        correspondence_count++;
+
+        const std::array<e::Vector3d,3> object_points = {
+          markers.at(groups[a].at(0)).pose.position,
+          markers.at(groups[b].at(0)).pose.position,
+          markers.at(groups[c].at(0)).pose.position};
+        for (auto &solution : p3p::solve(object_points, bearings)){
+          Pose local_pose;
+          local_pose.position = solution.t;
+          local_pose.orientation = e::Quaterniond(solution.R);
+          Pose global_pose = compose(fromcam, local_pose);
+          double error_total = hypothesisError(markers, global_pose, tocam, observed_points, threshold);
+          if (error_total < threshold){
+            output.push_back({global_pose, error_total});
+          }
+        }
+      }
+    }
+  }
+
+  if (tested){
+    *tested = correspondence_count;
+  }
+  return output;
+}
+//}
+
+/* refine //{ */
+std::optional<pose_core::Pose> pose_core::Reprojection::refine(const std::vector<Marker> &markers, const Pose &initial_pose, const Pose &tocam, const std::vector<ObservedPoint> &observed_points, double threshold, int *iterations) const {
+  const e::Matrix3d tocam_R = tocam.orientation.toRotationMatrix();
+
+  // residuals of the current correspondences and their Jacobian w.r.t. the translation and the rotation (in the output frame) of the target
+  auto linearize = [&](const Pose &pose, e::VectorXd &residuals, e::MatrixXd &jacobian, bool compute_jacobian){
+    struct VisibleMarker {
+      e::Vector3d offset; //rotated model point, relative to the target center
+      e::Vector3d cam_position;
+      e::Vector2d image_position;
+      int signal;
+    };
+    std::vector<VisibleMarker> visible;
+    for (auto &marker : markers){
+      VisibleMarker vm;
+      vm.offset = pose.orientation*marker.pose.position;
+      vm.cam_position = tocam_R*(vm.offset+pose.position) + tocam.position;
+      vm.image_position = camera_.project(vm.cam_position);
+      vm.signal = marker.signal;
+      if (!inImage(vm.image_position)){
+        continue;
+      }
+      e::Vector3d led_vector = tocam.orientation*(pose.orientation*(marker.pose.orientation*e::Vector3d::UnitX()));
+      double cos_view_angle = -(vm.cam_position.normalized().dot(led_vector));
+      if (expectedLedIntensity(vm.cam_position.norm(), cos_view_angle) > 0){
+        visible.push_back(vm);
+      }
+    }
+
+    std::vector<std::pair<int,int>> matches; //observed, visible
+    for (int i = 0; i < (int)(observed_points.size()); i++){
+      int closest = -1;
+      double closest_distance = std::numeric_limits<double>::max();
+      for (int j = 0; j < (int)(visible.size()); j++){
+        if (visible[j].signal == observed_points[i].signal){
+          double tent_distance = (visible[j].image_position - observed_points[i].position).norm();
+          if (tent_distance < closest_distance){
+            closest_distance = tent_distance;
+            closest = j;
+          }
+        }
+      }
+      if (closest >= 0){
+        matches.push_back({i,closest});
+      }
+    }
+
+    residuals.resize(2*matches.size());
+    if (compute_jacobian){
+      jacobian.resize(2*matches.size(),6);
+    }
+    for (int k = 0; k < (int)(matches.size()); k++){
+      const auto &obs = observed_points[matches[k].first];
+      const auto &vm = visible[matches[k].second];
+      residuals.segment<2>(2*k) = vm.image_position - obs.position;
+      if (compute_jacobian){
+        e::Matrix<double,2,3> J_cam = camera_.projectionJacobian(vm.cam_position)*tocam_R;
+        e::Matrix3d offset_skew;
+        offset_skew <<
+          0, -vm.offset.z(), vm.offset.y(),
+          vm.offset.z(), 0, -vm.offset.x(),
+          -vm.offset.y(), vm.offset.x(), 0;
+        jacobian.block<2,3>(2*k,0) = J_cam;
+        jacobian.block<2,3>(2*k,3) = -J_cam*offset_skew;
+      }
+    }
+    return (int)(matches.size());
+  };
+
+  Pose pose = initial_pose;
+  double lambda = LM_INITIAL_DAMPING;
+  e::VectorXd residuals;
+  e::MatrixXd jacobian;
+  int match_count = linearize(pose, residuals, jacobian, true);
+  double cost = residuals.squaredNorm();
+  bool failed = (match_count < 2);
+
+  int iter = 0;
+  for (; (!failed) && (iter < MAX_LM_ITERATIONS); iter++){
+    Matrix6d H = jacobian.transpose()*jacobian;
+    e::Matrix<double,6,1> g = jacobian.transpose()*residuals;
+    H.diagonal() += lambda*H.diagonal().cwiseMax(1e-9);
+    e::Matrix<double,6,1> step = -H.ldlt().solve(g);
+    if (!step.allFinite()){
+      failed = true;
+      break;
+    }
+
+    Pose pose_new;
+    pose_new.position = pose.position + step.head<3>();
+    double angle = step.tail<3>().norm();
+    if (angle > 1e-12){
+      pose_new.orientation = (e::AngleAxisd(angle, step.tail<3>()/angle)*pose.orientation).normalized();
+    }
+    else {
+      pose_new.orientation = pose.orientation;
+    }
+
+    e::VectorXd residuals_new;
+    e::MatrixXd jacobian_new;
+    int match_count_new = linearize(pose_new, residuals_new, jacobian_new, false);
+    double cost_new = residuals_new.squaredNorm();
+    if ((match_count_new >= match_count) && (cost_new < cost)){
+      pose = pose_new;
+      lambda = std::max(lambda/10.0, 1e-9);
+      match_count = linearize(pose, residuals, jacobian, true);
+      cost = residuals.squaredNorm();
+      if (step.norm() < LM_CONVERGED_STEP){
+        break;
+      }
+    }
+    else {
+      lambda *= 10.0;
+      if (lambda > 1e6){ //no descent direction left
+        break;
+      }
+    }
+  }
+  if (iterations){
+    *iterations = iter;
+  }
+
+  if (failed || (hypothesisError(markers, pose, tocam, observed_points, threshold) >= threshold)){
+    return std::nullopt;
+  }
+  return pose;
+}
+//}
+
+//}
@@ -0,0 +1,51 @@
+#ifndef _POSE_CORE_ROS_ADAPTER_H_
+#define _POSE_CORE_ROS_ADAPTER_H_
+#include <geometry_msgs/Transform.h>
+#include <geometry_msgs/Pose.h>
+#include "pose_core.h"
+
+namespace uvdar {
+
+  namespace pose_core {
+
+    /**
+     * @brief Conversions between ROS messages and the types of the pose core. Kept header-only, so that the core library itself does not link against ROS
+     */
+    namespace ros_adapter {
+
+      /**
+       * @brief Converts a transformation message, such that a point p is transformed as orientation*p+position
+       */
+      inline Pose fromMsg(const geometry_msgs::Transform &msg){
+        Pose output;
+        output.position = e::Vector3d(msg.translation.x, msg.translation.y, msg.translation.z);
+        output.orientation = e::Quaterniond(msg.rotation.w, msg.rotation.x, msg.rotation.y, msg.rotation.z);
+        return output;
+      }
+
+      inline Pose fromMsg(const geometry_msgs::Pose &msg){
+        Pose output;
+        output.position = e::Vector3d(msg.position.x, msg.position.y, msg.position.z);
+        output.orientation = e::Quaterniond(msg.orientation.w, msg.orientation.x, msg.orientation.y, msg.orientation.z);
+        return output;
+      }
+
+      inline geometry_msgs::Pose toMsg(const Pose &pose){
+        geometry_msgs::Pose output;
+        output.position.x = pose.position.x();
+        output.position.y = pose.position.y();
+        output.position.z = pose.position.z();
+        output.orientation.w = pose.orientation.w();
+        output.orientation.x = pose.orientation.x();
+        output.orientation.y = pose.orientation.y();
+        output.orientation.z = pose.orientation.z();
+        return output;
+      }
+
+    } //ros_adapter
+
+  } //pose_core
+
+} //uvdar
+
+#endif // _POSE_CORE_ROS_ADAPTER_H_
@@ -0,0 +1,70 @@
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace uvdar {
+
+  /**
+   * @brief Hand-over of state from the processing paths to the optional visualization, such that neither side ever waits for the other
+   */
+  namespace snapshot {
+
+    /**
+     * @brief Lock-free triple buffer for a single writer and a single reader. The writer fills its own slot and publishes it by swapping it with the shared middle slot; the reader swaps its own slot with the middle slot only if that holds a newer snapshot. Each side thus always owns one slot exclusively, and both publishing and fetching are a single atomic exchange. Intermediate snapshots that the reader did not fetch in time are overwritten.
+     *
+     * The slots are reused, so that snapshots consisting of containers stop allocating once these have grown to their working size.
+     */
+    template <class T>
+    class TripleBuffer {
+      public:
+        /**
+         * @brief Retrieves the slot owned by the writer, to be filled before publish()
+         */
+        T &writeSlot(){
+          return slots_[write_];
+        }
+
+        /**
+         * @brief Makes the filled slot of the writer available to the reader. The writer receives the previous middle slot, which holds an older snapshot.
+         */
+        void publish(){
+          write_ = middle_.exchange(write_ | FRESH, std::memory_order_acq_rel) & INDEX;
+        }
+
+        /**
+         * @brief Takes over the latest published snapshot, if there is one newer than the slot currently owned by the reader
+         *
+         * @return Whether a new snapshot was taken over
+         */
+        bool fetch(){
+          if (!(middle_.load(std::memory_order_relaxed) & FRESH)){
+            return false;
+          }
+          read_ = middle_.exchange(read_, std::memory_order_acq_rel) & INDEX;
+          return true;
+        }
+
+        /**
+         * @brief Retrieves the slot owned by the reader, holding the snapshot taken over by the last successful fetch()
+         */
+        const T &readSlot() const {
+          return slots_[read_];
+        }
+
+      private:
+        static constexpr uint8_t INDEX = 0x3;
+        static constexpr uint8_t FRESH = 0x4;
+
+        std::array<T, 3> slots_;
+        uint8_t write_ = 0;
+        uint8_t read_ = 1;
+        std::atomic<uint8_t> middle_ = 2;
+    };
+
+  } //snapshot
+
+} //uvdar
+
+#endif // _SNAPSHOT_H_
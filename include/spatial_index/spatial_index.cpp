@@ -0,0 +1,121 @@
+#include "spatial_index.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <Eigen/Dense>
+
+using namespace uvdar;
+
+#define SPATIAL_INDEX_RADIUS_SLACK 1e-6 //relative enlargement of the radii, covering the rounding errors of the eigenvalues
+
+namespace {
+
+  struct Interval {
+    double lower;
+    double upper;
+    int index;
+  };
+
+  /**
+   * @brief Sweeps over the spheres along the axis of the largest spread of their centers
+   *
+   * @param centers The centers of the spheres
+   * @param radii The radii of the spheres
+   * @param count_a If not negative, the spheres with indices below count_a form the first set and the rest the second set, and only pairs between the two sets are retrieved
+   *
+   * @return The intersecting pairs, with indices of the second set counted from its start
+   */
+  std::vector<std::pair<int,int>> sweep(const std::vector<e::Vector3d> &centers, const std::vector<double> &radii, int count_a){
+    std::vector<std::pair<int,int>> output;
+    int n = (int)(centers.size());
+    if (n < 2){
+      return output;
+    }
+
+    e::Vector3d low = e::Vector3d::Constant(std::numeric_limits<double>::infinity());
+    e::Vector3d high = -low;
+    for (auto &center : centers){
+      if (center.allFinite()){
+        low = low.cwiseMin(center);
+        high = high.cwiseMax(center);
+      }
+    }
+    int axis = 0;
+    if ((high-low).allFinite()){
+      (high-low).maxCoeff(&axis);
+    }
+
+    std::vector<Interval> intervals(n);
+    for (int i=0; i<n; i++){
+      intervals[i] = {centers[i](axis)-radii[i], centers[i](axis)+radii[i], i};
+      if (!std::isfinite(intervals[i].lower) || !std::isfinite(intervals[i].upper)){ //compared with everything - the exact test decides on these
+        intervals[i].lower = -std::numeric_limits<double>::infinity();
+        intervals[i].upper = std::numeric_limits<double>::infinity();
+      }
+    }
+    std::sort(intervals.begin(), intervals.end(), [](const Interval &a, const Interval &b){
+        return a.lower < b.lower;
+        });
+
+    std::vector<Interval> active;
+    for (auto &curr : intervals){
+      active.erase(std::remove_if(active.begin(), active.end(), [&curr](const Interval &other){
+            return other.upper < curr.lower;
+            }), active.end());
+      for (auto &other : active){
+        if ((count_a >= 0) && ((curr.index < count_a) == (other.index < count_a))){
+          continue;
+        }
+        double reach = radii[curr.index] + radii[other.index];
+        bool within = std::isinf(reach) || ((centers[curr.index] - centers[other.index]).squaredNorm() <= reach*reach);
+        if (!within){
+          continue;
+        }
+        int i = std::min(curr.index, other.index);
+        int j = std::max(curr.index, other.index);
+        output.push_back({i, (count_a >= 0)?(j-count_a):j});
+      }
+      active.push_back(curr);
+    }
+
+    std::sort(output.begin(), output.end());
+    return output;
+  }
+
+}
+
+double spatial_index::gateRadius(const e::Matrix3d &covariance, double gate){
+  e::SelfAdjointEigenSolver<e::Matrix3d> es;
+  es.computeDirect(0.5*(covariance + covariance.transpose()), e::EigenvaluesOnly);
+  auto eigenvalues = es.eigenvalues();
+  if (!eigenvalues.allFinite() || (eigenvalues(0) <= 0)){ //the distance to a distribution that is not positive definite is not bounded by its extent
+    return std::numeric_limits<double>::infinity();
+  }
+  return std::sqrt(gate*eigenvalues(2))*(1.0 + SPATIAL_INDEX_RADIUS_SLACK);
+}
+
+std::vector<std::pair<int,int>> spatial_index::intersectingPairs(const std::vector<e::Vector3d> &centers, const std::vector<double> &radii){
+  return sweep(centers, radii, -1);
+}
+
+std::vector<std::pair<int,int>> spatial_index::intersectingPairs(const std::vector<e::Vector3d> &centers_a, const std::vector<double> &radii_a, const std::vector<e::Vector3d> &centers_b, const std::vector<double> &radii_b){
+  std::vector<e::Vector3d> centers = centers_a;
+  centers.insert(centers.end(), centers_b.begin(), centers_b.end());
+  std::vector<double> radii = radii_a;
+  radii.insert(radii.end(), radii_b.begin(), radii_b.end());
+  return sweep(centers, radii, (int)(centers_a.size()));
+}
+
+double spatial_index::gaussJointMaxVal(const e::Matrix3d &si0, const e::Matrix3d &si1, const e::Vector3d &mu0, const e::Vector3d &mu1){
+  e::Matrix3d K = si0*(si0+si1).inverse();
+  e::Vector3d d0 = K*(mu1-mu0);
+  e::Vector3d d1 = (K-e::Matrix3d::Identity())*(mu1-mu0);
+  return std::exp((-0.5)*(d0.dot(si0.inverse()*d0) + d1.dot(si1.inverse()*d1)));
+}
+
+double spatial_index::mahalanobisSquared(const e::Matrix3d &si0, const e::Matrix3d &si1, const e::Vector3d &mu0, const e::Vector3d &mu1){
+  e::Vector3d difference = mu0 - mu1;
+  e::Matrix3d covariance = si0 + si1;
+  return difference.dot(covariance.ldlt().solve(difference));
+}
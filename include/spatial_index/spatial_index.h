@@ -0,0 +1,76 @@
+#ifndef _SPATIAL_INDEX_H_
+#define _SPATIAL_INDEX_H_
+#include <vector>
+#include <utility>
+#include <Eigen/Core>
+
+namespace uvdar {
+
+  namespace e = Eigen;
+
+  /**
+   * @brief Broad-phase search for nearby position distributions, such that costly pair-wise likelihood checks are only performed for pairs that may pass them. Each distribution is bounded by a sphere, and the intersecting spheres are found by sorting them along the axis of the largest spread of their centers and sweeping over the sorted intervals, in O(n log n + k) for k pairs overlapping along that axis.
+   */
+  namespace spatial_index {
+
+    /**
+     * @brief Retrieves the radius of a sphere centered at the mean of a Gaussian distribution of positions that contains all positions within the given Mahalanobis distance from the mean. Two distributions whose squared Mahalanobis distance w.r.t. the sum of their covariances is below the gate have intersecting spheres.
+     *
+     * @param covariance The 3x3 covariance of the positions
+     * @param gate The squared Mahalanobis distance
+     *
+     * @return The radius
+     */
+    double gateRadius(const e::Matrix3d &covariance, double gate);
+
+    /**
+     * @brief Retrieves all intersecting pairs of spheres within a single set
+     *
+     * @param centers The centers of the spheres
+     * @param radii The radii of the spheres
+     *
+     * @return Pairs of indices (i,j) with i<j, sorted
+     */
+    std::vector<std::pair<int,int>> intersectingPairs(const std::vector<e::Vector3d> &centers, const std::vector<double> &radii);
+
+    /**
+     * @brief Retrieves all intersecting pairs of spheres between two sets
+     *
+     * @param centers_a The centers of the spheres of the first set
+     * @param radii_a The radii of the spheres of the first set
+     * @param centers_b The centers of the spheres of the second set
+     * @param radii_b The radii of the spheres of the second set
+     *
+     * @return Pairs of indices (i,j) of a sphere i from the first set and a sphere j from the second set, sorted
+     */
+    std::vector<std::pair<int,int>> intersectingPairs(const std::vector<e::Vector3d> &centers_a, const std::vector<double> &radii_a, const std::vector<e::Vector3d> &centers_b, const std::vector<double> &radii_b);
+
+    /**
+     * @brief Returns a value between 0 and 1 representing the level of overlap between two probability distributions in the form of multivariate Gaussians. Multiplying two Gaussians produces another Gaussian, with the value of its peak roughly corresponding to the level of the overlap between the two inputs. The ouptut of this function is the value of such peak, given that the input Gaussians have been scaled s.t. their peaks have the value of 1. Therefore, the output is 1 if the means of both inputs are identical.
+     *
+     * @param si0 The covariance of the first distribution
+     * @param si1 The covariance of the second distribution
+     * @param mu0 The mean of the first distribution
+     * @param mu1 The mean of the second distribution
+     *
+     * @return The level of overlap between the two distribution
+     */
+    double gaussJointMaxVal(const e::Matrix3d &si0, const e::Matrix3d &si1, const e::Vector3d &mu0, const e::Vector3d &mu1);
+
+    /**
+     * @brief Returns the squared Mahalanobis distance between the means of two distributions w.r.t. their combined covariance. The output of gaussJointMaxVal equals exp(-0.5*d^2) of this distance, which is cheaper to evaluate.
+     *
+     * @param si0 The covariance of the first distribution
+     * @param si1 The covariance of the second distribution
+     * @param mu0 The mean of the first distribution
+     * @param mu1 The mean of the second distribution
+     *
+     * @return The squared distance
+     */
+    double mahalanobisSquared(const e::Matrix3d &si0, const e::Matrix3d &si1, const e::Vector3d &mu0, const e::Vector3d &mu1);
+
+  } //spatial_index
+
+} //uvdar
+
+#endif // _SPATIAL_INDEX_H_
@@ -0,0 +1,248 @@
+#ifndef _LATENCY_H_
+#define _LATENCY_H_
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <algorithm>
+#include <trace/trace.h>
+#include <uvdar_core/LatencyStamp.h>
+#include <uvdar_core/LatencyTrailer.h>
+#include <uvdar_core/LatencyHistograms.h>
+
+#define LATENCY_SUFFIX "/latency" //the latency trailers of the messages of a topic are published on the topic with this suffix, so that the messages themselves keep their definition
+#define LATENCY_TRAILER_BUFFER 16 //count of received trailers kept while waiting for their message
+#define LATENCY_MATCH_BUFFER 32 //count of applied measurements and of latency trailers kept by the collector while waiting for their counterpart
+
+namespace uvdar {
+
+  namespace trace {
+
+    /**
+     * @brief Starts a new latency trailer with the given stage
+     *
+     * @param trailer The trailer to (re)initialize
+     * @param stage The first stage, one of the constants of uvdar_core::LatencyStamp
+     * @param time Completion time of the stage, as returned by now()
+     */
+    inline void startLatency(std::vector<uvdar_core::LatencyStamp> &trailer, uint8_t stage, int64_t time){
+      trailer.clear();
+      uvdar_core::LatencyStamp stamp;
+      stamp.stage = stage;
+      stamp.time = time;
+      trailer.push_back(stamp);
+    }
+
+    /**
+     * @brief Appends the completion of a stage to a latency trailer. Trailers that were not started upstream stay empty, so that only the first stage decides whether the pipeline is stamped.
+     *
+     * @param trailer The trailer to extend
+     * @param stage The completed stage, one of the constants of uvdar_core::LatencyStamp
+     * @param time Completion time of the stage, as returned by now()
+     *
+     * @return True if the stage was stamped
+     */
+    inline bool stampLatency(std::vector<uvdar_core::LatencyStamp> &trailer, uint8_t stage, int64_t time = now()){
+      if (trailer.empty()){
+        return false;
+      }
+      uvdar_core::LatencyStamp stamp;
+      stamp.stage = stage;
+      stamp.time = time;
+      trailer.push_back(stamp);
+      return true;
+    }
+
+    /**
+     * @brief Pairs the latency trailers received on a companion topic with the messages of the same stamp. The trailers are published before their messages, but arrive through a separate subscription, so a few of them are kept until their message is processed
+     */
+    class LatencyMatcher {
+      public:
+        /**
+         * @brief Callback for the companion topic
+         */
+        void add(const uvdar_core::LatencyTrailer &trailer){
+          std::scoped_lock lock(mutex_);
+          trailers_.push_back(trailer);
+          if (trailers_.size() > LATENCY_TRAILER_BUFFER){
+            trailers_.pop_front();
+            unmatched_++;
+          }
+        }
+
+        /**
+         * @brief Retrieves the stages of the trailer of a message, and discards it together with all older trailers
+         *
+         * @param stamp The stamp of the message
+         *
+         * @return The stages, or an empty trailer if none was received for the message
+         */
+        std::vector<uvdar_core::LatencyStamp> take(const ros::Time &stamp){
+          std::vector<uvdar_core::LatencyStamp> output;
+          std::scoped_lock lock(mutex_);
+          while ((!trailers_.empty()) && (trailers_.front().stamp <= stamp)){
+            if (trailers_.front().stamp == stamp){
+              output = std::move(trailers_.front().stages);
+            }
+            else {
+              unmatched_++;
+            }
+            trailers_.pop_front();
+          }
+          return output;
+        }
+
+        /**
+         * @brief Retrieves the count of trailers discarded without their message since the last call
+         */
+        unsigned long unmatched(){
+          std::scoped_lock lock(mutex_);
+          return std::exchange(unmatched_, 0);
+        }
+
+      private:
+        std::mutex mutex_;
+        std::deque<uvdar_core::LatencyTrailer> trailers_;
+        unsigned long unmatched_ = 0;
+    };
+
+    /**
+     * @brief Completes the latency trailers at the end of the pipeline and accumulates the histograms of the latencies of the individual stages. A trailer is completed with the final stage once the message with the same stamp has been applied, whichever of the two arrives first
+     */
+    class LatencyCollector {
+      public:
+        /**
+         * @brief Constructor
+         *
+         * @param final_stage The stage stamped when a message is applied, one of the constants of uvdar_core::LatencyStamp
+         * @param bin_width The width of the bins of the histograms, in seconds
+         * @param bin_count The number of bins of the histograms. The last bin also holds all larger values
+         */
+        LatencyCollector(uint8_t final_stage, double bin_width, int bin_count) : final_stage_(final_stage), bin_width_(bin_width), bin_count_(bin_count){
+        }
+
+        /**
+         * @brief Callback for the companion topics of the applied messages
+         */
+        void add(const uvdar_core::LatencyTrailer &trailer){
+          std::scoped_lock lock(mutex_);
+          received_ = true;
+          for (auto it = applied_.begin(); it != applied_.end(); it++){
+            if (it->first == trailer.stamp){
+              addLatency(trailer, it->second);
+              applied_.erase(it);
+              return;
+            }
+          }
+          pending_trailers_.push_back(trailer);
+          if (pending_trailers_.size() > LATENCY_MATCH_BUFFER){
+            pending_trailers_.pop_front();
+            unmatched_++;
+          }
+        }
+
+        /**
+         * @brief Marks the completion of the final stage for the message with the given stamp
+         *
+         * @param stamp The stamp of the applied message
+         * @param time Completion time of the final stage, as returned by now()
+         */
+        void applied(const ros::Time &stamp, int64_t time = now()){
+          std::scoped_lock lock(mutex_);
+          if (!received_){
+            return;
+          }
+          for (auto it = pending_trailers_.begin(); it != pending_trailers_.end(); it++){
+            if (it->stamp == stamp){
+              addLatency(*it, time);
+              pending_trailers_.erase(it);
+              return;
+            }
+          }
+          applied_.push_back({stamp, time});
+          if (applied_.size() > LATENCY_MATCH_BUFFER){
+            applied_.pop_front();
+          }
+        }
+
+        /**
+         * @brief Retrieves the count of trailers discarded without their message since the last call
+         */
+        unsigned long unmatched(){
+          std::scoped_lock lock(mutex_);
+          return std::exchange(unmatched_, 0);
+        }
+
+        /**
+         * @brief Retrieves the cumulative histograms, indexed by the stage completing each interval, with uvdar_core::LatencyHistogram::TOTAL for the whole pipeline
+         *
+         * @return The histograms, without the stamp - empty if no trailer was completed yet
+         */
+        uvdar_core::LatencyHistograms histograms(){
+          uvdar_core::LatencyHistograms output;
+          std::scoped_lock lock(mutex_);
+          for (auto &[stage, histogram] : histograms_){
+            uvdar_core::LatencyHistogram msg_stage;
+            msg_stage.stage = stage;
+            msg_stage.count = histogram.count;
+            msg_stage.mean = histogram.sum/(double)(histogram.count);
+            msg_stage.max = histogram.max;
+            msg_stage.bin_width = bin_width_;
+            msg_stage.bins = histogram.bins;
+            output.stages.push_back(msg_stage);
+          }
+          return output;
+        }
+
+      private:
+        struct Histogram {
+          std::vector<uint32_t> bins;
+          uint32_t count = 0;
+          double sum = 0;
+          double max = 0;
+        };
+
+        /**
+         * @brief Adds the intervals between the stages of a completed trailer to the histograms. Has to be called with mutex_ locked
+         */
+        void addLatency(const uvdar_core::LatencyTrailer &trailer, int64_t applied_time){
+          auto stages = trailer.stages;
+          if (!stampLatency(stages, final_stage_, applied_time)){
+            return;
+          }
+          auto add = [this](uint8_t stage, int64_t duration){
+            auto &histogram = histograms_[stage];
+            if (histogram.bins.empty()){
+              histogram.bins.resize(bin_count_, 0);
+            }
+            double value = (double)(duration)/1e9;
+            int bin = std::clamp((int)(value/bin_width_), 0, bin_count_-1);
+            histogram.bins[bin]++;
+            histogram.count++;
+            histogram.sum += value;
+            histogram.max = std::max(histogram.max, value);
+          };
+          for (int i=1; i<(int)(stages.size()); i++){
+            add(stages[i].stage, stages[i].time - stages[i-1].time);
+          }
+          add(uvdar_core::LatencyHistogram::TOTAL, stages.back().time - stages.front().time);
+        }
+
+        const uint8_t final_stage_;
+        const double bin_width_;
+        const int bin_count_;
+        std::mutex mutex_;
+        bool received_ = false;
+        std::deque<std::pair<ros::Time, int64_t>> applied_; //stamps of recently applied messages with the times of their application
+        std::deque<uvdar_core::LatencyTrailer> pending_trailers_; //trailers that arrived before their message was applied
+        std::map<uint8_t, Histogram> histograms_;
+        unsigned long unmatched_ = 0;
+    };
+
+  } //trace
+
+} //uvdar
+
+#endif // _LATENCY_H_
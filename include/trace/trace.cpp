@@ -0,0 +1,155 @@
+#include "trace.h"
+
+#include <array>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <unistd.h>
+
+using namespace uvdar;
+
+#define TRACE_BUFFER_SIZE 16384 //events per thread
+#define TRACE_NAME_LENGTH 48 //must be a multiple of 8
+
+namespace {
+
+  struct Event {
+    char name[TRACE_NAME_LENGTH];
+    int64_t start;
+    int64_t duration;
+  };
+
+  /**
+   * @brief Storage of an event in a ring buffer. The fields are relaxed atomics, since the exporting thread may read a slot while its owner overwrites it - on common platforms, these compile to plain loads and stores
+   */
+  struct SharedEvent {
+    std::array<std::atomic<uint64_t>, TRACE_NAME_LENGTH/8> name;
+    std::atomic<int64_t> start;
+    std::atomic<int64_t> duration;
+
+    void store(const Event &event){
+      for (int i = 0; i < (int)(name.size()); i++){
+        uint64_t word;
+        memcpy(&word, event.name+(8*i), 8);
+        name[i].store(word, std::memory_order_relaxed);
+      }
+      start.store(event.start, std::memory_order_relaxed);
+      duration.store(event.duration, std::memory_order_relaxed);
+    }
+
+    Event load() const {
+      Event output;
+      for (int i = 0; i < (int)(name.size()); i++){
+        uint64_t word = name[i].load(std::memory_order_relaxed);
+        memcpy(output.name+(8*i), &word, 8);
+      }
+      output.name[TRACE_NAME_LENGTH-1] = '\0';
+      output.start = start.load(std::memory_order_relaxed);
+      output.duration = duration.load(std::memory_order_relaxed);
+      return output;
+    }
+  };
+
+  static_assert((TRACE_NAME_LENGTH % 8) == 0, "The name of an event is stored in 8-byte words");
+
+  /**
+   * @brief Ring buffer written only by its own thread, in the manner of a sequence lock. The head is published with release semantics, so that a reader sees complete events up to it. Before overwriting a slot, the writer issues a release fence, so that a reader that saw any part of the new content also sees the head that marks the old content of the slot as invalid.
+   */
+  struct ThreadBuffer {
+    std::array<SharedEvent, TRACE_BUFFER_SIZE> events;
+    std::atomic<uint64_t> head = 0;
+    int thread_index;
+  };
+
+  std::mutex registry_mutex; //guards only the registration of new threads and the export
+  std::vector<std::shared_ptr<ThreadBuffer>> registry;
+
+  ThreadBuffer &localBuffer(){
+    thread_local std::shared_ptr<ThreadBuffer> buffer; // the registry keeps the buffer alive after the thread exits, so that its events can still be exported
+    if (!buffer){
+      buffer = std::make_shared<ThreadBuffer>();
+      std::scoped_lock lock(registry_mutex);
+      buffer->thread_index = (int)(registry.size());
+      registry.push_back(buffer);
+    }
+    return *buffer;
+  }
+
+  void writeEscaped(std::ofstream &output, const char *text){
+    for (const char *c = text; *c != '\0'; c++){
+      if ((*c == '"') || (*c == '\\')){
+        output << '\\';
+      }
+      if ((unsigned char)(*c) >= 0x20){
+        output << *c;
+      }
+    }
+  }
+
+}
+
+std::atomic<bool> trace::enabled_flag = false;
+
+void trace::enable(bool enabled){
+  enabled_flag.store(enabled, std::memory_order_relaxed);
+}
+
+int64_t trace::now(){
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void trace::record(const char *name, int64_t start, int64_t duration){
+  if (!enabled()){
+    return;
+  }
+  ThreadBuffer &buffer = localBuffer();
+  uint64_t head = buffer.head.load(std::memory_order_relaxed);
+  Event event;
+  strncpy(event.name, name, TRACE_NAME_LENGTH-1);
+  event.name[TRACE_NAME_LENGTH-1] = '\0';
+  event.start = start;
+  event.duration = duration;
+  std::atomic_thread_fence(std::memory_order_release); // orders the previous publication of the head before the overwriting of the slot
+  buffer.events[head % TRACE_BUFFER_SIZE].store(event);
+  buffer.head.store(head+1, std::memory_order_release);
+}
+
+bool trace::writeChromeTrace(const std::string &filename){
+  std::ofstream output(filename);
+  if (!output.is_open()){
+    return false;
+  }
+
+  std::scoped_lock lock(registry_mutex);
+  int pid = (int)(getpid());
+  bool first = true;
+  output << std::fixed << std::setprecision(3);
+  output << "{\"traceEvents\":[\n";
+  for (auto &buffer : registry){
+    uint64_t head = buffer->head.load(std::memory_order_acquire);
+    uint64_t begin = (head > TRACE_BUFFER_SIZE)?(head - TRACE_BUFFER_SIZE):0;
+    std::vector<Event> events;
+    events.reserve(head-begin);
+    for (uint64_t i = begin; i < head; i++){
+      events.push_back(buffer->events[i % TRACE_BUFFER_SIZE].load());
+    }
+    // the owning thread may have kept recording while copying - the oldest events may then have been overwritten and are discarded. The slot of the event at head_after may be being written, so it is discarded as well
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t head_after = buffer->head.load(std::memory_order_relaxed);
+    uint64_t valid_begin = (head_after >= TRACE_BUFFER_SIZE)?(head_after - TRACE_BUFFER_SIZE + 1):0;
+    for (uint64_t i = std::max(begin, valid_begin); i < head; i++){
+      const Event &event = events[i-begin];
+      output << (first?"":",\n") << "{\"name\":\"";
+      writeEscaped(output, event.name);
+      output << "\",\"ph\":\"X\",\"ts\":" << event.start/1000.0 << ",\"dur\":" << event.duration/1000.0 << ",\"pid\":" << pid << ",\"tid\":" << buffer->thread_index << "}";
+      first = false;
+    }
+  }
+  output << "\n]}\n";
+  return output.good();
+}
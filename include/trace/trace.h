@@ -0,0 +1,85 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+namespace uvdar {
+
+  /**
+   * @brief Low-overhead tracing shared by the UVDAR nodes and nodelets. Each thread records into its own fixed-size ring buffer without locking, and the buffers of all threads in the process can be exported in the Chrome trace format (viewable in chrome://tracing or Perfetto). When tracing is disabled, recording costs a single relaxed atomic load.
+   */
+  namespace trace {
+
+    extern std::atomic<bool> enabled_flag;
+
+    /**
+     * @brief Enables or disables recording for the whole process
+     */
+    void enable(bool enabled);
+
+    inline bool enabled(){
+      return enabled_flag.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Retrieves the current time of the monotonic clock used by the trace, in nanoseconds
+     */
+    int64_t now();
+
+    /**
+     * @brief Records a completed interval into the ring buffer of the calling thread. Names longer than the storage of an event are truncated.
+     *
+     * @param name Name of the interval
+     * @param start Start of the interval, as returned by now()
+     * @param duration Duration of the interval in nanoseconds
+     */
+    void record(const char *name, int64_t start, int64_t duration);
+
+    /**
+     * @brief Writes all events currently held in the ring buffers of all threads to a file in the Chrome trace JSON format
+     *
+     * @param filename The output file
+     *
+     * @return success
+     */
+    bool writeChromeTrace(const std::string &filename);
+
+    /**
+     * @brief Records the interval of its own lifetime, if tracing was enabled at its construction
+     */
+    class Span {
+      public:
+        Span(const char *name) : name_(name), active_(enabled()){
+          if (active_){
+            start_ = now();
+          }
+        }
+
+        ~Span(){
+          if (active_){
+            record(name_, start_, now() - start_);
+          }
+        }
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+      private:
+        const char *name_;
+        bool active_;
+        int64_t start_ = 0;
+    };
+
+  } //trace
+
+} //uvdar
+
+#define UVDAR_TRACE_CONCAT_INNER(a, b) a ## b
+#define UVDAR_TRACE_CONCAT(a, b) UVDAR_TRACE_CONCAT_INNER(a, b)
+/**
+ * @brief Traces the remainder of the enclosing scope under the given name
+ */
+#define UVDAR_TRACE_SCOPE(name) uvdar::trace::Span UVDAR_TRACE_CONCAT(uvdar_trace_span_, __LINE__)(name)
+
+#endif // _TRACE_H_
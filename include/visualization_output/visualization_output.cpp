@@ -0,0 +1,75 @@
+#include "visualization_output.h"
+
+#include <cv_bridge/cv_bridge.h>
+#include <sensor_msgs/CompressedImage.h>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/imgcodecs/imgcodecs.hpp>
+#include <algorithm>
+#include <cmath>
+
+using namespace uvdar;
+
+#define VISUALIZATION_MIN_PERIOD 0.01 //seconds
+
+visualization_output::Publisher::Publisher(ros::NodeHandle &nh, const std::string &topic, const Options &options) :
+  options_(options){
+  if (!((options_.scale > 0) && (options_.scale <= 1.0))){
+    ROS_WARN_STREAM("[VisualizationOutput]: The scale of the visualization " << topic << " has to be in (0,1], but is " << options_.scale << ". The image will be published in full size.");
+    options_.scale = 1.0;
+  }
+  if (options_.jpeg_quality > 0){
+    pub_compressed_ = {nh.advertise<sensor_msgs::CompressedImage>(topic + "/compressed", 1), VISUALIZATION_MIN_PERIOD};
+  }
+  else {
+    pub_raw_ = {image_transport::ImageTransport(nh).advertise(topic, 1), VISUALIZATION_MIN_PERIOD};
+  }
+}
+
+bool visualization_output::Publisher::wanted(){
+  if (options_.jpeg_quality > 0){
+    return pub_compressed_.wanted();
+  }
+  return pub_raw_.wanted();
+}
+
+bool visualization_output::reduce(const cv::Mat &image, const std::vector<cv::Point> &markers, const Options &options, cv::Mat &output){
+  cv::Rect region(0, 0, image.cols, image.rows);
+  if ((options.roi_margin >= 0) && (!markers.empty())){
+    cv::Rect bounds = cv::boundingRect(markers);
+    bounds -= cv::Point(options.roi_margin, options.roi_margin);
+    bounds += cv::Size(2*options.roi_margin, 2*options.roi_margin);
+    region &= bounds;
+    if (region.empty()){
+      return false;
+    }
+  }
+
+  if ((options.scale > 0) && (options.scale < 1.0)){
+    // the size is rounded explicitly, so that a small scale or a narrow cropped region still yields at least a single pixel in each dimension
+    cv::Size size(std::max((int)(std::lround(region.width*options.scale)), 1), std::max((int)(std::lround(region.height*options.scale)), 1));
+    cv::resize(image(region), output, size, 0, 0, cv::INTER_AREA);
+  }
+  else {
+    output = image(region);
+  }
+  return true;
+}
+
+void visualization_output::Publisher::publish(const cv::Mat &image, const std::vector<cv::Point> &markers){
+  if (!reduce(image, markers, options_, output_)){
+    return;
+  }
+
+  std_msgs::Header header;
+  header.stamp = ros::Time::now();
+  if (options_.jpeg_quality > 0){
+    sensor_msgs::CompressedImage msg;
+    msg.header = header;
+    msg.format = "bgr8; jpeg compressed bgr8";
+    cv::imencode(".jpg", output_, msg.data, {cv::IMWRITE_JPEG_QUALITY, options_.jpeg_quality});
+    pub_compressed_.publish(msg);
+  }
+  else {
+    pub_raw_.publish(cv_bridge::CvImage(header, "bgr8", output_).toImageMsg());
+  }
+}
@@ -0,0 +1,75 @@
+#ifndef _VISUALIZATION_OUTPUT_H_
+#define _VISUALIZATION_OUTPUT_H_
+#include <ros/ros.h>
+#include <image_transport/image_transport.h>
+#include <opencv2/core/core.hpp>
+#include <string>
+#include <vector>
+#include <lazy_publisher/lazy_publisher.h>
+
+namespace uvdar {
+
+  /**
+   * @brief Publishing of the rendered visualization images of the UVDAR nodes, reducing the bandwidth they occupy on the network and in recorded bags
+   */
+  namespace visualization_output {
+
+    struct Options {
+      double scale = 1.0; //factor by which the published image is downscaled, in (0,1] - other values are replaced by 1 with a warning
+      int roi_margin = -1; //if non-negative, the published image is cropped to the bounding box of the markers enlarged by this many pixels on each side
+      int jpeg_quality = 0; //if positive, the image is JPEG-encoded with this quality and published as sensor_msgs/CompressedImage in place of the raw image
+    };
+
+    /**
+     * @brief Crops and downscales a rendered visualization image as configured
+     *
+     * @param image The rendered image
+     * @param markers Positions of the markers in the image, used for cropping
+     * @param options The reductions applied to the image. The JPEG quality is not used here.
+     * @param output Receives the reduced image, which may share its data with the input image
+     *
+     * @return False if the markers enlarged by the margin lie entirely outside of the image, so that there is nothing to publish
+     */
+    bool reduce(const cv::Mat &image, const std::vector<cv::Point> &markers, const Options &options, cv::Mat &output);
+
+    /**
+     * @brief Publishes a rendered visualization image, cropped, downscaled and compressed as configured. Only the topic matching the configured output is advertised, and the output is only processed while it has subscribers. Meant to be used from a single thread.
+     */
+    class Publisher {
+      public:
+        Publisher() = default;
+
+        /**
+         * @brief Constructor
+         *
+         * @param nh The node handle under which the topic is advertised
+         * @param topic Name of the image topic. The compressed output is advertised on its "compressed" subtopic, where image_transport clients with the "compressed" transport expect it.
+         * @param options The reductions applied to the images
+         */
+        Publisher(ros::NodeHandle &nh, const std::string &topic, const Options &options);
+
+        /**
+         * @brief Retrieves whether an image should be rendered now. If it is, the caller is expected to publish it.
+         */
+        bool wanted();
+
+        /**
+         * @brief Publishes the image
+         *
+         * @param image The rendered BGR image
+         * @param markers Positions of the markers in the image, used for cropping
+         */
+        void publish(const cv::Mat &image, const std::vector<cv::Point> &markers);
+
+      private:
+        Options options_;
+        lazy_publisher::Publisher<image_transport::Publisher> pub_raw_;
+        lazy_publisher::Publisher<ros::Publisher> pub_compressed_;
+        cv::Mat output_;
+    };
+
+  } //visualization_output
+
+} //uvdar
+
+#endif // _VISUALIZATION_OUTPUT_H_
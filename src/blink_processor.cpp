@@ -6,12 +6,18 @@
 /* #include <ht4dbt/ht4d_gpu.h> */
 #include <ami/ami.h>
 #include <color_selector/color_selector.h>
+#include <trace/trace.h>
+#include <trace/latency.h>
+#include <diagnostics/diagnostics.h>
+#include <packed_points/packed_points.h>
+#include <lazy_publisher/lazy_publisher.h>
+#include <visualization_output/visualization_output.h>
+#include <snapshot/snapshot.h>
 #include <uvdar_core/ImagePointsWithFloatStamped.h>
 #include <std_msgs/Float32.h>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <mrs_lib/param_loader.h>
-#include <mrs_lib/image_publisher.h>
 #include <uvdar_core/AMIDataForLogging.h>
 #include <uvdar_core/AMISeqVariables.h>
 #include <uvdar_core/AMIAllSequences.h>
@@ -19,7 +25,15 @@
 #include <mutex>
 #include <thread>
 #include <atomic>
+#include <deque>
+#include <chrono>
+#include <condition_variable>
 #include <fstream>
+#include <pthread.h>
+#include <sched.h>
+
+#define DEFAULT_PROCESS_FRAMES 3 //frames per retrieval, i.e. 20 Hz at 60 fps and 10 Hz at 30 fps
+#define INPUT_QUEUE_SIZE 10 //frames waiting for the worker of a camera - the trackers need every frame, so the queue only overflows if the worker falls behind permanently
 
 namespace uvdar{
 
@@ -31,7 +45,30 @@ namespace uvdar{
 
       UVDARBlinkProcessor(){};
 
-      ~UVDARBlinkProcessor(){};
+      ~UVDARBlinkProcessor(){
+        workers_running_ = false;
+        for (auto &queue : input_queues_){
+          std::scoped_lock lock(queue->mutex);
+          queue->condition.notify_all();
+        }
+        {
+          std::scoped_lock lock(mutex_workers_);
+          condition_workers_.notify_all();
+        }
+        for (auto &worker : camera_workers_){
+          if (worker.joinable()){
+            worker.join();
+          }
+        }
+        if (visualization_worker_.joinable()){
+          visualization_worker_.join();
+        }
+        if (!_trace_file_.empty()){
+          if (!trace::writeChromeTrace(_trace_file_)){
+            ROS_ERROR_STREAM("[UVDARBlinkProcessor]: Could not write the trace to " << _trace_file_);
+          }
+        }
+      };
   
 
     private:
@@ -75,14 +112,22 @@ namespace uvdar{
       void setupCallbackAndPublisher();
 
       /**
-      * @brief Callback to insert new image points to:
+      * @brief Callback passing new image points to the worker of the camera that produced them
+      *
+      * @param msg The input message with image points
+      * @param Image_index index of the camera image producing this message
+      */
+      void insertPoints(const uvdar_core::ImagePointsWithFloatStampedConstPtr &, const size_t &);
+
+      /**
+      * @brief Inserts new image points to:
       * - the AMI and processes+publishes receiving points
       * - if 4DHT activated: the accumulator of the HT4D process
       *
       * @param msg The input message with image points
       * @param Image_index index of the camera image producing this message
       */
-      void insertPoints(const uvdar_core::ImagePointsWithFloatStampedConstPtr &, const size_t &);
+      void processPoints(const uvdar_core::ImagePointsWithFloatStampedConstPtr &, const size_t &);
 
       /**
       * @brief Callback to insert points corresponding to pixels with sun to local variable for visualization
@@ -92,6 +137,15 @@ namespace uvdar{
       */
       void insertSunPoints(const uvdar_core::ImagePointsWithFloatStampedConstPtr&, const size_t&);
 
+      /**
+      * @brief Publishes the retrieved blinking markers, also in the compact variant if it is subscribed. A non-empty latency trailer is published on the companion topic first
+      *
+      * @param msg The message with the blinking markers
+      * @param image_index Index of the camera producing the image
+      * @param latency The latency trailer of the markers
+      */
+      void publishBlinkers(const uvdar_core::ImagePointsWithFloatStamped&, const size_t&, std::vector<uvdar_core::LatencyStamp>&&);
+
       /**
        * @brief setup callbacks,subscribers and threads for optional visualization 
        * 
@@ -100,7 +154,14 @@ namespace uvdar{
 
 
       /**
-      * @brief Thread function: 
+      * @brief Persistent worker of a single camera, processing the image points of that camera as they arrive. The worker is pinned to the CPU core given for its camera, if any.
+      *
+      * @param image_index Index of the camera served by this worker
+      */
+      void CameraWorker(const int);
+
+      /**
+      * @brief Thread function, run by the camera worker after every blink_process_frames inserted frames, or at most at blink_process_rate if that is not positive:
       * - 4DHT: processes the accumulated image points and periodically retrieves estimated origin points and frequency estimates of blinking markers
       * - AMI: Only used for visualization
       * 
@@ -109,11 +170,21 @@ namespace uvdar{
       void ProcessThread(const int&);
 
       /**
-      * @brief Thread function for optional visualization of the detected blinking markers
+      * @brief Hands the current tracking results of a camera over to the visualization, if it is enabled. Called by the camera worker, which also updates the tracker, so that the copied sequences are consistent.
       *
-      * @param te TimerEvent for the timer spinning this thread
+      * @param image_index Index of the camera producing the image
       */
-      void VisualizationThread([[maybe_unused]] const ros::TimerEvent&);
+      void snapshotBlinkers(const int);
+
+      /**
+      * @brief Persistent worker running the optional visualization at visualization_rate with the lowest scheduling priority, so that it never delays the camera workers
+      */
+      void VisualizationWorker();
+
+      /**
+      * @brief Thread function for optional visualization of the detected blinking markers
+      */
+      void VisualizationThread();
 
       /**
       * @brief Method for generating annotated image for optional visualization
@@ -141,43 +212,84 @@ namespace uvdar{
       
       std::vector<std::vector<bool>> sequences_;
       std::vector<ros::Publisher> pub_blinkers_seen_;
-      std::vector<ros::Publisher> pub_ami_logging_;
-      std::vector<ros::Publisher> pub_AMI_all_seq_info;
+      std::vector<ros::Publisher> pub_blinkers_seen_packed_;
+      std::vector<ros::Publisher> pub_blinkers_seen_latency_;
+      std::vector<lazy_publisher::Publisher<ros::Publisher>> pub_ami_logging_;
+      std::vector<lazy_publisher::Publisher<ros::Publisher>> pub_AMI_all_seq_info;
       std::vector<ros::Publisher> pub_estimated_framerate_;
 
       using points_seen_callback_t = boost::function<void (const uvdar_core::ImagePointsWithFloatStampedConstPtr&)>;
       std::vector<points_seen_callback_t> cals_points_seen_;
       std::vector<points_seen_callback_t> cals_sun_points_;
+      using packed_points_callback_t = boost::function<void (const uvdar_core::ImagePointsPackedStampedConstPtr&)>;
       std::vector<ros::Subscriber> sub_points_seen_;
       std::vector<ros::Subscriber> sub_sun_points_;
+      std::vector<ros::Subscriber> sub_points_latency_;
+      std::vector<std::unique_ptr<trace::LatencyMatcher>> latency_matchers_;
+
 
+      /**
+       * @brief Image points of a single camera waiting to be processed by its worker
+       */
+      struct CameraInputQueue {
+        std::deque<std::pair<uvdar_core::ImagePointsWithFloatStampedConstPtr, std::chrono::time_point<std::chrono::steady_clock>>> inputs; //with the times of their arrival
+        std::mutex mutex;
+        std::condition_variable condition;
+      };
+      std::vector<std::unique_ptr<CameraInputQueue>> input_queues_;
+      std::vector<std::thread> camera_workers_;
+      std::thread visualization_worker_;
+      std::atomic<bool> workers_running_ = true;
+      std::mutex mutex_workers_;
+      std::condition_variable condition_workers_; //wakes the visualization worker on shutdown
 
       // visualization variables
-      std::vector<ros::Timer> timer_process_;
-      ros::Timer timer_visualization_;
       using image_callback_t = boost::function<void (const sensor_msgs::ImageConstPtr&)>;
       std::vector<image_callback_t> cals_image_;
       std::vector<ros::Subscriber> sub_image_;
       std::atomic_bool current_visualization_done_ = false;
-      std::vector<cv::Mat> images_current_;
       cv::Mat image_visualization_;
-      std::vector<bool> current_images_received_;
       std::vector<cv::Size> camera_image_sizes_;
-      std::unique_ptr<mrs_lib::ImagePublisher> pub_visualization_;
-      std::vector<std::shared_ptr<std::mutex>>  mutex_camera_image_;
-      
+      visualization_output::Publisher pub_visualization_;
+      std::vector<cv::Point> visualization_markers_; //positions of the drawn blinkers in the visualization image, used for cropping
 
-      std::vector<std::vector<cv::Point>> sun_points_;
-      std::mutex mutex_sun;
-      
-      ros::Time last_publish_ami_logging_;
+      /**
+       * @brief The state of a tracked blinker needed to draw it in the visualization
+       */
+      struct BlinkerSnapshot {
+        cv::Point2d point;
+        int signal_index;
+        cv::Point2d predicted;
+        cv::Point2d confidence_interval;
+        std::vector<double> x_coeff;
+        std::vector<double> y_coeff;
+        double insert_time;
+        bool x_poly_reg_computed;
+        bool y_poly_reg_computed;
+        bool x_extended_search;
+        bool y_extended_search;
+        std::vector<cv::Point> sequence; //past positions with the LED on
+        double yaw; //4DHT only
+        double pitch; //4DHT only
+      };
+      struct VisualizationSnapshot {
+        std::vector<BlinkerSnapshot> blinkers;
+        double framerate_estimate = 72;
+      };
+      // the visualization renders from copies handed over through lock-free buffers, so that it never holds up the camera workers or the input callbacks
+      std::vector<std::unique_ptr<snapshot::TripleBuffer<VisualizationSnapshot>>> blinker_snapshots_; //written by the camera workers
+      std::vector<std::unique_ptr<snapshot::TripleBuffer<std::vector<cv::Point>>>> sun_snapshots_; //written by the sun point callbacks
+      std::vector<std::unique_ptr<snapshot::TripleBuffer<cv::Mat>>> image_snapshots_; //written by the image callbacks
 
       // dynamic loaded params
       std::string _uav_name_;   
       bool        _debug_;
+      std::string _trace_file_; //if not empty, the trace is recorded and written to this file on shutdown
+      std::unique_ptr<diagnostics::Publisher> diagnostics_;
       bool        _gui_;
       bool        _publish_visualization_;
       float       _visualization_rate_;
+      visualization_output::Options _visualization_options_;
       std::vector<std::string> _camera_topics_;
       bool        _use_camera_for_visualization_;
       std::vector<std::string> _blinkers_seen_topics_;
@@ -186,10 +298,12 @@ namespace uvdar{
       std::vector<std::string> _points_seen_topics_;
       std::vector<std::string> _ami_logging_topics_;
       std::vector<std::string> _ami_all_seq_info_topics;
+      double _ami_all_seq_info_period_; //minimum time between two messages with the AMI sequences
       
 
       bool _manchester_code_;
       bool _use_4DHT_;
+      bool _packed_input_; //if true, the compact variants of the input point topics are subscribed
       std::string _sequence_file;
 
       // params for AMI
@@ -213,6 +327,8 @@ namespace uvdar{
       int _nullify_radius_;
       bool _visual_debug_;
       int _process_rate_;
+      int _process_frames_; //if positive, the results are retrieved after this many inserted frames instead of at _process_rate_
+      std::vector<int> _camera_thread_cpus_; //CPU core of the worker of each camera, negative for no pinning
 
       // for extracting the received sequences from the AMI/4DHT
       struct BlinkData{
@@ -225,6 +341,7 @@ namespace uvdar{
         std::vector<std::pair<cv::Point2d,int>>      retrieved_blinkers_4DHT;
         std::vector<double>           pitch_4DHT;
         std::vector<double>           yaw_4DHT;
+        std::vector<uvdar_core::LatencyStamp> latency_4DHT; //latency trailer of the latest points inserted to 4DHT, not yet published
 
         std::shared_ptr<std::mutex>   mutex_retrieved_blinkers;
         BlinkData(){mutex_retrieved_blinkers = std::make_shared<std::mutex>();}
@@ -241,8 +358,6 @@ namespace uvdar{
 
     nh_ = nodelet::Nodelet::getMTPrivateNodeHandle();
 
-    last_publish_ami_logging_ = ros::Time::now();
-
     const bool print_params_console = false;
     loadParams(print_params_console);
 
@@ -254,9 +369,9 @@ namespace uvdar{
 
 
     parseSequenceFile(_sequence_file);
+    diagnostics_ = std::make_unique<diagnostics::Publisher>(nh_, "blink_processor");
     setupCallbackAndPublisher();
     
-    sun_points_.resize(_points_seen_topics_.size());
     if(!_use_4DHT_){
       if(!initAMI()){
         ROS_ERROR("[UVDARBlinkProcessor]: Shutting down - AMI wasn't initialized correctly!");
@@ -269,8 +384,10 @@ namespace uvdar{
 
     for (int i = 0; i < (int)_points_seen_topics_.size(); ++i) {
       blink_data_.push_back(BlinkData());
-      mutex_camera_image_.push_back(std::make_shared<std::mutex>());
+      blinker_snapshots_.push_back(std::make_unique<snapshot::TripleBuffer<VisualizationSnapshot>>());
+      sun_snapshots_.push_back(std::make_unique<snapshot::TripleBuffer<std::vector<cv::Point>>>());
       camera_image_sizes_.push_back(cv::Size(-1,-1));
+      input_queues_.push_back(std::make_unique<CameraInputQueue>());
     }
 
     
@@ -288,11 +405,18 @@ namespace uvdar{
 
     param_loader.loadParam("uav_name", _uav_name_, std::string());
     param_loader.loadParam("debug", _debug_, bool(false));
+    param_loader.loadParam("trace_file", _trace_file_, std::string(""));
+    if (!_trace_file_.empty()){
+      trace::enable(true);
+    }
 
 
     param_loader.loadParam("gui", _gui_, bool(true));                                     
     param_loader.loadParam("publish_visualization", _publish_visualization_, bool(true));
     param_loader.loadParam("visualization_rate", _visualization_rate_, float(2.0));    
+    param_loader.loadParam("visualization_scale", _visualization_options_.scale, double(1.0));
+    param_loader.loadParam("visualization_roi_margin", _visualization_options_.roi_margin, int(-1));
+    param_loader.loadParam("visualization_jpeg_quality", _visualization_options_.jpeg_quality, int(0));
     nh_.param("use_camera_for_visualization", _use_camera_for_visualization_, bool(true));
 
     /***** topic name params *****/
@@ -306,7 +430,9 @@ namespace uvdar{
     param_loader.loadParam("sequence_file", _sequence_file, std::string());    
     param_loader.loadParam("manchester_code", _manchester_code_, bool(false));
     param_loader.loadParam("use_4DHT", _use_4DHT_, bool(false));
+    param_loader.loadParam("packed_input", _packed_input_, bool(false));
     param_loader.loadParam("pub_tracking_stats", _pub_tracking_stats_, bool(false));
+    param_loader.loadParam("ami_all_seq_info_period", _ami_all_seq_info_period_, double(0.0));
 
     /***** AMI params *****/
     param_loader.loadParam("max_px_shift_x", _max_px_shift_.x, int(2));
@@ -329,6 +455,8 @@ namespace uvdar{
     param_loader.loadParam("reasonable_radius", _reasonable_radius_, int(6));
     param_loader.loadParam("nullify_radius", _nullify_radius_, int(5));
     param_loader.loadParam("blink_process_rate", _process_rate_, int(10));
+    param_loader.loadParam("blink_process_frames", _process_frames_, int(DEFAULT_PROCESS_FRAMES));
+    param_loader.loadParam("camera_thread_cpus", _camera_thread_cpus_, _camera_thread_cpus_);
     param_loader.loadParam("visual_debug", _visual_debug_, bool(false));
     if ( _visual_debug_) {
       ROS_WARN_STREAM("[UVDARBlinkProcessor]: You are using visual debugging. This option is only meant for development. Activating it significantly increases load on the system and the user should do so with care.");
@@ -358,6 +486,11 @@ namespace uvdar{
           << ") is not matching the number of blinkers_seen_topics (" << _estimated_framerate_topics_.size() << ")!");
       return false;
     }
+    if ((!_camera_thread_cpus_.empty()) && (_camera_thread_cpus_.size() != _points_seen_topics_.size())) {
+      ROS_ERROR_STREAM("[UVDARBlinkProcessor] The number of pointsSeenTopics (" << _points_seen_topics_.size() 
+          << ") is not matching the number of camera_thread_cpus (" << _camera_thread_cpus_.size() << ")!");
+      return false;
+    }
 
     // for AMI
     if( 100 <= _conf_probab_percent_){
@@ -440,8 +573,6 @@ namespace uvdar{
     params_AMI.decay_factor = _decay_factor_;
     params_AMI.conf_probab_percent = _conf_probab_percent_;
     params_AMI.allowed_BER_per_seq = _allowed_BER_per_seq_;
-    
-    sun_points_.resize(_points_seen_topics_.size());
 
     for (int i = 0; i < (int)_points_seen_topics_.size(); ++i) {
       ami_.push_back(std::make_shared<AMI>(params_AMI));
@@ -476,23 +607,40 @@ namespace uvdar{
         insertPoints(points_msg, image_index);
       };
       cals_points_seen_.push_back(callback);
-      sub_points_seen_.push_back(nh_.subscribe(_points_seen_topics_[i], 1, cals_points_seen_[i]));
       
       points_seen_callback_t sun_callback = [image_index=i,this] (const uvdar_core::ImagePointsWithFloatStampedConstPtr& sun_points_msg){
         insertSunPoints(sun_points_msg, image_index);
       };
-      cals_sun_points_.push_back(callback);
-      sub_sun_points_.push_back(nh_.subscribe(_points_seen_topics_[i] + "/sun", 1, cals_sun_points_[i]));
+      cals_sun_points_.push_back(sun_callback);
+
+      if (_packed_input_){
+        packed_points_callback_t packed_callback = [callback](const uvdar_core::ImagePointsPackedStampedConstPtr &points_msg){
+          callback(packed_points::unpack(*points_msg));
+        };
+        packed_points_callback_t packed_sun_callback = [sun_callback](const uvdar_core::ImagePointsPackedStampedConstPtr &sun_points_msg){
+          sun_callback(packed_points::unpack(*sun_points_msg));
+        };
+        sub_points_seen_.push_back(nh_.subscribe(_points_seen_topics_[i] + PACKED_POINTS_SUFFIX, 1, packed_callback));
+        sub_sun_points_.push_back(nh_.subscribe(_points_seen_topics_[i] + "/sun" + PACKED_POINTS_SUFFIX, 1, packed_sun_callback));
+      }
+      else {
+        sub_points_seen_.push_back(nh_.subscribe(_points_seen_topics_[i], 1, cals_points_seen_[i]));
+        sub_sun_points_.push_back(nh_.subscribe(_points_seen_topics_[i] + "/sun", 1, cals_sun_points_[i]));
+      }
+      latency_matchers_.push_back(std::make_unique<trace::LatencyMatcher>());
+      sub_points_latency_.push_back(nh_.subscribe(_points_seen_topics_[i] + LATENCY_SUFFIX, 5, &trace::LatencyMatcher::add, latency_matchers_.back().get()));
     } 
 
     for (size_t i = 0; i < _blinkers_seen_topics_.size(); ++i) {
       pub_blinkers_seen_.push_back(nh_.advertise<uvdar_core::ImagePointsWithFloatStamped>(_blinkers_seen_topics_[i], 1));
+      pub_blinkers_seen_packed_.push_back(nh_.advertise<uvdar_core::ImagePointsPackedStamped>(_blinkers_seen_topics_[i] + PACKED_POINTS_SUFFIX, 1));
+      pub_blinkers_seen_latency_.push_back(nh_.advertise<uvdar_core::LatencyTrailer>(_blinkers_seen_topics_[i] + LATENCY_SUFFIX, 1));
       pub_estimated_framerate_.push_back(nh_.advertise<std_msgs::Float32>(_estimated_framerate_topics_[i], 1));
       
       if(_pub_tracking_stats_){
         if(!_use_4DHT_){
-          pub_ami_logging_.push_back(nh_.advertise<uvdar_core::AMIDataForLogging>(_ami_logging_topics_[i], 1));
-          pub_AMI_all_seq_info.push_back(nh_.advertise<uvdar_core::AMIAllSequences>(_ami_all_seq_info_topics[i], 1));
+          pub_ami_logging_.emplace_back(nh_.advertise<uvdar_core::AMIDataForLogging>(_ami_logging_topics_[i], 1), (double)(_loaded_var_pub_rate_));
+          pub_AMI_all_seq_info.emplace_back(nh_.advertise<uvdar_core::AMIAllSequences>(_ami_all_seq_info_topics[i], 1), _ami_all_seq_info_period_);
         }
       }
     }
@@ -502,16 +650,20 @@ namespace uvdar{
   void UVDARBlinkProcessor::setupVisualization(){
     if (_gui_ || _publish_visualization_){ 
 
+      if (_publish_visualization_){
+        pub_visualization_ = visualization_output::Publisher(nh_, "uvdar_blink_visualization", _visualization_options_);
+      }
+
       current_visualization_done_ = false;
-      timer_visualization_ = nh_.createTimer(ros::Rate(_visualization_rate_), &UVDARBlinkProcessor::VisualizationThread, this, false);
 
       if (_use_camera_for_visualization_){
         /* subscribe to cameras //{ */
 
-        images_current_.resize(_camera_topics_.size());
+        for (size_t i = 0; i < _camera_topics_.size(); ++i) {
+          image_snapshots_.push_back(std::make_unique<snapshot::TripleBuffer<cv::Mat>>());
+        }
         // Create callbacks for each camera
         for (size_t i = 0; i < _camera_topics_.size(); ++i) {
-          current_images_received_.push_back(false);
           image_callback_t callback = [image_index=i,this] (const sensor_msgs::ImageConstPtr& image_msg) { 
             callbackImage(image_msg, image_index);
           };
@@ -520,14 +672,12 @@ namespace uvdar{
           sub_image_.push_back(nh_.subscribe(_camera_topics_[i], 1, cals_image_[i]));
         }
       }
-      
-      if (_publish_visualization_){
-        pub_visualization_ = std::make_unique<mrs_lib::ImagePublisher>(boost::make_shared<ros::NodeHandle>(nh_));
-      }
+
+      visualization_worker_ = std::thread(&UVDARBlinkProcessor::VisualizationWorker, this);
     }
 
-    for (size_t i = 0; i < _points_seen_topics_.size(); ++i) {
-      timer_process_.push_back(nh_.createTimer(ros::Duration(1.0/(double)(_process_rate_)), boost::bind(&UVDARBlinkProcessor::ProcessThread, this, i), false, true));
+    for (int i = 0; i < (int)(_points_seen_topics_.size()); ++i) {
+      camera_workers_.emplace_back(&UVDARBlinkProcessor::CameraWorker, this, i);
     }
   }
 
@@ -535,6 +685,68 @@ namespace uvdar{
   void UVDARBlinkProcessor::insertPoints(const uvdar_core::ImagePointsWithFloatStampedConstPtr &pts_msg, const size_t & img_index) {
     if (!initialized_) return;
 
+    auto &queue = *(input_queues_[img_index]);
+    std::scoped_lock lock(queue.mutex);
+    queue.inputs.push_back({pts_msg, std::chrono::steady_clock::now()});
+    while (queue.inputs.size() > INPUT_QUEUE_SIZE){
+      queue.inputs.pop_front();
+      diagnostics_->count("frames dropped");
+    }
+    queue.condition.notify_one();
+  }
+
+  void UVDARBlinkProcessor::CameraWorker(const int image_index) {
+    if ((!_camera_thread_cpus_.empty()) && (_camera_thread_cpus_[image_index] >= 0)){
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(_camera_thread_cpus_[image_index], &cpus);
+      if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus) != 0){
+        ROS_WARN_STREAM("[UVDARBlinkProcessor]: Could not pin the worker of camera " << image_index << " to CPU " << _camera_thread_cpus_[image_index] << ".");
+      }
+    }
+
+    const auto process_period = std::chrono::duration<double>(1.0/(double)(_process_rate_));
+    auto last_processing = std::chrono::steady_clock::now();
+    int frames_inserted = 0; //since the last processing
+    auto &queue = *(input_queues_[image_index]);
+    decltype(queue.inputs) batch;
+    while (workers_running_ && ros::ok()){
+      {
+        std::unique_lock lock(queue.mutex);
+        queue.condition.wait(lock, [&queue, this]{return (!queue.inputs.empty()) || (!workers_running_);});
+        if (!workers_running_){
+          return;
+        }
+        batch.swap(queue.inputs); //all frames that queued up while the tracker was busy are taken at once, so that the producer is not blocked for each of them
+      }
+
+      auto now = std::chrono::steady_clock::now();
+      for (auto &[input, arrival] : batch){
+        diagnostics_->gauge("queue wait [ms]", 1000.0*std::chrono::duration<double>(now - arrival).count());
+        processPoints(input, image_index);
+      }
+      frames_inserted += (int)(batch.size());
+      if (batch.size() > 1){
+        diagnostics_->count("coalesced frames", (int)(batch.size()) - 1);
+      }
+      batch.clear();
+
+      now = std::chrono::steady_clock::now();
+      bool due = (_process_frames_ > 0)?(frames_inserted >= _process_frames_):((now - last_processing) >= process_period);
+      if (due){ //evaluated once per batch, so the results are retrieved after a backlog as well, but only once for all of its frames
+        last_processing = now;
+        frames_inserted = 0;
+        ProcessThread(image_index);
+      }
+    }
+  }
+
+  void UVDARBlinkProcessor::processPoints(const uvdar_core::ImagePointsWithFloatStampedConstPtr &pts_msg, const size_t & img_index) {
+    UVDAR_TRACE_SCOPE("blink: points received");
+    int64_t start_time = trace::now();
+    diagnostics_->count("frames received");
+    diagnostics_->gauge("points per frame", (double)(pts_msg->points.size()));
+
     blink_data_[img_index].sample_count++;
     
     if ((blink_data_[img_index].sample_count % 10) == 0) { //update the estimate of frequency every 10 samples
@@ -562,6 +774,7 @@ namespace uvdar{
     double dt = (pts_msg->stamp - blink_data_[img_index].last_sample_time).toSec();
     if (dt > (1.5/(blink_data_[img_index].framerate_estimate)) ){
       int new_frame_count = (int)(dt*(blink_data_[img_index].framerate_estimate) + 0.5) - 1;
+      diagnostics_->count("missing frames", new_frame_count);
       if(!_use_4DHT_){
         ROS_ERROR_STREAM("[UVDARBlinkProcessor]: Missing frames! AMI will automatically insert " << new_frame_count << " empty frames!"); 
       }else{
@@ -584,11 +797,16 @@ namespace uvdar{
       ami_[img_index]->processBuffer(pts_msg);
 
     }else{
+      auto latency = latency_matchers_[img_index]->take(pts_msg->stamp);
       std::vector<cv::Point2i> points;
       for (auto& point : pts_msg->points) {
         points.push_back(cv::Point2d(point.x, point.y));
       }
       ht4dbt_trackers_[img_index]->insertFrame(points);
+      if (!latency.empty()){
+        std::scoped_lock lock(*(blink_data_[img_index].mutex_retrieved_blinkers));
+        blink_data_[img_index].latency_4DHT = std::move(latency);
+      }
     }
 
     if ((!_use_camera_for_visualization_) || ((!_gui_) && (!_publish_visualization_))){
@@ -605,11 +823,14 @@ namespace uvdar{
       }
     }
 
-    if(_use_4DHT_) return;
+    if(_use_4DHT_){
+      diagnostics_->gauge("processing time [ms]", (double)(trace::now() - start_time)/1e6);
+      return;
+    }
     
     uvdar_core::ImagePointsWithFloatStamped msg;
-    uvdar_core::AMIDataForLogging ami_logging_msg;
     uvdar_core::AMIAllSequences ami_all_seq_msg;
+    bool build_all_seq = _pub_tracking_stats_ && pub_AMI_all_seq_info[img_index].wanted(); //the sequences with their regression coefficients are only assembled if somebody listens
     ros::Time local_last_sample_time = blink_data_[img_index].last_sample_time;
     {
       std::scoped_lock lock(*(blink_data_[img_index].mutex_retrieved_blinkers));
@@ -630,6 +851,11 @@ namespace uvdar{
           point.value = -2;
           invalid_signal_cnt++;
         }
+        msg.points.push_back(point);
+
+        if (!build_all_seq){
+          continue;
+        }
                   
         // publish values from AMI if the sequence is valid
         uvdar_core::AMISeqVariables ami_seq_msg;
@@ -668,19 +894,22 @@ namespace uvdar{
         ami_seq_msg.extended_search.push_back(last_point.y_statistics.extended_search);
 
         ami_all_seq_msg.sequences.push_back(ami_seq_msg);
-        msg.points.push_back(point);
       }
       msg.stamp         = local_last_sample_time;
       msg.image_width   = camera_image_sizes_[img_index].width;
       msg.image_height  = camera_image_sizes_[img_index].height;
+      auto latency = latency_matchers_[img_index]->take(pts_msg->stamp);
+      trace::stampLatency(latency, uvdar_core::LatencyStamp::BLINK_PROCESSOR);
 
       if(_debug_){
         ROS_INFO("[UVDARBlinkProcessor]: Extracted %d valid signals and %d invalid signals", valid_signal_cnt, invalid_signal_cnt);
       }
+      diagnostics_->gauge("valid signals", valid_signal_cnt);
+      diagnostics_->gauge("invalid signals", invalid_signal_cnt);
 
       // publish the last point for the pose calculate
-      pub_blinkers_seen_[img_index].publish(msg);
-      if(_pub_tracking_stats_){
+      publishBlinkers(msg, img_index, std::move(latency));
+      if(build_all_seq){
         // publish whole sequence with infos from AMI
         pub_AMI_all_seq_info[img_index].publish(ami_all_seq_msg);
       }
@@ -691,13 +920,9 @@ namespace uvdar{
 
       if(_pub_tracking_stats_){
         // publish loaded variables every _loaded_var_pub_rate_ seconds
-        double diff = ros::Time::now().toSec() - last_publish_ami_logging_.toSec();
-        if( _loaded_var_pub_rate_ < diff ) {
-
-          if ( ( _loaded_var_pub_rate_ + 0.1 ) <= diff ) 
-          last_publish_ami_logging_ = ros::Time::now();
-
-          ami_logging_msg.stamp = last_publish_ami_logging_;
+        pub_ami_logging_[img_index].publishLazy([this]{
+          uvdar_core::AMIDataForLogging ami_logging_msg;
+          ami_logging_msg.stamp = ros::Time::now();
           ami_logging_msg.pub_rate = _loaded_var_pub_rate_; 
           uvdar_core::Point2DWithFloat max_px_shift;
           ami_logging_msg.stored_seq_len_factor = _stored_seq_len_factor_;
@@ -709,26 +934,42 @@ namespace uvdar{
           ami_logging_msg.confidence_probab_t_dist = _conf_probab_percent_;
           ami_logging_msg.decay_factor_weight_func = _decay_factor_;
           ami_logging_msg.max_px_shift = max_px_shift;
-          pub_ami_logging_[img_index].publish(ami_logging_msg);
-        }
+          return ami_logging_msg;
+        });
       }
     }
+    diagnostics_->gauge("processing time [ms]", (double)(trace::now() - start_time)/1e6);
     
   } 
 
   void UVDARBlinkProcessor::insertSunPoints(const uvdar_core::ImagePointsWithFloatStampedConstPtr& msg, const size_t & image_index) {
     if (!initialized_) return;
 
+    if (!(_gui_ || _publish_visualization_)){ //the sun points are only drawn
+      return;
+    }
+
     /* int                      countSeen; */
-    std::vector<cv::Point2i> points;
+    std::vector<cv::Point2i> &points = sun_snapshots_[image_index]->writeSlot();
+    points.clear();
 
     for (auto& point : msg->points) {
       points.push_back(cv::Point2d(point.x, point.y));
     }
 
-    {
-      std::scoped_lock lock(mutex_sun);
-      sun_points_[image_index] = points;
+    sun_snapshots_[image_index]->publish();
+  }
+
+  void UVDARBlinkProcessor::publishBlinkers(const uvdar_core::ImagePointsWithFloatStamped& msg, const size_t & image_index, std::vector<uvdar_core::LatencyStamp> &&latency) {
+    if (!latency.empty()){
+      uvdar_core::LatencyTrailer msg_latency;
+      msg_latency.stamp = msg.stamp;
+      msg_latency.stages = std::move(latency);
+      pub_blinkers_seen_latency_[image_index].publish(msg_latency);
+    }
+    pub_blinkers_seen_[image_index].publish(msg);
+    if (pub_blinkers_seen_packed_[image_index].getNumSubscribers() > 0){
+      pub_blinkers_seen_packed_[image_index].publish(packed_points::pack(msg));
     }
   }
 
@@ -736,6 +977,7 @@ namespace uvdar{
     if (!initialized_){
       return;
     }
+    UVDAR_TRACE_SCOPE("blink: processing");
 
     if(_use_4DHT_){
 
@@ -744,6 +986,7 @@ namespace uvdar{
       }
 
       uvdar_core::ImagePointsWithFloatStamped msg;
+      std::vector<uvdar_core::LatencyStamp> latency;
 
       if (_debug_){
         ROS_INFO("Processing accumulated points.");
@@ -756,6 +999,8 @@ namespace uvdar{
           blink_data_[image_index].retrieved_blinkers_4DHT = ht4dbt_trackers_[image_index]->getResults();
           blink_data_[image_index].pitch_4DHT              = ht4dbt_trackers_[image_index]->getPitch();
           blink_data_[image_index].yaw_4DHT                = ht4dbt_trackers_[image_index]->getYaw();      
+          latency = std::move(blink_data_[image_index].latency_4DHT); // each trailer is published only once
+          blink_data_[image_index].latency_4DHT.clear();
 
       }
 
@@ -775,24 +1020,99 @@ namespace uvdar{
         }
         msg.points.push_back(point);
       }
+      trace::stampLatency(latency, uvdar_core::LatencyStamp::BLINK_PROCESSOR);
+      diagnostics_->gauge("signals", (double)(msg.points.size()));
 
-      pub_blinkers_seen_[image_index].publish(msg);
+      publishBlinkers(msg, image_index, std::move(latency));
 
       std_msgs::Float32 msgFramerate;
       msgFramerate.data = blink_data_[image_index].framerate_estimate;
       pub_estimated_framerate_[image_index].publish(msgFramerate);
     }
 
-    current_visualization_done_ = false;
+    snapshotBlinkers(image_index);
 
   }
 
-  void UVDARBlinkProcessor::VisualizationThread([[maybe_unused]] const ros::TimerEvent& te) {
+  void UVDARBlinkProcessor::snapshotBlinkers(const int image_index) {
+    if (!(_gui_ || _publish_visualization_)){
+      return;
+    }
+
+    VisualizationSnapshot &snapshot = blinker_snapshots_[image_index]->writeSlot();
+    snapshot.framerate_estimate = blink_data_[image_index].framerate_estimate;
+    {
+      std::scoped_lock lock(*(blink_data_[image_index].mutex_retrieved_blinkers));
+      if(!_use_4DHT_){
+        auto &retrieved_blinkers = blink_data_[image_index].retrieved_blinkers;
+        snapshot.blinkers.resize(retrieved_blinkers.size()); // the elements are overwritten in place, reusing their storage
+        for (int j = 0; j < (int)(retrieved_blinkers.size()); j++){
+          const auto &last_point = retrieved_blinkers[j].first->end()[-1];
+          BlinkerSnapshot &blinker = snapshot.blinkers[j];
+          blinker.point = cv::Point2d(last_point.point.x, last_point.point.y);
+          blinker.signal_index = retrieved_blinkers[j].second;
+          blinker.predicted = cv::Point2d(last_point.x_statistics.predicted_coordinate, last_point.y_statistics.predicted_coordinate);
+          blinker.confidence_interval = cv::Point2d(last_point.x_statistics.confidence_interval, last_point.y_statistics.confidence_interval);
+          blinker.x_coeff.assign(last_point.x_statistics.coeff.begin(), last_point.x_statistics.coeff.end());
+          blinker.y_coeff.assign(last_point.y_statistics.coeff.begin(), last_point.y_statistics.coeff.end());
+          blinker.insert_time = last_point.insert_time.toSec();
+          blinker.x_poly_reg_computed = last_point.x_statistics.poly_reg_computed;
+          blinker.y_poly_reg_computed = last_point.y_statistics.poly_reg_computed;
+          blinker.x_extended_search = last_point.x_statistics.extended_search;
+          blinker.y_extended_search = last_point.y_statistics.extended_search;
+          blinker.sequence.clear();
+          for (auto &p : *(retrieved_blinkers[j].first)){
+            if (p.led_state){
+              blinker.sequence.push_back(cv::Point(p.point.x, p.point.y));
+            }
+          }
+        }
+      }
+      else {
+        auto &retrieved_blinkers = blink_data_[image_index].retrieved_blinkers_4DHT;
+        snapshot.blinkers.resize(retrieved_blinkers.size());
+        for (int j = 0; j < (int)(retrieved_blinkers.size()); j++){
+          BlinkerSnapshot &blinker = snapshot.blinkers[j];
+          blinker.point = retrieved_blinkers[j].first;
+          blinker.signal_index = retrieved_blinkers[j].second;
+          blinker.yaw = blink_data_[image_index].yaw_4DHT[j];
+          blinker.pitch = blink_data_[image_index].pitch_4DHT[j];
+        }
+      }
+    }
+    blinker_snapshots_[image_index]->publish();
+  }
+
+  void UVDARBlinkProcessor::VisualizationWorker() {
+    sched_param scheduling = {};
+    if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &scheduling) != 0){
+      ROS_WARN("[UVDARBlinkProcessor]: Could not lower the priority of the visualization.");
+    }
+
+    const auto period = std::chrono::duration<double>(1.0/std::max((double)(_visualization_rate_), 0.1));
+    auto next = std::chrono::steady_clock::now();
+    while (workers_running_ && ros::ok()){
+      next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+      {
+        std::unique_lock lock(mutex_workers_);
+        if (condition_workers_.wait_until(lock, next, [this]{return !workers_running_;})){
+          return;
+        }
+      }
+      VisualizationThread();
+    }
+  }
+
+  void UVDARBlinkProcessor::VisualizationThread() {
     if (initialized_){
+      bool publish = _publish_visualization_ && pub_visualization_.wanted();
+      if (!publish && !_gui_){ //nobody would see the image
+        return;
+      }
       if(generateVisualization(image_visualization_) >= 0){
         if ((image_visualization_.cols != 0) && (image_visualization_.rows != 0)){
-          if (_publish_visualization_){
-            pub_visualization_->publish("uvdar_blink_visualization", 0.01, image_visualization_, true);
+          if (publish){
+            pub_visualization_.publish(image_visualization_, visualization_markers_);
           }
           if (_gui_){
             cv::imshow("ocv_uvdar_blink_" + _uav_name_, image_visualization_);
@@ -816,6 +1136,18 @@ namespace uvdar{
     if (image_sizes_received_<(int)(camera_image_sizes_.size()))
       return -2;
 
+    bool updated = false;
+    for (int i = 0; i < (int)(camera_image_sizes_.size()); i++){
+      if (_use_camera_for_visualization_ && (i < (int)(image_snapshots_.size()))){
+        updated |= image_snapshots_[i]->fetch();
+      }
+      updated |= blinker_snapshots_[i]->fetch();
+      updated |= sun_snapshots_[i]->fetch();
+    }
+    if (updated){
+      current_visualization_done_ = false;
+    }
+
     if (current_visualization_done_)
       return 1;
 
@@ -847,74 +1179,57 @@ namespace uvdar{
       return -1;
     }
 
+    visualization_markers_.clear();
     int image_index = 0;
     for ([[maybe_unused]] auto curr_size : camera_image_sizes_){
-      std::scoped_lock lock(*(mutex_camera_image_[image_index]));
       cv::Point start_point = cv::Point(start_widths[image_index]+image_index, 0);
       if (_use_camera_for_visualization_){
-        if (current_images_received_[image_index]){
-          cv::Mat image_rgb;
-          /* ROS_INFO_STREAM("[UVDARBlinkProcessor]: Channel count: " << images_current_[image_index].channels()); */
-          cv::cvtColor(images_current_[image_index], image_rgb, cv::COLOR_GRAY2BGR);
-          image_rgb.copyTo(output_image(cv::Rect(start_point.x,0,images_current_[image_index].cols,images_current_[image_index].rows)));
+        if (image_index < (int)(image_snapshots_.size())){
+          const cv::Mat &image_current = image_snapshots_[image_index]->readSlot();
+          if (!image_current.empty() && (image_current.cols <= curr_size.width) && (image_current.rows <= max_image_height)){
+            cv::cvtColor(image_current, output_image(cv::Rect(start_point.x,0,image_current.cols,image_current.rows)), cv::COLOR_GRAY2BGR);
+          }
         }
       }
       else {
         output_image(cv::Rect(start_point.x,0,camera_image_sizes_[image_index].width,camera_image_sizes_[image_index].height)) = cv::Scalar(0,0,0);
       }
-      
-      if(!_use_4DHT_){
-        std::scoped_lock lock(*(blink_data_[image_index].mutex_retrieved_blinkers));
 
-        for(int j = 0; j < (int)(blink_data_[image_index].retrieved_blinkers.size()); j++){
+      const VisualizationSnapshot &snapshot = blinker_snapshots_[image_index]->readSlot();
+      if(!_use_4DHT_){
+        for (auto &blinker : snapshot.blinkers){
           cv::Scalar predict_colour(255,153,255);
           cv::Scalar seq_colour(160,160,160);
-          
-          cv::Point2d confidence_interval = cv::Point2d(
-            blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].x_statistics.confidence_interval,
-            blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].y_statistics.confidence_interval
-          );
-          cv::Point2d predicted = cv::Point2d(
-            blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].x_statistics.predicted_coordinate,
-            blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].y_statistics.predicted_coordinate
-          );
-          auto x_coeff = blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].x_statistics.coeff;
-          auto y_coeff = blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].y_statistics.coeff;
-          double curr_time = blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].insert_time.toSec();
-          bool x_poly_reg_computed = blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].x_statistics.poly_reg_computed;
-          bool y_poly_reg_computed = blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].y_statistics.poly_reg_computed;
-          bool x_extended_search = blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].x_statistics.extended_search;
-          bool y_extended_search = blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].y_statistics.extended_search;
 
           std::vector<cv::Point> interpolated_prediction;
           
-          if(x_extended_search || y_extended_search){
+          if(blinker.x_extended_search || blinker.y_extended_search){
           
-            double computed_time = curr_time;
+            double computed_time = blinker.insert_time;
   
-            double step_size_sec = 1.0 / blink_data_[image_index].framerate_estimate;
+            double step_size_sec = 1.0 / snapshot.framerate_estimate;
             int point_size = _draw_predict_window_sec_/step_size_sec;
 
             // drawing of the prediction for "_draw_predict_window_sec_" length 
             for(int i = 0; i < point_size; ++i){
               cv::Point2d interpolated_point = cv::Point2d{0,0};
               double x_calculated = 0.0; 
-              if(x_poly_reg_computed){
-                for(int k = 0; k < (int)x_coeff.size(); ++k){
-                x_calculated += x_coeff[k]*pow(computed_time, k);
+              if(blinker.x_poly_reg_computed){
+                for(int k = 0; k < (int)blinker.x_coeff.size(); ++k){
+                x_calculated += blinker.x_coeff[k]*pow(computed_time, k);
                 }
                 interpolated_point.x = x_calculated;
               }else{
-                interpolated_point.x = predicted.x;
+                interpolated_point.x = blinker.predicted.x;
               }
-              if(y_poly_reg_computed){
+              if(blinker.y_poly_reg_computed){
                 double y_calculated = 0.0;
-                for(int k = 0; k < (int)y_coeff.size(); ++k){
-                  y_calculated += y_coeff[k]*pow(computed_time, k);
+                for(int k = 0; k < (int)blinker.y_coeff.size(); ++k){
+                  y_calculated += blinker.y_coeff[k]*pow(computed_time, k);
                 }
                 interpolated_point.y = y_calculated;
               }else{
-                interpolated_point.y = predicted.y;
+                interpolated_point.y = blinker.predicted.y;
               }
               cv::Point2d start_point_d; 
               start_point_d.x = start_point.x;
@@ -928,11 +1243,12 @@ namespace uvdar{
             }
           }
   
-          cv::Point center = cv::Point(blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].point.x, blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].point.y) + start_point;
-          int signal_index = blink_data_[image_index].retrieved_blinkers[j].second;
+          cv::Point center = cv::Point(blinker.point.x, blinker.point.y) + start_point;
+          int signal_index = blinker.signal_index;
           if(signal_index == -2 || signal_index == -3) {
             continue;
           }
+          visualization_markers_.push_back(center);
           if(signal_index >= 0){
             std::string signal_text = std::to_string(std::max(signal_index, 0));
             cv::putText(output_image, cv::String(signal_text.c_str()), center + cv::Point(-5, -5), cv::FONT_HERSHEY_SIMPLEX, 0.3, cv::Scalar(255, 255, 255));
@@ -943,16 +1259,16 @@ namespace uvdar{
             cv::circle(output_image, center, 2, cv::Scalar(160,160,160));
           }
 
-          if(x_poly_reg_computed || y_poly_reg_computed){
+          if(blinker.x_poly_reg_computed || blinker.y_poly_reg_computed){
             cv::Point center_predict;
-            center_predict = cv::Point(std::round(predicted.x), std::round(predicted.y)) + start_point; 
+            center_predict = cv::Point(std::round(blinker.predicted.x), std::round(blinker.predicted.y)) + start_point; 
   
             cv::circle(output_image, center_predict, 2, predict_colour);
-            if(confidence_interval.x >= 1 && confidence_interval.y >= 1) {
+            if(blinker.confidence_interval.x >= 1 && blinker.confidence_interval.y >= 1) {
               // convert to cv::Point
               cv::Point confidence_interval_int;
-              confidence_interval_int.x = std::ceil(confidence_interval.x);
-              confidence_interval_int.y = std::ceil(confidence_interval.y);
+              confidence_interval_int.x = std::ceil(blinker.confidence_interval.x);
+              confidence_interval_int.y = std::ceil(blinker.confidence_interval.y);
               // construct BB 
               cv::Point2d left_top =     center_predict - confidence_interval_int;   
               cv::Point2d right_bottom = center_predict + confidence_interval_int;
@@ -966,34 +1282,29 @@ namespace uvdar{
   
           // draw "past" stored sequence points 
           std::vector<cv::Point> draw_seq;  
-          for(auto p : *blink_data_[image_index].retrieved_blinkers[j].first){
-            if(p.led_state){
-              cv::Point point;
-              point.x = p.point.x;
-              point.y = p.point.y;
-              draw_seq.push_back(point+start_point);
-            }
+          for(auto p : blinker.sequence){
+            draw_seq.push_back(p+start_point);
           }
           cv::polylines(output_image, draw_seq, false, seq_colour, 1);
         }
       }else{
-        std::scoped_lock lock(*(blink_data_[image_index].mutex_retrieved_blinkers));
-        for (int j = 0; j < (int)(blink_data_[image_index].retrieved_blinkers_4DHT.size()); j++) {
+        for (auto &blinker : snapshot.blinkers){
           cv::Point center =
             cv::Point(
-                blink_data_[image_index].retrieved_blinkers_4DHT[j].first.x, 
-                blink_data_[image_index].retrieved_blinkers_4DHT[j].first.y 
+                blinker.point.x, 
+                blinker.point.y 
                 )
             + start_point;
-          int signal_index = blink_data_[image_index].retrieved_blinkers_4DHT[j].second;
+          int signal_index = blinker.signal_index;
+          visualization_markers_.push_back(center);
           if (signal_index >= 0) {
-            std::string signal_text = std::to_string(std::max((int)blink_data_[image_index].retrieved_blinkers_4DHT[j].second, 0));
+            std::string signal_text = std::to_string(std::max(signal_index, 0));
             cv::putText(output_image, cv::String(signal_text.c_str()), center + cv::Point(-5, -5), cv::FONT_HERSHEY_SIMPLEX, 0.3, cv::Scalar(255, 255, 255));
             cv::Scalar color = ColorSelector::markerColor(signal_index);
             cv::circle(output_image, center, 5, color);
             double yaw, pitch, len;
-            yaw              = blink_data_[image_index].yaw_4DHT[j];
-            pitch            = blink_data_[image_index].pitch_4DHT[j];
+            yaw              = blinker.yaw;
+            pitch            = blinker.pitch;
             len              = cos(pitch);
             cv::Point target = center - (cv::Point(len * cos(yaw) * 20, len * sin(yaw) * 20.0));
             cv::line(output_image, center, target, cv::Scalar(0, 0, 255), 2);
@@ -1005,8 +1316,8 @@ namespace uvdar{
         }
       }
 
-      for (int j = 0; j < (int)(sun_points_[image_index].size()); j++) {
-        cv::Point sun_current = sun_points_[image_index][j]+start_point;
+      for (auto &sun_point : sun_snapshots_[image_index]->readSlot()) {
+        cv::Point sun_current = sun_point+start_point;
         cv::circle(output_image, sun_current, 10, cv::Scalar(0,0,255));
         cv::circle(output_image, sun_current, 2,  cv::Scalar(0,0,255));
         cv::putText(output_image, cv::String("Sun"), sun_current + cv::Point(10, -10), cv::FONT_HERSHEY_SIMPLEX, 0.3, cv::Scalar(255, 255, 255));
@@ -1028,12 +1339,8 @@ namespace uvdar{
   void UVDARBlinkProcessor::callbackImage(const sensor_msgs::ImageConstPtr& image_msg, size_t image_index) {
     cv_bridge::CvImageConstPtr image;
     image = cv_bridge::toCvShare(image_msg, sensor_msgs::image_encodings::MONO8);
-    {
-      std::scoped_lock lock(*(mutex_camera_image_[image_index]));
-      images_current_[image_index] = image->image; 
-      current_images_received_[image_index] = true;
-      current_visualization_done_ = false;
-    }
+    image_snapshots_[image_index]->writeSlot() = image->image; //shares the data, which is not modified after reception
+    image_snapshots_[image_index]->publish();
     if ( (camera_image_sizes_[image_index].width <= 0 ) || (camera_image_sizes_[image_index].width <= 0 )){
       camera_image_sizes_[image_index] = image->image.size();
       if(_use_4DHT_)ht4dbt_trackers_[image_index]->updateResolution(image->image.size());
@@ -1,5 +1,6 @@
 #define camera_delay 0.50
 #define MAX_POINTS_PER_IMAGE 100
+#define DEFAULT_VISUALIZATION_RATE 10 //Hz
 
 #include <ros/ros.h>
 #include <ros/package.h>
@@ -11,14 +12,26 @@
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/imgcodecs/imgcodecs.hpp>
 #include <uvdar_core/ImagePointsWithFloatStamped.h>
-#include <mrs_lib/image_publisher.h>
 #include <mrs_lib/param_loader.h>
 #include <boost/filesystem/operations.hpp>
 /* #include <experimental/filesystem> */
 #include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <pthread.h>
+#include <sched.h>
 
 #include "detect/uv_led_detect_fast_cpu.h"
 #include "detect/uv_led_detect_fast_gpu.h"
+#include <trace/trace.h>
+#include <trace/latency.h>
+#include <diagnostics/diagnostics.h>
+#include <packed_points/packed_points.h>
+#include <lazy_publisher/lazy_publisher.h>
+#include <visualization_output/visualization_output.h>
+#include <snapshot/snapshot.h>
 
 namespace enc = sensor_msgs::image_encodings;
 
@@ -40,8 +53,17 @@ public:
     param_loader.loadParam("uav_name", _uav_name_);
 
     param_loader.loadParam("debug", _debug_, bool(false));
+    param_loader.loadParam("trace_file", _trace_file_, std::string(""));
+    if (!_trace_file_.empty()){
+      trace::enable(true);
+    }
+    diagnostics_ = std::make_unique<diagnostics::Publisher>(nh_, "detector");
     param_loader.loadParam("gui", _gui_, bool(false));
     param_loader.loadParam("publish_visualization", _publish_visualization_, bool(false));
+    param_loader.loadParam("visualization_rate", _visualization_rate_, double(DEFAULT_VISUALIZATION_RATE));
+    param_loader.loadParam("visualization_scale", _visualization_options_.scale, double(1.0));
+    param_loader.loadParam("visualization_roi_margin", _visualization_options_.roi_margin, int(-1));
+    param_loader.loadParam("visualization_jpeg_quality", _visualization_options_.jpeg_quality, int(0));
 
     param_loader.loadParam("threshold", _threshold_, 200);
 
@@ -85,7 +107,7 @@ public:
 
       camera_image_sizes_.push_back(cv::Size(0,0));
 
-      images_current_.push_back(cv::Mat());
+      detection_snapshots_.push_back(std::make_unique<snapshot::TripleBuffer<DetectionSnapshot>>());
 
       detected_points_.push_back(std::vector<cv::Point>());
       sun_points_.push_back(std::vector<cv::Point>());
@@ -120,6 +142,8 @@ public:
     
     /* create pubslishers //{ */
     param_loader.loadParam("publish_sun_points", _publish_sun_points_, bool(false));
+    param_loader.loadParam("sun_points_period", _sun_points_period_, double(0.0));
+    param_loader.loadParam("latency_stamping", _latency_stamping_, bool(false));
 
     std::vector<std::string> _points_seen_topics;
     param_loader.loadParam("points_seen_topics", _points_seen_topics, _points_seen_topics);
@@ -131,19 +155,24 @@ public:
     // Create the publishers
     for (size_t i = 0; i < _points_seen_topics.size(); ++i) {
       pub_candidate_points_.push_back(nh_.advertise<uvdar_core::ImagePointsWithFloatStamped>(_points_seen_topics[i], 1));
+      pub_candidate_points_packed_.push_back(nh_.advertise<uvdar_core::ImagePointsPackedStamped>(_points_seen_topics[i]+PACKED_POINTS_SUFFIX, 1));
+      if (_latency_stamping_){
+        pub_candidate_points_latency_.push_back(nh_.advertise<uvdar_core::LatencyTrailer>(_points_seen_topics[i]+LATENCY_SUFFIX, 1));
+      }
 
       if (_publish_sun_points_){
-        pub_sun_points_.push_back(nh_.advertise<uvdar_core::ImagePointsWithFloatStamped>(_points_seen_topics[i]+"/sun", 1));
+        pub_sun_points_.emplace_back(nh_.advertise<uvdar_core::ImagePointsWithFloatStamped>(_points_seen_topics[i]+"/sun", 1), _sun_points_period_);
+        pub_sun_points_packed_.emplace_back(nh_.advertise<uvdar_core::ImagePointsPackedStamped>(_points_seen_topics[i]+"/sun"+PACKED_POINTS_SUFFIX, 1), _sun_points_period_);
       }
     }
 
     if (_publish_visualization_){
-      pub_visualization_ = std::make_unique<mrs_lib::ImagePublisher>(boost::make_shared<ros::NodeHandle>(nh_));
+      pub_visualization_ = visualization_output::Publisher(nh_, "uvdar_detection_visualization", _visualization_options_);
     }
     //}
     //
     if (_gui_ || _publish_visualization_){
-      timer_visualization_ = nh_.createTimer(ros::Duration(0.1), &UVDARDetector::VisualizationThread, this, false);
+      visualization_worker_ = std::thread(&UVDARDetector::VisualizationWorker, this);
     }
 
 
@@ -161,6 +190,19 @@ public:
    * @brief destructor
    */
   ~UVDARDetector() {
+    visualization_running_ = false;
+    {
+      std::scoped_lock lock(mutex_visualization_);
+      condition_visualization_.notify_all();
+    }
+    if (visualization_worker_.joinable()){
+      visualization_worker_.join();
+    }
+    if (!_trace_file_.empty()){
+      if (!trace::writeChromeTrace(_trace_file_)){
+        ROS_ERROR_STREAM("[UVDARDetector]: Could not write the trace to " << _trace_file_);
+      }
+    }
   }
   //}
 
@@ -205,8 +247,9 @@ private:
   void callbackImage(const sensor_msgs::ImageConstPtr& image_msg, int image_index) {
     cv_bridge::CvImageConstPtr image;
     image = cv_bridge::toCvShare(image_msg, enc::MONO8);
+    diagnostics_->count("images received"); //images replaced by a newer one before being processed are dropped
     ros::NodeHandle nh("~");
-    timer_process_[image_index] = nh.createTimer(ros::Duration(0), boost::bind(&UVDARDetector::processSingleImage, this, _1, image, image_index), true, true);
+    timer_process_[image_index] = nh.createTimer(ros::Duration(0), boost::bind(&UVDARDetector::processSingleImage, this, _1, image, image_index, trace::now()), true, true);
     camera_image_sizes_[image_index] = image->image.size();
 
     if (!all_cameras_detected_){
@@ -233,8 +276,11 @@ private:
    * @param te - timer event - necessary for use of this method as a timer callback
    * @param image - the input image
    * @param image_index - index of the camera that produced this image
+   * @param input_time - monotonic time of the reception of the image, used to start the latency trailer
    */
-  void processSingleImage([[maybe_unused]] const ros::TimerEvent& te, const cv_bridge::CvImageConstPtr image, int image_index) {
+  void processSingleImage([[maybe_unused]] const ros::TimerEvent& te, const cv_bridge::CvImageConstPtr image, int image_index, int64_t input_time) {
+    UVDAR_TRACE_SCOPE("detector: image");
+    int64_t start_time = trace::now();
 
     if (!all_cameras_detected_){
       ROS_WARN_STREAM_THROTTLE(1.0, "[UVDARDetector]: Not all cameras have produced input, waiting...");
@@ -271,7 +317,6 @@ private:
         uvdf_was_initialized_ = true;
       }
       
-      images_current_[image_index] = image->image;
       sun_points_[image_index].clear();
       detected_points_[image_index].clear();
 
@@ -284,8 +329,17 @@ private:
             )
          ){
         ROS_WARN_STREAM("Failed to extract markers from the image!");
+        diagnostics_->count("failed images");
         return;
       }
+
+      if (_gui_ || _publish_visualization_){ //the visualization renders from its own copy, so that it never holds up the detection
+        auto &snapshot = detection_snapshots_[image_index]->writeSlot();
+        snapshot.image = image->image;
+        snapshot.detected_points = detected_points_[image_index];
+        snapshot.sun_points = sun_points_[image_index];
+        detection_snapshots_[image_index]->publish();
+      }
       /* ROS_INFO_STREAM("Cam" << image_index << ". There are " << detected_points_[image_index].size() << " detected points."); */
 
       if (sun_points_[image_index].size() > 30){
@@ -297,12 +351,15 @@ private:
 
     if (detected_points_[image_index].size()>MAX_POINTS_PER_IMAGE){
       ROS_WARN_STREAM("[UVDARDetector]: Over " << MAX_POINTS_PER_IMAGE << " points received. Skipping noisy image.");
+      diagnostics_->count("noisy images skipped");
       return;
     }
 
     {
       std::scoped_lock lock(mutex_pub_);
-      if (_publish_sun_points_){
+      bool sun_wanted = _publish_sun_points_ && pub_sun_points_[image_index].wanted();
+      bool sun_packed_wanted = _publish_sun_points_ && pub_sun_points_packed_[image_index].wanted();
+      if (sun_wanted || sun_packed_wanted){
         uvdar_core::ImagePointsWithFloatStamped msg_sun;
         msg_sun.stamp = image->header.stamp;
         msg_sun.image_width = image->image.cols;
@@ -313,7 +370,12 @@ private:
           point.y = sun_point.y;
           msg_sun.points.push_back(point);
         }
-        pub_sun_points_[image_index].publish(msg_sun);
+        if (sun_wanted){
+          pub_sun_points_[image_index].publish(msg_sun);
+        }
+        if (sun_packed_wanted){
+          pub_sun_points_packed_[image_index].publish(packed_points::pack(msg_sun));
+        }
       }
 
       uvdar_core::ImagePointsWithFloatStamped msg_detected;
@@ -326,19 +388,64 @@ private:
         point.y = detected_point.y;
         msg_detected.points.push_back(point);
       }
+      if (_latency_stamping_){ // the trailer goes first, so that it is likely to be waiting when the points are processed downstream
+        uvdar_core::LatencyTrailer msg_latency;
+        msg_latency.stamp = msg_detected.stamp;
+        trace::startLatency(msg_latency.stages, uvdar_core::LatencyStamp::DETECTOR_INPUT, input_time);
+        trace::stampLatency(msg_latency.stages, uvdar_core::LatencyStamp::DETECTOR);
+        pub_candidate_points_latency_[image_index].publish(msg_latency);
+      }
       pub_candidate_points_[image_index].publish(msg_detected);
+      if (pub_candidate_points_packed_[image_index].getNumSubscribers() > 0){
+        pub_candidate_points_packed_[image_index].publish(packed_points::pack(msg_detected));
+      }
+    }
+
+    diagnostics_->count("images processed");
+    diagnostics_->gauge("points per image", (double)(detected_points_[image_index].size()));
+    diagnostics_->gauge("sun points per image", (double)(sun_points_[image_index].size()));
+    diagnostics_->gauge("processing time [ms]", (double)(trace::now() - start_time)/1e6);
+
+  }
+  //}
+
+  /* VisualizationWorker() //{ */
+
+  /**
+   * @brief Thread function running the optional visualization at low priority, so that it only uses CPU time left over by the detection
+   */
+  void VisualizationWorker() {
+    sched_param scheduling = {};
+    if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &scheduling) != 0){
+      ROS_WARN("[UVDARDetector]: Could not lower the priority of the visualization.");
     }
 
+    const auto period = std::chrono::duration<double>(1.0/std::max(_visualization_rate_, 0.1));
+    auto next = std::chrono::steady_clock::now();
+    while (visualization_running_ && ros::ok()){
+      next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+      {
+        std::unique_lock lock(mutex_visualization_);
+        if (condition_visualization_.wait_until(lock, next, [this]{return !visualization_running_;})){
+          return;
+        }
+      }
+      VisualizationThread();
+    }
   }
   //}
 
   /* VisualizationThread() //{ */
-  void VisualizationThread([[maybe_unused]] const ros::TimerEvent& te) {
+  void VisualizationThread() {
     if (initialized_){
+      bool publish = _publish_visualization_ && pub_visualization_.wanted();
+      if (!publish && !_gui_){ //nobody would see the image
+        return;
+      }
       generateVisualization(image_visualization_);
       if ((image_visualization_.cols != 0) && (image_visualization_.rows != 0)){
-        if (_publish_visualization_){
-          pub_visualization_->publish("uvdar_detection_visualization", 0.01, image_visualization_, true);
+        if (publish){
+          pub_visualization_.publish(image_visualization_, visualization_markers_);
         }
         if (_gui_){
           cv::imshow("ocv_uvdar_detection_" + _uav_name_, image_visualization_);
@@ -354,7 +461,9 @@ private:
     int max_image_height = 0;
     int sum_image_width = 0;
     std::vector<int> start_widths;
-    for (auto curr_size : camera_image_sizes_){
+    for (auto &detection_snapshot : detection_snapshots_){
+      detection_snapshot->fetch();
+      cv::Size curr_size = detection_snapshot->readSlot().image.size();
       if (max_image_height < curr_size.height){
         max_image_height = curr_size.height;
       }
@@ -362,23 +471,24 @@ private:
       sum_image_width += curr_size.width;
     }
 
-    output_image = cv::Mat(cv::Size(sum_image_width+((int)(camera_image_sizes_.size())-1), max_image_height),CV_8UC3);
+    output_image = cv::Mat(cv::Size(sum_image_width+((int)(detection_snapshots_.size())-1), max_image_height),CV_8UC3);
     output_image = cv::Scalar(255, 255, 255);
 
+    visualization_markers_.clear();
     int image_index = 0;
-    for ([[maybe_unused]] auto curr_size : camera_image_sizes_){
-      /* std::scoped_lock lock(*(mutex_camera_image_[image_index])); */
-      std::scoped_lock lock(mutex_camera_image_);
+    for (auto &detection_snapshot : detection_snapshots_){
+      const DetectionSnapshot &snapshot = detection_snapshot->readSlot();
       cv::Point start_point = cv::Point(start_widths[image_index]+image_index, 0);
-      cv::Mat image_rgb;
-      cv::cvtColor(images_current_[image_index], image_rgb, cv::COLOR_GRAY2BGR);
-      image_rgb.copyTo(output_image(cv::Rect(start_point.x,0,images_current_[image_index].cols,images_current_[image_index].rows)));
+      if (!snapshot.image.empty()){
+        cv::cvtColor(snapshot.image, output_image(cv::Rect(start_point.x,0,snapshot.image.cols,snapshot.image.rows)), cv::COLOR_GRAY2BGR);
+      }
 
-      for (int j = 0; j < (int)(detected_points_[image_index].size()); j++) {
-        cv::circle(output_image, detected_points_[image_index][j]+start_point, 5, cv::Scalar(255,0,0));
+      for (int j = 0; j < (int)(snapshot.detected_points.size()); j++) {
+        cv::circle(output_image, snapshot.detected_points[j]+start_point, 5, cv::Scalar(255,0,0));
+        visualization_markers_.push_back(snapshot.detected_points[j]+start_point);
       }
-      for (int j = 0; j < (int)(sun_points_[image_index].size()); j++) {
-        cv::circle(output_image, sun_points_[image_index][j]+start_point, 10, cv::Scalar(0,0,255));
+      for (int j = 0; j < (int)(snapshot.sun_points.size()); j++) {
+        cv::circle(output_image, snapshot.sun_points[j]+start_point, 10, cv::Scalar(0,0,255));
       }
 
       image_index++;
@@ -405,27 +515,46 @@ private:
 
 
   bool _publish_sun_points_ = false;
+  double _sun_points_period_; //minimum time between two messages with the sun points of a camera
+  bool _latency_stamping_ = false; //if true, the output points start the latency trailer propagated through the rest of the pipeline
 
-  std::vector<ros::Publisher> pub_sun_points_;
+  std::vector<lazy_publisher::Publisher<ros::Publisher>> pub_sun_points_;
   std::vector<ros::Publisher> pub_candidate_points_;
+  std::vector<lazy_publisher::Publisher<ros::Publisher>> pub_sun_points_packed_; //compact variants of the above, filled only if subscribed
+  std::vector<ros::Publisher> pub_candidate_points_packed_;
+  std::vector<ros::Publisher> pub_candidate_points_latency_;
 
 
   bool _debug_;
+  std::string _trace_file_; //if not empty, the trace is recorded and written to this file on shutdown
+  std::unique_ptr<diagnostics::Publisher> diagnostics_;
 
-  std::vector<cv::Mat> images_current_;
   std::vector<std::vector<cv::Point>> detected_points_;
   std::vector<std::vector<cv::Point>> sun_points_;
 
+  /**
+   * @brief The state of a camera needed to draw its part of the visualization
+   */
+  struct DetectionSnapshot {
+    cv::Mat image; //shares the data of the input image, which is not modified after reception
+    std::vector<cv::Point> detected_points;
+    std::vector<cv::Point> sun_points;
+  };
+  std::vector<std::unique_ptr<snapshot::TripleBuffer<DetectionSnapshot>>> detection_snapshots_; //written under mutex_camera_image_, read only by the visualization worker
+
   bool _gui_;
   bool _publish_visualization_;
-  std::unique_ptr<mrs_lib::ImagePublisher> pub_visualization_;
+  double _visualization_rate_;
+  visualization_output::Options _visualization_options_;
+  visualization_output::Publisher pub_visualization_;
+  std::vector<cv::Point> visualization_markers_; //positions of the detected points in the visualization image, used for cropping
   /* std::vector<std::unique_ptr<std::mutex>>  mutex_camera_image_; */
   std::mutex  mutex_camera_image_;
-  ros::Timer timer_visualization_;
-  ros::Timer timer_gui_visualization_;
-  ros::Timer timer_publish_visualization_;
-  cv::Mat image_visualization_;
+  std::thread visualization_worker_;
+  std::atomic<bool> visualization_running_ = true;
   std::mutex mutex_visualization_;
+  std::condition_variable condition_visualization_; //wakes the visualization worker on shutdown
+  cv::Mat image_visualization_;
 
   std::vector<cv::Size> camera_image_sizes_;
 
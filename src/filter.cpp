@@ -16,13 +16,22 @@
 #include <std_srvs/SetBool.h>
 #include <nav_msgs/Odometry.h>
 #include <std_msgs/String.h>
+#include <uvdar_core/LatencyTrailer.h>
+#include <uvdar_core/LatencyHistograms.h>
 
 #include <boost/range/adaptor/indexed.hpp> 
 
 #include <mutex>
+#include <limits>
 
 #include <Eigen/Dense>
 
+#include <trace/trace.h>
+#include <trace/latency.h>
+#include <diagnostics/diagnostics.h>
+#include <assignment/assignment.h>
+#include <spatial_index/spatial_index.h>
+
 #define sqr(X) ((X) * (X))
 
 #define DEFAULT_OUTPUT_FRAMERATE 20.0
@@ -34,38 +43,56 @@
 #define YAW_THRESH 1.5
 #define MATCH_LEVEL_THRESHOLD_ASSOCIATE 0.3
 #define MATCH_LEVEL_THRESHOLD_REMOVE 0.5
+#define DEFAULT_LATENCY_HISTOGRAM_PERIOD 1.0
+#define LATENCY_HISTOGRAM_BIN_WIDTH 0.002 //seconds
+#define LATENCY_HISTOGRAM_BINS 100
 
-using namespace boost::adaptors;
-
-namespace mrs_lib
-{
-  const int n_states = -1;
-  const int n_inputs = 0;
-  const int n_measurements = 6;
-  using lkf_t = LKF<n_states, n_inputs, n_measurements>;
-}
+#define KALMAN_STATES 6 //position and orientation
+#define KALMAN_STATES_VELOCITY 9 //position, velocity and orientation
+#define KALMAN_INPUTS 0
+#define KALMAN_MEASUREMENTS 6
 
-using A_t = mrs_lib::lkf_t::A_t;
-using B_t = mrs_lib::lkf_t::B_t;
-using H_t = mrs_lib::lkf_t::H_t;
-using Q_t = mrs_lib::lkf_t::Q_t;
-using u_t = mrs_lib::lkf_t::u_t;
-using statecov_t = mrs_lib::lkf_t::statecov_t;
+using namespace boost::adaptors;
 
 namespace e = Eigen;
 
 namespace uvdar {
 
 
+  /**
+   * @brief A measured pose - position and roll, pitch and yaw angles - with its error covariance
+   */
+  struct PoseMeasurement {
+    e::Matrix<double, KALMAN_MEASUREMENTS, 1> x;
+    e::Matrix<double, KALMAN_MEASUREMENTS, KALMAN_MEASUREMENTS> P;
+  };
+
   /**
    * @brief A processing lass for filtering measurements from UVDAR-based relative UAV pose estimator. This uses a vector of Kalman filter states for tracking multiple targets either if they have known identity or if they are anonymous.
+   *
+   * @tparam n_states The length of the state vector - KALMAN_STATES or KALMAN_STATES_VELOCITY. All filter matrices have sizes fixed at compile time, such that the prediction and correction do not allocate.
    */
+  template <int n_states>
   class UVDARKalman {
+    static_assert((n_states == KALMAN_STATES) || (n_states == KALMAN_STATES_VELOCITY), "The state has to consist of the position and orientation, optionally with velocity");
+
+    using lkf_t = mrs_lib::LKF<n_states, KALMAN_INPUTS, KALMAN_MEASUREMENTS>;
+    using A_t = typename lkf_t::A_t;
+    using B_t = typename lkf_t::B_t;
+    using H_t = typename lkf_t::H_t;
+    using Q_t = typename lkf_t::Q_t;
+    using u_t = typename lkf_t::u_t;
+    using z_t = decltype(PoseMeasurement::x);
+    using R_t = decltype(PoseMeasurement::P);
+    using statecov_t = typename lkf_t::statecov_t;
+    using measurement_t = PoseMeasurement;
+    using measurements_t = std::vector<measurement_t, e::aligned_allocator<measurement_t>>;
 
     private:
       /* attributes //{ */
 
       bool _debug_ = false;
+      std::string _trace_file_; //if not empty, the trace is recorded and written to this file on shutdown
 
       bool initialized_ = false;
       std::string _uav_name_;
@@ -78,11 +105,10 @@ namespace uvdar {
       bool _anonymous_measurements_;
       bool _use_velocity_;
 
-      std::mutex meas_mutex;
       std::mutex filter_mutex;
       std::mutex transformer_mutex;
 
-      std::shared_ptr<mrs_lib::lkf_t> filter;
+      std::shared_ptr<lkf_t> filter;
 
       struct td_t{
         A_t A;
@@ -100,7 +126,7 @@ namespace uvdar {
         unsigned long long int id;
       };
 
-      std::vector<FilterData> fd;
+      std::vector<FilterData, e::aligned_allocator<FilterData>> fd;
       // | ----------------------- subscribers ---------------------- |
 
       std::vector<ros::Subscriber> sub_measurements_;
@@ -117,6 +143,13 @@ namespace uvdar {
       unsigned long long int latest_id = 0;
 
       std::unique_ptr<mrs_lib::Transformer> transformer_;
+      std::unique_ptr<diagnostics::Publisher> diagnostics_;
+
+      // | ------------------------- latency ------------------------ |
+      std::vector<ros::Subscriber> sub_latency_;
+      ros::Publisher pub_latency_;
+      ros::Timer timer_latency_;
+      trace::LatencyCollector latency_{uvdar_core::LatencyStamp::FILTER, LATENCY_HISTOGRAM_BIN_WIDTH, LATENCY_HISTOGRAM_BINS};
 
       //}
 
@@ -133,6 +166,13 @@ namespace uvdar {
         mrs_lib::ParamLoader param_loader(nh, "UVDARKalman");
 
         param_loader.loadParam("debug", _debug_);
+        param_loader.loadParam("trace_file", _trace_file_, std::string(""));
+        double latency_histogram_period;
+        param_loader.loadParam("latency_histogram_period", latency_histogram_period, double(DEFAULT_LATENCY_HISTOGRAM_PERIOD));
+        if (!_trace_file_.empty()){
+          trace::enable(true);
+        }
+        diagnostics_ = std::make_unique<diagnostics::Publisher>(nh, "filter");
 
         param_loader.loadParam("uav_name", _uav_name_);
         param_loader.loadParam("output_frame", _output_frame_, std::string("local_origin"));
@@ -179,7 +219,10 @@ namespace uvdar {
         for (auto& topic : _measured_poses_topics) {
           ROS_INFO_STREAM("[UVDARKalman]: Subscribing to " << topic);
           sub_measurements_.push_back(nh.subscribe(topic, 3, &UVDARKalman::callbackMeasurement, this, ros::TransportHints().tcpNoDelay())); 
+          sub_latency_.push_back(nh.subscribe(topic+"/latency", 3, &UVDARKalman::callbackLatency, this)); 
         }
+        pub_latency_ = nh.advertise<uvdar_core::LatencyHistograms>("latency_histograms", 1);
+        timer_latency_ = nh.createTimer(ros::Duration(latency_histogram_period), &UVDARKalman::publishLatency, this);
 
         pub_filter_ = nh.advertise<mrs_msgs::PoseWithCovarianceArrayStamped>("filtered_poses", 1);
         pub_filter_tent_ = nh.advertise<mrs_msgs::PoseWithCovarianceArrayStamped>("filtered_poses/tentative", 1);
@@ -191,11 +234,16 @@ namespace uvdar {
           return;
         }
 
-        if (_anonymous_measurements_){
-          filter_matrices.A.resize(6,6);
-          filter_matrices.Q.resize(6,6);
-          filter_matrices.H.resize(6,6);
-
+        if constexpr (n_states == KALMAN_STATES_VELOCITY){
+          filter_matrices.H <<
+            1,0,0,0,0,0,0,0,0,
+            0,1,0,0,0,0,0,0,0,
+            0,0,1,0,0,0,0,0,0,
+            0,0,0,0,0,0,1,0,0,
+            0,0,0,0,0,0,0,1,0,
+            0,0,0,0,0,0,0,0,1;
+        }
+        else {
           filter_matrices.H <<
             1,0,0,0,0,0,
             0,1,0,0,0,0,
@@ -203,41 +251,12 @@ namespace uvdar {
             0,0,0,1,0,0,
             0,0,0,0,1,0,
             0,0,0,0,0,1;
-
-        }
-        else {
-          if (_use_velocity_){
-            filter_matrices.A.resize(9,9);
-            filter_matrices.Q.resize(9,9);
-            filter_matrices.H.resize(6,9);
-
-            filter_matrices.H <<
-              1,0,0,0,0,0,0,0,0,
-              0,1,0,0,0,0,0,0,0,
-              0,0,1,0,0,0,0,0,0,
-              0,0,0,0,0,0,1,0,0,
-              0,0,0,0,0,0,0,1,0,
-              0,0,0,0,0,0,0,0,1;
-          }
-          else {
-            filter_matrices.A.resize(6,6);
-            filter_matrices.Q.resize(6,6);
-            filter_matrices.H.resize(6,6);
-
-            filter_matrices.H <<
-              1,0,0,0,0,0,
-              0,1,0,0,0,0,
-              0,0,1,0,0,0,
-              0,0,0,1,0,0,
-              0,0,0,0,1,0,
-              0,0,0,0,0,1;
-          }
         }
 
         filter_matrices.B = B_t();
 
 
-        filter = std::make_unique<mrs_lib::lkf_t>(filter_matrices.A, filter_matrices.B, filter_matrices.H);
+        filter = std::make_unique<lkf_t>(filter_matrices.A, filter_matrices.B, filter_matrices.H);
 
 
         if (param_loader.loadedSuccessfully()) {
@@ -252,6 +271,19 @@ namespace uvdar {
       }
       //}
 
+      /**
+       * @brief Destructor - writes the trace, if it was recorded
+       */
+      /* Destructor //{ */
+      ~UVDARKalman(){
+        if (!_trace_file_.empty()){
+          if (!trace::writeChromeTrace(_trace_file_)){
+            ROS_ERROR_STREAM("[UVDARKalman]: Could not write the trace to " << _trace_file_);
+          }
+        }
+      }
+      //}
+
     private:
 
       /**
@@ -263,15 +295,15 @@ namespace uvdar {
       void callbackMeasurement(const mrs_msgs::PoseWithCovarianceArrayStamped& msg){
         if ((int)(msg.poses.size()) < 1)
           return;
+        UVDAR_TRACE_SCOPE("filter: measurement");
+        int64_t start_time = trace::now();
+        diagnostics_->count("measurement messages received");
+        diagnostics_->gauge("measurements per message", (double)(msg.poses.size()));
         if (_debug_)
           ROS_INFO_STREAM("[UVDARKalman]: Getting " << (int)(msg.poses.size()) << " measurements...");
 
 
-        mrs_msgs::PoseWithCovarianceArrayStamped msg_local;
-        {
-          std::scoped_lock lock(meas_mutex);
-          msg_local = msg;
-        }
+        const mrs_msgs::PoseWithCovarianceArrayStamped &msg_local = msg; //only read, so it is neither copied nor locked
 
         std::optional<geometry_msgs::TransformStamped> tf;
         {
@@ -280,38 +312,41 @@ namespace uvdar {
         }
         if (!tf) { 
           ROS_ERROR("[UVDARKalman]: Could not obtain transform from %s to %s",msg_local.header.frame_id.c_str(), _output_frame_.c_str());
+          diagnostics_->count("measurement messages without transform");
           return;
         }
-        std::vector<statecov_t> meas_converted;
+        // the transformation is obtained once, and applied to all poses of the message without locking the transformer
+        const auto &transform = tf.value().transform;
+        e::Quaterniond tf_orientation(transform.rotation.w, transform.rotation.x, transform.rotation.y, transform.rotation.z);
+        e::Isometry3d tf_eigen = e::Translation3d(transform.translation.x, transform.translation.y, transform.translation.z) * tf_orientation;
+        R_t tf_rotation = R_t::Zero(); //rotates both the position and the orientation parts of the covariances
+        tf_rotation.topLeftCorner<3,3>() = tf_eigen.linear();
+        tf_rotation.bottomRightCorner<3,3>() = tf_eigen.linear();
+
+        e::Matrix3Xd positions(3, msg_local.poses.size());
+        for (int i=0; i<(int)(msg_local.poses.size()); i++){
+          const auto &position = msg_local.poses[i].pose.position;
+          positions.col(i) << position.x, position.y, position.z;
+        }
+        positions = tf_eigen*positions;
+
+        measurements_t meas_converted;
+        meas_converted.reserve(msg_local.poses.size());
         std::vector<int> ids;
-        for (auto &meas : msg_local.poses){
-          e::VectorXd poseVec(6);
-          e::MatrixXd poseCov(6,6);
-
-          std::optional<geometry_msgs::PoseWithCovarianceStamped> meas_t;
-          geometry_msgs::PoseWithCovarianceStamped meas_s;
-          meas_s.pose.pose = meas.pose;
-          meas_s.pose.covariance = meas.covariance;
+        for (int i=0; i<(int)(msg_local.poses.size()); i++){
+          const auto &meas = msg_local.poses[i];
+          z_t poseVec;
+          R_t poseCov;
+
           if (_debug_)
             ROS_INFO_STREAM("[UVDARKalman]: Meas. cov. input: " << std::endl << rosCovarianceToEigen(meas.covariance));
-          meas_s.header = msg_local.header;
-          {
-            std::scoped_lock lock(transformer_mutex);
-            meas_t = transformer_->transform(meas_s, tf.value());
-          }
-          if (!meas_t){
-            ROS_INFO_STREAM("[UVDARKalman]: Failed to get transformation for measurement, returning.");
-            return;
-          }
 
-          poseVec(0) = meas_t.value().pose.pose.position.x;
-          poseVec(1) = meas_t.value().pose.pose.position.y;
-          poseVec(2) = meas_t.value().pose.pose.position.z;
-          e::Quaterniond qtemp(
-              meas_t.value().pose.pose.orientation.w,
-              meas_t.value().pose.pose.orientation.x,
-              meas_t.value().pose.pose.orientation.y,
-              meas_t.value().pose.pose.orientation.z
+          poseVec.head<3>() = positions.col(i);
+          e::Quaterniond qtemp = tf_orientation*e::Quaterniond(
+              meas.pose.orientation.w,
+              meas.pose.orientation.x,
+              meas.pose.orientation.y,
+              meas.pose.orientation.z
               );
 
           poseVec(3) = fixAngle(quatToRoll(qtemp), 0);
@@ -330,7 +365,7 @@ namespace uvdar {
           /*             } */
           /*           } */
 
-          poseCov = rosCovarianceToEigen(meas_t.value().pose.covariance);
+          poseCov = tf_rotation*rosCovarianceToEigen(meas.covariance)*tf_rotation.transpose();
 
           if (poseCov.array().isNaN().any()){
             ROS_INFO("[UVDARKalman]: Discarding input, covariance includes Nans.");
@@ -339,20 +374,21 @@ namespace uvdar {
 
           bool changed = false;
 
-          e::EigenSolver<e::Matrix3d> es(poseCov.bottomRightCorner(3,3));
-          auto eigvals = es.eigenvalues();
-          for (int i=0; i<(int)(eigvals.size()); i++){
-            /* ROS_INFO_STREAM("[UVDARKalman]: Eigenvalues: "<< eigvals(i).real() << " im: " <<  eigvals(i).imag()); */
-            if (eigvals(i).real() >= sqr(M_PI)){ //angle std.dev representing no knowledge (3*sigma contains 99.7 percent #edit: but one sigma is still meaningful with the "enclosing ellipsoid" approach)
-              eigvals(i) = sqr(666.0); //arbitrarily large number, s.t. the measurement will not affect the state
+          e::SelfAdjointEigenSolver<e::Matrix3d> es;
+          es.computeDirect(poseCov.bottomRightCorner<3,3>()); //the covariance is symmetric, so its eigenvalues are real and the closed-form solution for 3x3 matrices applies
+          e::Vector3d eigvals = es.eigenvalues();
+          for (int j=0; j<3; j++){
+            /* ROS_INFO_STREAM("[UVDARKalman]: Eigenvalues: "<< eigvals(j)); */
+            if (eigvals(j) >= sqr(M_PI)){ //angle std.dev representing no knowledge (3*sigma contains 99.7 percent #edit: but one sigma is still meaningful with the "enclosing ellipsoid" approach)
+              eigvals(j) = sqr(666.0); //arbitrarily large number, s.t. the measurement will not affect the state
               changed = true;
             }
           }
 
           if (changed){
-            auto eigvecs = es.eigenvectors();
-            /* ROS_INFO_STREAM("[UVDARKalman]: Eigenvectors: "<< std::endl << eigvecs.real() << std::endl << "im: " << std::endl <<  eigvecs.imag()); */
-            poseCov.bottomRightCorner(3,3) = eigvecs.real()*eigvals.real().asDiagonal()*eigvecs.real().transpose(); //reform the covariance with new expanded eigenvalues
+            e::Matrix3d eigvecs = es.eigenvectors();
+            /* ROS_INFO_STREAM("[UVDARKalman]: Eigenvectors: "<< std::endl << eigvecs); */
+            poseCov.bottomRightCorner<3,3>() = eigvecs*eigvals.asDiagonal()*eigvecs.transpose(); //reform the covariance with new expanded eigenvalues
           }
 
           if (_debug_){
@@ -373,6 +409,39 @@ namespace uvdar {
         else {
           applyMeasurementsWithIdentity(meas_converted, ids, msg_local.header.stamp, msg_local.header.frame_id);
         }
+        latency_.applied(msg_local.header.stamp);
+        diagnostics_->gauge("measurement processing time [ms]", (double)(trace::now() - start_time)/1e6);
+      }
+      //}
+
+      /**
+       * @brief Callback for the latency trailers accompanying the input measurements. The trailer is completed once the measurement with the same stamp has been applied.
+       *
+       * @param msg
+       */
+      /* callbackLatency //{ */
+      void callbackLatency(const uvdar_core::LatencyTrailer& msg){
+        latency_.add(msg);
+        auto unmatched = latency_.unmatched();
+        if (unmatched > 0){
+          diagnostics_->count("latency trailers unmatched", unmatched);
+        }
+      }
+      //}
+
+      /**
+       * @brief Publishes the histograms of latencies of the individual stages of the pipeline
+       *
+       * @param te TimerEvent for the timer spinning this function
+       */
+      /* publishLatency //{ */
+      void publishLatency([[ maybe_unused ]] const ros::TimerEvent& te){
+        auto msg = latency_.histograms();
+        if (msg.stages.empty()){
+          return;
+        }
+        msg.stamp = ros::Time::now();
+        pub_latency_.publish(msg);
       }
       //}
 
@@ -383,11 +452,13 @@ namespace uvdar {
        */
       /* spin //{ */
       void spin([[ maybe_unused ]] const ros::TimerEvent& te){
+        UVDAR_TRACE_SCOPE("filter: spin");
         std::scoped_lock lock(filter_mutex);
         removeNANs();
         if (_anonymous_measurements_){
           removeOverlaps();
         }
+        diagnostics_->gauge("tracked targets", (double)(fd.size()));
         for (int target=0; target<(int)(fd.size());target++){
           /* int targetsSeen = 0; */
           double age = (ros::Time::now() - fd[target].latest_measurement).toSec();
@@ -436,14 +507,14 @@ namespace uvdar {
        * @param id Identity of the target (-1 means that it is unknown or irrelevant)
        */
       /* initiateNew //{ */
-      void initiateNew(e::VectorXd x, e::MatrixXd C, ros::Time stamp, int id = -1){
+      void initiateNew(z_t x, R_t C, ros::Time stamp, int id = -1){
         if (fd.size() > 20)
           return;
 
         bool changed = false;
-        auto eigens = C.topLeftCorner(3,3).eigenvalues();
+        auto eigens = C.topLeftCorner<3,3>().eigenvalues();
         for (int i=0; i<3; i++){
-          if (eigens(i).real() > (x.topLeftCorner(3,1).norm())){
+          if (eigens(i).real() > (x.head<3>().norm())){
             eigens(i) = 5.0;
             changed = true;
           }
@@ -451,21 +522,21 @@ namespace uvdar {
 
         if (changed){
           if (id == -1){
-            e::EigenSolver<e::Matrix3d> es(C.topLeftCorner(3,3));
-            C.topLeftCorner(3,3) = es.eigenvectors().real()*eigens.real().asDiagonal()*es.eigenvectors().real().transpose();
-            x.topLeftCorner(3,1) = x.topLeftCorner(3,1).normalized()*15;
+            e::EigenSolver<e::Matrix3d> es(C.topLeftCorner<3,3>());
+            C.topLeftCorner<3,3>() = es.eigenvectors().real()*eigens.real().asDiagonal()*es.eigenvectors().real().transpose();
+            x.head<3>() = x.head<3>().normalized()*15;
             //so that we don't initialize with the long covariances intersecting in the origin
           }
         }
 
           auto C_local = C; // the correlation between angle and position only exists in the measurement - the filter may have many measurements where this relation does not exist anymore
-        if (!_use_velocity_){
+        if constexpr (n_states == KALMAN_STATES){
           int index = (int)(fd.size());
           ROS_INFO_STREAM("[UVDARKalman]: Initiating state " << index << "(ID:" << ((id<0)?(latest_id++):(id)) << ")  with: " << x.transpose());
           ROS_INFO_STREAM("[UVDARKalman]: The source input of the state is " << (ros::Time::now() - stamp).toSec() << "s old.");
 
-          C_local.topRightCorner(3,3).setZero();  // check the case of _use_velocity_ == true
-          C_local.bottomLeftCorner(3,3).setZero();  // check the case of _use_velocity_ == true
+          C_local.topRightCorner<3,3>().setZero();
+          C_local.bottomLeftCorner<3,3>().setZero();
 
           fd.push_back({.filter_state = {.x = x, .P = C_local}, .update_count = 0, .latest_update = stamp, .latest_measurement = stamp, .id = ((id<0)?(latest_id++):(id))});
         }
@@ -534,7 +605,7 @@ namespace uvdar {
        * @return The resulting state and its output covariance
        */
       /* correctWithMeasurement //{ */
-      statecov_t correctWithMeasurement(struct FilterData &fd_curr, statecov_t measurement, double &match_level_pos, ros::Time meas_time, bool prior_predict, bool apply_update = false, std::string camera_frame = ""){
+      statecov_t correctWithMeasurement(struct FilterData &fd_curr, const measurement_t &measurement, double &match_level_pos, ros::Time meas_time, bool prior_predict, bool apply_update = false, std::string camera_frame = ""){
         auto filter_local = fd_curr;
 
         auto orig_state = filter_local.filter_state;
@@ -553,10 +624,10 @@ namespace uvdar {
         /* ROS_INFO_STREAM("[UVDARKalman]: Fixed. angles: " << filter_local.filter_state.x.bottomRows(3)); */
 
         match_level_pos = gaussJointMaxVal(
-            measurement.P.topLeftCorner(3,3),
-            filter_local.filter_state.P.topLeftCorner(3,3),
-            measurement.x.topRows(3),
-            filter_local.filter_state.x.topRows(3)
+            measurement.P.topLeftCorner<3,3>(),
+            filter_local.filter_state.P.template topLeftCorner<3,3>(),
+            measurement.x.head<3>(),
+            filter_local.filter_state.x.template head<3>()
             );
         /* double match_level_rot = gaussJointMaxVal( */
         /*     measurement.P.bottomRightCorner(3,3), */
@@ -565,10 +636,10 @@ namespace uvdar {
         /*     filter_local.filter_state.x.bottomRows(3) */
         /*     ); */
 
-        auto P_local = measurement.P;
+        R_t P_local = measurement.P;
         /* ROS_INFO_STREAM("[UVDARKalman]: Meas. cov: " << std::endl << P_local); */
-        P_local.topRightCorner(3,3).setZero();  // check the case of _use_velocity_ == true
-        P_local.bottomLeftCorner(3,3).setZero();  // check the case of _use_velocity_ == true
+        P_local.topRightCorner<3,3>().setZero();  // check the case of _use_velocity_ == true
+        P_local.bottomLeftCorner<3,3>().setZero();  // check the case of _use_velocity_ == true
 
         /* double dt_from_last = std::fmax(std::fmin((filter_local.latest_update-meas_time).toSec(),(filter_local.latest_measurement-meas_time).toSec()),0.0); */
         /* P_local += Q_dt(dt_from_last)*dt_from_last; */
@@ -579,7 +650,7 @@ namespace uvdar {
 
         /* P_local.topLeftCorner(3,3) *= (1.0/(match_level_pos*volume_ratio_pos)); */
 
-        P_local.topLeftCorner(3,3) *= (1.0/(match_level_pos));
+        P_local.topLeftCorner<3,3>() *= (1.0/(match_level_pos));
 
         /* P_local.bottomRightCorner(3,3) *= (1.0/match_level_rot); */
         /* ROS_INFO_STREAM("[UVDARKalman]: With ML: " << std::endl << P_local); */
@@ -602,11 +673,11 @@ namespace uvdar {
 
         /* filter_local.filter_state.P *= (1+match_level);//this makes the filter not increase certainty in case of multiple identical measurements - the mean in the covariances is more probable than the rest of its x<1*sigma space */
 
-        auto eigens_pos = filter_local.filter_state.P.topLeftCorner(3,3).eigenvalues();
-        double min_eig_pos = eigens_pos.real().minCoeff();
-        auto eigens_rot = filter_local.filter_state.P.bottomRightCorner(3,3).eigenvalues();
+        e::Matrix3d P_pos = filter_local.filter_state.P.template topLeftCorner<3,3>();
+        double min_eig_pos = P_pos.eigenvalues().real().minCoeff();
+        /* auto eigens_rot = filter_local.filter_state.P.bottomRightCorner(3,3).eigenvalues(); */
         /* double min_eig_rot = eigens_rot.real().minCoeff(); */
-        filter_local.filter_state.P.topLeftCorner(3,3) += e::MatrixXd::Identity(3,3)*(min_eig_pos*(match_level_pos));//this makes the filter not increase certainty in case of multiple identical measurements - the mean in the covariances is more probable than the rest of its x<1*sigma space
+        filter_local.filter_state.P.template topLeftCorner<3,3>() += e::Matrix3d::Identity()*(min_eig_pos*(match_level_pos));//this makes the filter not increase certainty in case of multiple identical measurements - the mean in the covariances is more probable than the rest of its x<1*sigma space
         /* filter_local.filter_state.P.bottomRightCorner(3,3) += e::MatrixXd::Identity(3,3)*(min_eig_rot*(match_level_rot));//this makes the filter not increase certainty in case of multiple identical measurements - the mean in the covariances is more probable than the rest of its x<1*sigma space */
         /* ROS_INFO_STREAM("[UVDARKalman]: Filter exp.: " << std::endl << filter_local.filter_state.P); */
 
@@ -614,7 +685,7 @@ namespace uvdar {
         filter_local.filter_state.x[4] = fixAngle(filter_local.filter_state.x[4], 0);
         filter_local.filter_state.x[5] = fixAngle(filter_local.filter_state.x[5], 0);
 
-        if (isInFrontOfCamera(filter_local.filter_state.x.topRows(3), camera_frame, meas_time)){
+        if (isInFrontOfCamera(filter_local.filter_state.x.template head<3>(), camera_frame, meas_time)){
           if (apply_update){
             /* if (_debug_){ */
             /* if ( */
@@ -662,31 +733,11 @@ namespace uvdar {
       //}
 
       /**
-       * @brief Returns a value between 0 and 1 representing the level of overlap between two probability distributions in the form of multivariate Gaussians. Multiplying two Gaussians produces another Gaussian, with the value of its peak roughly corresponding to the level of the overlap between the two inputs. The ouptut of this function is the value of such peak, given that the input Gaussians have been scaled s.t. their peaks have the value of 1. Therefore, the output is 1 if the means of both inputs are identical.
-       *
-       * @param si0 The covariance of the first distribution
-       * @param si1 The covariance of the second distribution
-       * @param mu0 The mean of the first distribution
-       * @param mu1 The mean of the second distribution
-       *
-       * @return The level of overlap between the two distribution
+       * @brief Returns the level of overlap between two position distributions, see spatial_index::gaussJointMaxVal. NaN outputs are reported.
        */
       /* gaussJointMaxVal //{ */
-      double gaussJointMaxVal(e::MatrixXd si0,e::MatrixXd si1,e::VectorXd mu0,e::VectorXd mu1){
-        bool scaled = true;
-        int k=mu0.size();
-        auto K=si0*(si0+si1).inverse();
-        auto d0=K*(mu1-mu0);
-        auto d1=(K-e::MatrixXd::Identity(K.rows(),K.rows()))*(mu1-mu0);
-        double N;
-        if (scaled){
-          auto N_v = ((-0.5)*( (d0.transpose()*(si0).inverse()*d0) + (d1.transpose()*(si1).inverse()*d1) ));
-          N=exp(N_v(0));
-        }
-        else{
-          auto N_v = ((-0.5)*( (d0.transpose()*(si0).inverse()*d0) + (d1.transpose()*(si1).inverse()*d1) ));
-          N=(1.0/pow((2*M_PI),k)*sqrt((si0).determinant()*(si1).determinant()))*exp(N_v(0));
-        }
+      double gaussJointMaxVal(const e::Matrix3d &si0, const e::Matrix3d &si1, const e::Vector3d &mu0, const e::Vector3d &mu1){
+        double N = spatial_index::gaussJointMaxVal(si0, si1, mu0, mu1);
         if (isnan(N)){
           ROS_INFO("[UVDARKalman]: Joint Gaussian value came out NaN");
           ROS_INFO_STREAM("[UVDARKalman]: Sigma 1: " << std::endl << si0);
@@ -697,6 +748,37 @@ namespace uvdar {
       }
       //}
 
+      /**
+       * @brief Returns the squared Mahalanobis distance between the positions of two distributions w.r.t. their combined covariance. The output of gaussJointMaxVal for the positions equals exp(-0.5*d^2) of this distance, which is cheaper to evaluate.
+       *
+       * @param a The first distribution
+       * @param b The second distribution
+       *
+       * @return The squared distance
+       */
+      /* positionMahalanobisSquared //{ */
+      template <class T0, class T1>
+      double positionMahalanobisSquared(const T0 &a, const T1 &b){
+        return spatial_index::mahalanobisSquared(a.P.template topLeftCorner<3,3>(), b.P.template topLeftCorner<3,3>(), a.x.template head<3>(), b.x.template head<3>());
+      }
+      //}
+
+      /**
+       * @brief Adds the sphere bounding the position of a distribution, within which any distribution passing a gate on the Mahalanobis distance to it has to lie
+       *
+       * @param distribution The distribution - a measurement or a filter state
+       * @param gate The squared Mahalanobis distance
+       * @param centers The centers of the spheres to add to
+       * @param radii The radii of the spheres to add to
+       */
+      /* addBoundingSphere //{ */
+      template <class T>
+      void addBoundingSphere(const T &distribution, double gate, std::vector<e::Vector3d> &centers, std::vector<double> &radii){
+        centers.push_back(distribution.x.template head<3>());
+        radii.push_back(spatial_index::gateRadius(distribution.P.template topLeftCorner<3,3>(), gate));
+      }
+      //}
+
       bool isInFrontOfCamera(e::Vector3d mean, std::string camera_frame, ros::Time stamp){
         geometry_msgs::PoseStamped target_cam_view, target_filter;
         target_filter.header.frame_id = _output_frame_;
@@ -729,7 +811,7 @@ namespace uvdar {
        * @param meas_time The time of the input measurements
        */
       /* applyMeasurementsAnonymous //{ */
-      void applyMeasurementsAnonymous(std::vector<statecov_t> measurements, ros::Time meas_time, std::string camera_frame){
+      void applyMeasurementsAnonymous(const measurements_t &measurements, ros::Time meas_time, std::string camera_frame){
         std::scoped_lock lock(filter_mutex);
         if (fd.size() == 0){
           for (auto const& measurement_curr : measurements | indexed(0)){
@@ -738,72 +820,65 @@ namespace uvdar {
           return;
         }
 
-        e::MatrixXd match_matrix(measurements.size(),fd.size());
-        std::vector<std::vector<FilterData>> tentative_states;
-
-        for (auto const& measurement_curr : measurements | indexed(0)){
-          tentative_states.push_back(std::vector<FilterData>());
-          for (auto const& state_curr : fd | indexed(0)){
-
-            [[ maybe_unused ]] double dt_from_last = std::fmin((meas_time-state_curr.value().latest_update).toSec(),(meas_time-state_curr.value().latest_measurement).toSec());
-            
-
-            tentative_states.back().push_back(
-                state_curr.value()
-                );
-            double match_level;
-            correctWithMeasurement(tentative_states.back().back(),measurement_curr.value(), match_level, meas_time, true, true, camera_frame);
-            match_matrix(measurement_curr.index(),state_curr.index()) = match_level;
-            double dt_s = 0.1;
-            if ((ros::Time::now() - state_curr.value().latest_measurement).toSec() < dt_s){ // just in case - in simulation the camera outputs follow one another immediately, so no inflation happens in between
-              tentative_states.back().back().filter_state = predictTillTime(tentative_states.back().back(), ros::Time::now()+ros::Duration(dt_s),false);
-            }
-          }
+        // association is resolved before any correction - each state is predicted once, and the measurements are matched to the predictions
+        std::vector<statecov_t, e::aligned_allocator<statecov_t>> predicted_states;
+        predicted_states.reserve(fd.size());
+        for (auto& state_curr : fd){
+          predicted_states.push_back(predictTillTime(state_curr, meas_time, false));
+        }
+
+        // the match level of a pair equals exp(-0.5*d^2) for their Mahalanobis distance d, so the association threshold is a gate on d^2
+        const double gate = -2.0*std::log(MATCH_LEVEL_THRESHOLD_ASSOCIATE);
+        std::vector<e::Vector3d> measurement_centers, state_centers;
+        std::vector<double> measurement_radii, state_radii;
+        for (auto &measurement_curr : measurements){
+          addBoundingSphere(measurement_curr, gate, measurement_centers, measurement_radii);
+        }
+        for (auto &state_curr : predicted_states){
+          addBoundingSphere(state_curr, gate, state_centers, state_radii);
+        }
+
+        // pairs with disjoint bounding spheres lie outside of the gate - their match level is below the threshold, and is left at zero
+        e::MatrixXd match_matrix = e::MatrixXd::Zero(measurements.size(),fd.size());
+        e::MatrixXd cost_matrix = e::MatrixXd::Constant(measurements.size(),fd.size(),std::numeric_limits<double>::infinity());
+        for (auto [m_i, f_i] : spatial_index::intersectingPairs(measurement_centers, measurement_radii, state_centers, state_radii)){
+          double distance_sq = positionMahalanobisSquared(measurements[m_i], predicted_states[f_i]);
+          match_matrix(m_i,f_i) = exp(-0.5*distance_sq);
+          cost_matrix(m_i,f_i) = (distance_sq < gate)?(0.5*distance_sq):std::numeric_limits<double>::infinity();
         }
 
         if (_debug_){
           ROS_INFO_STREAM("[UVDARKalman]: match_matrix: " << std::endl <<match_matrix);
         }
 
-        std::vector<std::pair<int,int>> matches;
-
-        int best_index;
-        double best_match_level;
-        double best_update_count;
-        double curr_match_level;
-        for (int f_i = 0; f_i < (int)(fd.size()); f_i++) {
-          best_update_count = -1;
-          best_index = -1;
-          best_match_level = -1;
-          for (int m_i = 0; m_i < (int)(measurements.size()); m_i++) {
-            curr_match_level = match_matrix(m_i,f_i);  
-            if ((curr_match_level > MATCH_LEVEL_THRESHOLD_ASSOCIATE) && ( (fd[f_i].update_count > best_update_count) || ((fd[f_i].update_count == best_update_count) && (curr_match_level > best_match_level)) ) ){
-              best_match_level = curr_match_level;
-              best_index = m_i;
-              best_update_count = fd[f_i].update_count;
-            }
-          }
+        // the most pairs within the gates, with the least total negative log-likelihood
+        auto assigned = assignment::solve(cost_matrix);
 
-          if (best_index >= 0){
-            matches.push_back({best_index,f_i});
-            for (int f_j = 0; f_j < (int)(fd.size()); f_j++) {
-              match_matrix(best_index,f_j) = std::nan("");
-            }
+        std::vector<std::pair<int,int>> matches;
+        for (int m_i = 0; m_i < (int)(measurements.size()); m_i++) {
+          if (assigned[m_i] >= 0){
+            matches.push_back({m_i,assigned[m_i]});
           }
-          for (int m_j = 0; m_j < (int)(measurements.size()); m_j++) {
-            if (match_matrix(m_j,f_i) > MATCH_LEVEL_THRESHOLD_ASSOCIATE){
-              match_matrix(m_j,f_i) = std::nan("");
+          for (int f_i = 0; f_i < (int)(fd.size()); f_i++) {
+            if ((assigned[m_i] >= 0) || (match_matrix(m_i,f_i) > MATCH_LEVEL_THRESHOLD_ASSOCIATE)){ //neither used nor gated measurements initiate new states
+              match_matrix(m_i,f_i) = std::nan("");
             }
           }
         }
 
         for( auto& match_curr : matches){
+          auto state_new = fd[match_curr.second];
+          double match_level;
+          correctWithMeasurement(state_new, measurements[match_curr.first], match_level, meas_time, true, true, camera_frame);
+          double dt_s = 0.1;
+          if ((ros::Time::now() - fd[match_curr.second].latest_measurement).toSec() < dt_s){ // just in case - in simulation the camera outputs follow one another immediately, so no inflation happens in between
+            state_new.filter_state = predictTillTime(state_new, ros::Time::now()+ros::Duration(dt_s),false);
+          }
           if (_debug_){
             ROS_INFO_STREAM("[UVDARKalman]: Updating state: " << match_curr.second << " with " << measurements[match_curr.first].x.transpose());
-            ROS_INFO_STREAM("[UVDARKalman]: This yelds state: " << tentative_states[match_curr.first][match_curr.second].filter_state.x.topRows(6).transpose());
+            ROS_INFO_STREAM("[UVDARKalman]: This yelds state: " << state_new.filter_state.x.topRows(6).transpose());
           }
-          fd[match_curr.second] = tentative_states[match_curr.first][match_curr.second];
-
+          fd[match_curr.second] = state_new;
         }
 
         if (_debug_){
@@ -838,7 +913,7 @@ namespace uvdar {
        * @param meas_time
        */
       /* applyMeasurementsWithIdentity //{ */
-      void applyMeasurementsWithIdentity(std::vector<statecov_t> measurements, std::vector<int> ids, ros::Time meas_time, std::string camera_frame){
+      void applyMeasurementsWithIdentity(const measurements_t &measurements, const std::vector<int> &ids, ros::Time meas_time, std::string camera_frame){
         std::scoped_lock lock(filter_mutex);
 
         if (measurements.size() != ids.size()){
@@ -940,60 +1015,65 @@ namespace uvdar {
        */
       /* removeOverlaps //{ */
       void removeOverlaps(){
-        double curr_match_level;
-        for (int i=0; i<((int)(fd.size())-1);i++){
-          bool remove_first = false;
-          for (int j=i+1; j<(int)(fd.size()); j++){
-            curr_match_level = gaussJointMaxVal(
-                fd[i].filter_state.P.topLeftCorner(3,3),
-                fd[j].filter_state.P.topLeftCorner(3,3),
-                fd[i].filter_state.x.topRows(3),
-                fd[j].filter_state.x.topRows(3)
-                );
-            if (curr_match_level > MATCH_LEVEL_THRESHOLD_REMOVE){
-              auto eigens = fd[i].filter_state.P.topLeftCorner(3,3).eigenvalues();
-              double size_i = (eigens.topLeftCorner(3, 1)).norm();
-              eigens = fd[j].filter_state.P.topLeftCorner(3,3).eigenvalues();
-              double size_j = (eigens.topLeftCorner(3, 1)).norm();
-              int n = -1;
-              int m = -1;
-              if ( (fd[i].update_count < MIN_MEASUREMENTS_TO_VALIDATION) == (fd[j].update_count < MIN_MEASUREMENTS_TO_VALIDATION) ){
-                if ( size_j > size_i ){
-                  n = j;
-                  m = i;
-                }
-                else {
-                  n = i;
-                  m = j;
-                }
+        // the match level equals exp(-0.5*d^2) for the Mahalanobis distance d of the positions, so only the pairs with intersecting bounding spheres of the corresponding gate can overlap
+        const double gate = -2.0*std::log(MATCH_LEVEL_THRESHOLD_REMOVE);
+        std::vector<e::Vector3d> centers;
+        std::vector<double> radii;
+        for (auto &fd_curr : fd){
+          addBoundingSphere(fd_curr.filter_state, gate, centers, radii);
+        }
+
+        std::vector<bool> removed(fd.size(), false);
+        for (auto [i, j] : spatial_index::intersectingPairs(centers, radii)){ //sorted as in an exhaustive loop over the pairs, so the same states are removed
+          if (removed[i] || removed[j]){
+            continue;
+          }
+          double curr_match_level = gaussJointMaxVal(
+              fd[i].filter_state.P.template topLeftCorner<3,3>(),
+              fd[j].filter_state.P.template topLeftCorner<3,3>(),
+              fd[i].filter_state.x.template head<3>(),
+              fd[j].filter_state.x.template head<3>()
+              );
+          if (curr_match_level > MATCH_LEVEL_THRESHOLD_REMOVE){
+            e::Matrix3d P_pos = fd[i].filter_state.P.template topLeftCorner<3,3>();
+            double size_i = P_pos.eigenvalues().norm();
+            P_pos = fd[j].filter_state.P.template topLeftCorner<3,3>();
+            double size_j = P_pos.eigenvalues().norm();
+            int n = -1;
+            int m = -1;
+            if ( (fd[i].update_count < MIN_MEASUREMENTS_TO_VALIDATION) == (fd[j].update_count < MIN_MEASUREMENTS_TO_VALIDATION) ){
+              if ( size_j > size_i ){
+                n = j;
+                m = i;
               }
               else {
-                if (fd[i].update_count < MIN_MEASUREMENTS_TO_VALIDATION){
-                  n = i;
-                  m = j;
-                }
-                else {
-                  n = j;
-                  m = i;
-                }
-
+                n = i;
+                m = j;
               }
-              fd.erase(fd.begin()+n);
-              ROS_INFO_STREAM("[UVDARKalman]: Removing state " << n << " (ID:" << fd[n].id << "): " << fd[n].filter_state.x.transpose() << " due to large overlap with state " << m << ": " << fd[m].filter_state.x.transpose());
-              if (n<m){
-                remove_first=true;
-                break;
+            }
+            else {
+              if (fd[i].update_count < MIN_MEASUREMENTS_TO_VALIDATION){
+                n = i;
+                m = j;
               }
               else {
-                j--;
+                n = j;
+                m = i;
               }
+
             }
+            removed[n] = true;
+            ROS_INFO_STREAM("[UVDARKalman]: Removing state " << n << " (ID:" << fd[n].id << "): " << fd[n].filter_state.x.transpose() << " due to large overlap with state " << m << ": " << fd[m].filter_state.x.transpose());
           }
-          if (remove_first){
-            i--;
-          }
+        }
 
+        int kept = 0;
+        for (int i=0; i<(int)(fd.size()); i++){
+          if (!removed[i]){
+            fd[kept++] = fd[i];
+          }
         }
+        fd.erase(fd.begin()+kept, fd.end());
       }
       //}
 
@@ -1013,8 +1093,8 @@ namespace uvdar {
 
 
 
-      e::MatrixXd rosCovarianceToEigen(const boost::array<double,36> input){
-        e::MatrixXd output(6,6);
+      R_t rosCovarianceToEigen(const boost::array<double,36> &input){
+        R_t output;
         /* if ((int)(input.size()) != 36 ){ */
         /*   ROS_ERROR_STREAM("[UVDARKalman]: Covariance to be converted to Eigen matrix has " << input.size() << " elements instead of the expected 36! Returning"); */
         /*   return e::MatrixXd(); */
@@ -1029,7 +1109,7 @@ namespace uvdar {
         return output;
       }
 
-      boost::array<double,36> eigenCovarianceToRos(const e::MatrixXd input){
+      boost::array<double,36> eigenCovarianceToRos(const e::Ref<const e::MatrixXd> &input){
         boost::array<double, 36> output;
         if (((int)(input.rows()) != 6 ) || ((int)(input.cols()) != 6 )){
           ROS_ERROR_STREAM("[UVDARKalman]: Covariance to be converted to Ros has size of  " << input.rows() << "x" << input.cols() << " as opposed to the expected size of 6x6! Returning");
@@ -1121,7 +1201,19 @@ namespace uvdar {
        */
       /* A_dt //{ */
       A_t A_dt(double dt){
-        if (_anonymous_measurements_){
+        if constexpr (n_states == KALMAN_STATES_VELOCITY){
+          filter_matrices.A <<
+            1,0,0,dt,0, 0, 0,0,0,
+            0,1,0,0, dt,0, 0,0,0,
+            0,0,1,0, 0, dt,0,0,0,
+            0,0,0,1, 0, 0, 0,0,0,
+            0,0,0,0, 1, 0, 0,0,0,
+            0,0,0,0, 0, 1, 0,0,0,
+            0,0,0,0, 0, 0, 1,0,0,
+            0,0,0,0, 0, 0, 0,1,0,
+            0,0,0,0, 0, 0, 0,0,1;
+        }
+        else {
           filter_matrices.A <<
             1,0,0, 0,0,0,
             0,1,0, 0,0,0,
@@ -1129,28 +1221,6 @@ namespace uvdar {
             0,0,0, 1,0,0,
             0,0,0, 0,1,0,
             0,0,0, 0,0,1;
-        } else {
-          if (_use_velocity_){
-            filter_matrices.A <<
-              1,0,0,dt,0, 0, 0,0,0,
-              0,1,0,0, dt,0, 0,0,0,
-              0,0,1,0, 0, dt,0,0,0,
-              0,0,0,1, 0, 0, 0,0,0,
-              0,0,0,0, 1, 0, 0,0,0,
-              0,0,0,0, 0, 1, 0,0,0,
-              0,0,0,0, 0, 0, 1,0,0,
-              0,0,0,0, 0, 0, 0,1,0,
-              0,0,0,0, 0, 0, 0,0,1;
-          }
-          else{
-            filter_matrices.A <<
-              1,0,0, 0,0,0,
-              0,1,0, 0,0,0,
-              0,0,1, 0,0,0,
-              0,0,0, 1,0,0,
-              0,0,0, 0,1,0,
-              0,0,0, 0,0,1;
-          }
         }
         return filter_matrices.A;
       }
@@ -1165,27 +1235,28 @@ namespace uvdar {
        */
       // Q_dt //{ */
       Q_t Q_dt(double dt){
-        if (_anonymous_measurements_){
-          //simplified to the process described in detail below. These two approaches will be compared
+        if constexpr (n_states == KALMAN_STATES_VELOCITY){
           filter_matrices.Q <<
-            vl, 0 ,0, 0, 0 ,0,
-            0, vl, 0, 0, 0 ,0,
-            0, 0, vv, 0, 0 ,0,
-            0, 0, 0,  1, 0 ,0,
-            0, 0, 0,  0, 1 ,0,
-            0, 0, 0,  0, 0 ,1;
-        } else {
-          if (_use_velocity_){
+            sn*sn, 0,     0,     0,  0,  0,  0, 0, 0,
+            0,     sn*sn, 0,     0,  0,  0,  0, 0, 0,
+            0,     0,     sn*sn, 0,  0,  0,  0, 0, 0,
+            0,     0,     0,     vl, 0,  0,  0, 0, 0,
+            0,     0,     0,     0,  vl, 0,  0, 0, 0,
+            0,     0,     0,     0,  0,  vv, 0, 0, 0,
+            0,     0,     0,     0,  0,  0,  1, 0, 0,
+            0,     0,     0,     0,  0,  0,  0, 1, 0,
+            0,     0,     0,     0,  0,  0,  0, 0, 1;
+        }
+        else {
+          if (_anonymous_measurements_){
+            //simplified to the process described in detail below. These two approaches will be compared
             filter_matrices.Q <<
-              sn*sn, 0,     0,     0,  0,  0,  0, 0, 0,
-              0,     sn*sn, 0,     0,  0,  0,  0, 0, 0,
-              0,     0,     sn*sn, 0,  0,  0,  0, 0, 0,
-              0,     0,     0,     vl, 0,  0,  0, 0, 0,
-              0,     0,     0,     0,  vl, 0,  0, 0, 0,
-              0,     0,     0,     0,  0,  vv, 0, 0, 0,
-              0,     0,     0,     0,  0,  0,  1, 0, 0,
-              0,     0,     0,     0,  0,  0,  0, 1, 0,
-              0,     0,     0,     0,  0,  0,  0, 0, 1;
+              vl, 0 ,0, 0, 0 ,0,
+              0, vl, 0, 0, 0 ,0,
+              0, 0, vv, 0, 0 ,0,
+              0, 0, 0,  1, 0 ,0,
+              0, 0, 0,  0, 1 ,0,
+              0, 0, 0,  0, 0 ,1;
           }
           else{
             // This is an unorthodox approach.
@@ -1217,14 +1288,32 @@ namespace uvdar {
 
 } //uvdar
 
-int main(int argc, char** argv) {
-  ros::init(argc, argv, "uvdar_kalman_anonymous");
-  ros::NodeHandle nh("~");
-  uvdar::UVDARKalman        kl(nh);
+/**
+ * @brief Runs the filter with the given length of the state vector until the node is shut down
+ *
+ * @param nh Private NodeHandle of this ROS node
+ */
+template <int n_states>
+void runFilter(ros::NodeHandle &nh){
+  uvdar::UVDARKalman<n_states> kl(nh);
 
   ROS_INFO("[UVDARKalman]: filter node initiated");
 
   ros::spin();
+}
+
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "uvdar_kalman_anonymous");
+  ros::NodeHandle nh("~");
+
+  bool use_velocity;
+  nh.param("use_velocity", use_velocity, bool(false));
+  if (use_velocity){
+    runFilter<KALMAN_STATES_VELOCITY>(nh);
+  }
+  else {
+    runFilter<KALMAN_STATES>(nh);
+  }
 
   return 0;
 }
@@ -7,6 +7,8 @@
 #include <mrs_msgs/String.h>
 #include <std_msgs/Float32.h>
 #include <uvdar_core/RecMsg.h>
+#include <diagnostics/diagnostics.h>
+#include <packed_points/packed_points.h>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <string>
@@ -37,6 +39,8 @@ std::vector<std::string>    estimated_framerate_topics;
 std::vector<ros::Publisher> pub_blinkers_seen;
 std::vector<ros::Publisher> pub_estimated_framerate;
 using points_seen_callback = boost::function<void(const uvdar_core::ImagePointsWithFloatStampedConstPtr&)>;
+using packed_points_seen_callback = boost::function<void(const uvdar_core::ImagePointsPackedStampedConstPtr&)>;
+bool packed_input = false;  // if true, the compact variants of the point topics are subscribed
 std::vector<points_seen_callback> callbacks_points_seen;
 std::vector<ros::Subscriber>      subscribers_points_seen;
  
@@ -67,8 +71,10 @@ public:
     param_loader.loadParam("uav_id", uav_id);
     param_loader.loadParam("recieved_topic", recieved_topic);
     param_loader.loadParam("points_seen_topics", points_seen_topics, points_seen_topics);
+    param_loader.loadParam("packed_input", packed_input, bool(false));
     param_loader.loadParam("blinkers_seen_topics", blinkers_seen_topics, blinkers_seen_topics);
     param_loader.loadParam("estimated_framerate_topics", estimated_framerate_topics, estimated_framerate_topics);
+    diagnostics_ = std::make_unique<uvdar::diagnostics::Publisher>(nh, "rx");
     if (points_seen_topics.empty()) {
       ROS_WARN("[RX_processor]: No topics of points_seen_topics were supplied. Returning.");
       return;
@@ -107,7 +113,12 @@ public:
       // callback of individual image frames
       points_seen_callback callback = [i, this](const uvdar_core::ImagePointsWithFloatStampedConstPtr& pointsMessage) { VisiblePoints(pointsMessage, i); };
       callbacks_points_seen.push_back(callback);
-      subscribers_points_seen.push_back(nh.subscribe(points_seen_topics[i], 1, callbacks_points_seen[i]));
+      if (packed_input) {
+        packed_points_seen_callback packed_callback = [callback](const uvdar_core::ImagePointsPackedStampedConstPtr& pointsMessage) { callback(uvdar::packed_points::unpack(*pointsMessage)); };
+        subscribers_points_seen.push_back(nh.subscribe(points_seen_topics[i] + PACKED_POINTS_SUFFIX, 1, packed_callback));
+      } else {
+        subscribers_points_seen.push_back(nh.subscribe(points_seen_topics[i], 1, callbacks_points_seen[i]));
+      }
       
       ht4dbt_trackers_.push_back(std::make_shared<uvdar::HT4DBlinkerTrackerCPU>(ACC_LEN, _pitch_steps_, _yaw_steps_, _max_pixel_shift_, cv::Size(0, 0), _nullify_radius_, _reasonable_radius_));
       ht4dbt_trackers_.back()->setDebug(_debug_, _visual_debug_);
@@ -189,6 +200,8 @@ private:
   }
 
   void VisiblePoints(const uvdar_core::ImagePointsWithFloatStampedConstPtr& points_seen_msg, size_t camera_index) {
+    diagnostics_->count("frames received");
+    diagnostics_->gauge("points per frame", (double)(points_seen_msg->points.size()));
     /* if(camera_index!=0) return; */
 
     /*
@@ -788,6 +801,7 @@ private:
           rm_pub.msg_type = 0;
         }
         pub_rec_msg.publish(rm_pub);
+        diagnostics_->count("messages published");
       }
       ROS_INFO("------------------");
 
@@ -995,6 +1009,7 @@ private:
 
       if (faults != 0) {  // if both corrections were not succesful, ignore received frame
         ROS_WARN("Not able to decode msg");
+        diagnostics_->count("undecodable messages");
         received_msg_raw.clear();
         continue;
       }
@@ -1138,6 +1153,7 @@ private:
   std::vector<std::vector<std::vector<PointSeen>>> point_seen;  // ith camera, jth cluster, kth time of visible point
   std::vector<CamInfo>                             cam_info;
   std::vector<SignalData>                         signal_data_;
+  std::unique_ptr<uvdar::diagnostics::Publisher> diagnostics_;
 };
 }  // namespace RX
 
@@ -3,7 +3,15 @@
 
 #include <thread>
 #include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <deque>
+#include <set>
+#include <atomic>
+#include <unordered_map>
 #include <numeric>
+#include <algorithm>
+#include <random>
 #include <fstream>
 #include <boost/filesystem/operations.hpp>
 
@@ -13,10 +21,12 @@
 #include <geometry_msgs/Pose.h>
 #include <mrs_lib/param_loader.h>
 #include <mrs_lib/transformer.h>
-#include <mrs_lib/image_publisher.h>
+#include <image_transport/image_transport.h>
+#include <cv_bridge/cv_bridge.h>
 #include <mrs_lib/timer.h>
 #include <std_msgs/Float32.h>
 #include <uvdar_core/ImagePointsWithFloatStamped.h>
+#include <uvdar_core/LatencyTrailer.h>
 
 #include <Eigen/Dense>
 #include <Eigen/Geometry>
@@ -26,7 +36,16 @@
 
 #include "OCamCalib/ocam_functions.h"
 #include <unscented/unscented.h>
-/* #include <p3p/P3p.h> */
+#include <p3p/p3p.h>
+#include <pose_core/pose_core.h>
+#include <pose_core/hypotheses.h>
+#include <pose_core/input_queue.h>
+#include <pose_core/ros_adapter.h>
+#include <trace/trace.h>
+#include <trace/latency.h>
+#include <diagnostics/diagnostics.h>
+#include <packed_points/packed_points.h>
+#include <lazy_publisher/lazy_publisher.h>
 #include <color_selector/color_selector.h>
 /* #include <frequency_classifier/frequency_classifier.h> */
 
@@ -40,53 +59,23 @@
 #define deg2rad(X) ((X)*0.01745329251)
 #define rad2deg(X) ((X)*57.2957795131)
 
-#define DIRECTIONAL_LED_VIEW_ANGLE (deg2rad(120))
 #define RING_LED_VERT_ANGLE (deg2rad(120))
 
-#define UNMATCHED_OBSERVED_POINT_PENALTY sqr(15)
-/* #define UNMATCHED_PROJECTED_POINT_PENALTY sqr(5) */
-#define UNMATCHED_PROJECTED_POINT_PENALTY sqr(0)
 
 #define LED_GROUP_DISTANCE 0.03
 
-/* #define ERROR_THRESHOLD_INITIAL (752.0/M_PI) */
-/* #define ERROR_THRESHOLD_INITIAL sqr(10) */
-#define ERROR_THRESHOLD_INITIAL(img) sqr(_oc_models_.at(img).width/50.0)
-#define ERROR_THRESHOLD_MUTATION_1(img) sqr(_oc_models_.at(img).width/75.0)
-#define ERROR_THRESHOLD_MUTATION_2(img) sqr(_oc_models_.at(img).width/100.0)
-#define ERROR_THRESHOLD_MUTATION_3(img) sqr(_oc_models_.at(img).width/150.0)
+#define DEFAULT_FILTERING_QUEUE_SIZE 10
 
-#define PF_REPROJECT_THRESHOLD_VERIFIED(img) sqr(_oc_models_.at(img).width/150.0)
-/* #define PF_REPROJECT_THRESHOLD_VERIFIED(img) sqr(2) */
-#define PF_REPROJECT_THRESHOLD_UNFIT(img) sqr(_oc_models_.at(img).width/50.0)
-/* #define PF_MUTATION_THRESHOLD(img) sqr(_oc_models_.at(img).width/150.0) */
-#define SCATTER_TIME_STEP 0.1//s
-#define MUTATION_COUNT 1
-#define MUTATION_POSITION_MAX_STEP 5.0//m per second
-#define MUTATION_ORIENTATION_MAX_STEP 3.14//rad per second
-#define MUTATION_VELOCITY_MAX_STEP 1.0//m per second^2
-
-#define MAX_INITIAL_VELOCITY 1.0//m per second
-
-#define MAX_HYPOTHESIS_COUNT 1000
-
-#define INITIAL_ROUGH_HYPOTHESIS_COUNT 200
-#define INITIAL_HYPOTHESIS_COUNT 10
-
-#define MAX_HYPOTHESIS_AGE 1.5
-
-#define MAX_INIT_ITERATIONS 10000
-#define MAX_MUTATION_REFINE_ITERATIONS 1000
+#define DEFAULT_REINITIALIZATION_PERIOD 5.0 //s
 
 #define SIMILAR_ERRORS_THRESHOLD sqr(1)
 
-#define UVDAR_RANGE(img) (_oc_models_.at(img).width/50.0)
+#define VIEW_ANGLE_MARGIN (deg2rad(2))
+
 #define MAX_HYPOTHESIS_SPREAD 8.0
 
 #define REJECT_UPSIDE_DOWN true
 
-#define EDGE_DETECTION_MARGIN 10
-
 #define SINGLE_HYPOTHESIS_COVARIANCE sqr(0.1)
 
 #define PUBLISH_HYPO_CONSTITUENTS false
@@ -105,43 +94,45 @@ namespace uvdar {
   class Profiler{
 
     public:
+      typedef std::chrono::time_point<std::chrono::steady_clock> time_point; // the steady clock is shared with the trace, so that the recorded intervals can be forwarded to it
+
       Profiler(){
         std::scoped_lock lock(profiler_mutex);
         latest_times.push_back(getTime());
       }
 
       void addValue(std::string preamble){
-        if (active){
+        if (recording()){
           std::scoped_lock lock(profiler_mutex);
           auto now_time = getTime();
-          elapsed_time.push_back({currDepthIndent() + preamble,std::chrono::duration_cast<std::chrono::microseconds>(now_time - latest_times.back()).count()});
+          store(preamble, latest_times.back(), now_time);
           latest_times.back() = now_time;
         }
       }
 
-      void addValueBetween(std::string preamble, std::chrono::time_point<std::chrono::high_resolution_clock> start, std::chrono::time_point<std::chrono::high_resolution_clock> stop){
-        if (active){
+      void addValueBetween(std::string preamble, time_point start, time_point stop){
+        if (recording()){
           std::scoped_lock lock(profiler_mutex);
-          elapsed_time.push_back({currDepthIndent() + preamble,std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count()});
+          store(preamble, start, stop);
         }
       }
 
-      void addValueSince(std::string preamble, std::chrono::time_point<std::chrono::high_resolution_clock> start){
+      void addValueSince(std::string preamble, time_point start){
 
-        if (active){
+        if (recording()){
           std::scoped_lock lock(profiler_mutex);
           auto now_time = getTime();
-          elapsed_time.push_back({currDepthIndent() + preamble,std::chrono::duration_cast<std::chrono::microseconds>(now_time - start).count()});
+          store(preamble, start, now_time);
           latest_times.back() = now_time;
         }
       }
 
-      static std::chrono::time_point<std::chrono::high_resolution_clock> getTime(){
-        return std::chrono::high_resolution_clock::now();
+      static time_point getTime(){
+        return std::chrono::steady_clock::now();
       }
 
       void indent(){
-        if (active){
+        if (recording()){
           std::scoped_lock lock(profiler_mutex);
           latest_times.push_back(getTime());
           curr_depth_indent++;
@@ -149,9 +140,11 @@ namespace uvdar {
       }
 
       void unindent(){
-        if (active){
+        if (recording()){
           std::scoped_lock lock(profiler_mutex);
-          latest_times.pop_back();
+          if (latest_times.size() > 1){
+            latest_times.pop_back();
+          }
           curr_depth_indent--;
         }
       }
@@ -167,6 +160,8 @@ namespace uvdar {
         std::scoped_lock lock(profiler_mutex);
         elapsed_time.clear();
         latest_times.clear();
+        latest_times.push_back(getTime());
+        curr_depth_indent = 0;
       }
 
       void stop(){
@@ -189,12 +184,28 @@ namespace uvdar {
           return std::string(2*curr_depth_indent, ' ');
       }
 
+      /**
+       * @brief The intervals are recorded for the console output if the profiler is active, and forwarded to the trace if it is enabled
+       */
+      bool recording(){
+        return active || trace::enabled();
+      }
+
+      void store(const std::string &preamble, time_point start, time_point stop){
+        if (active){
+          elapsed_time.push_back({currDepthIndent() + preamble,std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count()});
+        }
+        if (trace::enabled()){
+          trace::record(preamble.c_str(), std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count(), std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+        }
+      }
+
       bool active = false;
       int curr_depth_indent = 0;
 
       std::vector<std::pair<std::string,int>>  elapsed_time;
 
-      std::vector<std::chrono::time_point<std::chrono::high_resolution_clock>> latest_times;
+      std::vector<time_point> latest_times;
 
       std::mutex profiler_mutex;
   };
@@ -203,14 +214,9 @@ namespace uvdar {
    * @brief A processing class for converting retrieved blinking markers from a UV camera image into relative poses of observed UAV that carry these markers, as well as the error covariances of these estimates
    */
   class UVDARPoseCalculator {
-    struct Pose {
-      e::Vector3d position;
-      e::Quaterniond orientation;
-    };
-    struct Twist {
-      e::Vector3d linear;
-      e::Quaterniond angular; //TODO or remove
-    };
+    typedef pose_core::Pose Pose;
+    typedef pose_core::Hypothesis Hypothesis;
+    typedef pose_core::AssociatedHypotheses AssociatedHypotheses;
 
     struct LEDMarker {
       Pose pose;
@@ -221,9 +227,12 @@ namespace uvdar {
     struct InputData {
       std::vector<uvdar_core::Point2DWithFloat> points;
       ros::Time time;
+      std::vector<uvdar_core::LatencyStamp> latency;
         /* geometry_msgs::TransformStamped tf; */
     };
 
+    typedef pose_core::InputQueue<InputData> CameraInputQueue;
+
     struct ImagePointIdentified{
       int ID;
       cv::Point2i position;
@@ -234,156 +243,6 @@ namespace uvdar {
       std::vector<ImagePointIdentified> points;
     };
 
-    enum HypothesisFlag { neutral, unfit, verified };
-    class Hypothesis {
-      public:
-      int index;
-      Pose pose;
-      Twist twist;
-      HypothesisFlag flag;
-      ros::Time observed;
-      ros::Time propagated;
-      int unique_id;
-
-      Hypothesis() {
-        unique_id = rand(); //not perfectly unique, this is only for debugging
-        /* ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: Creating hypothesis with ID "<< unique_id << " at " << ros::Time::now()); */
-      }
-
-      void setPose(geometry_msgs::Pose inp){
-        pose.position = e::Vector3d(
-            inp.position.x,
-            inp.position.y,
-            inp.position.z
-            );
-        pose.orientation = e::Quaterniond(
-            inp.orientation.w,
-            inp.orientation.x,
-            inp.orientation.y,
-            inp.orientation.z
-            );
-        }
-
-      geometry_msgs::Pose getPose(){
-          geometry_msgs::Pose output;
-          output.position.x = pose.position.x();
-          output.position.y = pose.position.y();
-          output.position.z = pose.position.z();
-          
-          output.orientation.w = pose.orientation.w();
-          output.orientation.x = pose.orientation.x();
-          output.orientation.y = pose.orientation.y();
-          output.orientation.z = pose.orientation.z();
-
-          return output;
-        }
-
-      std::string flagString(){
-        switch (flag){
-          case verified: return "verified";
-          case neutral: return "neutral";
-          default: return "unfit";
-        }
-      }
-
-    };
-
-    class AssociatedHypotheses {
-      public:
-        std::list<Hypothesis> hypotheses;
-        int target;
-        int verified_count = 0;
-
-        bool debug;
-
-        AssociatedHypotheses(const std::vector<Hypothesis> &hs, int target_i, bool debug_i){
-          debug = debug_i;
-          /* hypotheses = hs; */
-          std::copy(hs.begin(), hs.end(), std::back_inserter(hypotheses));
-          target = target_i;
-          for (auto &h :hypotheses){
-            if (h.flag == verified){
-              verified_count++;
-            }
-          }
-        }
-
-        std::list<Hypothesis>::iterator at(int index){
-          std::list<Hypothesis>::iterator it = hypotheses.begin();
-          std::advance(it, index);
-          return it;
-        }
-
-        std::vector<Hypothesis> getVerified(){
-          std::vector<Hypothesis> output;
-          for (auto &h : hypotheses){
-            if (h.flag == verified){
-              output.push_back(h);
-            }
-          }
-          return output;
-
-        }
-
-        std::list<Hypothesis>::iterator removeHypothesis(std::list<Hypothesis>::iterator it){
-          int hypothesis_count = (int)(hypotheses.size());
-          Hypothesis hypo_value = (*it);
-          if (debug)
-                ROS_INFO_STREAM("[UVDARPoseCalculator]: Removing hypothesis: " << hypo_value.unique_id << ": " << hypo_value.pose.position.transpose() <<", status: " << hypo_value.flagString());
-          if (hypothesis_count == 0){
-            ROS_ERROR_STREAM("[UVDARPoseCalculator]: Cannot remove, no hypotheses available");
-            return it;
-          }
-
-          if (hypo_value.flag == verified){
-            verified_count --;
-          }
-
-
-          return hypotheses.erase(it);
-
-        }
-
-        void removeUnfit(){
-          hypotheses.remove_if([](Hypothesis h){return h.flag == unfit;});
-        }
-
-        void addHypothesis(const Hypothesis &h){
-          hypotheses.push_back(h);
-          if (h.flag == verified){
-            verified_count++;
-          }
-        }
-
-        void addHypotheses(const std::vector<Hypothesis> &hs){
-          for (auto &h :hs){
-            if (h.flag == verified){
-              verified_count++;
-            }
-          }
-
-          hypotheses.insert(hypotheses.end(), hs.begin(), hs.end());
-        }
-
-        void setVerified(std::list<Hypothesis>::iterator it){
-          if ((*it).flag != verified)
-            verified_count++;
-          (*it).flag = verified;
-        }
-
-        void setUnfit(std::list<Hypothesis>::iterator it){
-          if ((*it).flag == verified)
-            verified_count--;
-          (*it).flag = unfit;
-        }
-
-        void setNeutral(std::list<Hypothesis>::iterator it){
-          if ((*it).flag == verified)
-            verified_count--;
-          (*it).flag = neutral;
-        }
-    };
-
     class LEDModel {
       private:
       std::vector<LEDMarker> markers;
@@ -434,6 +293,17 @@ namespace uvdar {
         return output;
       }
 
+      /**
+       * @brief Returns the indices of the markers of each group of co-located LEDs. The members of a group share a position, but may each carry a different signal
+       */
+      const std::vector<std::vector<int>> &getGroups() const {
+        return groups;
+      }
+
+      const LEDMarker &getMarker(int index) const {
+        return markers.at(index);
+      }
+
       LEDModel rotate(e::Vector3d center, e::AngleAxisd aa) const {
         LEDModel output = *this;
         for (auto &marker : output.markers){
@@ -491,54 +361,23 @@ namespace uvdar {
         return output;
       }
 
-      std::pair<double,double> getMaxMinVisibleDiameter(){
-        if ((int)(groups.size()) == 0){
-          return {-1,-1};
-        }
-
-        if ((int)(groups.size()) == 1){
-          return {std::numeric_limits<double>::max(), 0};
-        }
-
-        double max_dist = 0;
-        double min_dist = std::numeric_limits<double>::max();
-        for (int i=0; i<((int)(groups.size())-1); i++){
-          for (int j=i+1; j<(int)(groups.size()); j++){
-            if (areSimultaneouslyVisible(markers[groups[i][0]],markers[groups[j][0]])){
-              double tent_dist = (markers[groups[i][0]].pose.position - markers[groups[j][0]].pose.position).norm();
-              /* ROS_ERROR_STREAM("[UVDARPoseCalculator]: visible dist: " << tent_dist); */
-              if (tent_dist > max_dist){
-                max_dist = tent_dist;
-              }
-              if (tent_dist < min_dist){
-                min_dist = tent_dist;
-              }
-            }
-          }
+      double getBoundingRadius() const {
+        double output = 0;
+        for (auto &marker : markers){
+          output = std::max(output, marker.pose.position.norm());
         }
-        /* if (max_dist < 0.0001){ */
-        /*   ROS_ERROR_STREAM("[UVDARPoseCalculator]: Greatest visible diameter of the model evaluated as ZERO!"); */
-        /* } */
-        /* if (min_dist < 0.0001){ */
-        /*   ROS_ERROR_STREAM("[UVDARPoseCalculator]: Smallest visible diameter of the model evaluated as ZERO!"); */
-        /* } */
-        return {max_dist,min_dist};
+        return output;
       }
 
-      bool areSimultaneouslyVisible(LEDMarker a, LEDMarker b){
-        if ((a.type == 0) && (b.type == 0)){
-          double angle_between = a.pose.orientation.angularDistance(b.pose.orientation);
-          if (angle_between < DIRECTIONAL_LED_VIEW_ANGLE){
-            return true;
-          }
-          else{
-            return false;
-          }
-        }
-        else{
-          ROS_ERROR_STREAM("[UVDARPoseCalculator]: Non-directional markers not yet implemented!");
-          return false;
+      /**
+       * @brief Retrieves the largest and the smallest distance between LED groups that can be seen at the same time, see pose_core::visibleDiameters
+       */
+      std::pair<double,double> getMaxMinVisibleDiameter() const {
+        std::vector<pose_core::Marker> core_markers;
+        for (auto &marker : markers){
+          core_markers.push_back({.pose = marker.pose, .type = marker.type, .signal = marker.signal_id});
         }
+        return pose_core::visibleDiameters(core_markers, groups);
       }
 
       int maxSignalID(){
@@ -597,62 +436,23 @@ namespace uvdar {
 
       bool parseModelFile(std::string model_file){
             ROS_INFO_STREAM("[UVDARPoseCalculator]: Loading model from file: [ " + model_file + " ]");
-        std::ifstream ifs;
-        ifs.open(model_file);
-        std::string word;
-        std::string line;
-
-        LEDMarker curr_lm;
-
-        if (ifs.good()) {
-          while (getline( ifs, line )){
-            if (line[0] == '#'){
-              continue;
-            }
-            std::stringstream iss(line); 
-            double X, Y, Z;
-            iss >> X;
-            iss >> Y;
-            iss >> Z;
-            curr_lm.pose.position = e::Vector3d(X,Y,Z);
-            int type;
-            iss >> type;
-            curr_lm.type = type;
-            double pitch, yaw;
-            iss >> pitch;
-            iss >> yaw;
-            tf::Quaternion qtemp;
-            qtemp.setRPY(0, pitch, yaw);
-            curr_lm.pose.orientation.x() = qtemp.x();
-            curr_lm.pose.orientation.y() = qtemp.y();
-            curr_lm.pose.orientation.z() = qtemp.z();
-            curr_lm.pose.orientation.w() = qtemp.w();
-            int signal_id;
-            iss >> signal_id;
-            curr_lm.signal_id = signal_id;
-
-            markers.push_back(curr_lm);
-            ROS_INFO_STREAM("[UVDARPoseCalculator]: Loaded Model: [ X: " << X <<" Y: "  << Y << " Z: "  << Z << " type: " << type << " pitch: " << pitch << " yaw: " << yaw << " signal_id: " << signal_id << " ]");
-          }
-        ifs.close();
-        }
-        else {
+        auto loaded = pose_core::loadModel(model_file);
+        if (!loaded){
           ROS_ERROR_STREAM("[UVDARPoseCalculator]: Failed to load model file " << model_file << "! Returning.");
-        ifs.close();
           return false;
         }
+        for (auto &marker : loaded.value()){
+          LEDMarker curr_lm;
+          curr_lm.pose = marker.pose;
+          curr_lm.type = marker.type;
+          curr_lm.signal_id = marker.signal;
+          markers.push_back(curr_lm);
+          ROS_INFO_STREAM("[UVDARPoseCalculator]: Loaded Model: [ X: " << marker.pose.position.x() <<" Y: "  << marker.pose.position.y() << " Z: "  << marker.pose.position.z() << " type: " << marker.type << " signal_id: " << marker.signal << " ]");
+        }
         return true;
       }
     };
 
-    struct ReprojectionContext {
-      int target;
-      std::vector<ImagePointIdentified> observed_points;
-      int image_index;
-      geometry_msgs::TransformStamped tocam_tf;
-      LEDModel model;
-    };
-
     public:
 
       /**
@@ -671,6 +471,18 @@ namespace uvdar {
         param_loader.loadParam("debug", _debug_, bool(false));
         param_loader.loadParam("profiling", _profiling_, bool(false));
 
+        std::string replay_file;
+        param_loader.loadParam("pose_core_replay_file", replay_file, std::string(""));
+        if (!replay_file.empty()){
+          replay_file_.open(replay_file, std::ios::app);
+          if (!replay_file_.good()){
+            ROS_ERROR_STREAM("[UVDARPoseCalculator]: Failed to open the replay file " << replay_file << ", the observations will not be recorded.");
+          }
+          else {
+            ROS_INFO_STREAM("[UVDARPoseCalculator]: Recording the observations used for initialization to " << replay_file << ", to be replayed by uvdar_pose_core_replay.");
+          }
+        }
+
         if (_profiling_){
           profiler_main_.start();
           profiler_thread_.start();
@@ -680,10 +492,17 @@ namespace uvdar {
           profiler_thread_.stop();
         }
 
+        param_loader.loadParam("trace_file", _trace_file_, std::string(""));
+        if (!_trace_file_.empty()){
+          trace::enable(true);
+        }
+        diagnostics_ = std::make_unique<diagnostics::Publisher>(nh, "pose_calculator");
+
         param_loader.loadParam("gui", _gui_, bool(false));
         param_loader.loadParam("publish_visualization", _publish_visualization_, bool(false));
 
         param_loader.loadParam("publish_constituents", _publish_constituents_, bool(false));
+        param_loader.loadParam("constituents_period", _constituents_period_, double(0.0));
 
         param_loader.loadParam("quadrotor",_quadrotor_,bool(false));
 
@@ -697,6 +516,27 @@ namespace uvdar {
 
         param_loader.loadParam("output_frame", _output_frame_, std::string("local_origin"));
 
+        param_loader.loadParam("p3p_initialization", _p3p_initialization_, bool(true));
+        param_loader.loadParam("lm_refinement", _lm_refinement_, bool(true));
+        param_loader.loadParam("adaptive_hypothesis_count", _adaptive_hypothesis_count_, bool(true));
+        param_loader.loadParam("weighted_resampling", _weighted_resampling_, bool(true));
+        param_loader.loadParam("selective_initialization", _selective_initialization_, bool(true));
+        param_loader.loadParam("reinitialization_period", _reinitialization_period_, double(DEFAULT_REINITIALIZATION_PERIOD));
+
+        std::string filtering_queue_policy;
+        param_loader.loadParam("filtering_queue_policy", filtering_queue_policy, std::string("latest"));
+        if (filtering_queue_policy == "all"){
+          _filtering_process_all_ = true;
+        }
+        else {
+          if (filtering_queue_policy != "latest"){
+            ROS_WARN_STREAM("[UVDARPoseCalculator]: Unknown filtering queue policy \"" << filtering_queue_policy << "\", using \"latest\".");
+          }
+          _filtering_process_all_ = false;
+        }
+        param_loader.loadParam("filtering_queue_size", _filtering_queue_size_, int(DEFAULT_FILTERING_QUEUE_SIZE));
+        _filtering_queue_size_ = std::max(1, _filtering_queue_size_);
+
         prepareModel();
 
 
@@ -706,6 +546,7 @@ namespace uvdar {
           ROS_WARN("[UVDARPoseCalculator]: No signal IDs were supplied, using the default sequence set.");
           _signal_ids_ = {0, 1, 2, 3, 4, 5, 6, 7, 8};
         }
+        prepareTargetMarkers();
 
         //}
 
@@ -714,6 +555,7 @@ namespace uvdar {
         /* Subscribe to blinking point topics and advertise poses//{ */
         std::vector<std::string> _blinkers_seen_topics;
         param_loader.loadParam("blinkers_seen_topics", _blinkers_seen_topics, _blinkers_seen_topics);
+        param_loader.loadParam("packed_input", _packed_input_, bool(false));
         if (_blinkers_seen_topics.empty()) {
           ROS_WARN("[UVDARPoseCalculator]: No topics of blinkers were supplied");
         }
@@ -726,13 +568,27 @@ namespace uvdar {
           input_data_initialized.push_back(false);
           InputData id;
           latest_input_data_.push_back(id);
+          input_queues_.push_back(std::make_unique<CameraInputQueue>());
 
           blinkers_seen_callback_t callback = [image_index=i,this] (const uvdar_core::ImagePointsWithFloatStampedConstPtr& pointsMessage) { 
             ProcessPoints(pointsMessage, image_index);
           };
-          ROS_INFO_STREAM("[UVDARPoseCalculator]: Subscribing to " << _blinkers_seen_topics[i]);
-          sub_blinkers_seen_.push_back(
-              nh.subscribe(_blinkers_seen_topics[i], 1, callback));
+          if (_packed_input_){
+            packed_blinkers_seen_callback_t packed_callback = [callback] (const uvdar_core::ImagePointsPackedStampedConstPtr& pointsMessage) { 
+              callback(packed_points::unpack(*pointsMessage));
+            };
+            ROS_INFO_STREAM("[UVDARPoseCalculator]: Subscribing to " << _blinkers_seen_topics[i] << PACKED_POINTS_SUFFIX);
+            sub_blinkers_seen_.push_back(
+                nh.subscribe(_blinkers_seen_topics[i] + PACKED_POINTS_SUFFIX, 1, packed_callback));
+          }
+          else {
+            ROS_INFO_STREAM("[UVDARPoseCalculator]: Subscribing to " << _blinkers_seen_topics[i]);
+            sub_blinkers_seen_.push_back(
+                nh.subscribe(_blinkers_seen_topics[i], 1, callback));
+          }
+          latency_matchers_.push_back(std::make_unique<trace::LatencyMatcher>());
+          sub_blinkers_latency_.push_back(
+              nh.subscribe(_blinkers_seen_topics[i] + LATENCY_SUFFIX, 5, &trace::LatencyMatcher::add, latency_matchers_.back().get()));
 
           ROS_INFO_STREAM("[UVDARPoseCalculator]: Advertising measured poses " << i+1);
 
@@ -741,8 +597,8 @@ namespace uvdar {
             /* if (PUBLISH_HYPO_CONSTITUENTS){ */
             /*   pub_constituent_hypo_poses_.push_back(nh.advertise<mrs_msgs::PoseWithCovarianceArrayStamped>("constituentHypoPoses"+std::to_string(i+1), 1)); */ 
             /* } */
-              pub_hypotheses_ = nh.advertise<mrs_msgs::PoseWithCovarianceArrayStamped>("constituentHypotheses", 1); 
-              pub_hypotheses_tentative_ = nh.advertise<mrs_msgs::PoseWithCovarianceArrayStamped>("constituentHypothesesTentative", 1); 
+              pub_hypotheses_ = {nh.advertise<mrs_msgs::PoseWithCovarianceArrayStamped>("constituentHypotheses", 1), _constituents_period_};
+              pub_hypotheses_tentative_ = {nh.advertise<mrs_msgs::PoseWithCovarianceArrayStamped>("constituentHypothesesTentative", 1), _constituents_period_};
           }
 
           camera_image_sizes_.push_back(cv::Size(-1,-1));
@@ -752,6 +608,7 @@ namespace uvdar {
         //}
         
         pub_measured_poses_ = nh.advertise<mrs_msgs::PoseWithCovarianceArrayStamped>("measuredPoses", 1); 
+        pub_measured_poses_latency_ = nh.advertise<uvdar_core::LatencyTrailer>(std::string("measuredPoses") + LATENCY_SUFFIX, 1); 
 
         /* Load calibration files //{ */
         param_loader.loadParam("calib_files", _calib_files_, _calib_files_);
@@ -825,7 +682,7 @@ namespace uvdar {
 
         if (_gui_ || _publish_visualization_){
           if (_publish_visualization_){
-            pub_visualization_ = std::make_unique<mrs_lib::ImagePublisher>(boost::make_shared<ros::NodeHandle>(nh));
+            pub_visualization_ = {image_transport::ImageTransport(nh).advertise("ocv_point_separation", 1), 0.01};
           }
           timer_visualization_ = nh.createTimer(ros::Rate(1), &UVDARPoseCalculator::VisualizationThread, this, false);
         }
@@ -845,14 +702,38 @@ namespace uvdar {
         initializer_thread_ = std::make_unique<mrs_lib::ThreadTimer>(nh, ir, &UVDARPoseCalculator::InitializationThread, this, false, true);
         timer_particle_filter_ = nh.createTimer(ros::Rate(1.0/SCATTER_TIME_STEP), &UVDARPoseCalculator::ParticleScatteringThread, this, false); //Thread that filters and propagates hypotheses from prior estimates
 
-        ros::Duration idt(0);
-        particle_filtering_thread_ = std::make_unique<mrs_lib::ThreadTimer>(nh, idt, &UVDARPoseCalculator::InitializationThread, this, true, false); //the thread callback will change upon use.
-
         initialized_ = true;
+        for (unsigned int image_index = 0; image_index < _camera_count_; image_index++){
+          particle_filtering_workers_.emplace_back(&UVDARPoseCalculator::ParticleFilteringWorker, this, image_index); //Threads that filter hypotheses with new observations, one per camera
+        }
 
       }
       //}
 
+      /**
+       * @brief Destructor - stops the particle filtering workers
+       */
+      /* Destructor //{ */
+      ~UVDARPoseCalculator(){
+        for (auto &queue : input_queues_){
+          queue->stop();
+        }
+        for (auto &worker : particle_filtering_workers_){
+          if (worker.joinable()){
+            worker.join();
+          }
+        }
+        if (!_trace_file_.empty()){
+          if (trace::writeChromeTrace(_trace_file_)){
+            ROS_INFO_STREAM("[UVDARPoseCalculator]: Trace written to " << _trace_file_);
+          }
+          else {
+            ROS_ERROR_STREAM("[UVDARPoseCalculator]: Could not write the trace to " << _trace_file_);
+          }
+        }
+      }
+      //}
+
     private:
 
       /**
@@ -918,6 +799,7 @@ namespace uvdar {
           }
 
           ROS_INFO_STREAM("[UVDARPoseCalculator]: Camera resolution  is: " << _oc_models_.at(i).width << "x" << _oc_models_.at(i).height);
+          cameras_.emplace_back(_oc_models_.at(i));
 
           /* auto center_dir = directionFromCamPoint(cv::Point3d(_oc_models_[i].yc,_oc_models_[i].xc,0),i); */
           auto center_dir = directionFromCamPoint(cv::Point2d(_oc_models_.at(i).width/2,_oc_models_.at(i).height/2),i);
@@ -938,6 +820,10 @@ namespace uvdar {
 
           _center_fix_.push_back(e::Quaterniond(e::AngleAxisd(-x_ang*0.5, e::Vector3d(0,-1,0))*e::AngleAxisd(-y_ang*0.5, e::Vector3d(1,0,0))));
 
+          double max_view_angle = cameras_.at(i).maxViewAngle();
+          reprojections_.emplace_back(cameras_.at(i), led_projection_coefs_, VIEW_ANGLE_MARGIN);
+          ROS_INFO_STREAM("[UVDARPoseCalculator]: Maximum view angle from the optical axis: " << rad2deg(max_view_angle));
+
           i++;
         }
         return true;
@@ -974,6 +860,26 @@ namespace uvdar {
       }
       //}
 
+      /**
+       * @brief Prepares the model of each target for the pose core, with the local signal IDs of the markers replaced by the signals of that target
+       */
+      /* prepareTargetMarkers //{ */
+      void prepareTargetMarkers(){
+        target_markers_.clear();
+        for (int t = 0; (t+1)*signals_per_target_ <= (int)(_signal_ids_.size()); t++){
+          std::vector<pose_core::Marker> markers;
+          for (auto &led_marker : model_){
+            pose_core::Marker marker;
+            marker.pose = led_marker.pose;
+            marker.type = led_marker.type;
+            marker.signal = _signal_ids_.at((t*signals_per_target_)+led_marker.signal_id);
+            markers.push_back(marker);
+          }
+          target_markers_.push_back(markers);
+        }
+      }
+      //}
+
 
 
       /**
@@ -984,6 +890,7 @@ namespace uvdar {
        */
       /* ProcessPoints //{ */
       void ProcessPoints(const uvdar_core::ImagePointsWithFloatStampedConstPtr& msg, size_t image_index) {
+        UVDAR_TRACE_SCOPE("pose: points received");
         if (!initialized_){
           ROS_ERROR_STREAM("[UVDARPoseCalculator]: Uninitialized! Ignoring image points.");
           return;
@@ -993,6 +900,11 @@ namespace uvdar {
           std::scoped_lock lock(input_mutex);
           latest_input_data_[image_index].time = msg->stamp;
           latest_input_data_[image_index].points = msg->points;
+          latest_input_data_[image_index].latency = latency_matchers_[image_index]->take(msg->stamp);
+        }
+        auto unmatched_latency = latency_matchers_[image_index]->unmatched();
+        if (unmatched_latency > 0){
+          diagnostics_->count("latency trailers unmatched", unmatched_latency);
         }
         camera_image_sizes_[image_index].width = msg->image_width;
         camera_image_sizes_[image_index].height = msg->image_height;
@@ -1031,13 +943,13 @@ namespace uvdar {
 
         /* ROS_INFO_STREAM("[UVDARPoseCalculator]:PP: C, " << image_index); */
 
-        {
-          std::scoped_lock lock(threadconfig_mutex);
-          /* ROS_INFO_STREAM("[UVDARPoseCalculator]:PP: D, " << image_index); */
-          particle_filtering_thread_->setCallback(boost::bind(&UVDARPoseCalculator::ParticleFilteringThread, this, _1, image_index));
-          /* ROS_INFO_STREAM("[UVDARPoseCalculator]:PP: E, " << image_index); */
-          particle_filtering_thread_->start();
+        size_t queue_size = (_filtering_process_all_?(size_t)(_filtering_queue_size_):1);
+        auto [dropped, depth] = input_queues_[image_index]->push({msg->points, msg->stamp}, queue_size);
+        diagnostics_->count("inputs received");
+        if (dropped > 0){
+          diagnostics_->count("inputs dropped", dropped);
         }
+        diagnostics_->gauge("queue depth", (double)(depth));
 
 
       }
@@ -1053,6 +965,7 @@ namespace uvdar {
          */
         /* InitializationThread() //{ */
         void InitializationThread([[maybe_unused]] const ros::TimerEvent& evt) {
+          UVDAR_TRACE_SCOPE("pose: initialization");
           /* ROS_INFO("[UVDARPoseCalculator]:IN: A"); */
           if (!ros::ok())
             return;
@@ -1192,20 +1105,22 @@ namespace uvdar {
                 for (auto pt : separated_points[i].points)
                   ROS_INFO_STREAM("[UVDARPoseCalculator]:    " << pt.position << ", ID: " << pt.ID);
               }
+              if (_selective_initialization_ && isTargetTracked(separated_points[i], image_index, latest_local.time)){
+                if (_debug_)
+                  ROS_INFO_STREAM("[UVDARPoseCalculator]: Target " << (separated_points[i].ID%1000) << " is already tracked in camera " << image_index << ", skipping initialization.");
+                initializations_skipped_++;
+                diagnostics_->count("initializations skipped");
+                continue;
+              }
+              initializations_performed_++;
+              diagnostics_->count("initializations performed");
+
               mrs_msgs::PoseWithCovarianceIdentified pose;
               /* std::vector<mrs_msgs::PoseWithCovarianceIdentified> constituents; */
               std::vector<Hypothesis> new_hypotheses;
               /* bool res = extractSingleRelative(separated_points[i].second, separated_points[i].first, image_index, pose, constituents, new_hypotheses); */
               /* ROS_INFO("[%s]: C:%d - Image clusters: %d", ros::this_node::getName().c_str(), image_index, (int)(separated_points.size())); */
               new_hypotheses = extractHypotheses(separated_points[i].points, separated_points[i].ID, image_index, fromcam_tf, tocam_tf, profiler_thread_, latest_local.time);
-
-              //TODO: consider doing multiple for each hypothesis
-              double velocity_max_step = MAX_INITIAL_VELOCITY;
-              for (auto &h : new_hypotheses){
-                double vd = static_cast <double> (rand()) / static_cast <double> (RAND_MAX);//scaler form 0 to 1
-                e::Vector3d initial_velocity = (e::Vector3d::Random().normalized())*vd*velocity_max_step;
-                h.twist.linear = initial_velocity;
-              }
               /* ROS_INFO("[%s]: C:%d - New hypothesis count: %d", ros::this_node::getName().c_str(), image_index, (int)(new_hypotheses.size())); */
 
               /* if (res){ */
@@ -1237,31 +1152,35 @@ namespace uvdar {
 
               /* HypothesesToGlobal(new_hypotheses, image_index,latest_local.time); */
               {
-                std::scoped_lock lock(hypothesis_mutex);
-                int index = 0;
-                bool found = false;
-                for (auto &hb : hypothesis_buffer_){
-                  if (hb.target == (separated_points[i].ID%1000)){
-                    found = true;
-                    break;
+                std::shared_ptr<AssociatedHypotheses> target_hypotheses;
+                {
+                  std::unique_lock lock(hypothesis_buffer_mutex_);
+                  for (auto &hb : hypothesis_buffer_){
+                    if (hb->target == (separated_points[i].ID%1000)){
+                      target_hypotheses = hb;
+                      break;
+                    }
                   }
-                  index++;
-                }
 
-                if (!found){
-                  /* hypothesis_buffer_.push_back({.hypotheses = new_hypotheses,.target = (separated_points[i].ID%1000),.verified_count = 0}); */
-                  hypothesis_buffer_.push_back(AssociatedHypotheses(new_hypotheses, (separated_points[i].ID%1000), _debug_));
+                  if (!target_hypotheses){
+                    /* hypothesis_buffer_.push_back({.hypotheses = new_hypotheses,.target = (separated_points[i].ID%1000),.verified_count = 0}); */
+                    hypothesis_buffer_.push_back(std::make_shared<AssociatedHypotheses>(new_hypotheses, (separated_points[i].ID%1000)));
+                    hypothesis_buffer_.back()->last_initialization = latest_local.time.toSec();
+                  }
                 }
-                else{
+
+                if (target_hypotheses){
 
                   /* removeExtraHypotheses(index, latest_local.time); */
                   /* if (_debug_) */
                   /*   ROS_INFO("[%s]: Culling. Curr hypothesis count: %d", ros::this_node::getName().c_str(), (int)(hypothesis_buffer_.at(index).hypotheses.size())); */
                   /* hypothesis_buffer_.at(index).hypotheses.insert(hypothesis_buffer_.at(index).hypotheses.end(), new_hypotheses.begin(), new_hypotheses.end()); */
-                  hypothesis_buffer_.at(index).addHypotheses(new_hypotheses);
+                  std::scoped_lock lock(target_hypotheses->mutex);
+                  target_hypotheses->addHypotheses(new_hypotheses);
+                  target_hypotheses->last_initialization = latest_local.time.toSec();
                   /* hypothesis_buffer_.at(index).verified_count+=(int)(new_hypotheses.size()); */
                   if (_debug_)
-                    ROS_INFO("[%s]: Inserting new. Curr hypothesis count: %d", ros::this_node::getName().c_str(), (int)(hypothesis_buffer_.at(index).hypotheses.size()));
+                    ROS_INFO("[%s]: Inserting new. Curr hypothesis count: %d", ros::this_node::getName().c_str(), (int)(target_hypotheses->hypotheses.size()));
                 }
 
               }
@@ -1281,10 +1200,15 @@ namespace uvdar {
         }
         if (_debug_){
           ROS_INFO("[%s]: Hypothesis count: ", ros::this_node::getName().c_str());
-          for (auto &hb : hypothesis_buffer_){
-            ROS_INFO("[%s]:     target: %d: %d", ros::this_node::getName().c_str(), hb.target,(int)(hb.hypotheses.size()));
+          for (auto &hb : getTargetHypotheses()){
+            std::scoped_lock lock(hb->mutex);
+            ROS_INFO("[%s]:     target: %d: %d", ros::this_node::getName().c_str(), hb->target,(int)(hb->hypotheses.size()));
           }
         }
+        if (_profiling_ && ((initializations_performed_+initializations_skipped_) > 0)){
+          ROS_INFO_STREAM("[UVDARPoseCalculator]: [IN]: Target initializations performed: " << initializations_performed_ << ", skipped as already tracked: " << initializations_skipped_);
+          initializations_performed_ = initializations_skipped_ = 0;
+        }
         batch_processsed_ = true;
 
         /* r.sleep(); */
@@ -1301,29 +1225,40 @@ namespace uvdar {
          */
         /* ParticleScatteringThread() //{ */
         void ParticleScatteringThread([[maybe_unused]] const ros::TimerEvent& te) {
+          UVDAR_TRACE_SCOPE("pose: scattering");
           if ((!initialized_)){
             return;
           }
           /* ROS_INFO("[UVDARPoseCalculator]:PF: A"); */
 
           auto now_time = ros::Time::now();
+          auto target_hypotheses = getTargetHypotheses();
+          if (diagnostics_->active()){
+            size_t hypothesis_count = 0;
+            for (auto &hb : target_hypotheses){
+              std::scoped_lock lock(hb->mutex);
+              hypothesis_count += hb->hypotheses.size();
+            }
+            diagnostics_->gauge("targets", (double)(target_hypotheses.size()));
+            diagnostics_->gauge("hypotheses", (double)(hypothesis_count));
+          }
           if (true){
             /* if (false){ */
-            std::scoped_lock lock(hypothesis_mutex);
-            for (int index = 0; index < (int)(hypothesis_buffer_.size()); index++){
-              int verified_count = hypothesis_buffer_.at(index).verified_count;
+            for (auto &hb : target_hypotheses){
+              std::scoped_lock lock(hb->mutex);
+              int verified_count = hb->verified_count;
               if (_debug_)
-                ROS_INFO("[%s]: Prev. hypothesis count: %d, of which verified: %d", ros::this_node::getName().c_str(), (int)(hypothesis_buffer_.at(index).hypotheses.size()), verified_count);
+                ROS_INFO("[%s]: Prev. hypothesis count: %d, of which verified: %d", ros::this_node::getName().c_str(), (int)(hb->hypotheses.size()), verified_count);
               profiler_main_.indent();
               /* auto mutations = mutateHypotheses(hypothesis_buffer_.at(index).hypotheses, std::min(std::max(0,MAX_HYPOTHESIS_COUNT - (int)(hypothesis_buffer_.at(index).hypotheses.size())),verified_count), now_time); */
-              auto mutations = mutateHypotheses(hypothesis_buffer_.at(index), hypothesis_buffer_.at(index).hypotheses.size()/2, now_time);
+              auto mutations = pose_core::mutateHypotheses(*hb, hb->hypotheses.size()/2);
               /* auto mutations = mutateHypotheses(hypothesis_buffer_.at(index).hypotheses, MUTATION_COUNT); */
               if (_debug_)
                 ROS_INFO("[%s]: Made: %d mutations", ros::this_node::getName().c_str(), (int)(mutations.size()));
               profiler_main_.unindent();
-              hypothesis_buffer_.at(index).addHypotheses(mutations);
+              hb->addHypotheses(mutations);
               if (_debug_)
-                ROS_INFO("[%s]: Adding mutations to set. Curr hypothesis count: %d", ros::this_node::getName().c_str(), (int)(hypothesis_buffer_.at(index).hypotheses.size()));
+                ROS_INFO("[%s]: Adding mutations to set. Curr hypothesis count: %d", ros::this_node::getName().c_str(), (int)(hb->hypotheses.size()));
             }
 
             /* ROS_INFO("[UVDARPoseCalculator]:PF: B"); */
@@ -1359,11 +1294,12 @@ namespace uvdar {
               /* ROS_INFO("[UVDARPoseCalculator]:PF: F"); */
             }
               auto start = profiler_main_.getTime();
-              for (int index = 0; index < (int)(hypothesis_buffer_.size()); index++){
+              for (auto &hb : target_hypotheses){
+                std::scoped_lock lock(hb->mutex);
                 /* removeOldHypotheses(index,now_time); */
-                removeExtraHypotheses(index, now_time, profiler_main_);
+                pose_core::removeExtraHypotheses(*hb, now_time.toSec(), _adaptive_hypothesis_count_, _weighted_resampling_);
                 if (_debug_)
-                  ROS_INFO("[%s]: Culling. Curr hypothesis count: %d", ros::this_node::getName().c_str(), (int)(hypothesis_buffer_.at(index).hypotheses.size()));
+                  ROS_INFO("[%s]: Culling. Curr hypothesis count: %d", ros::this_node::getName().c_str(), (int)(hb->hypotheses.size()));
                 /* propagateHypotheses(index, now_time); */
               }
               profiler_main_.addValueSince("Extra hypothesis removal", start);
@@ -1377,8 +1313,9 @@ namespace uvdar {
               /*   if (_debug_) */
               /*     ROS_INFO("[%s]: Culling. Curr hypothesis count: %d", ros::this_node::getName().c_str(), (int)(hypothesis_buffer_.at(index).hypotheses.size())); */
               /* } */
-            std::scoped_lock lock(hypothesis_mutex);
-            if (_publish_constituents_){
+            bool constituents_wanted = _publish_constituents_ && pub_hypotheses_.wanted();
+            bool constituents_tentative_wanted = _publish_constituents_ && pub_hypotheses_tentative_.wanted();
+            if (constituents_wanted || constituents_tentative_wanted){
               auto start_pub_const = profiler_main_.getTime();
 
               mrs_msgs::PoseWithCovarianceArrayStamped msg_constuents_array;
@@ -1389,10 +1326,11 @@ namespace uvdar {
               msg_constuents_tentative_array.header.frame_id = _uav_name_+"/"+_output_frame_;
               msg_constuents_tentative_array.header.stamp = latest_input_data_[0].time;
 
-              for (auto &hb : hypothesis_buffer_){
+              for (auto &hb : target_hypotheses){
+                std::scoped_lock lock(hb->mutex);
                 if (_debug_)
-                  ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: Current hypothesis count for target " << hb.target << " is " << hb.hypotheses.size());
-                for (auto &h : hb.hypotheses){
+                  ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: Current hypothesis count for target " << hb->target << " is " << hb->hypotheses.size());
+                for (auto &h : hb->hypotheses){
                   /* ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: Age: " << (now_time - h.updated).toSec()); */
 
                   mrs_msgs::PoseWithCovarianceIdentified constituent;
@@ -1405,35 +1343,43 @@ namespace uvdar {
                   constituent.pose.orientation.z = h.pose.orientation.z();
                   constituent.pose.orientation.w = h.pose.orientation.w();
 
-                  e::MatrixXd hypo_covar = e::MatrixXd::Identity(6,6)*0.01;
+                  e::Matrix6d hypo_covar = e::Matrix6d::Identity()*0.01;
                   for (int i=0; i<6; i++){
                     for (int j=0; j<6; j++){
                       constituent.covariance[6*j+i] =  hypo_covar(j,i);
                     }
                   }
-                  if (h.flag == verified)
+                  if ((h.flag == pose_core::verified) && constituents_wanted)
                     msg_constuents_array.poses.push_back(constituent);
-                  else if (h.flag == neutral)
+                  else if ((h.flag == pose_core::neutral) && constituents_tentative_wanted)
                     msg_constuents_tentative_array.poses.push_back(constituent);
                 }
               }
 
-              pub_hypotheses_.publish(msg_constuents_array);
-              pub_hypotheses_tentative_.publish(msg_constuents_tentative_array);
+              if (constituents_wanted){
+                pub_hypotheses_.publish(msg_constuents_array);
+              }
+              if (constituents_tentative_wanted){
+                pub_hypotheses_tentative_.publish(msg_constuents_tentative_array);
+              }
               profiler_main_.addValueSince("Publishing constituents", start_pub_const);
             }
 
             mrs_msgs::PoseWithCovarianceArrayStamped msg_output;
             msg_output.header.frame_id = _uav_name_+"/"+_output_frame_;
             msg_output.header.stamp = latest_input_data_[0].time;
-            for (auto &hb : hypothesis_buffer_){
+            for (auto &hb : target_hypotheses){
               mrs_msgs::PoseWithCovarianceIdentified msg_target;
               auto start_conv_hull = profiler_main_.getTime();
-              auto res = getMeasurementElipsoidHull(hb);
+              std::optional<std::pair<Pose,e::Matrix6d>> res;
+              {
+                std::scoped_lock lock(hb->mutex);
+                res = pose_core::fuseHypotheses(*hb);
+              }
               profiler_main_.addValueSince("Constructing convex hull", start_conv_hull);
               if (res){
                 auto [m, C] = res.value();
-                msg_target.id = hb.target;
+                msg_target.id = hb->target;
                 msg_target.pose.position.x = m.position.x();
                 msg_target.pose.position.y = m.position.y();
                 msg_target.pose.position.z = m.position.z();
@@ -1451,13 +1397,34 @@ namespace uvdar {
               }
             }
             pub_measured_poses_.publish(msg_output);
+
+            {
+              // only the trailer of the newest observation not yet reported is forwarded, so that each observation is counted at most once downstream
+              uvdar_core::LatencyTrailer msg_latency;
+              {
+                std::scoped_lock lock(input_mutex);
+                for (auto &input : latest_input_data_){
+                  if (input.latency.empty() || (input.latency.front().time <= last_latency_origin_)){
+                    continue;
+                  }
+                  if (msg_latency.stages.empty() || (input.latency.front().time > msg_latency.stages.front().time)){
+                    msg_latency.stages = input.latency;
+                  }
+                }
+              }
+              if (trace::stampLatency(msg_latency.stages, uvdar_core::LatencyStamp::POSE_CALCULATOR)){
+                last_latency_origin_ = msg_latency.stages.front().time;
+                msg_latency.stamp = msg_output.header.stamp;
+                pub_measured_poses_latency_.publish(msg_latency);
+              }
+            }
           }
 
           {
-            std::scoped_lock lock(hypothesis_mutex);
             auto start_hypo_propagation = profiler_main_.getTime();
-            for (int index = 0; index < (int)(hypothesis_buffer_.size()); index++){
-              propagateHypotheses(index, now_time);
+            for (auto &hb : target_hypotheses){
+              std::scoped_lock lock(hb->mutex);
+              pose_core::propagateHypotheses(*hb, now_time.toSec());
             }
               profiler_main_.addValueSince("Propagating hypotheses", start_hypo_propagation);
           }
@@ -1466,13 +1433,69 @@ namespace uvdar {
 
           if (_profiling_){
             profiler_main_.printAll("[UVDARPoseCalculator]: [PF]:");
+            unsigned long evaluations = error_evaluations_.exchange(0);
+            unsigned long frustum_rejections = error_frustum_rejections_.exchange(0);
+            unsigned long early_exits = error_early_exits_.exchange(0);
+            if (evaluations > 0){
+              ROS_INFO_STREAM("[UVDARPoseCalculator]: [PF]: Hypothesis error evaluations: " << evaluations << ", rejected by view frustum: " << 100.0*frustum_rejections/evaluations << "%, terminated early: " << 100.0*early_exits/evaluations << "%");
+            }
+            for (unsigned int image_index = 0; image_index < _camera_count_; image_index++){
+              auto queue = input_queues_[image_index]->statistics(true);
+              if (queue.received_count > 0){
+                ROS_INFO_STREAM("[UVDARPoseCalculator]: [PF]: [cam:" << image_index << "]: Input queue depth: " << queue.depth << " (max " << queue.max_depth << "), received: " << queue.received_count << ", dropped: " << queue.dropped_count << ", processed: " << queue.processed_count);
+              }
+              if (queue.processed_count > 0){
+                ROS_INFO_STREAM("[UVDARPoseCalculator]: [PF]: [cam:" << image_index << "]: Queue wait: mean " << 1000.0*queue.total_wait/queue.processed_count << " ms, max " << 1000.0*queue.max_wait << " ms; latency: mean " << 1000.0*queue.total_latency/queue.processed_count << " ms, max " << 1000.0*queue.max_latency << " ms");
+              }
+            }
           }
           profiler_main_.clear();
         }
         //}
         
 
-        void ParticleFilteringThread([[maybe_unused]] const ros::TimerEvent& te, const int& image_index) {
+        /**
+         * @brief Persistent worker of a single camera, filtering the hypotheses with the observations from the input queue of that camera as they arrive
+         *
+         * @param image_index The index of the camera served by this worker
+         */
+        /* ParticleFilteringWorker //{ */
+        void ParticleFilteringWorker(const unsigned int image_index) {
+          auto &queue = *(input_queues_[image_index]);
+          Profiler profiler; // the profiler keeps the nesting of the recorded intervals, so each thread needs its own
+          if (_profiling_){
+            profiler.start();
+          }
+          while (ros::ok()){
+            auto input = queue.pop();
+            if (!input){ // stopped
+              return;
+            }
+            auto start_filtering = std::chrono::steady_clock::now();
+            diagnostics_->gauge("queue wait [ms]", 1000.0*std::chrono::duration<double>(start_filtering - input->second).count());
+
+            ParticleFilteringThread(input->first, image_index, profiler);
+            if (_profiling_){
+              profiler.printAll("[UVDARPoseCalculator]: [PF]: [cam:"+std::to_string(image_index)+"]:");
+            }
+            profiler.clear();
+            diagnostics_->gauge("filtering time [ms]", 1000.0*std::chrono::duration<double>(std::chrono::steady_clock::now() - start_filtering).count());
+
+            queue.finished(input->second);
+          }
+        }
+        //}
+
+        /**
+         * @brief Filters the hypotheses of all targets with a single observation of a camera
+         *
+         * @param latest_local The observation to use
+         * @param image_index The index of the camera that produced the observation
+         * @param profiler The profiler of the calling worker
+         */
+        /* ParticleFilteringThread //{ */
+        void ParticleFilteringThread(const InputData &latest_local, const int image_index, Profiler &profiler) {
+          UVDAR_TRACE_SCOPE("pose: filtering");
           if ((!initialized_)){
             return;
           }
@@ -1480,16 +1503,7 @@ namespace uvdar {
 
           /* auto now_time = ros::Time::now(); */
 
-          InputData latest_local;
           geometry_msgs::TransformStamped tocam_tf;
-          {
-            std::scoped_lock lock(input_mutex);
-            if (!input_data_initialized[image_index]){
-              /* ROS_ERROR_STREAM("[UVDARPoseCalculator]:PF: Input data for camera " << image_index << " not yet intializad!"); */
-              return;
-            }
-            latest_local = latest_input_data_[image_index];
-          }
           auto separated_points = separateBySignals(latest_local.points);
 
           /* ROS_INFO_STREAM("[UVDARPoseCalculator]:PF: C, " <<  image_index); */
@@ -1504,12 +1518,13 @@ namespace uvdar {
           }
           /* ROS_INFO_STREAM("[UVDARPoseCalculator]:PF: D, " <<  image_index); */
 
-          for (int index = 0; index < (int)(hypothesis_buffer_.size()); index++){
-            {
-              std::scoped_lock lock(hypothesis_mutex);
+          // targets are processed in the order in which their locks become available, so that a target currently used by another camera or the scattering thread does not hold up the rest
+          pose_core::processTargetsAsAvailable(getTargetHypotheses(), [&](AssociatedHypotheses &target){
+              auto hb = &target;
+              int index = hb->target;
 
               if (_debug_)
-                ROS_INFO("[%s]: C:%d, I:%d Refining. Prev. hypothesis count: %d", ros::this_node::getName().c_str(), image_index, index, (int)(hypothesis_buffer_.at(index).hypotheses.size()));
+                ROS_INFO("[%s]: C:%d, I:%d Refining. Prev. hypothesis count: %d", ros::this_node::getName().c_str(), image_index, index, (int)(hb->hypotheses.size()));
 
               /* auto start = profiler.getTime(); */
               /* auto local_hypotheses = HypothesesToLocal(hypothesis_buffer_,image_index); */
@@ -1528,25 +1543,28 @@ namespace uvdar {
               /* refineHypotheses(separated_points, hypothesis_buffer_.at(index).first, hypothesis_buffer_.at(index).second, image_index, tocam_tf, profiler_main_); */
               /* profiler_main_.unindent(); */
 
-              double threshold_reproject_unfit = PF_REPROJECT_THRESHOLD_UNFIT(image_index);
-              double threshold_reproject_verified = PF_REPROJECT_THRESHOLD_VERIFIED(image_index);
-
-              profiler_main_.indent();
-              checkHypothesisFitness(hypothesis_buffer_.at(index), image_index, threshold_reproject_unfit, threshold_reproject_verified, separated_points, tocam_tf, latest_local.time);
-              profiler_main_.addValue("Hypotheses fitness checking");
-              removeUnfitHypotheses(hypothesis_buffer_.at(index));
-              profiler_main_.addValue("Removal of unfit hypotheses");
-              profiler_main_.unindent();
+              profiler.indent();
+              for (auto &cluster : separated_points){
+                if ((cluster.ID%1000) != (hb->target%1000)){
+                  continue;
+                }
+                auto fitness = pose_core::checkHypothesisFitness(*hb, reprojections_[image_index], observation(cluster.ID, tocam_tf, cluster.points, latest_local.time), image_index);
+                if (_profiling_){
+                  error_evaluations_ += fitness.evaluations;
+                  error_frustum_rejections_ += fitness.outside_view;
+                  error_early_exits_ += fitness.early_exits;
+                }
+              }
+              profiler.addValue("Hypotheses fitness checking");
+              hb->removeUnfit();
+              profiler.addValue("Removal of unfit hypotheses");
+              profiler.unindent();
               if (_debug_)
-                ROS_INFO("[%s]: C:%d, I:%d Curr. hypothesis count: %d", ros::this_node::getName().c_str(), image_index, index, (int)(hypothesis_buffer_.at(index).hypotheses.size()));
+                ROS_INFO("[%s]: C:%d, I:%d Curr. hypothesis count: %d", ros::this_node::getName().c_str(), image_index, index, (int)(hb->hypotheses.size()));
               /* ROS_INFO("[%s]: C:%d Removing extras, left: %d", ros::this_node::getName().c_str(), image_index, (int)(hypothesis_buffer_.at(index).hypotheses.size())); */
-            }
-
-            /* ROS_INFO("[UVDARPoseCalculator]:PF: E"); */
-
-
-            /* ROS_INFO("[UVDARPoseCalculator]:PF: F"); */
-          }
+              }, [&profiler](Profiler::time_point start_lock_wait){
+              profiler.addValueSince("Target lock wait", start_lock_wait);
+              });
 
           /* ROS_INFO("[UVDARPoseCalculator]:PF: Z"); */
         }
@@ -1583,284 +1601,42 @@ namespace uvdar {
           return output;
         }
         
-        void checkHypothesisFitness(AssociatedHypotheses &hypotheses, int image_index, double threshold_unfit, double threshold_verified, std::vector<ImageCluster> points, geometry_msgs::TransformStamped tocam_tf, ros::Time time){
-          /* InputData latest_local; */
-          /* { */
-          /*   std::scoped_lock lock(input_mutex); */
-          /*   latest_local = latest_input_data_[image_index]; */
-          /* } */
-          /* std::vector<ImageCluster> separated_points; */
-          /* separated_points = separateBySignals(input_data.points); */
-          ReprojectionContext rpc;
-          rpc.image_index=image_index;
-          rpc.tocam_tf=tocam_tf;
-          rpc.model=model_;
-
-          std::vector<ImagePointIdentified> associated_points;
-          /* int i=0; */
-          for (auto &pts : points){
-            if ((pts.ID%1000)==(hypotheses.target%1000)){
-              associated_points = pts.points;
-              for (auto hit = hypotheses.hypotheses.begin(); hit!=hypotheses.hypotheses.end(); hit++){
-                if (_debug_)
-                  ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: Checking hypotheis " << (*hit).unique_id);
-                if (isInView((*hit),image_index, tocam_tf)){
-                  if (_debug_)
-                    ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: Hypotheis " << (*hit).unique_id << " is in view of camera " << image_index);
 
-                  /* auto model_curr = model_.rotate(h.pose.orientation).translate(h.pose.position); */
-
-                  double threshold_scaled_unfit = (int)(associated_points.size())*threshold_unfit;
-                  double threshold_scaled_verified = (int)(associated_points.size())*threshold_verified;
-
-                  rpc.observed_points=associated_points;
-                  rpc.target=(*hit).index;
-
-                  double error_total = hypothesisError((*hit), rpc);
-                  /* ROS_INFO("[%s]: error: %f vs threshold_scaled: %f", ros::this_node::getName().c_str(), error_total, threshold_scaled); */
-
-                  if (error_total > threshold_scaled_unfit){
-                    if (_debug_)
-                      ROS_INFO_STREAM("[UVDARPoseCalculator]: setting hypo " << (*hit).unique_id << " as unfit, err:" << error_total << " vs " << threshold_scaled_unfit);
-                    /* if (h.flag == verified) */
-                    /*   hypotheses.verified_count--; */
-                    /* h.flag = unfit; */
-                    hypotheses.setUnfit(hit);
-                    /* h.updated = time; */
-                  }
-                  else if (error_total < threshold_scaled_verified) {
-                    if (_debug_)
-                      ROS_INFO_STREAM("[UVDARPoseCalculator]: setting hypo " << (*hit).unique_id << " as verified, err:" << error_total << " vs " << threshold_scaled_verified);
-                    /* if (h.flag != verified) */
-                    /*   hypotheses.verified_count++; */
-                    /* h.flag = verified; */
-                    hypotheses.setVerified(hit);
-                    (*hit).observed = time;
-                  }
-                  else {
-                    if (_debug_)
-                      ROS_INFO_STREAM("[UVDARPoseCalculator]: setting hypo " << (*hit).unique_id << " as neutral, err:" << error_total << " vs " << threshold_scaled_verified << " and " << threshold_scaled_unfit);
-                    hypotheses.setNeutral(hit);
-                  }
-                  /* h.updated = time; */
-                }
-              }
-            }
-            else
+        /**
+         * @brief Checks whether the existing hypotheses of a target already explain its current observation, see pose_core::isTargetTracked
+         *
+         * @param cluster The current observation of the target
+         * @param image_index The index of the camera that produced the observation
+         * @param time The time of the observation
+         *
+         * @return True if initialization of this target can be skipped
+         */
+        /* isTargetTracked //{ */
+        bool isTargetTracked(const ImageCluster &cluster, int image_index, ros::Time time){
+          for (auto &hb : getTargetHypotheses()){
+            if (hb->target != (cluster.ID%1000)){
               continue;
+            }
+            std::scoped_lock lock(hb->mutex);
+            return pose_core::isTargetTracked(*hb, cameras_[image_index], image_index, (int)(cluster.points.size()), time.toSec(), _reinitialization_period_);
           }
+          return false;
         }
+        //}
 
-        std::vector<Hypothesis> removeUnfitAndMutateHypotheses(AssociatedHypotheses &hypotheses){
-          removeUnfitHypotheses(hypotheses);
-          return mutateHypotheses(hypotheses, MUTATION_COUNT, ros::Time::now());
-        }
 
-        void removeUnfitHypotheses(AssociatedHypotheses &hypotheses){
-          hypotheses.removeUnfit();
+        /**
+         * @brief Retrieves a snapshot of the list of tracked targets. The list lock is held only while copying, and the hypotheses of each target have to be accessed under the mutex of that target.
+         *
+         * @return The hypothesis sets of the currently tracked targets
+         */
+        std::vector<std::shared_ptr<AssociatedHypotheses>> getTargetHypotheses(){
+          std::shared_lock lock(hypothesis_buffer_mutex_);
+          return hypothesis_buffer_;
         }
 
-        void propagateHypotheses(int index, ros::Time time){
-          for (auto &h : hypothesis_buffer_.at(index).hypotheses){
-            h.pose.position += h.twist.linear*(time-h.propagated).toSec();
-            h.propagated = time;
-          }
-        }
 
-        void removeExtraHypotheses(int index, ros::Time time, Profiler &profiler){
-          profiler.indent();
-          auto start = profiler.getTime();
-          removeOldHypotheses(index, time);
-          profiler.addValueSince("Old hypothesis removal", start);
-
-          std::vector<std::list<Hypothesis>::iterator> nonverified_hypotheses;
-          for (auto hit = hypothesis_buffer_.at(index).hypotheses.begin(); hit!=hypothesis_buffer_.at(index).hypotheses.end(); hit++){
-            if ((*hit).flag != verified){
-              nonverified_hypotheses.push_back(hit);
-            }
-          }
-          profiler.addValue("Search for unverified hypotheses");
-          while (((int)(hypothesis_buffer_.at(index).hypotheses.size()) > MAX_HYPOTHESIS_COUNT) && (nonverified_hypotheses.size() > 0) ){ //first, let's try to remove the unverified only...
-            int cull_index_selection = rand() % (int)(nonverified_hypotheses.size());
-            auto hit = nonverified_hypotheses.at(cull_index_selection);
-            if ((*hit).flag !=verified){
-              if (_debug_)
-                ROS_INFO_STREAM("[UVDARPoseCalculator]: Culling extra unverified hypothesis " << (*hit).unique_id << ".");
-              hypothesis_buffer_.at(index).removeHypothesis(hit);
-              nonverified_hypotheses.erase(nonverified_hypotheses.begin()+cull_index_selection);
-            }
-              /* hypothesis_buffer_.at(index).hypotheses.erase(hypothesis_buffer_.at(index).hypotheses.begin()+cull_index); //remove */
-          }
-          profiler.addValue("Unverified hypothesis removal");
-          while ((int)(hypothesis_buffer_.at(index).hypotheses.size()) > MAX_HYPOTHESIS_COUNT){
-            int cull_index = rand() % (int)(hypothesis_buffer_.at(index).hypotheses.size());
-            /* if (hypothesis_buffer_.at(index).hypotheses[cull_index].flag == verified) */
-              /* hypothesis_buffer_.at(index).verified_count--; */
-            /* hypothesis_buffer_.at(index).hypotheses.erase(hypothesis_buffer_.at(index).hypotheses.begin()+cull_index); //remove */
-            auto hit = hypothesis_buffer_.at(index).at(cull_index);
-              if (_debug_)
-                ROS_INFO_STREAM("[UVDARPoseCalculator]: Culling extra hypothesis " << (*hit).unique_id << ".");
-            hypothesis_buffer_.at(index).removeHypothesis(hit);
-          }
-          profiler.addValue("Remaining hypothesis removal");
-          profiler.unindent();
-          return;
-        }
-
-        void removeOldHypotheses(int index, ros::Time time){
-          for (auto hit = hypothesis_buffer_.at(index).hypotheses.begin(); hit!=hypothesis_buffer_.at(index).hypotheses.end(); hit++){
-            if (ros::Duration(time - (*hit).observed).toSec() > MAX_HYPOTHESIS_AGE){
-              /* if (hypothesis_buffer_.at(index).hypotheses[i].flag == verified) */
-              /*   hypothesis_buffer_.at(index).verified_count--; */
-              /* hypothesis_buffer_.at(index).hypotheses.erase(hypothesis_buffer_.at(index).hypotheses.begin()+i); //remove old */
-              if (_debug_)
-                ROS_INFO_STREAM("[UVDARPoseCalculator]: Hypothesis " << (*hit).unique_id << " is " << ros::Duration(time - (*hit).observed).toSec() << " old, compared to " << time << ".");
-              hit = hypothesis_buffer_.at(index).removeHypothesis(hit);
-            }
-          }
-
-        }
-
-
-        std::vector<Hypothesis> mutateHypotheses(AssociatedHypotheses &hypotheses, int count, ros::Time time){
-          if ((int)(hypotheses.hypotheses.size()) == 0){
-            return {};
-          }
-
-          std::vector<Hypothesis> mutations;
-
-          for (int i = 0; i < count; i++){
-            int parent_index = rand() % (int)(hypotheses.hypotheses.size());
-
-            auto selected = hypotheses.at(parent_index);
-
-            if ((*selected).flag == verified){
-              auto new_mutations = generateVelocityMutations(*selected, 10, time, neutral, 1.0);//verification from current image only checks if they fit in the current moment - the target may have been moving differently than the hypothesis
-              mutations.insert(mutations.end(),new_mutations.begin(),new_mutations.end());
-
-              new_mutations = generateMutations(*selected, 10, time, 1.0, 1.0);
-              mutations.insert(mutations.end(),new_mutations.begin(),new_mutations.end());
-            }
-            else if ((*selected).flag == neutral){
-              auto new_mutations = generateMutations(*selected, 1, time, 1.0, 1.0);//consider them as old as the parent if the parent wasn't verified
-              mutations.insert(mutations.end(),new_mutations.begin(),new_mutations.end());
-            }
-            else{
-              i--;
-            }
-          }
-
-          return mutations;
-        }
-
-        bool isInView(Hypothesis h, int image_index, geometry_msgs::TransformStamped tocam_tf){
-
-          auto curr_projected =  camPointFromGlobal(h.pose.position, image_index, tocam_tf);
-
-          if (
-              (curr_projected.x >= 0) &&
-              (curr_projected.y >= 0) &&
-              (curr_projected.x < camera_image_sizes_[image_index].width) &&
-              (curr_projected.y < camera_image_sizes_[image_index].height)
-             ){
-            /* ROS_INFO_STREAM("[UVDARPoseCalculator]: C: " << image_index << " - In view: "<< curr_projected); */
-            return true;
-          }
-          else
-            return false;
-        }
-
-        std::vector<Hypothesis> generateMutations(Hypothesis hin, int count, [[maybe_unused]] ros::Time time, double position_max_step = -1.0, double angle_max_step = -1.0){
-          std::vector<Hypothesis> output;
-          if (position_max_step < 0)
-            position_max_step = MUTATION_POSITION_MAX_STEP*SCATTER_TIME_STEP;//m
-          /* if (velocity_max_step < 0) */
-          /*   velocity_max_step = MUTATION_VELOCITY_MAX_STEP*SCATTER_TIME_STEP;//m */
-          if (angle_max_step < 0)
-            angle_max_step = MUTATION_ORIENTATION_MAX_STEP*SCATTER_TIME_STEP;//rad
-
-          Hypothesis current_mutation;
-          current_mutation.index=hin.index;
-          current_mutation.flag=neutral;
-          current_mutation.observed=hin.observed;
-          current_mutation.propagated=hin.propagated;
-
-          for (int i = 0; i < count; i++) {
-            double d = static_cast <double> (rand()) / static_cast <double> (RAND_MAX);//scaler form 0 to 1
-            e::Vector3d offset_position = (e::Vector3d::Random().normalized())*d*position_max_step;
-            current_mutation.pose.position = hin.pose.position+offset_position;
-
-            /* double vd = static_cast <double> (rand()) / static_cast <double> (RAND_MAX);//scaler form 0 to 1 */
-            /* e::Vector3d offset_velocity = (e::Vector3d::Random().normalized())*vd*velocity_max_step; */
-            /* current_mutation.twist.linear = hin.twist.linear+offset_velocity; */
-            /* if ((hin.flag == verified) && (time > hin.propagated)) */
-            /*   current_mutation.twist.linear += */
-            /*     0.5 * //dampening */
-            /*     ((current_mutation.pose.position-hin.pose.position)/(time-hin.propagated).toSec()); // if our original hypothesis was verified, this mutation should have been the result of an incorrect velocity estimate */
-
-            current_mutation.twist.linear = hin.twist.linear;
-
-            double a = static_cast <double> (rand()) / static_cast <double> (RAND_MAX);//scaler form 0 to 1
-            auto offset_rotation = e::AngleAxisd(a*angle_max_step, e::Vector3d::Random().normalized());
-            current_mutation.pose.orientation = offset_rotation*hin.pose.orientation;
-
-            output.push_back(current_mutation);
-          }
-          /* for (double x_sgn = -1; x_sgn < 1.5; x_sgn=x_sgn+1.0){ */
-          /*   for (double y_sgn = -1; y_sgn < 1.5; y_sgn=y_sgn+1.0){ */
-          /*     for (double z_sgn = -1; z_sgn < 1.5; z_sgn=z_sgn+1.0){ */
-          /*       e::Vector3d shift_vector(x_sgn,y_sgn,z_sgn); */
-          /*       shift_vector.normalize(); */
-
-          /*       for (auto v : axis_vectors_global_){ */
-          /*         for (double a_sgn = -1; a_sgn < 1.5; a_sgn=a_sgn+1.0){ */
-
-          /*           if ((abs(x_sgn)<0.001) && (abs(y_sgn)<0.001) && (abs(z_sgn)<0.001) && (abs(a_sgn)<0.001) ) */
-          /*             continue; */
-
-
-          /*           current_mutation.pose.position = hin.pose.position+(position_max_step*shift_vector); */
-          /*           current_mutation.pose.orientation = e::AngleAxisd(a_sgn*angle_step,v)*hin.pose.orientation; */
-
-          /*           output.push_back(current_mutation); */
-          /*         } */
-          /*       } */
-
-          /* }}} */
-
-          return output;
-        }
-
-        std::vector<Hypothesis> generateVelocityMutations(Hypothesis hin, int count,[[maybe_unused]] ros::Time time, HypothesisFlag flag = neutral, double velocity_max_step = -1.0){
-          std::vector<Hypothesis> output;
-          if (velocity_max_step < 0)
-            velocity_max_step = MUTATION_VELOCITY_MAX_STEP*SCATTER_TIME_STEP;//m
-
-          Hypothesis current_mutation;
-          current_mutation.index=hin.index;
-          current_mutation.flag=flag;
-          current_mutation.observed=hin.observed;
-          current_mutation.propagated=hin.propagated;
-
-          current_mutation.pose = hin.pose;
-
-          for (int i = 0; i < count; i++) {
-
-
-            double vd = static_cast <double> (rand()) / static_cast <double> (RAND_MAX);//scaler form 0 to 1
-            e::Vector3d offset_velocity = (e::Vector3d::Random().normalized())*vd*velocity_max_step;
-            current_mutation.twist.linear = hin.twist.linear+offset_velocity;
-            /* if ((hin.flag == verified) && (time > hin.propagated)) */
-            /*   current_mutation.twist.linear += */
-            /*     0.5 * //dampening */
-            /*     ((current_mutation.pose.position-hin.pose.position)/(time-hin.propagated).toSec()); // if our original hypothesis was verified, this mutation should have been the result of an incorrect velocity estimate */
-
-            output.push_back(current_mutation);
-          }
-          return output;
-        }
-
-      /* Specific calculations used for individual cases of UAV models detection of various numbers of their markers//{ */
+      /* Specific calculations used for individual cases of UAV models detection of various numbers of their markers//{ */
 
       /**
        * @brief Rotates a 3D covariance 
@@ -2398,134 +2174,27 @@ namespace uvdar {
       /* } */
       //}
       //
-      std::vector<Hypothesis> extractHypotheses(std::vector<ImagePointIdentified> points, int target, size_t image_index, geometry_msgs::TransformStamped fromcam_tf, geometry_msgs::TransformStamped tocam_tf, Profiler &profiler, ros::Time time) {
-
-        auto start = profiler.getTime();
-
-        double alpha_max;
-        std::vector<e::Vector3d> v_w;
-        e::Vector3d furthest_position;
-
-        if (points.size() != 1){
-          for (auto& point: points){
-            v_w.push_back(directionFromCamPoint(point.position, image_index));
-          }
-          alpha_max = getLargestAngle(v_w);
-        }
-        if ((points.size() == 1) || (alpha_max < 0.01) || (avgIsNearEdge(points,EDGE_DETECTION_MARGIN, image_index))){
-          /* auto v_w_s = baseFromOptical(directionFromCamPoint(points.front().position, image_index)); */
-          auto v_w_s = directionFromCamPoint(points.front().position,image_index);
-          v_w_s *= UVDAR_RANGE(image_index); //max range
-          furthest_position = v_w_s;
-        }
-        else {
-          furthest_position = getRoughInit(model_, v_w, image_index);
+      /**
+       * @brief Generates fresh hypotheses of the pose of a target from a single observation, see pose_core::initialHypotheses. The stages of the generation are recorded by the profiler
+       *
+       * @param points The points of the target observed in the current image
+       * @param target The identifier of the cluster of points, see separateBySignals
+       * @param image_index The index of the current camera
+       * @param fromcam_tf Transformation from the current camera to the output frame
+       * @param tocam_tf Transformation from the output frame to the current camera
+       * @param profiler The profiler of the calling thread
+       * @param time The time of the observation
+       *
+       * @return The new hypotheses in the output frame
+       */
+      std::vector<Hypothesis> extractHypotheses(const std::vector<ImagePointIdentified> &points, int target, size_t image_index, const geometry_msgs::TransformStamped &fromcam_tf, const geometry_msgs::TransformStamped &tocam_tf, Profiler &profiler, ros::Time time) {
+        if (replay_file_.is_open()){
+          recordObservation(points, target, tocam_tf);
         }
 
-          if (_debug_){
-            ROS_INFO_STREAM("[UVDARPoseCalculator]: C: " << image_index << ", Furthest point : " << furthest_position.transpose());
-            ROS_INFO_STREAM("[UVDARPoseCalculator]: Furthest possible distance: " << furthest_position.norm());
-          }
-          /* auto rough_init = std::chrono::high_resolution_clock::now(); */
-          /* elapsedTime.push_back({currDepthIndent() + ,std::chrono::duration_cast<std::chrono::microseconds>(rough_init - start).count()}); */
-          profiler.addValueSince("Rough initialization", start);
-
-          auto [hypotheses_init, errors_init] = getViableInitialHyptheses(points, furthest_position, target, image_index, fromcam_tf, tocam_tf, INITIAL_ROUGH_HYPOTHESIS_COUNT, time);
-          profiler.addValue("InitialHypotheses");
-          double init_rough_count = (double)(INITIAL_ROUGH_HYPOTHESIS_COUNT);
-          double init_hypothesis_count =(double)(hypotheses_init.size());
-          double ratio_found = init_hypothesis_count / init_rough_count;
-          if (isnan(ratio_found)){
-            ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: FUCK 0!");
-          }
-          //ROS_INFO(" Ratio Init: %f", 100*ratio_found );
-
-          int desired_count = (int)(ratio_found*INITIAL_HYPOTHESIS_COUNT);
-          /* ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: desired_count" << desired_count); */
-          auto hypotheses_refined = refineByMutation(model_, points, hypotheses_init,     tocam_tf, image_index, target, ERROR_THRESHOLD_MUTATION_1(image_index), 1.0, 1.0, desired_count);
-          /* profiler.addValue("Initial Mutation 1"); */
-          if (hypotheses_refined.size() == 0){
-            profiler.addValue("Viable initial hypotheses");
-            return hypotheses_refined;
-          }
-          double ratio_found_2 = (double)(hypotheses_refined.size()) / desired_count;
-          if (isnan(ratio_found_2)){
-            ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: FUCK 1!");
-          }
-          //ROS_INFO(" Ratio Refin 1: %f", 100*ratio_found );
-          int desired_count_2 = (int)(ratio_found_2*desired_count);
-          hypotheses_refined      = refineByMutation(model_, points, hypotheses_refined,  tocam_tf, image_index, target, ERROR_THRESHOLD_MUTATION_2(image_index), 1.0, 1.0, desired_count_2);
-          if (hypotheses_refined.size() == 0){
-            profiler.addValue("Viable initial hypotheses");
-            return hypotheses_refined;
-          }
-          /* profiler.addValue("Initial Mutation 2"); */
-          double ratio_found_3 = (double)(hypotheses_refined.size()) / desired_count_2;
-          if (isnan(ratio_found_3)){
-            ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: FUCK 2!");
-          }
-          //ROS_INFO(" Ratio Refin 2: %f", 100*ratio_found );
-          int desired_count_3 = (int)(ratio_found_3*desired_count_2);
-          hypotheses_refined      = refineByMutation(model_, points, hypotheses_refined,  tocam_tf, image_index, target, ERROR_THRESHOLD_MUTATION_3(image_index), 1.0, 1.0, desired_count_3);
-          /* profiler.addValue("Initial Mutation 3"); */
-
-          int static_hypothesis_count = (int)(hypotheses_refined.size());
-          for (int i=0; i<static_hypothesis_count; i++){
-            auto new_mutations = generateVelocityMutations(hypotheses_refined.at(i), 5, time, neutral, 1.0);
-            hypotheses_refined.insert(hypotheses_refined.end(),new_mutations.begin(),new_mutations.end());
-          }
-          profiler.addValue("Initial Velocity Mutation");
-
-          /* for (auto &h : hypotheses_refined){ */
-          /*   h.flag = verified; */
-          /* } */
-
-
-          /* auto hypotheses_refined = hypotheses_init; */
-
-          /* int initial_hypothesis_count = (int)(hypotheses.size()); */
-
-          /* std::vector<Hypothesis> hypotheses_fitted; */
-          /* int i = 0; */
-          /* for (auto &h : hypotheses_init){ */
-          /*   double error_t; */
-          /*   Hypothesis h_t; */
-          /*   /1* std::tie(h_t, error_t) = iterFitFull(model_, points, h, target,  image_index, tocam_tf, profiler); *1/ */
-
-          /*   /1* if (_debug_) *1/ */
-          /*   /1*   ROS_INFO_STREAM("[UVDARPoseCalculator]: Fitted position: Pre. error: " << errors_init[i] << ", New error: " << error_t); *1/ */
-          /*   /1* const double threshold = (double)(points.size())*ERROR_THRESHOLD_FITTED(image_index); *1/ */
-          /*   /1* if (error_t <= threshold){ *1/ */
-          /*     hypotheses_fitted.push_back(h); */
-          /*     if (_debug_) */
-          /*       ROS_INFO_STREAM("[UVDARPoseCalculator]: Adding"); */
-          /*   /1* } *1/ */
-          /*   /1* else { *1/ */
-          /*   /1*   if (_debug_) *1/ */
-          /*   /1*     ROS_INFO_STREAM("[UVDARPoseCalculator]: Rejecting!"); *1/ */
-          /*   /1* } *1/ */
-
-          /*   i++; */
-          /* } */
-          /* if (_debug_){ */
-          /*   ROS_INFO_STREAM("[UVDARPoseCalculator]: Fitted position: " << fitted_position.transpose()); */
-          /* } */
-
-          /* if (_debug_){ */
-          /*   ROS_INFO_STREAM("[UVDARPoseCalculator]: Rough hypotheses for target " << target << " in image " << image_index << ": "); */
-          /*   int i = 0; */
-          /*   for (auto h: hypotheses){ */
-          /*     ROS_INFO_STREAM("x: [" << h.pose.position.transpose() << "] rot: [" << rad2deg(quaternionToRPY(h.pose.orientation)).transpose() << "] with error of " << errors.at(i++)); */
-          /*   } */
-          /* } */
-
-
-          /* auto viable_hypotheses = std::chrono::high_resolution_clock::now(); */
-          /* elapsedTime.push_back({currDepthIndent() + "Viable initial hypotheses",std::chrono::duration_cast<std::chrono::microseconds>(viable_hypotheses - rough_init).count()}); */
-          profiler.addValue("Viable initial hypotheses");
-
-          return hypotheses_refined;
-        
+        auto target_observation = observation(target, tocam_tf, points, time);
+        target_observation.fromcam = pose_core::ros_adapter::fromMsg(fromcam_tf.transform);
+        return pose_core::initialHypotheses(reprojections_[image_index], target_observation, model_.getGroups(), maxdiameter_, _p3p_initialization_, _lm_refinement_, [&profiler](const std::string &stage){profiler.addValue(stage);});
       }
 
           /* std::vector<Hypothesis> selected_poses; */
@@ -2685,64 +2354,6 @@ namespace uvdar {
       /* } */
       //}
 
-          e::Vector3d getRoughInit([[ maybe_unused ]] LEDModel model, std::vector<e::Vector3d> v_w, [[ maybe_unused ]] int image_index){
-
-            /* std::vector<e::Vector3d> v_w; */
-            e::Vector3d v_avg = {0,0,0};
-            for (auto& v: v_w){
-              /* v_w.push_back(directionFromCamPoint(point, image_index)); */
-              v_avg += v;
-            }
-            v_avg /= (double)(v_avg.size());
-            v_avg = v_avg.normalized();
-            /* ROS_ERROR_STREAM("[UVDARPoseCalculator]: model size: " << model.size()); */
-            /* for (sub_model : getSubModels(model, (int)(observed_points.size()))) { */
-            /* double d_model = getRoughVisibleDiameter(sub_model); */
-            double l_max = UVDAR_RANGE(image_index);
-            if ((int)(v_w.size()) > 1){
-              /* auto [d_max, d_min] = model.getMaxMinVisibleDiameter(); */
-              double alpha_max = getLargestAngle(v_w);
-
-              l_max = (maxdiameter_/2.0)/tan(alpha_max/2.0);
-              /* if (_debug_) */
-              /*   ROS_INFO_STREAM("[UVDARPoseCalculator]: d_max: " << d_max << "; alpha_max: " << alpha_max << "; l_rough: " << l_max); */
-            }
-
-            /* ROS_INFO_STREAM("[UVDARPoseCalculator]: d_min: " << d_min << "; alpha_min: " << alpha_min << "; l_rough: " << l_max); */
-          
-
-            /* return baseFromOptical(v_avg*l_max)*1.25; */
-            return v_avg*l_max*1.25;
-            /* } */
-          }
-
-
-          double getLargestAngle(std::vector<e::Vector3d> directions){
-            double max_angle = 0;
-            std::pair<int,int> sel_indices = {-1,-1};
-            for (int i = 0; i < ((int)(directions.size()) - 1); i++){
-              for (int j = i+1; j < (int)(directions.size()); j++){
-                double tent_angle = acos(directions[i].normalized().dot(directions[j].normalized()));
-                /* if (_debug_) */
-                /*   ROS_INFO_STREAM("[UVDARPoseCalculator]: tent_angle: "<< tent_angle); */
-                if (tent_angle > max_angle){
-                  max_angle = tent_angle;
-                  sel_indices = {i,j};
-                }
-              }
-            }
-
-            if ((sel_indices.first != -1) && (sel_indices.second != -1)){
-              if (_debug_)
-                ROS_INFO_STREAM("[UVDARPoseCalculator]: selected points: " << sel_indices.first << ": " << directions[sel_indices.first].transpose() << " and " << sel_indices.second << ": " << directions[sel_indices.second].transpose());
-            }
-            else{
-              if (_debug_)
-                ROS_INFO_STREAM("[UVDARPoseCalculator]: No points selected as closest");
-            }
-
-            return max_angle;
-          }
 
           /* std::vector<LEDModel> getSubModels(LEDModel full_model, int min_markers){ */
           /*   std::vector<LEDModel> output; */
@@ -2834,124 +2445,6 @@ namespace uvdar {
 
 
 
-          std::pair<std::vector<Hypothesis>,std::vector<double>> getViableInitialHyptheses( std::vector<ImagePointIdentified> observed_points, e::Vector3d furthest_position, int target, int image_index, geometry_msgs::TransformStamped fromcam_tf, geometry_msgs::TransformStamped tocam_tf, int initial_hypothesis_count, ros::Time time){
-            /* const auto start = profiler.getTime(); */
-
-            e::FullPivLU<e::MatrixXd> lu(furthest_position.normalized().transpose());
-            e::MatrixXd l_null_space = lu.kernel();
-            /* ROS_INFO_STREAM("[UVDARPoseCalculator]: span: \n" << psi); */
-            /* ROS_INFO_STREAM("[UVDARPoseCalculator]: nullspace: \n" << l_null_space); */
-            e::Vector3d side_shift_init = l_null_space.topLeftCorner(3,1).normalized()*maxdiameter_;
-
-            double threshold = (int)(observed_points.size())*ERROR_THRESHOLD_INITIAL(image_index);
-
-            ReprojectionContext rpc;
-            rpc.image_index=image_index;
-            rpc.tocam_tf=tocam_tf;
-            rpc.target=target;
-            rpc.observed_points=observed_points;
-            rpc.model=model_;
-
-
-            std::vector<Hypothesis> initial_hypotheses;
-            std::vector<double> errors;
-            int iter = 0;
-            for (; (int)(initial_hypotheses.size()) < initial_hypothesis_count;){
-                double d = static_cast <double> (rand()) / static_cast <double> (RAND_MAX);//random double form 0 to 1
-                double sidestep_direction = static_cast <double> (rand()) / static_cast <double> (RAND_MAX);//random double form 0 to 1
-                double sidestep_distance = static_cast <double> (rand()) / static_cast <double> (RAND_MAX);//random double form 0 to 1
-
-                auto side_shift_local = (e::AngleAxisd(2.0*M_PI*sidestep_direction,furthest_position.normalized())*side_shift_init)*sidestep_distance;
-                /* ROS_INFO_STREAM("[UVDARPoseCalculator]: Side shift: " << side_shift_local.transpose()); */
-
-                e::Vector3d current_position = (furthest_position*d) + (side_shift_local);
-
-                double a = static_cast <double> (rand()) / static_cast <double> (RAND_MAX);//scaler form 0 to 1
-                e::Quaterniond current_orientation(e::AngleAxisd(a*2.0*M_PI, e::Vector3d::Random().normalized()));
-
-                auto global_position = transform(current_position, fromcam_tf);
-
-                /* rpc.model=model_.rotate(current_orientation).translate(global_position.value()); */
-                Hypothesis hypo_new;
-                hypo_new.index = target;
-                hypo_new.pose = {.position=global_position.value(), .orientation=current_orientation};
-                hypo_new.flag = neutral;
-                hypo_new.observed = time;
-                hypo_new.propagated = time;
-                double error_total = hypothesisError(hypo_new, rpc);
-
-                /* ROS_INFO_STREAM("[UVDARPoseCalculator]: Err: "<< error_total << " from P: " <<  global_position.value().transpose() << "; R: " << quaternionToRPY(current_orientation).transpose()); */
-
-                
-                if (error_total < threshold){
-
-                  initial_hypotheses.push_back(hypo_new);
-                  errors.push_back(error_total);
-                }
-                iter++;
-                if (iter > MAX_INIT_ITERATIONS){
-                  break;
-                }
-
-            }
-            if (_debug_)
-              ROS_INFO_STREAM("[UVDARPoseCalculator]: Iterations for initialization : "<< iter );
-            return {initial_hypotheses, errors};
-          }
-
-          std::vector<Hypothesis> refineByMutation(const LEDModel& model, const std::vector<ImagePointIdentified>& observed_points, std::vector<Hypothesis> &hypotheses,  geometry_msgs::TransformStamped tocam_tf, int image_index, int target, double threshold_local, double position_max_step, double angle_max_step, unsigned int desired_count){
-            std::vector<Hypothesis> output;
-            double threshold = (int)(observed_points.size())*threshold_local;
-
-            ReprojectionContext rpc;
-
-            rpc.model=model;
-            rpc.target=target;
-            rpc.tocam_tf=tocam_tf;
-            rpc.image_index=image_index;
-            rpc.observed_points = observed_points;
-
-            for (auto &h : hypotheses){
-              if ( hypothesisError(h, rpc) < threshold){
-                output.push_back(h);
-                output.back().flag = neutral;
-              }
-            }
-
-            int iter = 0;
-            /* bool breakloop = false; */
-            for (; (unsigned int)(output.size()) < desired_count;){
-            for (auto &h : hypotheses){
-
-                auto new_mutations = generateMutations(h, 1, h.observed, position_max_step, angle_max_step);
-                for (auto &hm : new_mutations){
-                  double error_curr = hypothesisError(hm, rpc);
-                  if (error_curr < threshold){
-                    output.push_back(hm);
-                    output.back().flag = neutral;
-                    if (_debug_)
-                      ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: Adding hypo with error of " << error_curr);
-                  }
-                  else {
-                    /* ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: Discarding hypo with error of " << error_curr << " vs. " << threshold); */
-                  }
-                }
-
-              }
-
-              iter++;
-              if (iter > MAX_MUTATION_REFINE_ITERATIONS){
-                break;
-              }
-
-            }
-
-            if (_debug_)
-              ROS_INFO_STREAM("[UVDARPoseCalculator]: Iterations for mutation : "<< iter );
-
-            return output;
-
-          }
 
           /* std::pair<Hypothesis, double> iterFitFull(const LEDModel& model, const std::vector<ImagePointIdentified>& observed_points, const Hypothesis& hypothesis, int target, int image_index, geometry_msgs::TransformStamped tocam_tf, Profiler &profiler) */
           /* { */
@@ -3310,156 +2803,46 @@ namespace uvdar {
           /*     return {hypo_new, error_total}; */
       /* } */
 
-      double hypothesisError(Hypothesis &hypothesis, const ReprojectionContext rpc, std::shared_ptr<std::vector<ImagePointIdentified>> projected_points={}, bool return_projections=false, bool discrete_pixels=false){
-        if  ( rpc.target != hypothesis.index){
-          ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: Hypothesis " << hypothesis.unique_id << " has different ID of " << hypothesis.index << " compared to the target with id " << rpc.target);
-          return -1;
-        }
-
-        e::Vector3d position_curr = hypothesis.pose.position;
-        const e::Quaterniond orientation_curr  = hypothesis.pose.orientation;
-        auto model_curr = rpc.model.rotate(orientation_curr).translate(position_curr);
-        auto rpc_tr = rpc;
-        rpc_tr.model = model_curr;
-
-        double error_total = modelError(rpc_tr, projected_points, return_projections, discrete_pixels);
-        return error_total;
-      }
-
-      double modelError(const ReprojectionContext rpc, std::shared_ptr<std::vector<ImagePointIdentified>> projected_points={}, bool return_projections=false, bool discrete_pixels=false){
-
-        struct ProjectedMarker {
-          cv::Point2d position;
-          /* int freq_id; */
-          int signal_id;
-          double cos_view_angle;
-          double distance;
-        };
-        double total_error = 0;
-
-        /* if (return_projections){ */
-        /*   ROS_INFO_STREAM("[UVDARPoseCalculator]: A"); */
-        /* } */
-        if (return_projections && projected_points){
-          /* ROS_INFO_STREAM("[UVDARPoseCalculator]: B"); */
-          projected_points->clear();
-        }
-
-        std::vector<ProjectedMarker> projected_markers;
-        for (auto marker : rpc.model){
-          /* auto curr_projected =  camPointFromModelPoint(marker, image_index); */
-          auto curr_projected =  camPointFromGlobal(marker, rpc.image_index, rpc.tocam_tf);
-
-          /* ROS_INFO_STREAM("[UVDARPoseCalculator]: marker: pos: " << marker.position.transpose() << " rot: " << quaternionToRPY(marker.orientation).transpose()  << " : " << (target*signals_per_target_)+marker.signal_id); */
-          if (
-              (std::get<0>(curr_projected).position.x>-0.5) && // edge of the leftmost pixel
-              (std::get<0>(curr_projected).position.y>-0.5) && // edge of the topmost pixel
-              (std::get<0>(curr_projected).position.x<(_oc_models_[rpc.image_index].width + 0.5)) && // edge of the rightmost pixel
-              (std::get<0>(curr_projected).position.y<(_oc_models_[rpc.image_index].height+ 0.5)) // edge of the bottommost pixel
-             ){
-            projected_markers.push_back({
-                .position = std::get<0>(curr_projected).position,
-                .signal_id = marker.signal_id,
-                .cos_view_angle = std::get<2>(curr_projected),
-                .distance = std::get<1>(curr_projected),
-                });
-          }
-
-
-          /* ROS_INFO_STREAM("[UVDARPoseCalculator]: fid:  " << (target*_frequencies_per_target_)+projected_markers.back().signal_id  << "; target: " << target << "; lfid: " << projected_markers.back().signal_id); */
-        }
-
-        std::vector<ProjectedMarker> selected_markers;
-        for (auto marker : projected_markers){
-          double distance = marker.distance;
-          double cos_angle =  marker.cos_view_angle;
-          double led_intensity =
-            round(std::max(.0, cos_angle) * (led_projection_coefs_[0] + (led_projection_coefs_[1] / ((distance + led_projection_coefs_[2]) * (distance + led_projection_coefs_[2])))));
-          /* if (return_projections){ */
-            /* ROS_INFO_STREAM("[UVDARPoseCalculator]: C:" << image_index << ", cos_angle: " << cos_angle << " distance: " << distance << " led_intensity: " << led_intensity); */
-            /* ROS_INFO_STREAM("[UVDARPoseCalculator]: C:" << image_index << ", ID: " << marker.signal_id <<  ", marker pos: x:" << marker.position.x << " y:" << marker.position.y ); */
-          /* } */
-          if (led_intensity > 0) { // otherwise they will probably not be visible
-            selected_markers.push_back(marker);
-            /* if (return_projections){ */
-            /*   ROS_INFO_STREAM("[UVDARPoseCalculator]: C"); */
-            /* } */
-          }
-        }
-
-        /* ROS_INFO_STREAM("[UVDARPoseCalculator]: projected_markers: " << projected_markers.size() << " vs. selected_markers (i): " << selected_markers.size()); */
 
-        for (int i = 0; i < ((int)(selected_markers.size()) - 1); i++){
-          for (int j = i+1; j < (int)(selected_markers.size()); j++){
-            double tent_dist = cv::norm(selected_markers[i].position-selected_markers[j].position);
-            if (tent_dist < 3){
-              if (selected_markers[i].signal_id == selected_markers[j].signal_id){ // if the frequencies are the same, they tend to merge. Otherwise, the result varies
-                selected_markers[i].position = (selected_markers[i].position + selected_markers[j].position)/2; //average them
-                selected_markers.erase(selected_markers.begin()+j); //remove the other
-                j--; //we are not expecting many 2+ clusters, so we will not define special case for this
-
-              }
+      /**
+       * @brief Appends an observation of a target to the replay file, in the format read by uvdar_pose_core_replay. The signals are converted back to the IDs of the model file
+       */
+      void recordObservation(const std::vector<ImagePointIdentified> &points, int target, const geometry_msgs::TransformStamped &tocam_tf){
+        std::stringstream line;
+        const auto &t = tocam_tf.transform.translation;
+        const auto &q = tocam_tf.transform.rotation;
+        line << t.x << " " << t.y << " " << t.z << " " << q.w << " " << q.x << " " << q.y << " " << q.z << " " << points.size();
+        for (auto &point : points){
+          int signal_id = -1;
+          for (int j = 0; j < signals_per_target_; j++){
+            if (_signal_ids_.at(((target%1000)*signals_per_target_)+j) == point.ID){
+              signal_id = j;
+              break;
             }
           }
+          line << " " << signal_id << " " << point.position.x << " " << point.position.y;
         }
+        std::scoped_lock lock(replay_mutex_);
+        replay_file_ << line.str() << std::endl;
+      }
 
-        /* for (auto pt : observed_points){ */
-        /*   ROS_INFO_STREAM("[UVDARPoseCalculator]: observed_marker: " << pt.x << " : " << pt.y << " : " << pt.z); */
-        /* } */
-        /* for (auto pt : selected_markers){ */
-        /*   ROS_INFO_STREAM("[UVDARPoseCalculator]: projected_marker: " << pt.position.x << " : " << pt.position.y << " : " << pt.signal_id); */
-        /* } */
-
-        if (return_projections && projected_points){
-          for (auto pt : selected_markers){
-            projected_points->push_back({.ID=pt.signal_id, .position = cv::Point2i(pt.position.x,pt.position.y) });
-          }
-        }
-
-        for (auto& obs_point : rpc.observed_points){
-
-          /* ROS_INFO_STREAM("[UVDARPoseCalculator]: observed marker:  " << obs_point); */
-          ProjectedMarker closest_projection;
-          double closest_distance = std::numeric_limits<double>::max();
-          bool any_match_found = false;
-          /* for (auto& proj_point : projected_markers){ */
-          for (auto& proj_point : selected_markers){
-            /* double tent_signal_distance = abs( (1.0/(_signal_ids_[(target*signals_per_target_)+proj_point.signal_id])) - (1.0/(obs_point.z)) ); */
-            /* ROS_INFO_STREAM("[UVDARPoseCalculator]: signal id:  " << (target*signals_per_target_)+proj_point.signal_id); */
-            /* ROS_INFO_STREAM("[UVDARPoseCalculator]: signal ids size:  " << _signal_ids_.size()); */
-            /* if (tent_signal_distance < (2.0/estimated_framerate_[image_index])){ */
-            if (_signal_ids_.at(((rpc.target%1000)*signals_per_target_)+proj_point.signal_id) == (int)(obs_point.ID)){
-              double tent_image_distance;
-              if (!discrete_pixels){
-                tent_image_distance = cv::norm(proj_point.position - cv::Point2d(obs_point.position));
-              }
-              else {
-                tent_image_distance = cv::norm(cv::Point2i(proj_point.position.x - obs_point.position.x, proj_point.position.y - obs_point.position.y));
-              }
-                /* ROS_INFO_STREAM("[UVDARPoseCalculator]: obs_point: " << cv::Point2d(obs_point.position.x, obs_point.position.y) << " : proj_point: " << proj_point.position); */
-              /* if (tent_image_distance > 100){ */
-                /* exit(3); */
-              /* } */
-              if (tent_image_distance < closest_distance){
-                closest_distance = tent_image_distance;
-                any_match_found = true;
-              }
-            }
-          }
-          if (any_match_found){
-            total_error += sqr(closest_distance);
-            /* ROS_INFO_STREAM("[UVDARPoseCalculator]: closest_distance squared: " << sqr(closest_distance)); */
-          }
-          else {
-            total_error += UNMATCHED_OBSERVED_POINT_PENALTY;
-          }
-          }
-
-          total_error += (UNMATCHED_PROJECTED_POINT_PENALTY) * std::max(0,(int)(selected_markers.size() - rpc.observed_points.size()));
-          /* total_error += (UNMATCHED_OBSERVED_POINT_PENALTY) * std::max(0,(int)(observed_points.size() - selected_markers.size())); */
-
-          return total_error;
-        }
+      /**
+       * @brief Converts an observation of a target for the pose core, once for the evaluation of many hypotheses. The transformation from the camera is the inverse of the one to the camera
+       */
+      pose_core::Observation observation(int target, const geometry_msgs::TransformStamped &tocam_tf, const std::vector<ImagePointIdentified> &observed_points, ros::Time time){
+        pose_core::Observation output;
+        output.target = target;
+        output.markers = &target_markers_.at(target%1000);
+        output.tocam = pose_core::ros_adapter::fromMsg(tocam_tf.transform);
+        output.fromcam.orientation = output.tocam.orientation.inverse();
+        output.fromcam.position = -(output.fromcam.orientation*output.tocam.position);
+        output.points.reserve(observed_points.size());
+        for (auto &point : observed_points){
+          output.points.push_back({point.ID, e::Vector2d(point.position.x, point.position.y)});
+        }
+        output.time = time.toSec();
+        return output;
+      }
 
         /* std::pair<std::pair<e::Vector3d, e::Quaterniond>,e::MatrixXd> getCovarianceEstimate(LEDModel model, std::vector<ImagePointIdentified> observed_points, std::pair<e::Vector3d, e::Quaterniond> pose, int target, int image_index, geometry_msgs::TransformStamped tocam_tf){ */
 
@@ -3630,82 +3013,6 @@ namespace uvdar {
         /* return {{pose.first+e::Vector3d(y(0,0), y(1,0), y(2,0)),pose.second},P}; */
         /* } */
 
-        //Implemented based on "Generalised Covariance Union: A Unified Approach to Hypothesis Merging in Tracking" by STEVEN REECE and STEPHEN ROBERTS
-        //and
-        //"Generalized Information Representation and Compression Using Covariance Union"  by Ottmar Bochardt et. al. (error: Eq. (12) and (13) have - instead of +)
-        std::pair<std::pair<e::Vector3d, e::Quaterniond>, e::MatrixXd> getMeasurementUnion(std::vector<std::pair<e::Vector3d, e::Quaterniond>> means, std::vector<e::MatrixXd> covariances){
-          if (means.size() != covariances.size()){
-            ROS_ERROR_STREAM("[UVDARPoseCalculator]: The count of means and covariances for union generation does not match. Returning!");
-            return std::pair<std::pair<e::Vector3d, e::Quaterniond>, e::MatrixXd>();
-          }
-
-
-          /* std::pair<std::pair<e::Vector3d, e::Quaterniond>, e::MatrixXd> measurement_union; */
-          std::vector<std::pair<std::pair<e::Vector3d, e::Quaterniond>, e::MatrixXd>> measurement_unions_prev;
-          std::vector<std::pair<std::pair<e::Vector3d, e::Quaterniond>, e::MatrixXd>> measurement_unions_next;
-
-          for (int i = 0; i< (int)(means.size()); i++){
-            measurement_unions_prev.push_back({means[i], covariances[i]});
-          }
-
-          //pair-wise approach - if performance becomes a problem, we can consider batch solution for later
-          //
-          /* if (means.size() > 2){ // let's start with the two most mutually distant ones to avoid the drawbacks of serial pair-wise unionization */
-          /*   std::tuple<int, int, double> dist_pair =  {-1,-1, 0}; */
-          /*   for (int i=0; i<(int)(means.size()); i++){ */
-          /*     for (int j=0; j<i; j++){ */
-          /*       double mutual_distance = (means[i].first - means[j].first).norm(); */
-          /*       if (mutual_distance > std::get<2>(dist_pair) ){ */
-          /*         std::get<0>(dist_pair) = i; */
-          /*         std::get<1>(dist_pair) = j; */
-          /*         std::get<2>(dist_pair) = mutual_distance; */
-          /*       } */
-          /*     } */
-          /*   } */
-
-          /*   if ((std::get<0>(dist_pair) >= 0) && (std::get<1>(dist_pair) >= 0)) */
-          /*     measurement_union = twoMeasurementUnion({means[std::get<0>(dist_pair)],covariances[std::get<0>(dist_pair)]}, {means[std::get<1>(dist_pair)], covariances[std::get<1>(dist_pair)]}); */
-          /* } */
-          /* return measurement_union; */
-
-          /* if (means.size() < 1){ */
-          /*   ROS_ERROR_STREAM("[UVDARPoseCalculator]: No measurements!"); */
-          /*   measurement_union = {{e::Vector3d(),e::Quaterniond()},{e::MatrixXd::Identity(6,6)}}; */
-          /*   return measurement_union; */
-          /* } */
-
-          /* measurement_union = {means[0],covariances[0]}; */
-          /* for (int i=1; i<(int)(means.size()); i++){ */
-          /*   measurement_union = twoMeasurementUnion(measurement_union, {means[i], covariances[i]}); */
-          /* } */
-
-          /* return measurement_union; */
-
-          /* if (_debug_) */
-          ROS_INFO_STREAM("[UVDARPoseCalculator]: Meas count: "<< means.size());
-
-          while((int)(measurement_unions_prev.size()) > 1){
-            for (int i = 0; i< (int)(measurement_unions_prev.size()/2); i++){
-
-              /* ROS_INFO_STREAM("[UVDARPoseCalculator]: a: "<< measurement_unions_prev.at(2*i).first.first.transpose() << ", b: " <<measurement_unions_prev.at((2*i)+1).first.first.transpose()); */
-              ROS_INFO_STREAM("[UVDARPoseCalculator]: a: "<< quaternionToRPY(measurement_unions_prev.at(2*i).first.second).transpose() << ", b: " << quaternionToRPY(measurement_unions_prev.at((2*i)+1).first.second).transpose());
-              ROS_INFO_STREAM("[UVDARPoseCalculator]: Ca: "<< measurement_unions_prev.at(2*i).second.bottomRightCorner(3,3).eigenvalues().transpose() << ", Cb: " << measurement_unions_prev.at((2*i)+1).second.bottomRightCorner(3,3).eigenvalues().transpose());
-              measurement_unions_next.push_back(twoMeasurementUnion(measurement_unions_prev.at(2*i), measurement_unions_prev.at((2*i)+1)));
-              /* ROS_INFO_STREAM("[UVDARPoseCalculator]: u: "<< measurement_unions_next.back().first.first.transpose()); */
-              ROS_INFO_STREAM("[UVDARPoseCalculator]: u: "<< quaternionToRPY(measurement_unions_next.back().first.second).transpose());
-              ROS_INFO_STREAM("[UVDARPoseCalculator]: Cu: "<< measurement_unions_next.back().second.bottomRightCorner(3,3).eigenvalues().transpose());
-
-            }
-            if ((measurement_unions_prev.size() % 2) != 0){
-              measurement_unions_next.push_back(measurement_unions_prev.back());
-            }
-            measurement_unions_prev = measurement_unions_next;
-            measurement_unions_next.clear();
-          }
-
-          return measurement_unions_prev.at(0);
-
-        }
 
         /* std::pair<std::pair<e::Vector3d, e::Quaterniond>, e::MatrixXd> getMeasurementUnionSimple(std::vector<Hypothesis> meas){ */
         /*   if (meas.size() < 1){ */
@@ -3742,552 +3049,11 @@ namespace uvdar {
 
         /* } */
 
-        //contains code from https://gist.github.com/PeteBlackerThe3rd/f73e9d569e29f23e8bd828d7886636a0
-        e::Quaterniond getAverageOrientation(std::vector<Hypothesis> meas){
-          if (meas.size() < 1){
-            return e::Quaterniond::Identity();
-            ROS_ERROR_STREAM("[UVDARPoseCalculator]: No measurements provided. Returning!");
-          }
-
-          // first build a 4x4 matrix which is the elementwise sum of the product of each quaternion with itself
-          Eigen::Matrix4d A = Eigen::Matrix4d::Zero();
-
-          for (auto &m : meas){
-            A += m.pose.orientation.coeffs()*m.pose.orientation.coeffs().transpose();
-          }
-          A /= (double)(meas.size());
-
-          // Compute the SVD of this 4x4 matrix
-          Eigen::JacobiSVD<Eigen::MatrixXd> svd(A, Eigen::ComputeThinU | Eigen::ComputeThinV);
-
-          Eigen::VectorXd singularValues = svd.singularValues();
-          Eigen::MatrixXd U = svd.matrixU();
-
-          // find the eigen vector corresponding to the largest eigen value
-          int largestEigenValueIndex = 0;
-          double largestEigenValue = singularValues(0);
-
-          for (int i=1; i<singularValues.rows(); ++i) {
-            if (singularValues(i) > largestEigenValue) {
-              largestEigenValue = singularValues(i);
-              largestEigenValueIndex = i;
-            }
-          }
-
-          /* if (largestEigenValueIndex == -1){ */
-          /*   ROS_ERROR("[UVDARPoseCalculator]: Failed to obtain orientation mean. Returning!"); */
-          /*   return std::pair<std::pair<e::Vector3d, e::Quaterniond>, e::MatrixXd>(); */
-          /* } */
-
-          Eigen::Quaterniond mean_rot;
-          mean_rot.x() = U(0, largestEigenValueIndex);
-          mean_rot.y() = U(1, largestEigenValueIndex);
-          mean_rot.z() = U(2, largestEigenValueIndex);
-          mean_rot.w() = U(3, largestEigenValueIndex);
-
-          return mean_rot;
-        }
-
-
-        std::optional<std::pair<Pose,e::MatrixXd>> getMeasurementElipsoidHull(AssociatedHypotheses meas){
-          if (_debug_)
-            ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: Hypo count: " << meas.hypotheses.size());
-          if (meas.hypotheses.size() < 1){
-            ROS_ERROR_STREAM("[UVDARPoseCalculator]: No hypotheses provided. Returning!");
-            return std::nullopt;
-          }
-
-          if (_debug_)
-            ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: Verified count: " << meas.verified_count);
-          if (meas.verified_count < 1){
-            ROS_ERROR_STREAM("[UVDARPoseCalculator]: No verified hypotheses provided. Returning!");
-            return std::nullopt;
-          }
-          
-          if (meas.verified_count == 1){
-            e::Vector3d singleton_position;
-            e::Quaterniond singleton_orientation;
-            for (auto &h : meas.hypotheses){
-              if (h.flag == verified){
-                singleton_position = h.pose.position;
-                singleton_orientation = h.pose.orientation;
-              }
-            }
-            e::Matrix6d C = e::Matrix6d::Zero();
-            C.topLeftCorner(3,3) = 0.5*e::Matrix3d::Identity();
-            C.bottomRightCorner(3,3) = 0.5*e::Matrix3d::Identity();
-            std::pair<Pose,e::MatrixXd> output = {{.position=singleton_position,.orientation=singleton_orientation},C};
-            return output;
-          }
-
-          if (_debug_)
-            ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: Verified count: " << meas.verified_count);
-
-          // position
-          std::vector<e::Vector3d> meas_pos;
-
-          e::Vector3d mean_pos(0.0,0.0,0.0);
-
-          for (auto &m : meas.hypotheses){
-            if (m.flag == verified){
-              meas_pos.push_back(m.pose.position);
-              mean_pos += m.pose.position;
-            }
-          }
-          mean_pos /= ((double)(meas.hypotheses.size()));
-          std::vector<e::Vector3d> meas_pos_diff;
-          if (_debug_)
-            ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: Verified count: " << meas.verified_count);
-
-          // orientation
-          e::Quaterniond mean_rot = getAverageOrientation(meas.getVerified());
-          std::vector<e::Vector3d> meas_rpy_diff;
-
-          for (auto &m : meas.hypotheses){
-            if (m.flag == verified){
-              meas_pos_diff.push_back(m.pose.position-mean_pos);
-              meas_rpy_diff.push_back(quaternionToRPY(m.pose.orientation*mean_rot.inverse()));
-            }
-          }
-
-          if (_debug_)
-            ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: Verified count: " << meas.verified_count);
-
-          if (_debug_){
-            if (meas_pos_diff.size() > 0)
-              ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: meas_pos_diff: " << meas_pos_diff.at(0));
-            else
-              ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: meas_pos_diff is empty");
-          }
-          /* auto Hp = get3DEnclosingEllipsoid(meas_pos_diff,0.001); */
-          auto Hp = get3DEnclosingEllipsoid(meas_pos_diff);
-          if ( (Hp.first.array().isNaN().any()) ||(Hp.second.array().isNaN().any()) ){
-            ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: Position ellipsoid contains NaNs, returning...");
-            return std::nullopt;
-          }
-
-          if (_debug_){
-            if (meas_rpy_diff.size() > 0)
-              ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: meas_rpy_diff: " << meas_rpy_diff.at(0));
-            else
-              ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: meas_rpy_diff is empty");
-          }
-
-          auto Ho = get3DEnclosingEllipsoid(meas_rpy_diff);
-          if ( (Ho.first.array().isNaN().any()) ||(Ho.second.array().isNaN().any()) ){
-            ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: Orientation ellipsoid contains NaNs, returning...");
-            return std::nullopt;
-          }
-          
-          e::Vector3d mean_pos_shift = Hp.first;
-          
-          e::Quaterniond mean_rot_shift =
-                      e::AngleAxisd(Ho.first(0), e::Vector3d::UnitX()) *
-                      e::AngleAxisd(Ho.first(1), e::Vector3d::UnitY()) *
-                      e::AngleAxisd(Ho.first(2), e::Vector3d::UnitZ());
-
-          e::Matrix6d C = e::Matrix6d::Zero();
-          C.topLeftCorner(3,3) = Hp.second;
-          C.bottomRightCorner(3,3) = Ho.second;
-
-          std::pair<Pose,e::MatrixXd> output = {{.position=mean_pos+mean_pos_shift,.orientation=mean_rot*mean_rot_shift},C};
-          return output;
-        }
-
-        //based on [Nima Moshtagh (2022). Minimum Volume Enclosing Ellipsoid (https://www.mathworks.com/matlabcentral/fileexchange/9542-minimum-volume-enclosing-ellipsoid), MATLAB Central File Exchange. Retrieved May 11, 2022.]
-        //
-        //condition and initialization changed to one from [Michael J. Todd; E. Alper Yıldırım (2005). On Khachiyan’s Algorithm for the Computation of Minimum Volume Enclosing Ellipsoids] which seems to work much better
-        //
-        std::pair<e::Vector3d, e::Matrix3d> get3DEnclosingEllipsoid(std::vector<e::Vector3d> Pv){
-          //function [A , c] = MinVolEllipse(P, tolerance)
-
-          // [A , c] = MinVolEllipse(P, tolerance)
-          // Finds the minimum volume enclosing ellipsoid (MVEE) of a set of data
-          // points stored in matrix P. The following optimization problem is solved: 
-          //
-          // minimize       log(det(A))
-          // subject to     (P_i - c)' * A * (P_i - c) <= 1
-          //                
-          // in variables A and c, where P_i is the i-th column of the matrix P. 
-          // The solver is based on Khachiyan Algorithm, and the final solution 
-          // is different from the optimal value by the pre-spesified amount of 'tolerance'.
-          //
-          // inputs:
-          //---------
-          // P : (d x N) dimnesional matrix containing N points in R^d.
-          // tolerance : error in the solution with respect to the optimal value.
-          //
-          // outputs:
-          //---------
-          // A : (d x d) matrix of the ellipse equation in the 'center form': 
-          // (x-c)' * A * (x-c) = 1 
-          // c : 'd' dimensional vector as the center of the ellipse. 
-          // 
-          // example:
-          // --------
-          //      P = rand(5,100);
-          //      [A, c] = MinVolEllipse(P, .01)
-          //
-          //      To reduce the computation time, work with the boundary points only:
-          //      
-          //      K = convhulln(P');  
-          //      K = unique(K(:));  
-          //      Q = P(:,K);
-          //      [A, c] = MinVolEllipse(Q, .01)
-          //
-          //
-          // Nima Moshtagh (nima@seas.upenn.edu)
-          // University of Pennsylvania
-          //
-          // December 2005
-          // UPDATE: Jan 2009
-          //%%%%%%%%%%%%%%%%%%%% Solving the Dual problem%%%%%%%%%%%%%%%%%%%%%%%%%%%5
-          // ---------------------------------
-          // data points 
-          // -----------------------------------
-          int d = 3;
-          double n = (double)(d+1);
-          int N = (int)(Pv.size());
-
-          /* ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: N " << N); */
-          e::MatrixXd P = stdVecOfVectorsToMatrix(Pv);
-
-          e::MatrixXd Q = e::MatrixXd::Constant(4,N,1.0);
-          Q.block(0,0, 3,N) = P;
-          // initializations
-          // -----------------------------------
-          int count = 0;
-          [[maybe_unused]] double err = 1.0;
-          /* e::VectorXd u = (1.0/((double)(N))) * e::VectorXd::Constant(N,1.0);          // 1st iteration */
-          e::VectorXd u = e::VectorXd::Zero(N);
-
-          //initial volume approximation 
-          {
-            std::vector<e::Vector3d> Pv_local = Pv;
-            if (N <= (2*d)){
-              u = e::VectorXd::Constant(N,(1.0/((double)(N)))); 
-            }
-            else {
-              u = e::VectorXd::Zero(N);
-              int span_dim = 0;
-              int compliant_count = 0;
-              e::MatrixXd psi(3,0);
-              while (span_dim < d){
-                e::Vector3d direction;
-                if (span_dim == 0){
-                  direction = e::Vector3d(1.0,0.0,0.0);
-                }
-                else {
-                  e::FullPivLU<e::MatrixXd> lu(psi.transpose());
-                  e::MatrixXd l_null_space = lu.kernel();
-                  /* ROS_INFO_STREAM("[UVDARPoseCalculator]: span: \n" << psi); */
-                  /* ROS_INFO_STREAM("[UVDARPoseCalculator]: nullspace: \n" << l_null_space); */
-                  direction = l_null_space.topLeftCorner(3,1).normalized();
-                }
-                /* ROS_INFO_STREAM("[UVDARPoseCalculator]: direction: " << direction); */
-
-                double alpha = std::numeric_limits<double>::lowest();
-                double beta = std::numeric_limits<double>::max();
-                e::Vector3d a_alpha, a_beta;
-                int j_alpha = -1, j_beta = -1;
-                int j = 0;
-                for (e::Vector3d &v : Pv_local){
-                  if (v.array().isNaN().any()){
-                    j++;
-                    continue;
-                  }
-                  double dirtest = direction.transpose()*v;
-                  /* ROS_INFO_STREAM("[UVDARPoseCalculator]: dirtest: " << dirtest); */
-                  if (dirtest > alpha){
-                    alpha = dirtest;
-                    a_alpha = v;
-                    j_alpha = j;
-                  }
-                  if (dirtest < beta){
-                    beta = dirtest;
-                    a_beta = v;
-                    j_beta = j;
-                  }
-                  j++;
-                }
-                Pv_local[j_alpha] = e::Vector3d(std::nan(""),std::nan(""),std::nan(""));//so that we won't get duplicates
-                Pv_local[j_beta] = e::Vector3d(std::nan(""),std::nan(""),std::nan(""));//so that we won't get duplicates
-                /* ROS_INFO_STREAM("[UVDARPoseCalculator]: alpha: " << alpha << ", beta: " << beta); */
-                /* ROS_INFO_STREAM("[UVDARPoseCalculator]: j_alpha: " << j_alpha << ", j_beta: " << j_beta); */
-                if ((j_alpha == -1) || (j_beta == -1)){
-                  /* ROS_ERROR("[UVDARPoseCalculator]: index -1 on enclosing ellipsoid initialization!"); */
-                }
-                if (u(j_alpha)<1){
-                  compliant_count++;
-                  u(j_alpha) = 1.0;
-                }
-                if (u(j_beta)<1){
-                  compliant_count++;
-                  u(j_beta) = 1.0;
-                }
-                e::MatrixXd psi_new(3,span_dim+1);
-                psi_new << psi, (a_beta-a_alpha).normalized();
-                psi = psi_new;
-                span_dim++;
-              }
-              u = u*(1.0/(double)(compliant_count));
-              /* ROS_INFO_STREAM("[UVDARPoseCalculator]: Basing initial u on " << compliant_count << " points"); */
-            }
-          }
-          // Khachiyan Algorithm
-            // -----------------------------------
-          /* e::VectorXd cmp = e::VectorXd::Constant(N,((1+eps)*n)); */
-          /* ROS_INFO_STREAM("[UVDARPoseCalculator]: u_i:\n" << u.transpose()); */
-          while (count < 1000){
-            e::Matrix4d X = Q * u.asDiagonal() * Q.transpose();       // X = \sum_i ( u_i * q_i * q_i')  is a (d+1)x(d+1) matrix
-            e::VectorXd m = (Q.transpose() * X.inverse() * Q).diagonal();  // M the diagonal vector of an NxN matrix
-
-
-            int jp, jm;
-            /* ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: A"); */
-            /* ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: X " << X); */
-            /* ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: Q " << Q); */
-            /* ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: u " << u); */
-            /* ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: m " << m); */
-            double maximum = m.maxCoeff(&jp);
-            /* ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: B"); */
-            double minimum = m.minCoeff(&jm);
-            /* ROS_INFO_STREAM("[" << ros::this_node::getName().c_str() << "]: C"); */
-            double eps_plus = ((maximum/n) - 1.0);
-            double eps_minus = (1.0 - (minimum/n));
-
-            double eps = std::max(eps_plus,eps_minus);
-            bool test = ((m.array()>((1.0+eps)*n)).any()) || (((m.array()<((1.0-eps)*n))&&(u.array()>0.00001)).any()) ;
-            /* ROS_INFO_STREAM("["<< ros::this_node::getName().c_str()<<"]: " << u.transpose()); */
-            /* ROS_INFO_STREAM("["<< ros::this_node::getName().c_str()<<"]: " << m.transpose()); */
-            /* ROS_INFO_STREAM("["<< ros::this_node::getName().c_str()<<"]: " << ((1.0+eps)*n)); */
-            /* ROS_INFO_STREAM("["<< ros::this_node::getName().c_str()<<"]: " << (m.array()>((1.0+eps)*n))); */
-            /*   ROS_INFO_STREAM("["<< ros::this_node::getName().c_str()<<"]: " << ((1.0-eps)*n)); */
-            /*   ROS_INFO_STREAM("["<< ros::this_node::getName().c_str()<<"]: " << (m.array()<((1.0-eps)*n))); */
-            if (!test){
-              break;
-            }
-
-            double step_size;
-            e::VectorXd new_u;
-            if (eps_plus>=eps_minus){
-              eps = eps_plus;
-              step_size = (maximum - n)/(n*(maximum-1.0));
-              new_u = (1.0 - step_size)*u ;
-              new_u(jp) = new_u(jp) + step_size;
-              /* ROS_INFO_STREAM("["<< ros::this_node::getName().c_str()<<"]: " << "+"); */
-            }
-            else{
-              eps = eps_minus;
-              step_size = std::min(((n - minimum)/(n*(minimum-1.0))),((u(jm))/(1.0-u(jm))));
-              new_u = (1.0 + step_size)*u ;
-              new_u(jm) = new_u(jm) - step_size;
-              /* ROS_INFO_STREAM("["<< ros::this_node::getName().c_str()<<"]: " << "-"); */
-            }
-            count = count + 1;
-            err = (new_u - u).norm();
-            u = new_u;
-
-          }
-          /* ROS_INFO_STREAM("[UVDARPoseCalculator]: P:\n" << P); */
-          /* ROS_INFO_STREAM("[UVDARPoseCalculator]: u:\n" << u.transpose()); */
-          /* ROS_INFO_STREAM("["<< ros::this_node::getName().c_str()<<"]: " << "We did "<< count << " iterations. err: " << err ); */
-          //%%%%%%%%%%%%%%%%%% Computing the Ellipse parameters%%%%%%%%%%%%%%%%%%%%%%
-          // Finds the ellipse equation in the 'center form': 
-          // (x-c)' * A * (x-c) = 1
-          // It computes a dxd matrix 'A' and a d dimensional vector 'c' as the center
-          // of the ellipse. 
-          e::MatrixXd U = u.asDiagonal();
-          // the A matrix for the ellipse
-          // --------------------------------------------
-          /* e::Matrix3d A = (1.0/(double)(d)) * (P * U * P.transpose() - (P*u)*(P*u).transpose() ).inverse(); */
-          /* e::Matrix3d A = (1.0/(double)(d)) * (P * U * P.transpose() - (P*u)*(P*u).transpose() ).inverse(); */
-          /* e::Matrix3d A = (1.0/(double)(d)) * (P * U * P.transpose() - (P*u)*(P*u).transpose() ).inverse(); */
-
-          /* if (A.array().isNaN().any()){ */
-          /*   e::Vector3d c_z = P * u; */
-          /*   e::Matrix3d C_z = (double)(d) * (P * U * P.transpose() - (P*u)*(P*u).transpose() ); */
-          /*   return {c_z,C_z}; */
-          /* } */
-
-          //Now to convert it into covariance matrix
-          /* ROS_INFO_STREAM("[UVDARPoseCalculator]: A:\n" << A); */
-          /* e::JacobiSVD<e::MatrixXd> svd(A, e::ComputeThinU | e::ComputeThinV); */
-          /* ROS_INFO_STREAM("[UVDARPoseCalculator]: sgval of A:\n" << svd.singularValues().transpose()); */
-          /* ROS_INFO_STREAM("[UVDARPoseCalculator]: sgvec of A:\n" << svd.matrixV()); */
-
-          /* e::Vector3d sgvs = svd.singularValues(); */
-          /* e::Matrix3d D = ((sgvs.array()<0.00000001).select(std::numeric_limits<double>::max(),sgvs)).cwiseInverse().asDiagonal(); */
-          /* e::Matrix3d V = svd.matrixV(); */
-
-            /* ROS_INFO_STREAM("[UVDARPoseCalculator]: Singular values: [\n" << svd.singularValues() << "\n]"); */
-            /* ROS_INFO_STREAM("[UVDARPoseCalculator]: Matrix V: [\n" << svd.matrixV() << "\n]"); */
-
-          //
-          /* e::EigenSolver<e::Matrix3d> es(A); */
-          /* e::Matrix3d D = es.eigenvalues().real().cwiseInverse().asDiagonal(); */
-          /* e::Matrix3d V = es.eigenvectors().real(); */
-
-          /* ROS_INFO_STREAM("[UVDARPoseCalculator]: D:\n" << D); */
-
-          /* e::Matrix3d C = V*D*V.inverse(); */
-          e::Matrix3d C = (double)(d) * (P * U * P.transpose() - (P*u)*(P*u).transpose() );
-
-          // center of the ellipse 
-          // --------------------------------------------
-          e::Vector3d c = P * u;
-
-          return {c,C};
-        }
-
-        e::MatrixXd stdVecOfVectorsToMatrix(std::vector<e::Vector3d> V){
-          e::MatrixXd M(3,V.size());
-          int i = 0;
-          for (e::Vector3d &v : V){
-            M.block(0,i, 3,1) = v;
-            i++;
-          }
-          return M;
-        }
-
-
-        std::pair<std::pair<e::Vector3d, e::Quaterniond>, e::MatrixXd> twoMeasurementUnion(std::pair<std::pair<e::Vector3d, e::Quaterniond>, e::MatrixXd> a, std::pair<std::pair<e::Vector3d, e::Quaterniond>, e::MatrixXd> b){
-          e::MatrixXd U = e::MatrixXd::Identity(6,6);
-          e::Vector3d up;
-          e::Quaterniond uo;
-
-          //position
-
-          e::Matrix3d A = a.second.topLeftCorner(3,3);
-          e::Matrix3d B = b.second.topLeftCorner(3,3);
-
-          e::Vector3d c = b.first.first - a.first.first;
-          /* e::Matrix3d c2 = c*c.transpose(); */
-
-
-          double om = 0;
-          double  value_prev = std::numeric_limits<double>::max();
-
-          int pos_steps = 5;
-          for (int p = 0; p<=pos_steps; p++){
-            double om_tent = (double)(p)/(double)(pos_steps);
-
-            auto Ut = getCandidateUnion(A,B,c,om_tent);
-
-
-            double value_curr =Ut.determinant();
-            /* ROS_INFO_STREAM("[UVDARPoseCalculator]: om: "<< om_tent << ", val: " << value_curr); */
-            if (value_curr < value_prev){
-              /* ROS_INFO_STREAM("[UVDARPoseCalculator]: acc"); */
-              value_prev = value_curr;
-              om = om_tent;
-            }
-          }
-
-          U.topLeftCorner(3,3) = getCandidateUnion(A,B,c,om);
-          up = a.first.first + om*c;
-
-          //orientation
-
-          A = a.second.bottomRightCorner(3,3);
-          B = b.second.bottomRightCorner(3,3);
-
-          e::Quaterniond c_q = b.first.second*a.first.second.inverse();
-
-
-          /* double c_ang = e::AngleAxisd(c_q).angle(); */
-          e::Matrix3d c_M = c_q.toRotationMatrix();
-          e::Vector3d c_v = e::Vector3d( rotmatToRoll(c_M), rotmatToPitch(c_M), rotmatToYaw(c_M));
-          /* e::Matrix3d c2_o = c_v*c_v.transpose(); */
-
-
-          double om_o = 0;
-          value_prev = std::numeric_limits<double>::max();
-
-          int rot_steps = 5;
-          for (int p = 0; p<=rot_steps; p++){
-            double om_tent = (double)(p)/(double)(rot_steps);
-
-            auto Ut = getCandidateUnion(A,B,c_v,om_tent,false);
-            if (quaternionToRPY(c_q).norm() < 0.01){
-              ROS_INFO_STREAM("[UVDARPoseCalculator]: c_v: " << c_v.transpose() << "\n c2: \n" << c_v*c_v.transpose());
-              ROS_INFO_STREAM("[UVDARPoseCalculator]: U_t: " << Ut.eigenvalues().transpose());
-            }
-
 
-            double value_curr =Ut.determinant();
-            if (value_curr < value_prev){
-              value_prev = value_curr;
-              om_o = om_tent;
-            }
-          }
-
-          U.bottomRightCorner(3,3) = getCandidateUnion(A,B,c_v,om_o,false);
-          e::AngleAxisd c_aa = e::AngleAxisd(c_q);
-          uo = (e::AngleAxisd(c_aa.angle()*om_o,c_aa.axis()))*(a.first.second);
-
-          return {{up, uo}, U};
-        }
-
-        e::Matrix3d getCandidateUnion(const e::Matrix3d &A, const e::Matrix3d &B,const e::Vector3d &c, double om, bool force_consistency=true){
-
-          e::Matrix3d c2 = c*c.transpose();
-
-          double beta1 = 1.0, beta2 = 1.0;
-          if (force_consistency){
-            //The beta term comes from S. Reece and S. Roberts: Generalized Covariance Union: A Unified Approach to Hypothesis Merging in Tracking
-            e::LLT<e::Matrix3d,e::Upper> Sla(A);
-            e::Matrix3d Sa = Sla.matrixU();
-            e::Vector3d m1 = om*c;
-            double d1 = (Sa.transpose().inverse()*m1).norm();
-            double dc1 = ((1+d1)*(1+d1))/(1+(d1*d1));
-            beta1 = (d1>1?2:dc1);
-
-            e::LLT<e::Matrix3d,e::Upper> Slb(B);
-            e::Matrix3d Sb = Slb.matrixU();
-            e::Vector3d m2 = (1-om)*c;
-            double d2 = (Sb.transpose().inverse()*m2).norm();
-            double dc2 = ((1+d2)*(1+d2))/(1+(d2*d2));
-            beta2 = (d2>1?2:dc2);
-          }
-
-          //The rest of the algorithm comes from O. Bochardt, R. Calhoun, J.K.Uhlmann and S.J.Julier: Generalized information representation and compression using covariance union
-          e::Matrix3d U1     = beta1 * (A + (sqr(om)*c2));
-          e::Matrix3d U2     = beta2 * (B + (sqr(1.0-om)*c2));
-
-          e::LLT<e::Matrix3d,e::Upper> Sl(U2);
-          e::Matrix3d S = Sl.matrixU();
-          e::Matrix3d US = S.inverse().transpose()*U1*S.inverse();
-
-
-          e::JacobiSVD<e::MatrixXd> svd(US, e::ComputeThinU | e::ComputeThinV);
-
-          e::EigenSolver<e::Matrix3d> es(US);
-          e::Matrix3d D = es.eigenvalues().real().asDiagonal();
-          e::Matrix3d V = es.eigenvectors().real();
-          e::Matrix3d U = S.transpose()*V*(D.cwiseMax(e::Matrix3d::Identity()))*V.transpose()*S;
-
-          if (c.norm() < 0.01){
-            ROS_INFO_STREAM("[UVDARPoseCalculator]: Singular values: [\n" << svd.singularValues() << "\n]");
-            ROS_INFO_STREAM("[UVDARPoseCalculator]: Matrix V: [\n" << svd.matrixV() << "\n]");
 
-            ROS_INFO_STREAM("[UVDARPoseCalculator]: U1:\n " << U1);
-            ROS_INFO_STREAM("[UVDARPoseCalculator]: U2:\n " << U2);
-            ROS_INFO_STREAM("[UVDARPoseCalculator]: S: " << S);
-            ROS_INFO_STREAM("[UVDARPoseCalculator]: US: " << US);
-            ROS_INFO_STREAM("[UVDARPoseCalculator]: V: " << V);
-            ROS_INFO_STREAM("[UVDARPoseCalculator]: D: " << D);
-            ROS_INFO_STREAM("[UVDARPoseCalculator]: U: " << U);
-          }
-
-          return U;
-        }
 
         e::Vector3d directionFromCamPoint(cv::Point2d point, int image_index){
-          double v_i[2] = {(double)(point.y), (double)(point.x)};
-          double v_w_raw[3];
-          cam2world(v_w_raw, v_i, &(_oc_models_[image_index]));
-          return e::Vector3d(v_w_raw[1], v_w_raw[0], -v_w_raw[2]);
+          return cameras_[image_index].direction(e::Vector2d(point.x, point.y));
         }
 
         std::pair<cv::Point2d, double> camPointFromModelPoint(LEDMarker marker, int image_index){
@@ -4302,15 +3068,6 @@ namespace uvdar {
           return {output_position, cos_view_angle};
         }
 
-        cv::Point2i camPointFromGlobal(e::Vector3d ipt, int image_index, geometry_msgs::TransformStamped tocam_tf){
-
-          std::optional<e::Vector3d> position_transformed;
-          position_transformed = transform(ipt, tocam_tf).value();
-          LEDMarker tmpmarker;
-          tmpmarker.pose.position = position_transformed.value();
-          auto projection = camPointFromModelPoint(tmpmarker, image_index);
-          return projection.first;
-        }
 
         e::Vector3d camPositionFromGlobal(e::Vector3d ipt, geometry_msgs::TransformStamped tocam_tf){
 
@@ -4319,17 +3076,6 @@ namespace uvdar {
           return position_transformed.value();
         }
 
-        std::tuple<ImagePointIdentified,double,double> camPointFromGlobal(LEDMarker marker, int image_index, geometry_msgs::TransformStamped tocam_tf){
-
-          /* Pose pose_marker = {.position = marker.position, .orientation=marker.orientation}; */
-          Pose pose_transformed;
-          pose_transformed = transform(marker.pose, tocam_tf).value();
-          LEDMarker tmpmarker;
-          tmpmarker.pose = pose_transformed;
-          auto projection = camPointFromModelPoint(tmpmarker, image_index);
-          return {{.ID = marker.signal_id, .position = projection.first},pose_transformed.position.norm(),projection.second};
-        }
-
         /* std::pair<e::Vector3d, e::Matrix3d> opticalFromMarker(LEDMarker marker){ */
         /*   /1* e::Quaterniond q_rotator(0.5,0.5,-0.5,0.5); *1/ */
         /*   e::Matrix3d m_rotator; */
@@ -4378,10 +3124,8 @@ namespace uvdar {
         /* } */
 
         cv::Point2d camPointFromObjectPoint(e::Vector3d point, int image_index){
-          double v_w[3] = {point.y(), point.x(),-point.z()};
-          double v_i_raw[2];
-          world2cam(v_i_raw, v_w, &(_oc_models_[image_index]));
-          return cv::Point2d(v_i_raw[1], v_i_raw[0]);
+          auto projection = cameras_[image_index].project(point);
+          return cv::Point2d(projection.x(), projection.y());
         }
 
         std::optional<Pose> transform(Pose input, geometry_msgs::TransformStamped tf){
@@ -4461,39 +3205,6 @@ namespace uvdar {
         //}
 
 
-        /**
-         * @brief Returns true if the centroid of the image points is within <margin> pixels from the image edge
-         *
-         * @param points Vector of image points
-         * @param margin The distance from the image edge to consider
-         * @param image_index The index of the current camera used to generate the input points
-         *
-         * @return True if centroid is in the image margin, False otherwise
-         */
-        /* avgIsNearEdge //{ */
-        bool avgIsNearEdge(std::vector<ImagePointIdentified> points, int margin, int image_index){
-
-
-          cv::Point2d mean(0,0);
-          for (auto &point : points){
-            mean += cv::Point2d(point.position);
-          }
-
-          mean /= (int)(points.size());
-          if (
-              (mean.x < margin) ||
-              (mean.y < margin) ||
-              (mean.x > (camera_image_sizes_[image_index].width-margin)) ||
-              (mean.y > (camera_image_sizes_[image_index].height-margin))
-             ){
-            return true;
-          }
-
-
-          return false;
-        }
-        //}
-
 
         /**
          * @brief Thread function for optional visualization of separated markers
@@ -4503,11 +3214,17 @@ namespace uvdar {
         /* VisualizationThread() //{ */
         void VisualizationThread([[maybe_unused]] const ros::TimerEvent& te) {
           if (initialized_){
+            bool publish = _publish_visualization_ && pub_visualization_.wanted();
+            if (!publish && !_gui_){ //nobody would see the image
+              return;
+            }
             /* std::scoped_lock lock(mutex_visualization_); */
             if(generateVisualization(image_visualization_) >= 0){
               if ((image_visualization_.cols != 0) && (image_visualization_.rows != 0)){
-                if (_publish_visualization_){
-                  pub_visualization_->publish("ocv_point_separation", 0.01, image_visualization_, true);
+                if (publish){
+                  std_msgs::Header header;
+                  header.stamp = ros::Time::now();
+                  pub_visualization_.publish(cv_bridge::CvImage(header, "bgr8", image_visualization_).toImageMsg());
                 }
                 if (_gui_){
                   cv::imshow("ocv_point_separation_" + _uav_name_, image_visualization_);
@@ -4585,29 +3302,6 @@ namespace uvdar {
         }
 
 
-        /* Conversions of rotation matrices to aviation angles //{ */
-        /* rotmatToYaw //{ */
-        double rotmatToYaw(e::Matrix3d m){
-          return atan2(m(1,0),m(0,0));
-        }
-        //}
-        /* rotmatToPitch //{ */
-        double rotmatToPitch(e::Matrix3d m){
-          return atan2( -m(2,0), sqrt( m(2,1)*m(2,1) +m(2,2)*m(2,2) )  );
-        }
-        //}
-        /* rotmatToRoll //{ */
-        double rotmatToRoll(e::Matrix3d m){
-          return atan2(m(2,1),m(2,2));
-        }
-        //}
-
-        e::Vector3d quaternionToRPY(e::Quaterniond q){
-          auto rotmat = q.toRotationMatrix();
-          return e::Vector3d(rotmatToRoll(rotmat), rotmatToPitch(rotmat), rotmatToYaw(rotmat));
-        }
-
-        //}
 
         e::Vector3d fastMatrixVectorProduct(e::Matrix3d M, e::Vector3d v){//matrix - vector multiplication in this order
           e::Vector3d output;
@@ -4640,6 +3334,8 @@ namespace uvdar {
         /* attributes //{ */
         bool _debug_;
         bool _profiling_;
+        bool _packed_input_; //if true, the compact variants of the input point topics are subscribed
+        std::string _trace_file_; //if not empty, the trace is recorded and written to this file on shutdown
 
         std::string _uav_name_;
 
@@ -4648,7 +3344,10 @@ namespace uvdar {
 
 
         using blinkers_seen_callback_t = boost::function<void (const uvdar_core::ImagePointsWithFloatStampedConstPtr& msg)>;
+        using packed_blinkers_seen_callback_t = boost::function<void (const uvdar_core::ImagePointsPackedStampedConstPtr& msg)>;
         std::vector<ros::Subscriber> sub_blinkers_seen_;
+        std::vector<ros::Subscriber> sub_blinkers_latency_;
+        std::vector<std::unique_ptr<trace::LatencyMatcher>> latency_matchers_;
         ros::Time last_blink_time_;
 
         using estimated_framerate_callback_t = boost::function<void (const std_msgs::Float32ConstPtr& msg)>;
@@ -4663,11 +3362,12 @@ namespace uvdar {
         bool _gui_;
         bool _publish_visualization_;
         bool _publish_constituents_;
+        double _constituents_period_; //minimum time between two messages with the constituent hypotheses
 
         ros::Timer timer_visualization_;
         std::vector<cv::Size> camera_image_sizes_;
         cv::Mat image_visualization_;
-        std::unique_ptr<mrs_lib::ImagePublisher> pub_visualization_;
+        lazy_publisher::Publisher<image_transport::Publisher> pub_visualization_;
 
 
         std::vector<struct ocam_model> _oc_models_;
@@ -4681,9 +3381,11 @@ namespace uvdar {
 
         /* std::vector<ros::Publisher> pub_measured_poses_; */
         ros::Publisher pub_measured_poses_;
+        ros::Publisher pub_measured_poses_latency_;
+        int64_t last_latency_origin_ = 0; //first stamp of the latest latency trailer forwarded to the filter
         /* std::vector<ros::Publisher> pub_constituent_poses_; */
-        ros::Publisher pub_hypotheses_;
-        ros::Publisher pub_hypotheses_tentative_;
+        lazy_publisher::Publisher<ros::Publisher> pub_hypotheses_;
+        lazy_publisher::Publisher<ros::Publisher> pub_hypotheses_tentative_;
 
         std::vector<int> _signal_ids_;
         int signals_per_target_;
@@ -4710,6 +3412,25 @@ namespace uvdar {
 
         std::string _output_frame_;
 
+        bool _p3p_initialization_;
+        bool _lm_refinement_;
+        bool _adaptive_hypothesis_count_;
+        bool _weighted_resampling_;
+        bool _selective_initialization_;
+        double _reinitialization_period_; //s - targets are re-initialized at least this often, even if they are tracked well
+        bool _filtering_process_all_; //if false, only the latest observation of each camera is used, and the older ones waiting in the queue are dropped
+        int _filtering_queue_size_;
+
+        std::vector<pose_core::CameraModel> cameras_;
+        std::vector<pose_core::Reprojection> reprojections_;
+        std::vector<std::vector<pose_core::Marker>> target_markers_; // the model with the signals of each target
+        std::atomic<unsigned long> error_evaluations_ = 0;
+        std::atomic<unsigned long> error_frustum_rejections_ = 0;
+        std::atomic<unsigned long> error_early_exits_ = 0;
+        std::unique_ptr<diagnostics::Publisher> diagnostics_;
+        unsigned long initializations_performed_ = 0;
+        unsigned long initializations_skipped_ = 0;
+
         bool _separate_by_distance_;
         double _max_cluster_distance_;
 
@@ -4730,13 +3451,14 @@ namespace uvdar {
         /* std::vector<std::shared_ptr<std::mutex>>  mutex_separated_points_; */
         /* std::vector<std::vector<std::pair<int,std::vector<cv::Point3d>>>> separated_points_; */
 
-        double led_projection_coefs_[3] = {1.3398, 31.4704, 0.0154}; //empirically measured coefficients of the decay of blob radius wrt. distance of a LED in our UVDAR cameras.
+        std::array<double,3> led_projection_coefs_ = {1.3398, 31.4704, 0.0154}; //empirically measured coefficients of the decay of blob radius wrt. distance of a LED in our UVDAR cameras.
 
 
         std::mutex input_mutex;
-        std::mutex hypothesis_mutex;
+        std::shared_mutex hypothesis_buffer_mutex_; //guards only the list of targets, the hypotheses of each target are guarded by their own mutex
         std::mutex transformer_mutex;
-        std::mutex threadconfig_mutex;
+        std::ofstream replay_file_;
+        std::mutex replay_mutex_;
         mrs_lib::Transformer transformer_;
         /* std::vector<std::optional<geometry_msgs::TransformStamped>> tf_fcu_to_cam; */
         /* std::vector<e::Quaterniond> camera_view_; */
@@ -4745,7 +3467,8 @@ namespace uvdar {
         /* e::Quaterniond rot_optical_to_base = e::Quaterniond(0.5,-0.5,0.5,-0.5); */
 
         std::unique_ptr<mrs_lib::ThreadTimer>  initializer_thread_=nullptr;
-        std::unique_ptr<mrs_lib::ThreadTimer>  particle_filtering_thread_=nullptr;
+        std::vector<std::unique_ptr<CameraInputQueue>> input_queues_;
+        std::vector<std::thread> particle_filtering_workers_;
         ros::Timer timer_initializer_;
         ros::Timer timer_particle_filter_;
 
@@ -4754,7 +3477,7 @@ namespace uvdar {
         /* std::vector<geometry_msgs::TransformStamped> fromcam_tf_; */
         /* std::vector<InputData> previous_input_data_; */
 
-        std::vector<AssociatedHypotheses> hypothesis_buffer_;
+        std::vector<std::shared_ptr<AssociatedHypotheses>> hypothesis_buffer_;
 
         //}
   };
@@ -0,0 +1,389 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <optional>
+#include <ctime>
+#include <pose_core/pose_core.h>
+#include <pose_core/hypotheses.h>
+
+#define LED_PROJECTION_COEFS {1.3398, 31.4704, 0.0154} // as in the pose calculator
+#define VIEW_ANGLE_MARGIN 0.0349066 // 2 deg
+#define LED_GROUP_DISTANCE 0.03
+
+#define OBSERVATION_RATE 30.0 //Hz - rate of the observations of the target, also assumed for recorded observations
+#define INITIALIZATION_PERIOD 1.0 //s - as the initialization thread of the pose calculator
+#define REINITIALIZATION_PERIOD 5.0 //s - as the default of the pose calculator
+#define SYNTHETIC_DURATION 60.0 //s
+#define SYNTHETIC_TARGET_SPREAD 4.0 //m - lateral distance between the outermost synthetic targets
+#define SYNTHETIC_OCCLUSION_START 30.0 //s - the synthetic targets are not observed for a while, to measure their re-acquisition
+#define SYNTHETIC_OCCLUSION_DURATION 2.5 //s - longer than the hypotheses survive without observations
+#define ACQUISITION_GAP 0.5 //s - a target not observed for longer is considered lost, and re-acquired by the next fused pose
+
+namespace e = Eigen;
+using namespace uvdar;
+
+/**
+ * @brief A recorded or generated observation of the target by the camera
+ */
+struct Frame {
+  int target = 0;
+  double time; //s
+  pose_core::Pose tocam;
+  std::vector<pose_core::ObservedPoint> points;
+  std::optional<pose_core::Pose> truth; // the pose of the target in the output frame, if known
+};
+
+/**
+ * @brief Statistics of a quantity sampled during the replay, such as the duration of a stage of the pose estimation
+ */
+struct Statistics {
+  std::string name;
+  std::string unit;
+  std::vector<double> values;
+
+  void print() const {
+    if (values.empty()){
+      std::cout << name << ": no samples" << std::endl;
+      return;
+    }
+    auto sorted = values;
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0;
+    for (auto v : sorted){
+      sum += v;
+    }
+    const std::string suffix = (unit.empty()?"":(" " + unit));
+    std::cout << name << ": mean " << sum/sorted.size() << suffix << ", median " << sorted[sorted.size()/2] << suffix << ", 99th percentile " << sorted[(sorted.size()*99)/100] << suffix << ", max " << sorted.back() << suffix << " (" << sorted.size() << " samples)" << std::endl;
+  }
+};
+
+/**
+ * @brief The hypotheses of a single target and the timers of their lifecycle
+ */
+struct TargetState {
+  std::unique_ptr<pose_core::AssociatedHypotheses> hypotheses;
+  double next_initialization = 0;
+  double next_scatter = 0;
+  std::optional<double> last_observed;
+  std::optional<double> acquisition_start; // the first observation after the target appeared or reappeared, until a pose is fused
+  int acquisitions = 0;
+};
+
+/**
+ * @brief Switches of the hypothesis lifecycle, as the parameters of the pose calculator
+ */
+struct LifecycleOptions {
+  bool p3p_initialization = true;
+  bool lm_refinement = true;
+  bool adaptive_count = true;
+  bool weighted_resampling = true;
+  bool selective_initialization = true;
+};
+
+template <class F>
+static double measure(F &&f){
+  auto start = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+static pose_core::Pose inverse(const pose_core::Pose &pose){
+  pose_core::Pose output;
+  output.orientation = pose.orientation.inverse();
+  output.position = -(output.orientation*pose.position);
+  return output;
+}
+
+/* loadReplay //{ */
+/**
+ * @brief Loads observations recorded by the pose calculator (see its pose_core_replay_file parameter). Each line holds the transformation from the output frame to the camera as "x y z qw qx qy qz", followed by the number of observed points and the "signal x y" triplet of each. The signals are the IDs of the model file, not the IDs of the target. The line may end with the ground truth pose of the target in the output frame as "x y z qw qx qy qz", e.g. added from a motion capture system. The lines are replayed as consecutive observations of a single target at OBSERVATION_RATE
+ */
+static std::optional<std::vector<Frame>> loadReplay(const std::string &file_name){
+  std::ifstream ifs(file_name);
+  if (!ifs.good()){
+    return std::nullopt;
+  }
+  std::vector<Frame> output;
+  std::string line;
+  while (getline(ifs, line)){
+    if (line.empty() || (line[0] == '#')){
+      continue;
+    }
+    std::stringstream iss(line);
+    Frame frame;
+    double qw, qx, qy, qz;
+    int count;
+    iss >> frame.tocam.position.x() >> frame.tocam.position.y() >> frame.tocam.position.z() >> qw >> qx >> qy >> qz >> count;
+    frame.tocam.orientation = e::Quaterniond(qw, qx, qy, qz).normalized();
+    for (int i = 0; (i < count) && iss; i++){
+      pose_core::ObservedPoint point;
+      iss >> point.signal >> point.position.x() >> point.position.y();
+      frame.points.push_back(point);
+    }
+    pose_core::Pose truth;
+    if (iss && (iss >> truth.position.x())){
+      iss >> truth.position.y() >> truth.position.z() >> qw >> qx >> qy >> qz;
+      truth.orientation = e::Quaterniond(qw, qx, qy, qz).normalized();
+      frame.truth = truth;
+    }
+    else if (iss.eof() && (!iss.bad())){
+      iss.clear();
+    }
+    if (!iss){
+      std::cerr << "Skipping malformed line: " << line << std::endl;
+      continue;
+    }
+    frame.time = output.size()/OBSERVATION_RATE;
+    output.push_back(frame);
+  }
+  return output;
+}
+//}
+
+/* generateTrajectory //{ */
+/**
+ * @brief Generates observations of targets flying along smooth trajectories in front of the camera, seen from above such that the LEDs do not project onto a line. The targets are spread out sideways and their trajectories are shifted in phase. They are occluded for SYNTHETIC_OCCLUSION_DURATION once. The output frame is the frame of the camera
+ */
+static std::vector<Frame> generateTrajectory(const pose_core::Reprojection &reprojection, const std::vector<pose_core::Marker> &markers, double duration, int target_count){
+  std::vector<Frame> output;
+  for (int k = 0; k < (int)(duration*OBSERVATION_RATE); k++){
+    for (int target = 0; target < target_count; target++){
+      Frame frame;
+      frame.target = target;
+      frame.time = k/OBSERVATION_RATE;
+      const double phase = frame.time + 2.0*target;
+      const double offset = ((target_count > 1)?(SYNTHETIC_TARGET_SPREAD*((double)(target)/(target_count-1) - 0.5)):0.0);
+      pose_core::Pose pose;
+      pose.position = e::Vector3d(offset + 1.5*sin(0.4*phase)/target_count, 0.5*sin(0.7*phase), 7.0+2.0*sin(0.3*phase));
+      pose.orientation =
+        e::AngleAxisd(M_PI/2, e::Vector3d::UnitY())*
+        e::AngleAxisd(0.5+0.1*sin(phase), e::Vector3d::UnitY())*
+        e::AngleAxisd(0.5*phase, e::Vector3d::UnitZ());
+      if ((frame.time < SYNTHETIC_OCCLUSION_START) || (frame.time >= SYNTHETIC_OCCLUSION_START + SYNTHETIC_OCCLUSION_DURATION)){
+        reprojection.hypothesisError(markers, pose, frame.tocam, {}, std::numeric_limits<double>::max(), false, &frame.points);
+      }
+      frame.truth = pose;
+      output.push_back(frame);
+    }
+  }
+  return output;
+}
+//}
+
+static void printUsage(const char *name){
+  std::cerr << "Usage: " << name << " [options] <OCamCalib calibration file> <model file> [replay file]" << std::endl;
+  std::cerr << "Replays the hypothesis lifecycle of the pose calculator (initialization, fitness checks, scattering, culling and fusion) on recorded observations, or on " << SYNTHETIC_DURATION << " s of a synthetic trajectory if no replay file is given. Prints the timing of each stage, the CPU time, the time to the first fused pose and to the re-acquisition of lost targets and, where the ground truth is known, the error of the fused poses." << std::endl;
+  std::cerr << "Options:" << std::endl;
+  std::cerr << "  --baseline         initialize by random sampling only, without P3P seeding and Levenberg-Marquardt refinement" << std::endl;
+  std::cerr << "  --fixed-count      keep the fixed maximum number of hypotheses per target instead of adapting it" << std::endl;
+  std::cerr << "  --no-selective     initialize the targets on every initialization cycle, even if they are already tracked" << std::endl;
+  std::cerr << "  --targets <count>  number of targets of the synthetic trajectory, 1 by default" << std::endl;
+}
+
+/* main //{ */
+int main(int argc, char** argv) {
+  LifecycleOptions options;
+  int target_count = 1;
+  std::vector<std::string> arguments;
+  for (int i = 1; i < argc; i++){
+    std::string argument(argv[i]);
+    if (argument == "--baseline"){
+      options.p3p_initialization = false;
+      options.lm_refinement = false;
+    }
+    else if (argument == "--fixed-count"){
+      options.adaptive_count = false;
+    }
+    else if (argument == "--no-selective"){
+      options.selective_initialization = false;
+    }
+    else if ((argument == "--targets") && (i+1 < argc)){
+      target_count = std::atoi(argv[++i]);
+      if (target_count < 1){
+        std::cerr << "The number of targets must be positive" << std::endl;
+        return 1;
+      }
+    }
+    else if (argument.rfind("--", 0) == 0){
+      std::cerr << "Unknown option " << argument << std::endl;
+      printUsage(argv[0]);
+      return 1;
+    }
+    else {
+      arguments.push_back(argument);
+    }
+  }
+  if ((arguments.size() < 2) || (arguments.size() > 3)){
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  ocam_model oc_model;
+  if (get_ocam_model(&oc_model, (char*)(arguments[0].c_str())) < 0){
+    std::cerr << "Failed to load the calibration file " << arguments[0] << std::endl;
+    return 1;
+  }
+  const pose_core::CameraModel camera(oc_model);
+  const pose_core::Reprojection reprojection(camera, LED_PROJECTION_COEFS, VIEW_ANGLE_MARGIN);
+
+  auto markers = pose_core::loadModel(arguments[1]);
+  if (!markers || markers->empty()){
+    std::cerr << "Failed to load the model file " << arguments[1] << std::endl;
+    return 1;
+  }
+  const auto groups = pose_core::groupMarkers(markers.value(), LED_GROUP_DISTANCE);
+  const double max_diameter = pose_core::visibleDiameters(markers.value(), groups).first;
+
+  std::vector<Frame> frames;
+  if (arguments.size() == 3){
+    if (target_count != 1){
+      std::cerr << "Replay files hold the observations of a single target, ignoring --targets" << std::endl;
+      target_count = 1;
+    }
+    auto loaded = loadReplay(arguments[2]);
+    if (!loaded){
+      std::cerr << "Failed to load the replay file " << arguments[2] << std::endl;
+      return 1;
+    }
+    frames = loaded.value();
+  }
+  else {
+    frames = generateTrajectory(reprojection, markers.value(), SYNTHETIC_DURATION, target_count);
+  }
+  if (frames.empty()){
+    std::cerr << "No observations to replay" << std::endl;
+    return 1;
+  }
+  std::cout << "Replaying " << frames.size() << " observations of " << target_count << " target(s), initializing " << (options.p3p_initialization?"by P3P":"by random sampling") << (options.lm_refinement?" with Levenberg-Marquardt refinement":"") << ", with " << (options.adaptive_count?"the adaptive":"the fixed") << " hypothesis count, " << (options.selective_initialization?"skipping":"not skipping") << " the initialization of tracked targets" << std::endl;
+
+  Statistics initialization_statistics = {"Initialization", "us", {}};
+  Statistics check_statistics = {"Fitness check", "us", {}};
+  Statistics scatter_statistics = {"Scattering and culling", "us", {}};
+  Statistics fusion_statistics = {"Fusion", "us", {}};
+  Statistics position_errors = {"Position error", "m", {}};
+  Statistics orientation_errors = {"Orientation error", "deg", {}};
+  Statistics first_pose_times = {"Time to the first pose", "s", {}};
+  Statistics first_pose_processing = {"Processing to the first pose", "ms", {}};
+  Statistics reacquisition_times = {"Time to re-acquisition", "s", {}};
+  Statistics hypothesis_counts = {"Hypotheses per target", "", {}};
+  long initializations = 0, initializations_skipped = 0, fused_count = 0, scatter_count = 0;
+  pose_core::FitnessStatistics fitness_total;
+  double processing_time = 0; //us
+
+  std::vector<TargetState> targets(target_count);
+  const std::clock_t cpu_start = std::clock();
+  for (auto &frame : frames){
+    auto &target = targets[frame.target];
+    auto &hypotheses = target.hypotheses;
+    pose_core::Observation observation;
+    observation.target = frame.target;
+    observation.markers = &markers.value();
+    observation.tocam = frame.tocam;
+    observation.fromcam = inverse(frame.tocam);
+    observation.points = frame.points;
+    observation.time = frame.time;
+
+    if (!observation.points.empty()){
+      if ((!target.last_observed) || (frame.time - target.last_observed.value() > ACQUISITION_GAP)){
+        target.acquisition_start = frame.time;
+      }
+      target.last_observed = frame.time;
+    }
+
+    // the steps are taken in the order of the threads of the pose calculator - the filtering with each observation, the initialization and the scattering on their timers
+    if (hypotheses && (!observation.points.empty())){
+      check_statistics.values.push_back(measure([&]{
+            auto fitness = pose_core::checkHypothesisFitness(*hypotheses, reprojection, observation, 0);
+            hypotheses->removeUnfit();
+            fitness_total.evaluations += fitness.evaluations;
+            fitness_total.outside_view += fitness.outside_view;
+            fitness_total.early_exits += fitness.early_exits;
+            }));
+      processing_time += check_statistics.values.back();
+    }
+
+    // as the timer of the initialization thread, the cycles pass also while the target is not observed
+    if (frame.time >= target.next_initialization){
+      target.next_initialization += INITIALIZATION_PERIOD;
+      if (!observation.points.empty()){
+        if (options.selective_initialization && hypotheses && pose_core::isTargetTracked(*hypotheses, camera, 0, (int)(observation.points.size()), frame.time, REINITIALIZATION_PERIOD)){
+          initializations_skipped++;
+        }
+        else {
+          initialization_statistics.values.push_back(measure([&]{
+                auto new_hypotheses = pose_core::initialHypotheses(reprojection, observation, groups, max_diameter, options.p3p_initialization, options.lm_refinement);
+                if (!hypotheses){
+                  hypotheses = std::make_unique<pose_core::AssociatedHypotheses>(new_hypotheses, observation.target);
+                }
+                else {
+                  hypotheses->addHypotheses(new_hypotheses);
+                }
+                hypotheses->last_initialization = frame.time;
+                }));
+          processing_time += initialization_statistics.values.back();
+          initializations++;
+        }
+      }
+    }
+
+    if (frame.time >= target.next_scatter){
+      target.next_scatter += SCATTER_TIME_STEP;
+      if (hypotheses){
+        scatter_statistics.values.push_back(measure([&]{
+              hypotheses->addHypotheses(pose_core::mutateHypotheses(*hypotheses, hypotheses->hypotheses.size()/2));
+              pose_core::removeExtraHypotheses(*hypotheses, frame.time, options.adaptive_count, options.weighted_resampling);
+              }));
+        std::optional<std::pair<pose_core::Pose,pose_core::Matrix6d>> fused;
+        fusion_statistics.values.push_back(measure([&]{
+              fused = pose_core::fuseHypotheses(*hypotheses);
+              }));
+        processing_time += scatter_statistics.values.back() + fusion_statistics.values.back();
+        hypothesis_counts.values.push_back(hypotheses->hypotheses.size());
+        if (fused){
+          fused_count++;
+          if (target.acquisition_start){
+            if (target.acquisitions == 0){
+              first_pose_times.values.push_back(frame.time - target.acquisition_start.value());
+              first_pose_processing.values.push_back(processing_time/1000.0);
+            }
+            else {
+              reacquisition_times.values.push_back(frame.time - target.acquisition_start.value());
+            }
+            target.acquisition_start.reset();
+            target.acquisitions++;
+          }
+          if (frame.truth){
+            position_errors.values.push_back((fused->first.position - frame.truth->position).norm());
+            orientation_errors.values.push_back(fused->first.orientation.angularDistance(frame.truth->orientation)*180.0/M_PI);
+          }
+        }
+        scatter_count++;
+        pose_core::propagateHypotheses(*hypotheses, frame.time);
+      }
+    }
+  }
+  const double cpu_time = 1000.0*(std::clock() - cpu_start)/CLOCKS_PER_SEC; //ms
+  const double duration = frames.back().time - frames.front().time + 1.0/OBSERVATION_RATE;
+
+  initialization_statistics.print();
+  check_statistics.print();
+  scatter_statistics.print();
+  fusion_statistics.print();
+  std::cout << "Initializations: " << initializations << ", skipped as already tracked: " << initializations_skipped << std::endl;
+  std::cout << "Hypothesis error evaluations: " << fitness_total.evaluations << ", rejected by view frustum: " << fitness_total.outside_view << ", terminated early: " << fitness_total.early_exits << std::endl;
+  hypothesis_counts.print();
+  std::cout << "Fused poses: " << fused_count << "/" << scatter_count << " scattering cycles" << std::endl;
+  std::cout << "CPU time: " << cpu_time/duration << " ms per second of observations, " << cpu_time/(duration*target_count) << " ms per second per target" << std::endl;
+  first_pose_times.print();
+  first_pose_processing.print();
+  reacquisition_times.print();
+  position_errors.print();
+  orientation_errors.print();
+  return 0;
+}
+//}
@@ -7,6 +7,8 @@
 #include <mrs_msgs/String.h>
 #include <std_msgs/Float32.h>
 #include <uvdar_core/RecMsg.h>
+#include <diagnostics/diagnostics.h>
+#include <packed_points/packed_points.h>
 #include <string>
 #include <cmath>
 
@@ -30,6 +32,8 @@ std::vector<std::string>    estimated_framerate_topics;
 std::vector<ros::Publisher> pub_blinkers_seen;
 std::vector<ros::Publisher> pub_estimated_framerate;
 using points_seen_callback = boost::function<void(const uvdar_core::ImagePointsWithFloatStampedConstPtr&)>;
+using packed_points_seen_callback = boost::function<void(const uvdar_core::ImagePointsPackedStampedConstPtr&)>;
+bool packed_input = false;  // if true, the compact variants of the point topics are subscribed
 std::vector<points_seen_callback> callbacks_points_seen;
 std::vector<ros::Subscriber>      subscribers_points_seen;
 
@@ -45,8 +49,10 @@ public:
     param_loader.loadParam("uav_id", uav_id);
     param_loader.loadParam("recieved_topic", recieved_topic);
     param_loader.loadParam("points_seen_topics", points_seen_topics, points_seen_topics);
+    param_loader.loadParam("packed_input", packed_input, bool(false));
     param_loader.loadParam("blinkers_seen_topics", blinkers_seen_topics, blinkers_seen_topics);
     param_loader.loadParam("estimated_framerate_topics", estimated_framerate_topics, estimated_framerate_topics);
+    diagnostics_ = std::make_unique<uvdar::diagnostics::Publisher>(nh, "rx");
     if (points_seen_topics.empty()) {
       ROS_WARN("[RX_processor]: No topics of points_seen_topics were supplied. Returning.");
       return;
@@ -73,7 +79,12 @@ public:
       // callback of individual image frames
       points_seen_callback callback = [i, this](const uvdar_core::ImagePointsWithFloatStampedConstPtr& pointsMessage) { VisiblePoints(pointsMessage, i); };
       callbacks_points_seen.push_back(callback);
-      subscribers_points_seen.push_back(nh.subscribe(points_seen_topics[i], 1, callbacks_points_seen[i]));
+      if (packed_input) {
+        packed_points_seen_callback packed_callback = [callback](const uvdar_core::ImagePointsPackedStampedConstPtr& pointsMessage) { callback(uvdar::packed_points::unpack(*pointsMessage)); };
+        subscribers_points_seen.push_back(nh.subscribe(points_seen_topics[i] + PACKED_POINTS_SUFFIX, 1, packed_callback));
+      } else {
+        subscribers_points_seen.push_back(nh.subscribe(points_seen_topics[i], 1, callbacks_points_seen[i]));
+      }
     }
 
     ROS_INFO("Node initialized");
@@ -141,6 +152,8 @@ private:
   }
 
   void VisiblePoints(const uvdar_core::ImagePointsWithFloatStampedConstPtr& points_seen_msg, size_t camera_index) {
+    diagnostics_->count("frames received");
+    diagnostics_->gauge("points per frame", (double)(points_seen_msg->points.size()));
     /*
      *Estimation and publishing of camera framerate
      * */
@@ -451,6 +464,7 @@ private:
 
       if (faults != 0) {  // if both corrections were not succesful, ignore received frame
         ROS_WARN("Not able to decode msg");
+        diagnostics_->count("undecodable messages");
         received_msg_raw.clear();
         continue;
       }
@@ -524,6 +538,7 @@ private:
 
       // publish decoded message
       pub_rec_msg.publish(rm_pub);
+      diagnostics_->count("messages published");
 
       received_msg.clear();
       received_msg_raw.clear();
@@ -554,6 +569,7 @@ private:
   };
   std::vector<std::vector<std::vector<PointSeen>>> point_seen;  // ith camera, jth cluster, kth time of visible point
   std::vector<CamInfo>                             cam_info;
+  std::unique_ptr<uvdar::diagnostics::Publisher> diagnostics_;
 };
 }  // namespace RX
 int main(int argc, char** argv) {
@@ -0,0 +1,187 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <limits>
+#include <cmath>
+#include <algorithm>
+#include <assignment/assignment.h>
+
+using namespace uvdar;
+
+#define RANDOM_PROBLEM_COUNT 3000
+#define RANDOM_PROBLEM_MAX_SIZE 6
+#define FORBIDDEN_PROBABILITY 0.4
+#define SWARM_COUNT 2000
+#define SWARM_MIN_SIZE 5
+#define SWARM_MAX_SIZE 50
+#define MATCH_LEVEL_THRESHOLD_ASSOCIATE 0.3 // as in the filter
+
+static const double forbidden = std::numeric_limits<double>::infinity();
+
+/* helpers //{ */
+/**
+ * @brief The count of assigned pairs and their total cost
+ */
+static std::pair<int,double> score(const e::MatrixXd &cost, const std::vector<int> &assigned){
+  int count = 0;
+  double sum = 0;
+  for (int i = 0; i < (int)(assigned.size()); i++){
+    if (assigned[i] >= 0){
+      count++;
+      sum += cost(i,assigned[i]);
+    }
+  }
+  return {count, sum};
+}
+
+/**
+ * @brief Finds the best score by enumerating all assignments - the most allowed pairs first, then the least total cost
+ */
+static void bruteForce(const e::MatrixXd &cost, int row, std::vector<int> &current, std::vector<bool> &used, std::pair<int,double> &best){
+  if (row == cost.rows()){
+    auto current_score = score(cost, current);
+    if ((current_score.first > best.first) || ((current_score.first == best.first) && (current_score.second < best.second))){
+      best = current_score;
+    }
+    return;
+  }
+  current[row] = -1;
+  bruteForce(cost, row+1, current, used, best);
+  for (int j = 0; j < cost.cols(); j++){
+    if ((!used[j]) && std::isfinite(cost(row,j))){
+      used[j] = true;
+      current[row] = j;
+      bruteForce(cost, row+1, current, used, best);
+      used[j] = false;
+      current[row] = -1;
+    }
+  }
+}
+
+/**
+ * @brief The association used by the filter before the assignment solver - each state in turn takes the measurement with the highest match level above the threshold, and all measurements above the threshold for it are discarded
+ */
+static std::vector<int> greedyAssociation(e::MatrixXd match_matrix, double threshold){
+  std::vector<int> output(match_matrix.rows(), -1);
+  for (int f_i = 0; f_i < match_matrix.cols(); f_i++){
+    int best_index = -1;
+    double best_level = -1;
+    for (int m_i = 0; m_i < match_matrix.rows(); m_i++){
+      if ((match_matrix(m_i,f_i) > threshold) && (match_matrix(m_i,f_i) > best_level)){
+        best_level = match_matrix(m_i,f_i);
+        best_index = m_i;
+      }
+    }
+    if (best_index >= 0){
+      output[best_index] = f_i;
+      for (int f_j = 0; f_j < match_matrix.cols(); f_j++){
+        match_matrix(best_index,f_j) = std::nan("");
+      }
+    }
+    for (int m_i = 0; m_i < match_matrix.rows(); m_i++){
+      if (match_matrix(m_i,f_i) > threshold){
+        match_matrix(m_i,f_i) = std::nan("");
+      }
+    }
+  }
+  return output;
+}
+//}
+
+/* small cases //{ */
+TEST(Assignment, EmptyProblems){
+  EXPECT_TRUE(assignment::solve(e::MatrixXd(0,3)).empty());
+  EXPECT_EQ(assignment::solve(e::MatrixXd(2,0)), std::vector<int>({-1,-1}));
+}
+
+TEST(Assignment, AllForbidden){
+  EXPECT_EQ(assignment::solve(e::MatrixXd::Constant(2,3,forbidden)), std::vector<int>({-1,-1}));
+}
+
+TEST(Assignment, PrefersMorePairsOverLowerCost){
+  e::MatrixXd cost(2,2);
+  cost << 0.0,  1.0,
+          10.0, forbidden;
+  // assigning row 0 to column 0 alone would be cheaper, but leaves row 1 unassigned
+  EXPECT_EQ(assignment::solve(cost), std::vector<int>({1,0}));
+}
+
+TEST(Assignment, RectangularBothOrientations){
+  e::MatrixXd cost(3,2);
+  cost << 5.0, 1.0,
+          1.0, 5.0,
+          0.5, 3.0;
+  EXPECT_EQ(assignment::solve(cost), std::vector<int>({1,-1,0}));
+  EXPECT_EQ(assignment::solve(cost.transpose()), std::vector<int>({2,0}));
+}
+//}
+
+/* random problems //{ */
+TEST(Assignment, OptimalOnRandomProblems){
+  std::mt19937 generator(5);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  for (int t = 0; t < RANDOM_PROBLEM_COUNT; t++){
+    int rows = 1+generator()%RANDOM_PROBLEM_MAX_SIZE;
+    int cols = 1+generator()%RANDOM_PROBLEM_MAX_SIZE;
+    e::MatrixXd cost(rows, cols);
+    for (int i = 0; i < rows; i++){
+      for (int j = 0; j < cols; j++){
+        cost(i,j) = (uniform(generator) < FORBIDDEN_PROBABILITY)?forbidden:(10.0*uniform(generator));
+      }
+    }
+
+    auto assigned = assignment::solve(cost);
+    ASSERT_EQ((int)(assigned.size()), rows);
+    std::vector<bool> used(cols, false);
+    for (int i = 0; i < rows; i++){
+      if (assigned[i] >= 0){
+        ASSERT_LT(assigned[i], cols);
+        ASSERT_FALSE(used[assigned[i]]) << "column assigned twice in problem " << t;
+        ASSERT_TRUE(std::isfinite(cost(i,assigned[i]))) << "forbidden entry assigned in problem " << t;
+        used[assigned[i]] = true;
+      }
+    }
+
+    std::vector<int> current(rows, -1);
+    std::vector<bool> brute_used(cols, false);
+    std::pair<int,double> best = {0, 0.0};
+    bruteForce(cost, 0, current, brute_used, best);
+    auto assigned_score = score(cost, assigned);
+    ASSERT_EQ(assigned_score.first, best.first) << "in problem " << t;
+    ASSERT_NEAR(assigned_score.second, best.second, 1e-9) << "in problem " << t;
+  }
+}
+//}
+
+/* equivalence with the greedy association //{ */
+TEST(Assignment, UnambiguousSwarmsMatchGreedyAssociation){
+  // each measurement falls within the gate of at most its own target, so that the greedy association has a single correct answer
+  std::mt19937 generator(7);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  const double gate = -2.0*std::log(MATCH_LEVEL_THRESHOLD_ASSOCIATE);
+  for (int t = 0; t < SWARM_COUNT; t++){
+    int target_count = SWARM_MIN_SIZE + generator()%(SWARM_MAX_SIZE-SWARM_MIN_SIZE+1);
+    int measurement_count = SWARM_MIN_SIZE + generator()%(SWARM_MAX_SIZE-SWARM_MIN_SIZE+1);
+    std::vector<int> owners(target_count);
+    for (int j = 0; j < target_count; j++){
+      owners[j] = j;
+    }
+    std::shuffle(owners.begin(), owners.end(), generator);
+
+    e::MatrixXd match_matrix(measurement_count, target_count), cost(measurement_count, target_count);
+    for (int i = 0; i < measurement_count; i++){
+      for (int j = 0; j < target_count; j++){
+        bool own = (i < target_count) && (owners[i] == j) && (uniform(generator) < 0.8); // some targets are missed
+        double distance_sq = own?(0.99*gate*uniform(generator)):(gate*(1.01+5.0*uniform(generator)));
+        match_matrix(i,j) = std::exp(-0.5*distance_sq);
+        cost(i,j) = (distance_sq < gate)?(0.5*distance_sq):forbidden;
+      }
+    }
+    ASSERT_EQ(assignment::solve(cost), greedyAssociation(match_matrix, MATCH_LEVEL_THRESHOLD_ASSOCIATE)) << "in swarm " << t << " of " << target_count << " targets and " << measurement_count << " measurements";
+  }
+}
+//}
+
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
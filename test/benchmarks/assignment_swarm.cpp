@@ -0,0 +1,146 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <Eigen/Dense>
+#include <assignment/assignment.h>
+
+using namespace uvdar;
+
+#define SWARM_SIZES {5, 10, 20, 50}
+#define PAIRS_PER_SIZE 100000 // repetitions of each measurement are scaled so that each evaluates about this many pairs
+#define MATCH_LEVEL_THRESHOLD_ASSOCIATE 0.3 // as in the filter
+#define STATE_LENGTH 6
+
+/**
+ * @brief A state of the filter, emulated with dynamic sizes as in mrs_lib::LKF
+ */
+struct StateCov {
+  e::VectorXd x;
+  e::MatrixXd P;
+};
+
+/* filter emulation //{ */
+static void predict(StateCov &state, const e::MatrixXd &A, const e::MatrixXd &Q){
+  state.x = A*state.x;
+  state.P = A*state.P*A.transpose() + Q;
+}
+
+static void correct(StateCov &state, const StateCov &measurement){
+  e::MatrixXd H = e::MatrixXd::Identity(STATE_LENGTH, STATE_LENGTH);
+  e::MatrixXd S = H*state.P*H.transpose() + measurement.P;
+  e::MatrixXd K = state.P*H.transpose()*S.inverse();
+  state.x = state.x + K*(measurement.x - H*state.x);
+  state.P = (e::MatrixXd::Identity(STATE_LENGTH, STATE_LENGTH) - K*H)*state.P;
+}
+
+static double gaussJointMaxVal(const e::MatrixXd &si0, const e::MatrixXd &si1, const e::VectorXd &mu0, const e::VectorXd &mu1){
+  e::MatrixXd K = si0*(si0+si1).inverse();
+  e::VectorXd d0 = K*(mu1-mu0);
+  e::VectorXd d1 = (K-e::MatrixXd::Identity(K.rows(),K.rows()))*(mu1-mu0);
+  e::VectorXd N_v = (-0.5)*((d0.transpose()*si0.inverse()*d0) + (d1.transpose()*si1.inverse()*d1));
+  return std::exp(N_v(0));
+}
+//}
+
+/* association //{ */
+/**
+ * @brief The association used by the filter before the assignment solver - every pair is predicted, corrected and evaluated, and the states then take their best measurements greedily
+ */
+static std::vector<int> greedyAssociation(const std::vector<StateCov> &states, const std::vector<StateCov> &measurements, const e::MatrixXd &A, const e::MatrixXd &Q){
+  e::MatrixXd match_matrix(measurements.size(), states.size());
+  for (int m_i = 0; m_i < (int)(measurements.size()); m_i++){
+    for (int f_i = 0; f_i < (int)(states.size()); f_i++){
+      StateCov state = states[f_i];
+      predict(state, A, Q);
+      match_matrix(m_i,f_i) = gaussJointMaxVal(measurements[m_i].P.topLeftCorner(3,3), state.P.topLeftCorner(3,3), measurements[m_i].x.head(3), state.x.head(3));
+      correct(state, measurements[m_i]);
+      predict(state, A, Q);
+    }
+  }
+  std::vector<int> output(measurements.size(), -1);
+  for (int f_i = 0; f_i < match_matrix.cols(); f_i++){
+    int best_index = -1;
+    double best_level = -1;
+    for (int m_i = 0; m_i < match_matrix.rows(); m_i++){
+      if ((match_matrix(m_i,f_i) > MATCH_LEVEL_THRESHOLD_ASSOCIATE) && (match_matrix(m_i,f_i) > best_level)){
+        best_level = match_matrix(m_i,f_i);
+        best_index = m_i;
+      }
+    }
+    if (best_index >= 0){
+      output[best_index] = f_i;
+      match_matrix.row(best_index).setConstant(std::nan(""));
+    }
+    for (int m_i = 0; m_i < match_matrix.rows(); m_i++){
+      if (match_matrix(m_i,f_i) > MATCH_LEVEL_THRESHOLD_ASSOCIATE){
+        match_matrix(m_i,f_i) = std::nan("");
+      }
+    }
+  }
+  return output;
+}
+
+/**
+ * @brief The current association - each state is predicted once, pairs are gated on their Mahalanobis distance and assigned by the solver, and only the chosen pairs are corrected
+ */
+static std::vector<int> gatedAssignment(const std::vector<StateCov> &states, const std::vector<StateCov> &measurements, const e::MatrixXd &A, const e::MatrixXd &Q){
+  std::vector<StateCov> predicted = states;
+  for (auto &state : predicted){
+    predict(state, A, Q);
+  }
+  const double gate = -2.0*std::log(MATCH_LEVEL_THRESHOLD_ASSOCIATE);
+  e::MatrixXd cost(measurements.size(), states.size());
+  for (int m_i = 0; m_i < (int)(measurements.size()); m_i++){
+    for (int f_i = 0; f_i < (int)(states.size()); f_i++){
+      e::Vector3d difference = measurements[m_i].x.head<3>() - predicted[f_i].x.head<3>();
+      e::Matrix3d S = measurements[m_i].P.topLeftCorner<3,3>() + predicted[f_i].P.topLeftCorner<3,3>();
+      double distance_sq = difference.dot(S.ldlt().solve(difference));
+      cost(m_i,f_i) = (distance_sq < gate)?(0.5*distance_sq):std::numeric_limits<double>::infinity();
+    }
+  }
+  auto assigned = assignment::solve(cost);
+  for (int m_i = 0; m_i < (int)(measurements.size()); m_i++){
+    if (assigned[m_i] >= 0){
+      StateCov state = predicted[assigned[m_i]];
+      correct(state, measurements[m_i]);
+      predict(state, A, Q);
+    }
+  }
+  return assigned;
+}
+//}
+
+/* main //{ */
+int main() {
+  std::srand(0);
+  const e::MatrixXd A = e::MatrixXd::Identity(STATE_LENGTH, STATE_LENGTH);
+  const e::MatrixXd Q = 0.01*e::MatrixXd::Identity(STATE_LENGTH, STATE_LENGTH);
+
+  for (int count : SWARM_SIZES){
+    std::vector<StateCov> states(count), measurements(count);
+    for (int i = 0; i < count; i++){
+      e::MatrixXd B = e::MatrixXd::Random(STATE_LENGTH, STATE_LENGTH);
+      states[i] = {20.0*e::VectorXd::Random(STATE_LENGTH), 0.01*B*B.transpose() + 0.1*e::MatrixXd::Identity(STATE_LENGTH, STATE_LENGTH)};
+      measurements[i] = {states[i].x + 0.1*e::VectorXd::Random(STATE_LENGTH), 0.2*e::MatrixXd::Identity(STATE_LENGTH, STATE_LENGTH)};
+    }
+
+    int repetitions = std::max(PAIRS_PER_SIZE/(count*count), 1);
+    double greedy_duration = 0, gated_duration = 0;
+    bool identical = true;
+    for (int r = 0; r < repetitions; r++){
+      auto start = std::chrono::steady_clock::now();
+      auto greedy = greedyAssociation(states, measurements, A, Q);
+      auto middle = std::chrono::steady_clock::now();
+      auto gated = gatedAssignment(states, measurements, A, Q);
+      auto end = std::chrono::steady_clock::now();
+      greedy_duration += std::chrono::duration<double, std::micro>(middle - start).count();
+      gated_duration += std::chrono::duration<double, std::micro>(end - middle).count();
+      identical = identical && (greedy == gated);
+    }
+    std::cout << count << " targets x " << count << " measurements: all-pairs correction with greedy association " << greedy_duration/repetitions << " us, gated assignment with corrections " << gated_duration/repetitions << " us (" << greedy_duration/gated_duration << "x)" << (identical?"":", associations differ") << std::endl;
+  }
+  return 0;
+}
+//}
@@ -0,0 +1,230 @@
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <ctime>
+#include <pthread.h>
+#include <sched.h>
+
+#define CAMERA_COUNT 3
+#define CAMERA_RATE 60.0 //Hz
+#define TRACKER_WORK 0.002 //s of CPU time, inserting the points of a frame into the tracker
+#define PROCESS_RATE 10.0 //Hz, as blink_process_rate
+#define PROCESS_WORK 0.003 //s of CPU time, retrieving the blinkers of a camera
+#define IMAGE_RATE 30.0 //Hz
+#define IMAGE_WORK 0.001 //s of CPU time
+#define VISUALIZATION_RATE 2.0 //Hz
+#define VISUALIZATION_WORK 0.040 //s of CPU time
+#define POOL_THREADS 2 // of the nodelet manager
+#define DURATION 5.0 //s
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * @brief Spins for the given CPU time of the calling thread, so that the work takes the same effort however the threads share the cores
+ */
+static void work(double duration){
+  auto cpuTime = []{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+  };
+  double end = cpuTime() + duration;
+  while (cpuTime() < end){
+  }
+}
+
+/**
+ * @brief A queue of callbacks served by a pool of threads, as the callback queue of the nodelet manager
+ */
+class CallbackQueue {
+  public:
+    CallbackQueue(int thread_count, bool idle_priority = false){
+      for (int t = 0; t < thread_count; t++){
+        threads_.emplace_back([this, idle_priority]{
+            if (idle_priority){
+              sched_param parameters = {};
+              pthread_setschedparam(pthread_self(), SCHED_IDLE, &parameters);
+            }
+            while (true){
+              std::function<void()> callback;
+              {
+                std::unique_lock lock(mutex_);
+                condition_.wait(lock, [this]{return (!callbacks_.empty()) || stopped_;});
+                if (callbacks_.empty()){
+                  return;
+                }
+                callback = std::move(callbacks_.front());
+                callbacks_.pop_front();
+              }
+              callback();
+            }
+            });
+      }
+    }
+
+    ~CallbackQueue(){
+      {
+        std::scoped_lock lock(mutex_);
+        stopped_ = true;
+        condition_.notify_all();
+      }
+      for (auto &thread : threads_){
+        thread.join();
+      }
+    }
+
+    void push(std::function<void()> callback){
+      std::scoped_lock lock(mutex_);
+      callbacks_.push_back(std::move(callback));
+      condition_.notify_one();
+    }
+
+  private:
+    std::vector<std::thread> threads_;
+    std::deque<std::function<void()>> callbacks_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool stopped_ = false;
+};
+
+/**
+ * @brief Calls the function at the given rate until the end of the run, with the scheduled time of each call
+ */
+static std::thread periodic(double rate, Clock::time_point start, std::function<void(Clock::time_point)> call){
+  return std::thread([rate, start, call]{
+      for (int k = 0; k < (int)(DURATION*rate); k++){
+        auto scheduled = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(k/rate));
+        std::this_thread::sleep_until(scheduled);
+        call(scheduled);
+      }
+      });
+}
+
+/**
+ * @brief Latencies of one camera
+ */
+struct Latencies {
+  std::mutex mutex;
+  std::vector<double> frames; //ms, from the arrival of a frame to the end of its insertion into the tracker
+  std::vector<double> retrievals; //ms, from the trigger of a retrieval to its end
+
+  void add(std::vector<double> &values, Clock::time_point since){
+    std::scoped_lock lock(mutex);
+    values.push_back(std::chrono::duration<double, std::milli>(Clock::now() - since).count());
+  }
+
+  static void print(const std::string &name, std::vector<double> values){
+    std::sort(values.begin(), values.end());
+    double sum = 0, sum_squares = 0;
+    for (auto v : values){
+      sum += v;
+      sum_squares += v*v;
+    }
+    double mean = sum/values.size();
+    std::cout << "    " << name << ": mean " << mean << " ms, jitter (std. dev.) " << std::sqrt(std::max(0.0, sum_squares/values.size() - mean*mean)) << " ms, 50th percentile " << values[values.size()/2] << " ms, 99th percentile " << values[(values.size()*99)/100] << " ms, max " << values.back() << " ms" << std::endl;
+  }
+};
+
+/**
+ * @brief The previous setup - the point callbacks, the retrieval timers of the cameras, the image callbacks and the visualization timer all share the callback queue of the nodelet manager
+ */
+static void runShared(std::vector<Latencies> &latencies){
+  CallbackQueue pool(POOL_THREADS);
+  const auto start = Clock::now();
+  std::vector<std::thread> sources;
+  for (int c = 0; c < CAMERA_COUNT; c++){
+    sources.push_back(periodic(CAMERA_RATE, start + std::chrono::milliseconds(5*c), [&, c](Clock::time_point){
+          auto arrival = Clock::now();
+          pool.push([&, c, arrival]{
+              work(TRACKER_WORK);
+              latencies[c].add(latencies[c].frames, arrival);
+              });
+          }));
+    sources.push_back(periodic(PROCESS_RATE, start + std::chrono::milliseconds(30*c), [&, c](Clock::time_point scheduled){
+          pool.push([&, c, scheduled]{
+              work(PROCESS_WORK);
+              latencies[c].add(latencies[c].retrievals, scheduled);
+              });
+          }));
+  }
+  sources.push_back(periodic(IMAGE_RATE, start, [&](Clock::time_point){
+        pool.push([]{work(IMAGE_WORK);});
+        }));
+  sources.push_back(periodic(VISUALIZATION_RATE, start, [&](Clock::time_point){
+        pool.push([]{work(VISUALIZATION_WORK);});
+        }));
+  for (auto &source : sources){
+    source.join();
+  }
+}
+
+/**
+ * @brief The current setup - each camera has its own worker, inserting the frames and retrieving the blinkers after new data at most at PROCESS_RATE, and the visualization runs with the idle priority
+ */
+static void runDedicated(std::vector<Latencies> &latencies){
+  std::vector<Clock::time_point> last_processing(CAMERA_COUNT); // declared before the queues, which finish their callbacks on destruction
+  CallbackQueue pool(POOL_THREADS);
+  CallbackQueue visualization(1, true);
+  std::vector<std::unique_ptr<CallbackQueue>> workers;
+  for (int c = 0; c < CAMERA_COUNT; c++){
+    workers.push_back(std::make_unique<CallbackQueue>(1));
+  }
+  const auto start = Clock::now();
+  std::vector<std::thread> sources;
+  for (int c = 0; c < CAMERA_COUNT; c++){
+    last_processing[c] = start;
+    sources.push_back(periodic(CAMERA_RATE, start + std::chrono::milliseconds(5*c), [&, c](Clock::time_point){
+          auto arrival = Clock::now();
+          workers[c]->push([&, c, arrival]{
+              work(TRACKER_WORK);
+              latencies[c].add(latencies[c].frames, arrival);
+              auto now = Clock::now();
+              if ((now - last_processing[c]) >= std::chrono::duration<double>(1.0/PROCESS_RATE)){
+                last_processing[c] = now;
+                work(PROCESS_WORK);
+                latencies[c].add(latencies[c].retrievals, arrival);
+              }
+              });
+          }));
+  }
+  sources.push_back(periodic(IMAGE_RATE, start, [&](Clock::time_point){
+        pool.push([]{work(IMAGE_WORK);});
+        }));
+  sources.push_back(periodic(VISUALIZATION_RATE, start, [&](Clock::time_point){
+        visualization.push([]{work(VISUALIZATION_WORK);});
+        }));
+  for (auto &source : sources){
+    source.join();
+  }
+}
+
+/* main //{ */
+int main() {
+  std::cout << CAMERA_COUNT << " cameras at " << CAMERA_RATE << " Hz, " << std::thread::hardware_concurrency() << " cores" << std::endl;
+  for (bool dedicated : {false, true}){
+    std::vector<Latencies> latencies(CAMERA_COUNT);
+    if (dedicated){
+      runDedicated(latencies);
+    }
+    else {
+      runShared(latencies);
+    }
+    std::cout << (dedicated?"Dedicated camera workers:":"Shared callback queue with retrieval timers:") << std::endl;
+    for (int c = 0; c < CAMERA_COUNT; c++){
+      std::cout << "  camera " << c << ":" << std::endl;
+      Latencies::print("frames", latencies[c].frames);
+      Latencies::print("retrievals", latencies[c].retrievals);
+    }
+  }
+  return 0;
+}
+//}
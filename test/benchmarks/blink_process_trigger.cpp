@@ -0,0 +1,227 @@
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+#include <memory>
+#include <ctime>
+
+#define CAMERA_COUNT 3
+#define TRACKER_WORK 0.0005 //s of CPU time, inserting the points of a frame into the tracker
+#define PROCESS_RATE 10.0 //Hz, blink_process_rate
+#define PROCESS_FRAMES 3 // blink_process_frames
+#define PROCESS_WORK 0.002 //s of CPU time, retrieving the blinkers of a camera
+#define IDENTIFICATION_FRAMES 23 // frames of a new blinker needed before its ID is retrieved, as accumulator_length
+#define APPEARANCE_PERIOD 37 //frames, between the appearances of new blinkers in each camera
+#define DURATION 5.0 //s
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * @brief Spins for the given CPU time of the calling thread, so that the work takes the same effort however the threads share the cores
+ */
+static void work(double duration){
+  auto cpuTime = []{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+  };
+  double end = cpuTime() + duration;
+  while (cpuTime() < end){
+  }
+}
+
+/**
+ * @brief Retrieves the CPU time of the whole process, in seconds
+ */
+static double processCpuTime(){
+  timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+/**
+ * @brief Calls the function at the given rate until the end of the run, with the index of each call
+ */
+static std::thread periodic(double rate, Clock::time_point start, std::function<void(int)> call){
+  return std::thread([rate, start, call]{
+      for (int k = 0; k < (int)(DURATION*rate); k++){
+        std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(k/rate)));
+        call(k);
+      }
+      });
+}
+
+/**
+ * @brief A single camera with its tracker and the queue of its input frames
+ */
+class Camera {
+  public:
+    Camera(bool frame_triggered) : frame_triggered_(frame_triggered){
+      worker_ = std::thread([this]{run();});
+    }
+
+    ~Camera(){
+      {
+        std::scoped_lock lock(queue_mutex_);
+        stopped_ = true;
+        condition_.notify_all();
+      }
+      worker_.join();
+    }
+
+    /**
+     * @brief Hands a frame over to the worker, as the callback of the image points does
+     *
+     * @param appearance Whether a new blinker appears in this frame
+     */
+    void push(bool appearance){
+      std::scoped_lock lock(queue_mutex_);
+      inputs_.push_back({Clock::now(), appearance});
+      condition_.notify_one();
+    }
+
+    /**
+     * @brief Retrieves the blinkers and records the latency of each newly identified one
+     */
+    void retrieve(){
+      std::scoped_lock lock(tracker_mutex_);
+      work(PROCESS_WORK);
+      if (identifiable_){
+        identification_latencies_.push_back(std::chrono::duration<double, std::milli>(Clock::now() - appearance_).count());
+        identifiable_ = false;
+      }
+    }
+
+    /**
+     * @brief Retrieves the latencies, in ms, from the arrival of the first frame of each new blinker to the retrieval of its ID
+     */
+    std::vector<double> identificationLatencies(){
+      std::scoped_lock lock(tracker_mutex_);
+      return identification_latencies_;
+    }
+
+  private:
+    /**
+     * @brief The camera worker - inserts the frames in batches and, if triggered by frames, retrieves the blinkers after every PROCESS_FRAMES of them, once per batch
+     */
+    void run(){
+      std::deque<std::pair<Clock::time_point, bool>> batch;
+      int frames_inserted = 0;
+      while (true){
+        {
+          std::unique_lock lock(queue_mutex_);
+          condition_.wait(lock, [this]{return (!inputs_.empty()) || stopped_;});
+          if (stopped_){
+            return;
+          }
+          batch.swap(inputs_);
+        }
+        for (auto &[arrival, appearance] : batch){
+          std::scoped_lock lock(tracker_mutex_);
+          work(TRACKER_WORK);
+          if (appearance){
+            appearance_ = arrival;
+            blinker_frames_ = 0;
+          }
+          if ((blinker_frames_ >= 0) && ((++blinker_frames_) == IDENTIFICATION_FRAMES)){
+            identifiable_ = true;
+          }
+        }
+        frames_inserted += (int)(batch.size());
+        batch.clear();
+        if (frame_triggered_ && (frames_inserted >= PROCESS_FRAMES)){
+          frames_inserted = 0;
+          retrieve();
+        }
+      }
+    }
+
+    bool frame_triggered_;
+    std::thread worker_;
+    std::deque<std::pair<Clock::time_point, bool>> inputs_;
+    std::mutex queue_mutex_;
+    std::condition_variable condition_;
+    bool stopped_ = false;
+
+    std::mutex tracker_mutex_;
+    Clock::time_point appearance_;
+    int blinker_frames_ = -1; //inserted frames of the latest new blinker, negative before the first one
+    bool identifiable_ = false;
+    std::vector<double> identification_latencies_;
+};
+
+/**
+ * @brief Runs the cameras for DURATION and prints the latencies of the identification and the CPU usage
+ *
+ * @param framerate Rate of the frames of each camera, or 0 for idle cameras
+ * @param frame_triggered Whether the blinkers are retrieved after every PROCESS_FRAMES frames, rather than by a timer at PROCESS_RATE
+ */
+static void run(double framerate, bool frame_triggered){
+  std::vector<double> latencies;
+  double cpu_start = processCpuTime();
+  {
+    std::vector<std::unique_ptr<Camera>> cameras;
+    for (int c = 0; c < CAMERA_COUNT; c++){
+      cameras.push_back(std::make_unique<Camera>(frame_triggered));
+    }
+    const auto start = Clock::now();
+    std::vector<std::thread> sources;
+    for (int c = 0; c < CAMERA_COUNT; c++){
+      if (framerate > 0){
+        sources.push_back(periodic(framerate, start + std::chrono::milliseconds(5*c), [&, c](int k){
+              cameras[c]->push(((k + 11*c) % APPEARANCE_PERIOD) == 0);
+              }));
+      }
+      if (!frame_triggered){ // the retrieval timer of the camera, which fires whether or not new frames arrived
+        sources.push_back(periodic(PROCESS_RATE, start + std::chrono::milliseconds(30*c), [&, c](int){
+              cameras[c]->retrieve();
+              }));
+      }
+    }
+    for (auto &source : sources){
+      source.join();
+    }
+    if (framerate <= 0){
+      std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(DURATION)));
+    }
+    for (auto &camera : cameras){
+      auto camera_latencies = camera->identificationLatencies();
+      latencies.insert(latencies.end(), camera_latencies.begin(), camera_latencies.end());
+    }
+  }
+  double cpu = (processCpuTime() - cpu_start)/DURATION;
+
+  std::cout << "  " << (frame_triggered?("every " + std::to_string(PROCESS_FRAMES) + " frames"):("timer at " + std::to_string((int)(PROCESS_RATE)) + " Hz")) << ": CPU " << 1e3*cpu << " ms per s (" << 100.0*cpu << " %)";
+  if (!latencies.empty()){
+    std::sort(latencies.begin(), latencies.end());
+    double sum = 0;
+    for (auto l : latencies){
+      sum += l;
+    }
+    std::cout << ", time to ID: mean " << sum/latencies.size() << " ms, 50th percentile " << latencies[latencies.size()/2] << " ms, 99th percentile " << latencies[(latencies.size()*99)/100] << " ms, max " << latencies.back() << " ms (" << latencies.size() << " blinkers)";
+  }
+  std::cout << std::endl;
+}
+
+/* main //{ */
+int main() {
+  std::cout << CAMERA_COUNT << " cameras, " << std::thread::hardware_concurrency() << " cores" << std::endl;
+  for (double framerate : {30.0, 60.0}){
+    std::cout << framerate << " fps, the ID needs " << IDENTIFICATION_FRAMES << " frames (" << 1e3*IDENTIFICATION_FRAMES/framerate << " ms):" << std::endl;
+    for (bool frame_triggered : {false, true}){
+      run(framerate, frame_triggered);
+    }
+  }
+  std::cout << "Idle cameras:" << std::endl;
+  for (bool frame_triggered : {false, true}){
+    run(0.0, frame_triggered);
+  }
+  return 0;
+}
+//}
@@ -0,0 +1,59 @@
+#include <ros/ros.h>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <diagnostics/diagnostics.h>
+
+using namespace uvdar;
+
+#define FRAME_COUNT 1000000
+#define FRAMERATE 60.0 //Hz
+#define VALUES_PER_FRAME 27 // calls of count() and gauge() in the detector, blink processor and pose calculator together
+#define ACTIVATION_TIMEOUT 5.0 //s
+
+/**
+ * @brief Measures the cost of recording the values of a frame, in nanoseconds
+ */
+static double frameCost(diagnostics::Publisher &diagnostics){
+  auto start = std::chrono::steady_clock::now();
+  for (int f = 0; f < FRAME_COUNT; f++){
+    for (int v = 0; v < VALUES_PER_FRAME; v++){
+      if (v%2 == 0){
+        diagnostics.count("frames received");
+      }
+      else {
+        diagnostics.gauge("points per frame", f%16);
+      }
+    }
+  }
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count()/FRAME_COUNT;
+}
+
+static void report(const std::string &label, double frame_cost){
+  std::cout << label << ": " << frame_cost/VALUES_PER_FRAME << " ns per value, " << frame_cost/1000.0 << " us per frame, " << 100.0*frame_cost*FRAMERATE/1e9 << " % of a core at " << FRAMERATE << " fps" << std::endl;
+}
+
+/* main //{ */
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "diagnostics_overhead", ros::init_options::AnonymousName);
+  ros::NodeHandle nh("~");
+  nh.setParam("diagnostics_period", 0.1);
+  diagnostics::Publisher diagnostics(nh, "benchmark");
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  report("Not subscribed", frameCost(diagnostics));
+
+  ros::Subscriber sub = nh.subscribe<uvdar_core::RuntimeDiagnostics>("diagnostics", 1, [](const uvdar_core::RuntimeDiagnosticsConstPtr&){});
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(ACTIVATION_TIMEOUT);
+  while ((!diagnostics.active()) && (std::chrono::steady_clock::now() < deadline)){
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  if (!diagnostics.active()){
+    std::cerr << "The publisher did not activate after subscription" << std::endl;
+    return 1;
+  }
+  report("Subscribed", frameCost(diagnostics));
+  return 0;
+}
+//}
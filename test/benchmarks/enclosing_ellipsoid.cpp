@@ -0,0 +1,74 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <pose_core/pose_core.h>
+
+using namespace uvdar;
+
+#define CLOUD_SIZES {10, 50, 200, 1000} // verified hypotheses of a target
+#define CYCLES 2000 // consecutive fusions of a moving cloud
+#define MVEE_TOLERANCE 0.01 // as in pose_core
+
+/**
+ * @brief Statistics of the enclosing ellipsoids computed with one kind of start
+ */
+struct Durations {
+  std::vector<double> samples; //us
+  long iterations = 0;
+  int deadline_hits = 0; // stopped before reaching the tolerance
+
+  void print(const std::string &name){
+    std::sort(samples.begin(), samples.end());
+    double sum = 0;
+    for (auto d : samples){
+      sum += d;
+    }
+    std::cout << "  " << name << ": mean " << sum/samples.size() << " us, 99th percentile " << samples[(samples.size()*99)/100] << " us, max " << samples.back() << " us, " << (double)(iterations)/samples.size() << " iterations, stopped early " << deadline_hits << "/" << samples.size() << std::endl;
+  }
+};
+
+/* main //{ */
+int main() {
+  std::mt19937 generator(0);
+  std::normal_distribution<double> normal(0.0, 1.0);
+
+  for (int size : CLOUD_SIZES){
+    e::Vector3d scale(0.5, 0.2, 1.0);
+    std::vector<e::Vector3d> cloud(size);
+    for (auto &point : cloud){
+      point = scale.cwiseProduct(e::Vector3d(normal(generator), normal(generator), normal(generator)));
+    }
+
+    Durations cold, warm;
+    std::vector<double> weights;
+    for (int c = 0; c < CYCLES; c++){
+      pose_core::ellipsoid_statistics statistics;
+      auto start = std::chrono::steady_clock::now();
+      pose_core::enclosingEllipsoid(cloud, nullptr, &statistics);
+      cold.samples.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+      cold.iterations += statistics.iterations;
+      cold.deadline_hits += (statistics.eps > MVEE_TOLERANCE);
+
+      start = std::chrono::steady_clock::now();
+      pose_core::enclosingEllipsoid(cloud, &weights, &statistics);
+      warm.samples.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+      warm.iterations += statistics.iterations;
+      warm.deadline_hits += (statistics.eps > MVEE_TOLERANCE);
+
+      // the hypotheses move between the fusions, and a few of them are replaced by resampling
+      e::Vector3d shift(normal(generator), normal(generator), normal(generator));
+      for (auto &point : cloud){
+        point += 0.02*shift + 0.02*e::Vector3d(normal(generator), normal(generator), normal(generator));
+      }
+      cloud[c%size] = scale.cwiseProduct(e::Vector3d(normal(generator), normal(generator), normal(generator))) + cloud[(c+1)%size];
+    }
+    std::cout << size << " points:" << std::endl;
+    cold.print("cold start");
+    warm.print("warm start");
+  }
+  return 0;
+}
+//}
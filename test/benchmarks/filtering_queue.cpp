@@ -0,0 +1,163 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <pose_core/pose_core.h>
+#include <pose_core/hypotheses.h>
+#include <pose_core/input_queue.h>
+
+using namespace uvdar;
+
+#define CALIBRATION_FILE TEST_CONFIG_DIR "/ocamcalib/calib_results_bf_uv_fe.txt"
+#define MODEL_FILE TEST_CONFIG_DIR "/models/quadrotor_foursided.txt"
+#define LED_PROJECTION_COEFS {1.3398, 31.4704, 0.0154}
+#define VIEW_ANGLE_MARGIN 0.035
+#define LED_GROUP_DISTANCE 0.03
+
+#define CAMERA_COUNT 3
+#define TARGET_COUNT 10
+#define CAMERA_RATE 60.0 //Hz
+#define DURATION 5.0 //s
+#define QUEUE_CAPACITIES {1, 10} // the "latest" and the "all" filtering queue policies of the pose calculator, with its default queue size
+
+/**
+ * @brief A frame of a camera, observing all of the targets
+ */
+struct Input {
+  int camera;
+  double time; //s
+};
+
+/**
+ * @brief Generates the observations of the targets, spread out in a row in front of the cameras. The cameras share the pose, the output frame is their frame
+ */
+static std::vector<pose_core::Observation> observeTargets(const pose_core::Reprojection &reprojection, const std::vector<pose_core::Marker> &markers){
+  std::vector<pose_core::Observation> output;
+  for (int t = 0; t < TARGET_COUNT; t++){
+    pose_core::Pose pose;
+    pose.position = e::Vector3d(-3.0 + 6.0*t/(TARGET_COUNT-1), 0.3*((t%3)-1), 6.0+0.2*t);
+    pose.orientation =
+      e::AngleAxisd(M_PI/2, e::Vector3d::UnitY())*
+      e::AngleAxisd(0.5, e::Vector3d::UnitY())*
+      e::AngleAxisd(0.3*t, e::Vector3d::UnitZ());
+    pose_core::Observation observation;
+    observation.target = t;
+    observation.markers = &markers;
+    reprojection.hypothesisError(markers, pose, observation.tocam, {}, std::numeric_limits<double>::max(), false, &observation.points);
+    output.push_back(observation);
+  }
+  return output;
+}
+
+static double percentile(std::vector<double> values, int p){
+  if (values.empty()){
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  return values[(values.size()*p)/100];
+}
+
+/* main //{ */
+int main() {
+  ocam_model oc_model;
+  if (get_ocam_model(&oc_model, (char*)(CALIBRATION_FILE)) < 0){
+    std::cerr << "Failed to load the calibration file " << CALIBRATION_FILE << std::endl;
+    return 1;
+  }
+  const pose_core::CameraModel camera(oc_model);
+  const pose_core::Reprojection reprojection(camera, LED_PROJECTION_COEFS, VIEW_ANGLE_MARGIN);
+  auto markers = pose_core::loadModel(MODEL_FILE);
+  if (!markers || markers->empty()){
+    std::cerr << "Failed to load the model file " << MODEL_FILE << std::endl;
+    return 1;
+  }
+  const auto groups = pose_core::groupMarkers(markers.value(), LED_GROUP_DISTANCE);
+  const double max_diameter = pose_core::visibleDiameters(markers.value(), groups).first;
+  auto observations = observeTargets(reprojection, markers.value());
+
+  for (size_t capacity : QUEUE_CAPACITIES){
+    std::vector<std::shared_ptr<pose_core::AssociatedHypotheses>> targets;
+    for (auto &observation : observations){
+      targets.push_back(std::make_shared<pose_core::AssociatedHypotheses>(pose_core::initialHypotheses(reprojection, observation, groups, max_diameter), observation.target));
+    }
+
+    std::vector<std::unique_ptr<pose_core::InputQueue<Input>>> queues;
+    for (int c = 0; c < CAMERA_COUNT; c++){
+      queues.push_back(std::make_unique<pose_core::InputQueue<Input>>());
+    }
+    std::vector<std::vector<double>> latencies(CAMERA_COUNT); //ms
+    std::atomic<bool> running = true;
+    const auto start = std::chrono::steady_clock::now();
+    auto now = [&start]{
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    // as the particle filtering workers of the pose calculator
+    std::vector<std::thread> workers;
+    for (int c = 0; c < CAMERA_COUNT; c++){
+      workers.emplace_back([&, c]{
+          while (auto input = queues[c]->pop()){
+            pose_core::processTargetsAsAvailable(targets, [&](pose_core::AssociatedHypotheses &target){
+                auto observation = observations[target.target];
+                observation.time = input->first.time;
+                pose_core::checkHypothesisFitness(target, reprojection, observation, c);
+                target.removeUnfit();
+                });
+            latencies[c].push_back(1000.0*queues[c]->finished(input->second));
+          }
+          });
+    }
+
+    // as the scattering timer, competing for the targets
+    std::thread scattering([&]{
+        for (int k = 1; running; k++){
+          std::this_thread::sleep_until(start + std::chrono::duration<double>(k*SCATTER_TIME_STEP));
+          pose_core::processTargetsAsAvailable(targets, [&](pose_core::AssociatedHypotheses &target){
+              target.addHypotheses(pose_core::mutateHypotheses(target, target.hypotheses.size()/2));
+              pose_core::removeExtraHypotheses(target, now());
+              pose_core::fuseHypotheses(target);
+              pose_core::propagateHypotheses(target, now());
+              });
+        }
+        });
+
+    // as the callbacks of the cameras, each in its own thread, at staggered phases
+    std::vector<std::thread> producers;
+    for (int c = 0; c < CAMERA_COUNT; c++){
+      producers.emplace_back([&, c]{
+          for (int k = 0; k < (int)(DURATION*CAMERA_RATE); k++){
+            double time = (k + (double)(c)/CAMERA_COUNT)/CAMERA_RATE;
+            std::this_thread::sleep_until(start + std::chrono::duration<double>(time));
+            queues[c]->push({c, now()}, capacity);
+          }
+          });
+    }
+
+    for (auto &producer : producers){
+      producer.join();
+    }
+    running = false;
+    scattering.join();
+    for (auto &queue : queues){
+      queue->stop();
+    }
+    for (auto &worker : workers){
+      worker.join();
+    }
+
+    std::cout << "Queue capacity " << capacity << ", " << CAMERA_COUNT << " cameras at " << CAMERA_RATE << " Hz, " << TARGET_COUNT << " targets:" << std::endl;
+    std::vector<double> all;
+    for (int c = 0; c < CAMERA_COUNT; c++){
+      auto statistics = queues[c]->statistics();
+      std::cout << "  camera " << c << ": latency p50 " << percentile(latencies[c], 50) << " ms, p99 " << percentile(latencies[c], 99) << " ms, max " << statistics.max_latency*1000.0 << " ms, processed " << statistics.processed_count << "/" << statistics.received_count << ", dropped " << statistics.dropped_count << ", max depth " << statistics.max_depth << std::endl;
+      all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+    }
+    std::cout << "  all cameras: latency p50 " << percentile(all, 50) << " ms, p99 " << percentile(all, 99) << " ms" << std::endl;
+  }
+  return 0;
+}
+//}
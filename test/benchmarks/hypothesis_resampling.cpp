@@ -0,0 +1,88 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <memory>
+#include <pose_core/hypotheses.h>
+
+using namespace uvdar;
+
+#define HYPOTHESIS_COUNTS {1000, 2000, 3000, 4000, 5000}
+#define REPETITIONS 200
+#define VERIFIED_FRACTION 0.2
+#define KEPT_FRACTION (2.0/3.0) // each scattering cycle adds half of the hypotheses as mutations and culls them back
+
+/**
+ * @brief Generates the hypotheses of a target as after a fitness check, with random fitness errors and a fraction of them verified
+ */
+static std::unique_ptr<pose_core::AssociatedHypotheses> randomHypotheses(int count, std::mt19937 &generator){
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  std::vector<pose_core::Hypothesis> hs(count);
+  for (auto &h : hs){
+    h.pose.position = e::Vector3d(uniform(generator), uniform(generator), 5.0+uniform(generator));
+    h.fitness_error = (uniform(generator) < 0.1)?-1.0:(3.0*uniform(generator)); // some not yet checked
+    h.observed = 1.0;
+  }
+  auto output = std::make_unique<pose_core::AssociatedHypotheses>(hs, 0);
+  for (auto it = output->hypotheses.begin(); it != output->hypotheses.end(); it++){
+    if (uniform(generator) < VERIFIED_FRACTION){
+      output->setVerified(it);
+    }
+  }
+  return output;
+}
+
+/**
+ * @brief Statistics of the durations of a single operation
+ */
+struct Durations {
+  std::vector<double> samples; //us
+
+  void print(const std::string &name, int count){
+    std::sort(samples.begin(), samples.end());
+    double sum = 0;
+    for (auto d : samples){
+      sum += d;
+    }
+    double mean = sum/samples.size();
+    std::cout << "  " << name << ": mean " << mean << " us (" << 1000.0*mean/count << " ns/hypothesis), 99th percentile " << samples[(samples.size()*99)/100] << " us, max " << samples.back() << " us" << std::endl;
+  }
+};
+
+/* main //{ */
+int main() {
+  std::mt19937 generator(0);
+
+  for (int count : HYPOTHESIS_COUNTS){
+    Durations resampling, culling_weighted, culling_random;
+    size_t kept_resampling = 0, kept_weighted = 0, kept_random = 0;
+    for (int r = 0; r < REPETITIONS; r++){
+      // each operation gets its own copy, generated outside of the measurement
+      auto resampled = randomHypotheses(count, generator);
+      auto start = std::chrono::steady_clock::now();
+      pose_core::resampleHypotheses(*resampled, (int)(count*KEPT_FRACTION));
+      resampling.samples.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+      kept_resampling = resampled->hypotheses.size();
+
+      auto weighted = randomHypotheses(count, generator);
+      start = std::chrono::steady_clock::now();
+      pose_core::removeExtraHypotheses(*weighted, 1.0, false, true);
+      culling_weighted.samples.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+      kept_weighted = weighted->hypotheses.size();
+
+      auto random = randomHypotheses(count, generator);
+      start = std::chrono::steady_clock::now();
+      pose_core::removeExtraHypotheses(*random, 1.0, false, false);
+      culling_random.samples.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+      kept_random = random->hypotheses.size();
+    }
+    std::cout << count << " hypotheses:" << std::endl;
+    resampling.print("resampling to " + std::to_string(kept_resampling), count);
+    culling_weighted.print("culling to the fixed count of " + std::to_string(pose_core::maxHypothesisCount()) + " by resampling (" + std::to_string(kept_weighted) + " kept)", count);
+    culling_random.print("culling to the fixed count by random removal (" + std::to_string(kept_random) + " kept)", count);
+  }
+  return 0;
+}
+//}
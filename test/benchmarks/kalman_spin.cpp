@@ -0,0 +1,152 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <mrs_lib/lkf.h>
+#include <spatial_index/spatial_index.h>
+
+using namespace uvdar;
+
+#define KALMAN_STATES 6 // as in the filter
+#define KALMAN_STATES_VELOCITY 9
+#define KALMAN_INPUTS 0
+#define KALMAN_MEASUREMENTS 6
+#define OUTPUT_FRAMERATE 20.0 //Hz
+#define TARGET_COUNT 30
+#define SPIN_COUNT 20000
+#define MATCH_LEVEL_THRESHOLD_ASSOCIATE 0.3
+#define MATCH_LEVEL_THRESHOLD_REMOVE 0.5
+
+/* allocation counting //{ */
+static long allocation_count = 0;
+
+extern "C" void *__libc_malloc(size_t size);
+
+extern "C" void *malloc(size_t size){
+  allocation_count++;
+  return __libc_malloc(size);
+}
+//}
+
+/**
+ * @brief The overlap check of the filter before its sizes were fixed, with dynamic matrices passed by value
+ */
+static double gaussJointMaxValDynamic(e::MatrixXd si0, e::MatrixXd si1, e::VectorXd mu0, e::VectorXd mu1){
+  auto K = si0*(si0+si1).inverse();
+  auto d0 = K*(mu1-mu0);
+  auto d1 = (K-e::MatrixXd::Identity(K.rows(),K.rows()))*(mu1-mu0);
+  auto N_v = ((-0.5)*((d0.transpose()*(si0).inverse()*d0) + (d1.transpose()*(si1).inverse()*d1)));
+  return std::exp(N_v(0));
+}
+
+/**
+ * @brief One output period of the filter for the given LKF: each state is corrected by a measurement and predicted to the output time, and all pairs of states are checked for overlaps
+ *
+ * @tparam n_lkf The state length of the LKF type - n_states, or -1 for the dynamic sizes used before
+ * @tparam n_states The actual length of the state vector
+ */
+template <int n_lkf, int n_states>
+class Spin {
+  public:
+    using lkf_t = mrs_lib::LKF<n_lkf, KALMAN_INPUTS, KALMAN_MEASUREMENTS>;
+    using statecov_t = typename lkf_t::statecov_t;
+
+    Spin() : filter_(lkf_t::A_t::Identity(n_states, n_states), typename lkf_t::B_t(), lkf_t::H_t::Identity(KALMAN_MEASUREMENTS, n_states)) {
+      std::mt19937 generator(0);
+      std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+      for (int i = 0; i < TARGET_COUNT; i++){
+        statecov_t state;
+        state.x = lkf_t::x_t::Zero(n_states);
+        state.x.template head<3>() = e::Vector3d(20.0*uniform(generator), 20.0*uniform(generator), 5.0*uniform(generator));
+        state.P = 0.1*lkf_t::P_t::Identity(n_states, n_states);
+        states_.push_back(state);
+        z_.push_back(state.x.template head<KALMAN_MEASUREMENTS>() + 0.05*e::Matrix<double, KALMAN_MEASUREMENTS, 1>::Random());
+      }
+      Q_ = 0.01*lkf_t::Q_t::Identity(n_states, n_states);
+      R_ = 0.2*lkf_t::R_t::Identity();
+    }
+
+    int operator()(){
+      const double gate = -2.0*std::log(MATCH_LEVEL_THRESHOLD_ASSOCIATE);
+      int result = 0;
+      for (int i = 0; i < TARGET_COUNT; i++){
+        auto &state = states_[i];
+        state = filter_.predict(state, typename lkf_t::u_t(), Q_, 0.5/OUTPUT_FRAMERATE);
+        if constexpr (n_lkf < 0){
+          if (gaussJointMaxValDynamic(R_.topLeftCorner(3,3), state.P.topLeftCorner(3,3), z_[i].head(3), state.x.head(3)) > MATCH_LEVEL_THRESHOLD_ASSOCIATE){
+            state = filter_.correct(state, z_[i], R_);
+            result++;
+          }
+        }
+        else {
+          if (spatial_index::mahalanobisSquared(R_.template topLeftCorner<3,3>(), state.P.template topLeftCorner<3,3>(), z_[i].template head<3>(), state.x.template head<3>()) < gate){
+            state = filter_.correct(state, z_[i], R_);
+            result++;
+          }
+        }
+        state = filter_.predict(state, typename lkf_t::u_t(), Q_, 0.5/OUTPUT_FRAMERATE);
+      }
+
+      for (int i = 0; i < TARGET_COUNT; i++){
+        for (int j = i+1; j < TARGET_COUNT; j++){
+          double match_level;
+          if constexpr (n_lkf < 0){
+            match_level = gaussJointMaxValDynamic(states_[i].P.topLeftCorner(3,3), states_[j].P.topLeftCorner(3,3), states_[i].x.head(3), states_[j].x.head(3));
+          }
+          else {
+            match_level = spatial_index::gaussJointMaxVal(states_[i].P.template topLeftCorner<3,3>(), states_[j].P.template topLeftCorner<3,3>(), states_[i].x.template head<3>(), states_[j].x.template head<3>());
+          }
+          if (match_level > MATCH_LEVEL_THRESHOLD_REMOVE){
+            result++;
+          }
+        }
+      }
+      return result;
+    }
+
+  private:
+    lkf_t filter_;
+    typename lkf_t::Q_t Q_;
+    typename lkf_t::R_t R_;
+    std::vector<statecov_t, e::aligned_allocator<statecov_t>> states_;
+    std::vector<e::Matrix<double, KALMAN_MEASUREMENTS, 1>, e::aligned_allocator<e::Matrix<double, KALMAN_MEASUREMENTS, 1>>> z_;
+};
+
+/* measure //{ */
+template <int n_lkf, int n_states>
+static void measure(const std::string &label){
+  Spin<n_lkf, n_states> spin;
+  volatile int sink = spin(); // keeps the spins from being optimized out
+  std::vector<double> durations;
+  durations.reserve(SPIN_COUNT);
+  long start_count = allocation_count;
+  for (int s = 0; s < SPIN_COUNT; s++){
+    auto start = std::chrono::steady_clock::now();
+    sink = sink + spin();
+    durations.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+  }
+  double allocations = (double)(allocation_count - start_count)/SPIN_COUNT;
+
+  std::sort(durations.begin(), durations.end());
+  double sum = 0;
+  for (auto d : durations){
+    sum += d;
+  }
+  double mean = sum/SPIN_COUNT;
+  std::cout << label << ": mean " << mean << " us, 99th percentile " << durations[(SPIN_COUNT*99)/100] << " us, max " << durations.back() << " us per spin, " << allocations << " allocations per spin, " << 100.0*mean*OUTPUT_FRAMERATE/1e6 << " % of the " << 1000.0/OUTPUT_FRAMERATE << " ms period" << std::endl;
+}
+//}
+
+/* main //{ */
+int main() {
+  std::cout << TARGET_COUNT << " targets at " << OUTPUT_FRAMERATE << " Hz" << std::endl;
+  measure<-1, KALMAN_STATES>("Dynamic sizes, 6 states");
+  measure<KALMAN_STATES, KALMAN_STATES>("Fixed sizes, 6 states");
+  measure<-1, KALMAN_STATES_VELOCITY>("Dynamic sizes, 9 states");
+  measure<KALMAN_STATES_VELOCITY, KALMAN_STATES_VELOCITY>("Fixed sizes, 9 states");
+  return 0;
+}
+//}
@@ -0,0 +1,194 @@
+#include <ros/serialization.h>
+#include <iostream>
+#include <string>
+#include <ctime>
+#include <uvdar_core/ImagePointsWithFloatStamped.h>
+#include <uvdar_core/AMIAllSequences.h>
+#include <mrs_msgs/PoseWithCovarianceArrayStamped.h>
+#include <lazy_publisher/lazy_publisher.h>
+#include <packed_points/packed_points.h>
+
+using namespace uvdar;
+
+#define CAMERA_COUNT 3
+#define FRAMERATE 60.0 //Hz, of the detector
+#define BLINK_PROCESS_RATE 10.0 //Hz, blink_process_rate
+#define SCATTER_RATE 10.0 //Hz, of the particle scattering of the pose calculator
+#define SIGNAL_COUNT 12 // tracked by the blink processor in each camera
+#define SEQUENCE_LENGTH 80 // points of each tracked sequence
+#define REGRESSION_COEFFICIENTS 5
+#define SUN_POINT_COUNT 30 // per frame
+#define HYPOTHESIS_COUNT 160 // of all targets together
+#define CYCLES 20000
+
+/**
+ * @brief Stands in for a publisher with the given number of subscribers, serializing each message as for a subscriber in another process
+ */
+struct MockPublisher {
+  uint32_t subscribers = 0;
+  uint64_t bytes = 0;
+
+  explicit operator bool() const {
+    return true;
+  }
+
+  uint32_t getNumSubscribers() const {
+    return subscribers;
+  }
+
+  template <class M>
+  void publish(const M &msg){
+    bytes += ros::serialization::serializeMessage(msg).num_bytes;
+  }
+
+  template <class M>
+  void publish(const boost::shared_ptr<M> &msg){
+    publish(*msg);
+  }
+};
+typedef lazy_publisher::Publisher<MockPublisher> Publisher;
+
+/**
+ * @brief Retrieves the CPU time of the calling thread, in seconds
+ */
+static double cpuTime(){
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+/**
+ * @brief A retrieval of the blink processor - the blinkers are always published, the sequences with their regression coefficients only if wanted
+ */
+static void blinkProcessor(MockPublisher &pub_blinkers, Publisher &pub_all_seq){
+  uvdar_core::ImagePointsWithFloatStamped msg;
+  uvdar_core::AMIAllSequences ami_all_seq_msg;
+  bool build_all_seq = pub_all_seq.wanted();
+  for (int s = 0; s < SIGNAL_COUNT; s++){
+    uvdar_core::Point2DWithFloat point;
+    point.x = 10.0*s;
+    point.y = 20.0*s;
+    point.value = s;
+    msg.points.push_back(point);
+    if (!build_all_seq){
+      continue;
+    }
+    uvdar_core::AMISeqVariables ami_seq_msg;
+    ami_seq_msg.signal_id = s;
+    ami_seq_msg.confidence_interval.x = 1.0;
+    ami_seq_msg.confidence_interval.y = 1.0;
+    ami_seq_msg.predicted_point = point;
+    for (int c = 0; c < REGRESSION_COEFFICIENTS; c++){
+      ami_seq_msg.x_coeff_reg.push_back(0.1f*c);
+      ami_seq_msg.y_coeff_reg.push_back(0.2f*c);
+    }
+    ami_seq_msg.sequence.reserve(SEQUENCE_LENGTH);
+    for (int k = 0; k < SEQUENCE_LENGTH; k++){
+      uvdar_core::AMISeqPoint seq_point;
+      seq_point.point = point;
+      seq_point.point.x += 0.1*k;
+      ami_seq_msg.sequence.push_back(seq_point);
+    }
+    ami_seq_msg.poly_reg_computed = {true, true};
+    ami_seq_msg.extended_search = {false, false};
+    ami_all_seq_msg.sequences.push_back(ami_seq_msg);
+  }
+  pub_blinkers.publish(msg);
+  if (build_all_seq){
+    pub_all_seq.publish(ami_all_seq_msg);
+  }
+}
+
+/**
+ * @brief The sun points of a frame of the detector, plain and packed, each only if wanted
+ */
+static void detector(Publisher &pub_sun_points, Publisher &pub_sun_points_packed){
+  bool sun_wanted = pub_sun_points.wanted();
+  bool sun_packed_wanted = pub_sun_points_packed.wanted();
+  if (!(sun_wanted || sun_packed_wanted)){
+    return;
+  }
+  uvdar_core::ImagePointsWithFloatStamped msg_sun;
+  msg_sun.image_width = 752;
+  msg_sun.image_height = 480;
+  for (int i = 0; i < SUN_POINT_COUNT; i++){
+    uvdar_core::Point2DWithFloat point;
+    point.x = (13*i)%752;
+    point.y = (7*i)%480;
+    msg_sun.points.push_back(point);
+  }
+  if (sun_wanted){
+    pub_sun_points.publish(msg_sun);
+  }
+  if (sun_packed_wanted){
+    pub_sun_points_packed.publish(packed_points::pack(msg_sun));
+  }
+}
+
+/**
+ * @brief The constituent hypotheses of a scattering cycle of the pose calculator, verified and tentative, each only if wanted
+ */
+static void poseCalculator(Publisher &pub_hypotheses, Publisher &pub_hypotheses_tentative){
+  bool constituents_wanted = pub_hypotheses.wanted();
+  bool constituents_tentative_wanted = pub_hypotheses_tentative.wanted();
+  if (!(constituents_wanted || constituents_tentative_wanted)){
+    return;
+  }
+  mrs_msgs::PoseWithCovarianceArrayStamped msg_constuents_array, msg_constuents_tentative_array;
+  for (int h = 0; h < HYPOTHESIS_COUNT; h++){
+    mrs_msgs::PoseWithCovarianceIdentified constituent;
+    constituent.id = h;
+    constituent.pose.position.x = 0.01*h;
+    constituent.pose.position.z = 5.0;
+    constituent.pose.orientation.w = 1.0;
+    for (int i=0; i<6; i++){
+      constituent.covariance[6*i+i] = 0.01;
+    }
+    if ((h%2 == 0) && constituents_wanted)
+      msg_constuents_array.poses.push_back(constituent);
+    else if ((h%2 == 1) && constituents_tentative_wanted)
+      msg_constuents_tentative_array.poses.push_back(constituent);
+  }
+  if (constituents_wanted){
+    pub_hypotheses.publish(msg_constuents_array);
+  }
+  if (constituents_tentative_wanted){
+    pub_hypotheses_tentative.publish(msg_constuents_tentative_array);
+  }
+}
+
+/**
+ * @brief Measures the CPU time of the cycles of a node and scales it to the rate of the node
+ */
+template <class F>
+static void report(const std::string &name, double rate, F &&cycle){
+  double start = cpuTime();
+  for (int c = 0; c < CYCLES; c++){
+    cycle();
+  }
+  double duration = (cpuTime() - start)/CYCLES;
+  std::cout << "  " << name << ": " << 1e6*duration << " us/cycle, at " << rate << " Hz " << 1e3*duration*rate << " ms of CPU per s (" << 100.0*duration*rate << " %)" << std::endl;
+}
+
+/* main //{ */
+int main() {
+  for (uint32_t subscribers : {0u, 1u}){
+    MockPublisher mock;
+    mock.subscribers = subscribers;
+    MockPublisher pub_blinkers;
+    Publisher pub_all_seq(mock), pub_sun_points(mock), pub_sun_points_packed(mock), pub_hypotheses(mock), pub_hypotheses_tentative(mock);
+
+    std::cout << subscribers << " subscribers of the optional outputs:" << std::endl;
+    report("blink processor, " + std::to_string(CAMERA_COUNT) + " cameras", CAMERA_COUNT*BLINK_PROCESS_RATE, [&]{
+        blinkProcessor(pub_blinkers, pub_all_seq);
+        });
+    report("detector, " + std::to_string(CAMERA_COUNT) + " cameras", CAMERA_COUNT*FRAMERATE, [&]{
+        detector(pub_sun_points, pub_sun_points_packed);
+        });
+    report("pose calculator", SCATTER_RATE, [&]{
+        poseCalculator(pub_hypotheses, pub_hypotheses_tentative);
+        });
+  }
+  return 0;
+}
+//}
@@ -0,0 +1,256 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <mutex>
+#include <cmath>
+#include <Eigen/Dense>
+#include <mrs_msgs/PoseWithCovarianceArrayStamped.h>
+#include <geometry_msgs/PoseWithCovarianceStamped.h>
+#include <geometry_msgs/TransformStamped.h>
+
+namespace e = Eigen;
+
+#define sqr(X) ((X) * (X))
+#define POSE_COUNTS {1, 2, 5, 10, 20, 50} // per measurement message
+#define REPETITIONS 5000
+#define UNCERTAIN_ORIENTATION_FRACTION 0.5 // of the poses, whose orientation covariance is inflated by the filter
+
+typedef e::Matrix<double,6,1> z_t; // as in the filter
+typedef e::Matrix<double,6,6> R_t;
+struct Measurement {
+  z_t x;
+  R_t P;
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+typedef std::vector<Measurement, e::aligned_allocator<Measurement>> measurements_t;
+
+/* helpers of the filter //{ */
+static R_t rosCovarianceToEigen(const boost::array<double,36> &input){
+  R_t output;
+  for (int i=0; i<6; i++){
+    for (int j=0; j<6; j++){
+      output(j,i) = input[6*j+i];
+    }
+  }
+  return output;
+}
+
+static boost::array<double,36> eigenCovarianceToRos(const R_t &input){
+  boost::array<double,36> output;
+  for (int i=0; i<6; i++){
+    for (int j=0; j<6; j++){
+      output[6*j+i] = input(j,i);
+    }
+  }
+  return output;
+}
+
+static double fixAngle(double angle){
+  angle = std::fmod(angle, 2*M_PI);
+  if (angle > M_PI){
+    angle -= 2.0*M_PI;
+  }
+  if (angle < -M_PI){
+    angle += 2.0*M_PI;
+  }
+  return angle;
+}
+
+static z_t poseVector(const e::Vector3d &position, const e::Quaterniond &orientation){
+  e::Matrix3d m = orientation.matrix();
+  z_t output;
+  output.head<3>() = position;
+  output(3) = fixAngle(atan2(m(2,1),m(2,2)));
+  output(4) = fixAngle(atan2(-m(2,0), sqrt(m(2,1)*m(2,1) + m(2,2)*m(2,2))));
+  output(5) = fixAngle(atan2(m(1,0),m(0,0)));
+  return output;
+}
+//}
+
+/**
+ * @brief The conversion of the filter before the poses were transformed at once - each pose is copied into a stamped message and transformed on its own while the transformer is locked, and its covariance is inflated with the general eigen solver
+ */
+static measurements_t convertPerPose(const mrs_msgs::PoseWithCovarianceArrayStamped &msg, const geometry_msgs::TransformStamped &tf, std::mutex &transformer_mutex){
+  mrs_msgs::PoseWithCovarianceArrayStamped msg_local = msg;
+  measurements_t output;
+  for (auto &meas : msg_local.poses){
+    geometry_msgs::PoseWithCovarianceStamped meas_s;
+    meas_s.pose.pose = meas.pose;
+    meas_s.pose.covariance = meas.covariance;
+    meas_s.header = msg_local.header;
+    geometry_msgs::PoseWithCovarianceStamped meas_t = meas_s;
+    {
+      // as tf2::doTransform of the transformer
+      std::scoped_lock lock(transformer_mutex);
+      const auto &transform = tf.transform;
+      e::Quaterniond tf_orientation(transform.rotation.w, transform.rotation.x, transform.rotation.y, transform.rotation.z);
+      e::Vector3d tf_translation(transform.translation.x, transform.translation.y, transform.translation.z);
+      e::Vector3d position = tf_orientation*e::Vector3d(meas_s.pose.pose.position.x, meas_s.pose.pose.position.y, meas_s.pose.pose.position.z) + tf_translation;
+      e::Quaterniond orientation = tf_orientation*e::Quaterniond(meas_s.pose.pose.orientation.w, meas_s.pose.pose.orientation.x, meas_s.pose.pose.orientation.y, meas_s.pose.pose.orientation.z);
+      meas_t.pose.pose.position.x = position.x();
+      meas_t.pose.pose.position.y = position.y();
+      meas_t.pose.pose.position.z = position.z();
+      meas_t.pose.pose.orientation.w = orientation.w();
+      meas_t.pose.pose.orientation.x = orientation.x();
+      meas_t.pose.pose.orientation.y = orientation.y();
+      meas_t.pose.pose.orientation.z = orientation.z();
+      R_t rotation = R_t::Zero();
+      rotation.topLeftCorner<3,3>() = tf_orientation.matrix();
+      rotation.bottomRightCorner<3,3>() = tf_orientation.matrix();
+      meas_t.pose.covariance = eigenCovarianceToRos(rotation*rosCovarianceToEigen(meas_s.pose.covariance)*rotation.transpose());
+    }
+
+    auto &pose = meas_t.pose.pose;
+    z_t poseVec = poseVector(e::Vector3d(pose.position.x, pose.position.y, pose.position.z), e::Quaterniond(pose.orientation.w, pose.orientation.x, pose.orientation.y, pose.orientation.z));
+    R_t poseCov = rosCovarianceToEigen(meas_t.pose.covariance);
+    bool changed = false;
+    e::EigenSolver<e::Matrix3d> es(poseCov.bottomRightCorner<3,3>());
+    auto eigvals = es.eigenvalues();
+    for (int i=0; i<(int)(eigvals.size()); i++){
+      if (eigvals(i).real() >= sqr(M_PI)){
+        eigvals(i) = sqr(666.0);
+        changed = true;
+      }
+    }
+    if (changed){
+      auto eigvecs = es.eigenvectors();
+      poseCov.bottomRightCorner<3,3>() = eigvecs.real()*eigvals.real().asDiagonal()*eigvecs.real().transpose();
+    }
+    output.push_back({poseVec, poseCov});
+  }
+  return output;
+}
+
+/**
+ * @brief The conversion of the filter, transforming all poses of the message at once with the transformer unlocked, and inflating the covariances with the closed-form symmetric eigen solver
+ */
+static measurements_t convertBatched(const mrs_msgs::PoseWithCovarianceArrayStamped &msg, const geometry_msgs::TransformStamped &tf){
+  const auto &transform = tf.transform;
+  e::Quaterniond tf_orientation(transform.rotation.w, transform.rotation.x, transform.rotation.y, transform.rotation.z);
+  e::Isometry3d tf_eigen = e::Translation3d(transform.translation.x, transform.translation.y, transform.translation.z) * tf_orientation;
+  R_t tf_rotation = R_t::Zero();
+  tf_rotation.topLeftCorner<3,3>() = tf_eigen.linear();
+  tf_rotation.bottomRightCorner<3,3>() = tf_eigen.linear();
+
+  e::Matrix3Xd positions(3, msg.poses.size());
+  for (int i=0; i<(int)(msg.poses.size()); i++){
+    const auto &position = msg.poses[i].pose.position;
+    positions.col(i) << position.x, position.y, position.z;
+  }
+  positions = tf_eigen*positions;
+
+  measurements_t output;
+  output.reserve(msg.poses.size());
+  for (int i=0; i<(int)(msg.poses.size()); i++){
+    const auto &meas = msg.poses[i];
+    z_t poseVec = poseVector(positions.col(i), tf_orientation*e::Quaterniond(meas.pose.orientation.w, meas.pose.orientation.x, meas.pose.orientation.y, meas.pose.orientation.z));
+    R_t poseCov = tf_rotation*rosCovarianceToEigen(meas.covariance)*tf_rotation.transpose();
+    bool changed = false;
+    e::SelfAdjointEigenSolver<e::Matrix3d> es;
+    es.computeDirect(poseCov.bottomRightCorner<3,3>());
+    e::Vector3d eigvals = es.eigenvalues();
+    for (int j=0; j<3; j++){
+      if (eigvals(j) >= sqr(M_PI)){
+        eigvals(j) = sqr(666.0);
+        changed = true;
+      }
+    }
+    if (changed){
+      e::Matrix3d eigvecs = es.eigenvectors();
+      poseCov.bottomRightCorner<3,3>() = eigvecs*eigvals.asDiagonal()*eigvecs.transpose();
+    }
+    output.push_back({poseVec, poseCov});
+  }
+  return output;
+}
+
+/**
+ * @brief Generates a measurement message of the pose calculator, with random poses and covariances
+ */
+static mrs_msgs::PoseWithCovarianceArrayStamped randomMessage(int count, std::mt19937 &generator){
+  std::normal_distribution<double> normal(0.0, 1.0);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  mrs_msgs::PoseWithCovarianceArrayStamped output;
+  output.header.frame_id = "uav1/uvdar_bluefox_left_optical";
+  for (int i = 0; i < count; i++){
+    mrs_msgs::PoseWithCovarianceIdentified meas;
+    meas.id = i;
+    meas.pose.position.x = 5.0*normal(generator);
+    meas.pose.position.y = 5.0*normal(generator);
+    meas.pose.position.z = 10.0 + 5.0*normal(generator);
+    e::Quaterniond orientation(normal(generator), normal(generator), normal(generator), normal(generator));
+    orientation.normalize();
+    meas.pose.orientation.w = orientation.w();
+    meas.pose.orientation.x = orientation.x();
+    meas.pose.orientation.y = orientation.y();
+    meas.pose.orientation.z = orientation.z();
+    R_t root = R_t::Random();
+    R_t covariance = 0.1*root*root.transpose();
+    if (uniform(generator) < UNCERTAIN_ORIENTATION_FRACTION){
+      covariance.bottomRightCorner<3,3>() *= 100.0;
+    }
+    meas.covariance = eigenCovarianceToRos(covariance);
+    output.poses.push_back(meas);
+  }
+  return output;
+}
+
+/**
+ * @brief Statistics of the durations of a single conversion
+ */
+struct Durations {
+  std::vector<double> samples; //us
+
+  void print(const std::string &name, int count){
+    std::sort(samples.begin(), samples.end());
+    double sum = 0;
+    for (auto d : samples){
+      sum += d;
+    }
+    double mean = sum/samples.size();
+    std::cout << "  " << name << ": mean " << mean << " us (" << mean/count << " us/pose), 99th percentile " << samples[(samples.size()*99)/100] << " us, max " << samples.back() << " us" << std::endl;
+  }
+};
+
+/* main //{ */
+int main() {
+  std::mt19937 generator(0);
+  geometry_msgs::TransformStamped tf;
+  e::Quaterniond tf_orientation(e::AngleAxisd(0.7, e::Vector3d(1.0, 2.0, 3.0).normalized()));
+  tf.transform.translation.x = 1.0;
+  tf.transform.translation.y = 2.0;
+  tf.transform.translation.z = 3.0;
+  tf.transform.rotation.w = tf_orientation.w();
+  tf.transform.rotation.x = tf_orientation.x();
+  tf.transform.rotation.y = tf_orientation.y();
+  tf.transform.rotation.z = tf_orientation.z();
+  std::mutex transformer_mutex;
+
+  for (int count : POSE_COUNTS){
+    auto msg = randomMessage(count, generator);
+    Durations per_pose, batched;
+    double max_difference = 0;
+    for (int r = 0; r < REPETITIONS; r++){
+      auto start = std::chrono::steady_clock::now();
+      auto output_per_pose = convertPerPose(msg, tf, transformer_mutex);
+      per_pose.samples.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+
+      start = std::chrono::steady_clock::now();
+      auto output_batched = convertBatched(msg, tf);
+      batched.samples.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+
+      for (int i = 0; i < count; i++){
+        max_difference = std::max(max_difference, (output_per_pose[i].x - output_batched[i].x).cwiseAbs().maxCoeff());
+        max_difference = std::max(max_difference, (output_per_pose[i].P - output_batched[i].P).cwiseAbs().maxCoeff()/output_per_pose[i].P.cwiseAbs().maxCoeff());
+      }
+    }
+    std::cout << count << " poses per message (largest difference " << max_difference << "):" << std::endl;
+    per_pose.print("per pose", count);
+    batched.print("batched", count);
+  }
+  return 0;
+}
+//}
@@ -0,0 +1,60 @@
+#include <ros/serialization.h>
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <packed_points/packed_points.h>
+
+using namespace uvdar;
+
+#define IMAGE_WIDTH 752
+#define IMAGE_HEIGHT 480
+#define FRAMERATE 60.0 //Hz
+#define POINT_COUNTS {10, 30, 100, 300, 1000}
+#define POINTS_PER_REPETITION 3000000 // repetitions of each measurement are scaled so that each processes this many points
+
+template <class F>
+static double measure(int repetitions, F &&f){
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < repetitions; r++){
+    f();
+  }
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count()/repetitions;
+}
+
+/* main //{ */
+int main() {
+  std::mt19937 generator(0);
+  volatile uint32_t sink = 0; // keeps the measured conversions from being optimized out
+
+  for (int count : POINT_COUNTS){
+    uvdar_core::ImagePointsWithFloatStamped msg;
+    msg.image_width = IMAGE_WIDTH;
+    msg.image_height = IMAGE_HEIGHT;
+    for (int i = 0; i < count; i++){
+      uvdar_core::Point2DWithFloat point;
+      point.x = generator()%IMAGE_WIDTH;
+      point.y = generator()%IMAGE_HEIGHT;
+      point.value = (int)(generator()%20)-2;
+      msg.points.push_back(point);
+    }
+    auto packed = packed_points::pack(msg);
+
+    uint32_t original_size = ros::serialization::serializationLength(msg);
+    uint32_t packed_size = ros::serialization::serializationLength(*packed);
+    int repetitions = std::max(POINTS_PER_REPETITION/count, 1);
+
+    double original_duration = measure(repetitions, [&]{
+        sink = sink + ros::serialization::serializeMessage(msg).num_bytes;
+        });
+    double packed_duration = measure(repetitions, [&]{
+        sink = sink + ros::serialization::serializeMessage(*packed_points::pack(msg)).num_bytes;
+        });
+    double unpack_duration = measure(repetitions, [&]{
+        sink = sink + packed_points::unpack(*packed)->points.size();
+        });
+
+    std::cout << count << " points: original " << original_size << " B, serialized in " << original_duration << " us; packed " << packed_size << " B (" << (double)(original_size)/packed_size << "x smaller), packed and serialized in " << packed_duration << " us, unpacked in " << unpack_duration << " us; at " << FRAMERATE << " fps: " << original_size*FRAMERATE/1000.0 << " kB/s vs " << packed_size*FRAMERATE/1000.0 << " kB/s" << std::endl;
+  }
+  return 0;
+}
+//}
@@ -0,0 +1,130 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <pose_core/pose_core.h>
+
+using namespace uvdar;
+
+#define CALIBRATION_FILE TEST_CONFIG_DIR "/ocamcalib/calib_results_bf_uv_fe.txt"
+#define MODEL_FILE TEST_CONFIG_DIR "/models/quadrotor_foursided.txt"
+#define LED_PROJECTION_COEFS {1.3398, 31.4704, 0.0154}
+#define VIEW_ANGLE_MARGIN 0.035
+
+#define HYPOTHESIS_COUNT 5000
+#define REPETITIONS 20
+#define POSITION_SPREADS {0.05, 0.2, 1.0} //m - of the hypotheses around the true pose, as fresh mutations, a converged and a lost particle filter
+#define ANGLE_PER_POSITION_SPREAD 0.5 //rad/m
+#define FOREIGN_SIGNAL 99 // not emitted by the model, as a point of another target wrongly associated with this one
+#define ERROR_BOUND_PER_POINT(camera) std::pow((camera).width()/50.0, 2) // as PF_REPROJECT_THRESHOLD_UNFIT of the fitness check
+
+/**
+ * @brief A population of hypotheses and the observation they are checked against
+ */
+struct Scenario {
+  std::string name;
+  std::vector<pose_core::Pose> poses;
+  std::vector<pose_core::ObservedPoint> points;
+};
+
+static pose_core::Pose observedPose(){
+  pose_core::Pose output;
+  output.position = e::Vector3d(0.5, 0.2, 6.0);
+  output.orientation =
+    e::AngleAxisd(M_PI/2, e::Vector3d::UnitY())*
+    e::AngleAxisd(0.5, e::Vector3d::UnitY())* // seen from above, so that most of the LEDs are observed
+    e::AngleAxisd(M_PI/4, e::Vector3d::UnitZ());
+  return output;
+}
+
+static std::vector<pose_core::Pose> spreadPoses(const pose_core::Pose &center, double position_spread, std::mt19937 &generator){
+  std::normal_distribution<double> normal(0.0, 1.0);
+  std::vector<pose_core::Pose> output(HYPOTHESIS_COUNT);
+  for (auto &pose : output){
+    e::Vector3d axis(normal(generator), normal(generator), normal(generator));
+    pose.position = center.position + position_spread*e::Vector3d(normal(generator), normal(generator), normal(generator));
+    pose.orientation = center.orientation*e::Quaterniond(e::AngleAxisd(ANGLE_PER_POSITION_SPREAD*position_spread*normal(generator), axis.normalized()));
+  }
+  return output;
+}
+
+/**
+ * @brief The result of evaluating a whole population once
+ */
+struct Evaluation {
+  double duration = 0; //us
+  int rejected = 0; // exceeding the bound
+  int early_exits = 0;
+  std::vector<bool> decisions;
+};
+
+static Evaluation evaluate(const pose_core::Reprojection &reprojection, const std::vector<pose_core::Marker> &markers, const Scenario &scenario, double error_bound){
+  const double threshold = scenario.points.size()*ERROR_BOUND_PER_POINT(reprojection.camera());
+  Evaluation output;
+  output.decisions.reserve(scenario.poses.size());
+  auto start = std::chrono::steady_clock::now();
+  for (auto &pose : scenario.poses){
+    pose_core::ErrorOutcome outcome;
+    double error = reprojection.hypothesisError(markers, pose, pose_core::Pose(), scenario.points, error_bound, false, nullptr, &outcome);
+    output.decisions.push_back(error > threshold);
+    output.rejected += (error > threshold);
+    output.early_exits += (outcome == pose_core::ErrorOutcome::early_exit);
+  }
+  output.duration = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  return output;
+}
+
+/* main //{ */
+int main() {
+  ocam_model oc_model;
+  if (get_ocam_model(&oc_model, (char*)(CALIBRATION_FILE)) < 0){
+    std::cerr << "Failed to load the calibration file " << CALIBRATION_FILE << std::endl;
+    return 1;
+  }
+  const pose_core::CameraModel camera(oc_model);
+  const pose_core::Reprojection reprojection(camera, LED_PROJECTION_COEFS, VIEW_ANGLE_MARGIN);
+  auto markers = pose_core::loadModel(MODEL_FILE);
+  if (!markers || markers->empty()){
+    std::cerr << "Failed to load the model file " << MODEL_FILE << std::endl;
+    return 1;
+  }
+
+  // the output frame is the frame of the camera
+  const auto truth = observedPose();
+  std::vector<pose_core::ObservedPoint> points;
+  reprojection.hypothesisError(markers.value(), truth, pose_core::Pose(), {}, std::numeric_limits<double>::max(), false, &points);
+  std::cout << points.size() << " observed points, " << HYPOTHESIS_COUNT << " hypotheses per scenario" << std::endl;
+
+  std::mt19937 generator(0);
+  std::vector<Scenario> scenarios;
+  for (double spread : POSITION_SPREADS){
+    std::stringstream name;
+    name << "spread " << spread << " m";
+    scenarios.push_back({name.str(), spreadPoses(truth, spread, generator), points});
+  }
+  auto misassociated = points;
+  for (auto &point : misassociated){
+    point.signal = FOREIGN_SIGNAL;
+  }
+  scenarios.push_back({"spread 0.05 m, only foreign points", spreadPoses(truth, 0.05, generator), misassociated});
+
+  for (auto &scenario : scenarios){
+    const double threshold = scenario.points.size()*ERROR_BOUND_PER_POINT(camera);
+    double unbounded_duration = 0, bounded_duration = 0;
+    Evaluation unbounded, bounded;
+    for (int r = 0; r < REPETITIONS; r++){
+      unbounded = evaluate(reprojection, markers.value(), scenario, std::numeric_limits<double>::max());
+      bounded = evaluate(reprojection, markers.value(), scenario, threshold);
+      unbounded_duration += unbounded.duration;
+      bounded_duration += bounded.duration;
+    }
+    const double evaluations = (double)(REPETITIONS)*scenario.poses.size();
+    std::cout << scenario.name << ": rejected " << (100.0*bounded.rejected)/scenario.poses.size() << " %, terminated early " << (100.0*bounded.early_exits)/scenario.poses.size() << " %" << std::endl;
+    std::cout << "  without the bound " << 1000.0*unbounded_duration/evaluations << " ns/hypothesis, with the bound " << 1000.0*bounded_duration/evaluations << " ns/hypothesis (" << unbounded_duration/bounded_duration << "x)" << (unbounded.decisions == bounded.decisions?"":", DECISIONS DIFFER") << std::endl;
+  }
+  return 0;
+}
+//}
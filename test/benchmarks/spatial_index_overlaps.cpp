@@ -0,0 +1,126 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <Eigen/Dense>
+#include <spatial_index/spatial_index.h>
+
+using namespace uvdar;
+
+#define STATE_COUNTS {10, 50, 200}
+#define PAIRS_PER_COUNT 2000000 // repetitions of each measurement are scaled so that the exhaustive removal evaluates about this many pairs
+#define MATCH_LEVEL_THRESHOLD_REMOVE 0.5 // as in the filter
+#define MIN_MEASUREMENTS_TO_VALIDATION 10
+
+/**
+ * @brief The position part of a filter state
+ */
+struct State {
+  e::Vector3d x;
+  e::Matrix3d P;
+  int update_count;
+};
+
+/* overlap removal //{ */
+static int removedOfPair(const std::vector<State> &states, int i, int j){
+  double size_i = states[i].P.eigenvalues().norm();
+  double size_j = states[j].P.eigenvalues().norm();
+  bool unvalidated_i = states[i].update_count < MIN_MEASUREMENTS_TO_VALIDATION;
+  bool unvalidated_j = states[j].update_count < MIN_MEASUREMENTS_TO_VALIDATION;
+  if (unvalidated_i == unvalidated_j){
+    return (size_j > size_i)?j:i;
+  }
+  return unvalidated_i?i:j;
+}
+
+/**
+ * @brief The overlap removal of the filter before the index - all pairs are checked
+ */
+static void removeOverlapsExhaustive(std::vector<State> &states){
+  for (int i = 0; i < (int)(states.size())-1; i++){
+    bool removed_first = false;
+    for (int j = i+1; j < (int)(states.size()); j++){
+      if (spatial_index::gaussJointMaxVal(states[i].P, states[j].P, states[i].x, states[j].x) > MATCH_LEVEL_THRESHOLD_REMOVE){
+        int n = removedOfPair(states, i, j);
+        states.erase(states.begin()+n);
+        if (n == i){
+          removed_first = true;
+          break;
+        }
+        j--;
+      }
+    }
+    if (removed_first){
+      i--;
+    }
+  }
+}
+
+/**
+ * @brief The overlap removal of the filter - only the pairs with intersecting bounding spheres are checked
+ */
+static void removeOverlapsIndexed(std::vector<State> &states){
+  const double gate = -2.0*std::log(MATCH_LEVEL_THRESHOLD_REMOVE);
+  std::vector<e::Vector3d> centers;
+  std::vector<double> radii;
+  for (auto &state : states){
+    centers.push_back(state.x);
+    radii.push_back(spatial_index::gateRadius(state.P, gate));
+  }
+  std::vector<bool> removed(states.size(), false);
+  for (auto [i, j] : spatial_index::intersectingPairs(centers, radii)){
+    if (removed[i] || removed[j]){
+      continue;
+    }
+    if (spatial_index::gaussJointMaxVal(states[i].P, states[j].P, states[i].x, states[j].x) > MATCH_LEVEL_THRESHOLD_REMOVE){
+      removed[removedOfPair(states, i, j)] = true;
+    }
+  }
+  int kept = 0;
+  for (int i = 0; i < (int)(states.size()); i++){
+    if (!removed[i]){
+      states[kept++] = states[i];
+    }
+  }
+  states.erase(states.begin()+kept, states.end());
+}
+//}
+
+/* main //{ */
+int main() {
+  std::mt19937 generator(0);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0), scale(0.05, 1.0);
+  std::uniform_int_distribution<int> update_count(0, 2*MIN_MEASUREMENTS_TO_VALIDATION);
+
+  for (int count : STATE_COUNTS){
+    // the extent grows with the count, so that the density of the swarm stays similar
+    double extent = 4.0*std::sqrt((double)(count));
+    std::vector<State> states;
+    for (int i = 0; i < count; i++){
+      e::Matrix3d A = e::Matrix3d::Random();
+      states.push_back({e::Vector3d(extent*uniform(generator), extent*uniform(generator), 0.3*extent*uniform(generator)), scale(generator)*A*A.transpose() + 0.01*e::Matrix3d::Identity(), update_count(generator)});
+    }
+
+    int repetitions = std::max(PAIRS_PER_COUNT/(count*count), 1);
+    double exhaustive_duration = 0, indexed_duration = 0;
+    size_t exhaustive_kept = 0, indexed_kept = 0;
+    for (int r = 0; r < repetitions; r++){
+      auto exhaustive = states;
+      auto indexed = states;
+      auto start = std::chrono::steady_clock::now();
+      removeOverlapsExhaustive(exhaustive);
+      auto middle = std::chrono::steady_clock::now();
+      removeOverlapsIndexed(indexed);
+      auto end = std::chrono::steady_clock::now();
+      exhaustive_duration += std::chrono::duration<double, std::micro>(middle - start).count();
+      indexed_duration += std::chrono::duration<double, std::micro>(end - middle).count();
+      exhaustive_kept = exhaustive.size();
+      indexed_kept = indexed.size();
+    }
+    std::cout << count << " states: exhaustive removal " << exhaustive_duration/repetitions << " us, indexed removal " << indexed_duration/repetitions << " us (" << exhaustive_duration/indexed_duration << "x), " << exhaustive_kept << "/" << indexed_kept << " states kept" << std::endl;
+  }
+  return 0;
+}
+//}
@@ -0,0 +1,167 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <unistd.h>
+#include <trace/trace.h>
+
+using namespace uvdar;
+
+#define SPAN_COUNT 10000000
+#define THREAD_COUNT 4
+#define SAMPLE_DURATION 0.5 //s
+#define SAMPLE_FRAMERATE 60.0 //Hz
+#define SAMPLE_PROCESS_FRAMES 3 // the blink processor evaluates the accumulated points every this many frames
+
+/**
+ * @brief Measures the average cost of a span, in nanoseconds
+ */
+static double spanCost(int count){
+  volatile int sink = 0; // keeps the loop from being optimized out
+  int64_t start = trace::now();
+  for (int i = 0; i < count; i++){
+    UVDAR_TRACE_SCOPE("benchmark span");
+    sink = sink + i;
+  }
+  return (double)(trace::now() - start)/count;
+}
+
+static void busyWait(double duration){
+  auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(duration);
+  while (std::chrono::steady_clock::now() < end){
+  }
+}
+
+/* writeSample //{ */
+/**
+ * @brief Writes a synthetic trace with the spans of the detector, blink processor and pose calculator, with their processing replaced by busy waiting of typical durations. Each thread stands for one of the nodes - run as nodelets in a single manager, they are exported in the same manner
+ */
+static bool writeSample(const std::string &filename){
+  trace::enable(true);
+  const auto period = std::chrono::duration<double>(1.0/SAMPLE_FRAMERATE);
+  const int frame_count = (int)(SAMPLE_DURATION*SAMPLE_FRAMERATE);
+  std::atomic<int> detected(0), processed(0);
+
+  std::thread detector([&]{
+      auto next = std::chrono::steady_clock::now();
+      for (int f = 0; f < frame_count; f++){
+        {
+          UVDAR_TRACE_SCOPE("detector: image");
+          busyWait(0.0015);
+        }
+        detected++;
+        next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+        std::this_thread::sleep_until(next);
+      }
+      });
+
+  std::thread blink([&]{
+      int seen = 0;
+      while (seen < frame_count){
+        if (detected > seen){
+          seen++;
+          {
+            UVDAR_TRACE_SCOPE("blink: points received");
+            busyWait(0.0001);
+          }
+          if ((seen % SAMPLE_PROCESS_FRAMES) == 0){
+            UVDAR_TRACE_SCOPE("blink: processing");
+            busyWait(0.004);
+            processed++;
+          }
+        }
+        else {
+          std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+      }
+      });
+
+  std::thread pose([&]{
+      int seen = 0;
+      while (seen < (frame_count/SAMPLE_PROCESS_FRAMES)){
+        if (processed > seen){
+          seen++;
+          {
+            UVDAR_TRACE_SCOPE("pose: points received");
+            busyWait(0.0001);
+          }
+          if (seen == 1){
+            UVDAR_TRACE_SCOPE("pose: initialization");
+            busyWait(0.008);
+          }
+          UVDAR_TRACE_SCOPE("pose: filtering");
+          busyWait(0.003);
+        }
+        else {
+          std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+      }
+      });
+
+  detector.join();
+  blink.join();
+  pose.join();
+  return trace::writeChromeTrace(filename);
+}
+//}
+
+/* main //{ */
+int main(int argc, char** argv) {
+  if (argc > 2){
+    std::cerr << "Usage: " << argv[0] << " [sample trace file]" << std::endl;
+    std::cerr << "Measures the overhead of tracing, or writes a sample trace of the detection pipeline if a file is given." << std::endl;
+    return 1;
+  }
+  if (argc == 2){
+    if (!writeSample(argv[1])){
+      std::cerr << "Failed to write " << argv[1] << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  trace::enable(false);
+  std::cout << "Disabled: " << spanCost(SPAN_COUNT) << " ns per span" << std::endl;
+
+  trace::enable(true);
+  std::cout << "Enabled, 1 thread: " << spanCost(SPAN_COUNT) << " ns per span" << std::endl;
+
+  std::vector<double> costs(THREAD_COUNT);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < THREAD_COUNT; t++){
+    threads.emplace_back([&costs, t]{
+        costs[t] = spanCost(SPAN_COUNT/THREAD_COUNT);
+        });
+  }
+  for (auto &thread : threads){
+    thread.join();
+  }
+  double cost_sum = 0;
+  for (auto cost : costs){
+    cost_sum += cost;
+  }
+  std::cout << "Enabled, " << THREAD_COUNT << " threads: " << cost_sum/THREAD_COUNT << " ns per span" << std::endl;
+
+  // export while a thread keeps recording, as happens when a node exports at shutdown or on request
+  std::atomic<bool> running(true);
+  std::atomic<long> recorded(0);
+  std::thread writer([&]{
+      while (running){
+        UVDAR_TRACE_SCOPE("benchmark concurrent span");
+        recorded++;
+      }
+      });
+  std::string filename = "/tmp/uvdar_trace_benchmark_" + std::to_string(getpid()) + ".json";
+  int64_t start = trace::now();
+  bool success = trace::writeChromeTrace(filename);
+  double export_duration = (trace::now() - start)/1e6;
+  running = false;
+  writer.join();
+  std::remove(filename.c_str());
+  std::cout << "Export of " << (THREAD_COUNT+2) << " thread buffers: " << export_duration << " ms" << (success?"":" (failed)") << ", " << recorded << " spans recorded concurrently" << std::endl;
+  return success?0:1;
+}
+//}
@@ -0,0 +1,142 @@
+#include <ros/serialization.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <ctime>
+#include <cv_bridge/cv_bridge.h>
+#include <sensor_msgs/CompressedImage.h>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/imgcodecs/imgcodecs.hpp>
+#include <visualization_output/visualization_output.h>
+
+using namespace uvdar;
+
+#define IMAGE_WIDTH 752
+#define IMAGE_HEIGHT 480
+#define CAMERA_COUNT 3
+#define LED_COUNT 6 // bright spots in each frame
+#define MARKER_COUNT 8 // detected points of a single target, drawn into the first frame
+#define DETECTOR_VISUALIZATION_RATE 10.0 //Hz, visualization_rate
+#define BLINK_VISUALIZATION_RATE 2.0 //Hz
+#define REPETITIONS 50
+
+/**
+ * @brief A configuration of the visualization output
+ */
+struct Mode {
+  std::string name;
+  double scale;
+  int roi_margin;
+  int jpeg_quality;
+};
+
+/**
+ * @brief Retrieves the CPU time of the calling thread, in seconds
+ */
+static double cpuTime(){
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+/**
+ * @brief Renders the frames of the cameras side by side with the markers, as the detector does
+ */
+static void render(const std::vector<cv::Mat> &frames, const std::vector<cv::Point> &points, cv::Mat &output_image, std::vector<cv::Point> &markers){
+  output_image = cv::Mat(cv::Size(CAMERA_COUNT*IMAGE_WIDTH + CAMERA_COUNT - 1, IMAGE_HEIGHT), CV_8UC3);
+  output_image = cv::Scalar(255, 255, 255);
+  markers.clear();
+  for (int c = 0; c < CAMERA_COUNT; c++){
+    cv::Point start_point(c*(IMAGE_WIDTH + 1), 0);
+    cv::cvtColor(frames[c], output_image(cv::Rect(start_point.x, 0, IMAGE_WIDTH, IMAGE_HEIGHT)), cv::COLOR_GRAY2BGR);
+    if (c > 0){
+      continue;
+    }
+    for (auto &point : points){
+      cv::circle(output_image, point + start_point, 5, cv::Scalar(255,0,0));
+      markers.push_back(point + start_point);
+    }
+  }
+}
+
+/**
+ * @brief Reduces and encodes the image as the visualization output does
+ *
+ * @return The size of the serialized message in bytes, or 0 if nothing would be published
+ */
+static uint32_t output(const cv::Mat &image, const std::vector<cv::Point> &markers, const Mode &mode, cv::Mat &reduced){
+  visualization_output::Options options;
+  options.scale = mode.scale;
+  options.roi_margin = mode.roi_margin;
+  if (!visualization_output::reduce(image, markers, options, reduced)){
+    return 0;
+  }
+  std_msgs::Header header;
+  if (mode.jpeg_quality > 0){
+    sensor_msgs::CompressedImage msg;
+    msg.header = header;
+    msg.format = "bgr8; jpeg compressed bgr8";
+    cv::imencode(".jpg", reduced, msg.data, {cv::IMWRITE_JPEG_QUALITY, mode.jpeg_quality});
+    return ros::serialization::serializationLength(msg);
+  }
+  return ros::serialization::serializationLength(*(cv_bridge::CvImage(header, "bgr8", reduced).toImageMsg()));
+}
+
+/* main //{ */
+int main() {
+  std::mt19937 generator(0);
+  std::normal_distribution<double> noise(12.0, 4.0);
+  std::uniform_int_distribution<int> led_x(50, IMAGE_WIDTH-50), led_y(50, IMAGE_HEIGHT-50);
+  std::uniform_int_distribution<int> marker_x(-60, 60), marker_y(-40, 40);
+
+  // UV frames - a dark background with sensor noise and a few bright spots
+  std::vector<cv::Mat> frames;
+  for (int c = 0; c < CAMERA_COUNT; c++){
+    cv::Mat frame(IMAGE_HEIGHT, IMAGE_WIDTH, CV_8UC1);
+    for (int y = 0; y < IMAGE_HEIGHT; y++){
+      for (int x = 0; x < IMAGE_WIDTH; x++){
+        frame.at<uint8_t>(y, x) = cv::saturate_cast<uint8_t>(noise(generator));
+      }
+    }
+    for (int l = 0; l < LED_COUNT; l++){
+      cv::circle(frame, cv::Point(led_x(generator), led_y(generator)), 3, cv::Scalar(255), -1);
+    }
+    frames.push_back(frame);
+  }
+  std::vector<cv::Point> points; // the markers of a single target are close to each other
+  for (int m = 0; m < MARKER_COUNT; m++){
+    points.push_back(cv::Point(300 + marker_x(generator), 200 + marker_y(generator)));
+  }
+
+  const std::vector<Mode> modes = {
+    {"full raw", 1.0, -1, 0},
+    {"scale 0.5", 0.5, -1, 0},
+    {"scale 0.25", 0.25, -1, 0},
+    {"roi +40 px", 1.0, 40, 0},
+    {"jpeg q80", 1.0, -1, 80},
+    {"scale 0.5 + jpeg q80", 0.5, -1, 80},
+    {"roi +40 px + jpeg q80", 1.0, 40, 80},
+  };
+
+  cv::Mat image, reduced;
+  std::vector<cv::Point> markers;
+  std::cout << CAMERA_COUNT << " cameras of " << IMAGE_WIDTH << "x" << IMAGE_HEIGHT << ", " << MARKER_COUNT << " markers:" << std::endl;
+  for (auto &mode : modes){
+    uint32_t bytes = 0;
+    double render_duration = 0, output_duration = 0;
+    for (int r = 0; r < REPETITIONS; r++){
+      double start = cpuTime();
+      render(frames, points, image, markers);
+      double rendered = cpuTime();
+      bytes = output(image, markers, mode, reduced);
+      output_duration += cpuTime() - rendered;
+      render_duration += rendered - start;
+    }
+    render_duration /= REPETITIONS;
+    output_duration /= REPETITIONS;
+    std::cout << "  " << mode.name << ": " << bytes/1024.0 << " KiB/image, " << bytes*DETECTOR_VISUALIZATION_RATE/(1024.0*1024.0) << " MiB/s at " << DETECTOR_VISUALIZATION_RATE << " Hz (detector), " << bytes*BLINK_VISUALIZATION_RATE/(1024.0*1024.0) << " MiB/s at " << BLINK_VISUALIZATION_RATE << " Hz (blink processor); CPU per image: render " << 1e3*render_duration << " ms, reduce and encode " << 1e3*output_duration << " ms" << std::endl;
+  }
+  return 0;
+}
+//}
@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include <diagnostics/diagnostics.h>
+
+using namespace uvdar;
+using uvdar_core::DiagnosticValue;
+
+/* helpers //{ */
+static const DiagnosticValue *findValue(const uvdar_core::RuntimeDiagnostics &msg, const std::string &name){
+  for (auto &value : msg.values){
+    if (value.name == name){
+      return &value;
+    }
+  }
+  return nullptr;
+}
+//}
+
+/* counters //{ */
+TEST(Diagnostics, CounterReportsCountAndRate){
+  diagnostics::Aggregator aggregator("test");
+  for (int k = 0; k < 10; k++){
+    aggregator.add("frames", DiagnosticValue::COUNTER, 2);
+  }
+  auto msg = aggregator.aggregate(4.0);
+  EXPECT_EQ(msg.component, "test");
+  EXPECT_DOUBLE_EQ(msg.period, 4.0);
+  auto value = findValue(msg, "frames");
+  ASSERT_NE(value, nullptr);
+  EXPECT_EQ(value->type, DiagnosticValue::COUNTER);
+  EXPECT_EQ(value->count, 20u);
+  EXPECT_DOUBLE_EQ(value->rate, 5.0);
+}
+
+TEST(Diagnostics, CounterWithZeroPeriodHasZeroRate){
+  diagnostics::Aggregator aggregator("test");
+  aggregator.add("frames", DiagnosticValue::COUNTER, 3);
+  auto msg = aggregator.aggregate(0.0);
+  auto value = findValue(msg, "frames");
+  ASSERT_NE(value, nullptr);
+  EXPECT_EQ(value->count, 3u);
+  EXPECT_DOUBLE_EQ(value->rate, 0.0);
+}
+//}
+
+/* gauges //{ */
+TEST(Diagnostics, GaugeReportsLastMeanAndMax){
+  diagnostics::Aggregator aggregator("test");
+  for (double sample : {3.0, 7.0, 5.0}){
+    aggregator.add("points", DiagnosticValue::GAUGE, sample);
+  }
+  auto msg = aggregator.aggregate(1.0);
+  auto value = findValue(msg, "points");
+  ASSERT_NE(value, nullptr);
+  EXPECT_EQ(value->type, DiagnosticValue::GAUGE);
+  EXPECT_EQ(value->count, 3u);
+  EXPECT_DOUBLE_EQ(value->last, 5.0);
+  EXPECT_DOUBLE_EQ(value->mean, 5.0);
+  EXPECT_DOUBLE_EQ(value->max, 7.0);
+}
+
+TEST(Diagnostics, GaugeMaximumOfNegativeSamples){
+  diagnostics::Aggregator aggregator("test");
+  aggregator.add("offset", DiagnosticValue::GAUGE, -3.0);
+  aggregator.add("offset", DiagnosticValue::GAUGE, -5.0);
+  auto msg = aggregator.aggregate(1.0);
+  auto value = findValue(msg, "offset");
+  ASSERT_NE(value, nullptr);
+  EXPECT_DOUBLE_EQ(value->max, -3.0);
+  EXPECT_DOUBLE_EQ(value->mean, -4.0);
+}
+//}
+
+/* periods //{ */
+TEST(Diagnostics, AggregationResetsValuesButKeepsNames){
+  diagnostics::Aggregator aggregator("test");
+  aggregator.add("frames", DiagnosticValue::COUNTER, 4);
+  aggregator.add("points", DiagnosticValue::GAUGE, 9.0);
+  aggregator.aggregate(1.0);
+
+  auto msg = aggregator.aggregate(1.0);
+  ASSERT_EQ(msg.values.size(), 2u);
+  for (auto &value : msg.values){
+    EXPECT_EQ(value.count, 0u);
+    EXPECT_DOUBLE_EQ(value.rate, 0.0);
+    EXPECT_DOUBLE_EQ(value.max, 0.0);
+  }
+
+  // the maximum of the new period is not bounded by the samples of the previous one
+  aggregator.add("points", DiagnosticValue::GAUGE, 2.0);
+  msg = aggregator.aggregate(1.0);
+  auto value = findValue(msg, "points");
+  ASSERT_NE(value, nullptr);
+  EXPECT_DOUBLE_EQ(value->max, 2.0);
+}
+
+TEST(Diagnostics, ConcurrentRecordingLosesNoEvents){
+  diagnostics::Aggregator aggregator("test");
+  const int thread_count = 4, event_count = 100000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_count; t++){
+    threads.emplace_back([&]{
+        for (int k = 0; k < event_count; k++){
+          aggregator.add("frames", DiagnosticValue::COUNTER, 1);
+          aggregator.add("points", DiagnosticValue::GAUGE, k);
+        }
+        });
+  }
+  for (auto &thread : threads){
+    thread.join();
+  }
+  auto msg = aggregator.aggregate(1.0);
+  EXPECT_EQ(findValue(msg, "frames")->count, (uint64_t)(thread_count*event_count));
+  EXPECT_EQ(findValue(msg, "points")->count, (uint64_t)(thread_count*event_count));
+  EXPECT_DOUBLE_EQ(findValue(msg, "points")->max, event_count-1);
+}
+//}
+
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
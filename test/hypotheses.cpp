@@ -0,0 +1,225 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <set>
+#include <cmath>
+#include <pose_core/pose_core.h>
+#include <pose_core/hypotheses.h>
+
+using namespace uvdar;
+
+#define CALIBRATION_FILE TEST_CONFIG_DIR "/ocamcalib/calib_results_bf_uv_fe.txt"
+#define MODEL_FILE TEST_CONFIG_DIR "/models/quadrotor_foursided.txt"
+#define LED_PROJECTION_COEFS {1.3398, 31.4704, 0.0154}
+#define VIEW_ANGLE_MARGIN 0.035
+#define LED_GROUP_DISTANCE 0.03
+#define TEST_POSE_COUNT 20
+#define MAX_FUSED_POSITION_ERROR 0.3 //m
+#define RESAMPLED_ENTRY_COUNT 20
+#define RESAMPLING_DRAW_COUNT 100
+#define RESAMPLING_TRIAL_COUNT 5000
+#define CHI_SQUARE_QUANTILE_Z 3.090 // standard normal quantile of the 0.999 level
+
+/* helpers //{ */
+static pose_core::CameraModel loadCamera(){
+  ocam_model model;
+  get_ocam_model(&model, (char*)(CALIBRATION_FILE));
+  return pose_core::CameraModel(model);
+}
+
+static std::vector<pose_core::Marker> loadMarkers(){
+  auto markers = pose_core::loadModel(MODEL_FILE);
+  EXPECT_TRUE(markers.has_value());
+  return markers.value_or(std::vector<pose_core::Marker>());
+}
+
+/**
+ * @brief Generates an observation of the target at a random pose in front of the camera, turned such that at least three of its LED groups are observed. The output frame is the frame of the camera
+ */
+static pose_core::Observation randomObservation(const pose_core::Reprojection &reprojection, const std::vector<pose_core::Marker> &markers, std::mt19937 &generator, pose_core::Pose &truth){
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  pose_core::Observation output;
+  output.target = 0;
+  output.markers = &markers;
+  while (true){
+    truth.position = e::Vector3d(uniform(generator), 0.5*uniform(generator), 5+uniform(generator));
+    truth.orientation =
+      e::AngleAxisd(M_PI/2, e::Vector3d::UnitY())*
+      e::AngleAxisd(0.4+0.2*uniform(generator), e::Vector3d::UnitY())* // seen from above, otherwise the LEDs project onto a line
+      e::AngleAxisd(M_PI/4+0.5*uniform(generator), e::Vector3d::UnitZ());
+    reprojection.hypothesisError(markers, truth, output.tocam, {}, std::numeric_limits<double>::max(), false, &output.points);
+    if (output.points.size() >= 3){
+      return output;
+    }
+  }
+}
+//}
+
+/* lifecycle //{ */
+TEST(Hypotheses, InitializedHypothesesFuseNearTruth){
+  const auto camera = loadCamera();
+  const pose_core::Reprojection reprojection(camera, LED_PROJECTION_COEFS, VIEW_ANGLE_MARGIN);
+  const auto markers = loadMarkers();
+  const auto groups = pose_core::groupMarkers(markers, LED_GROUP_DISTANCE);
+  const double max_diameter = pose_core::visibleDiameters(markers, groups).first;
+  std::mt19937 generator(1);
+
+  for (int t = 0; t < TEST_POSE_COUNT; t++){
+    pose_core::Pose truth;
+    auto observation = randomObservation(reprojection, markers, generator, truth);
+    auto initial = pose_core::initialHypotheses(reprojection, observation, groups, max_diameter);
+    ASSERT_FALSE(initial.empty()) << "for pose " << t;
+    for (auto &h : initial){
+      EXPECT_EQ(h.flag, pose_core::neutral);
+      EXPECT_EQ(h.index, observation.target);
+    }
+
+    pose_core::AssociatedHypotheses hypotheses(initial, observation.target);
+    auto fitness = pose_core::checkHypothesisFitness(hypotheses, reprojection, observation, 0);
+    hypotheses.removeUnfit();
+    EXPECT_GT(fitness.verified, 0) << "for pose " << t;
+    EXPECT_EQ(hypotheses.verified_count, (int)(hypotheses.getVerified().size()));
+    EXPECT_TRUE(pose_core::isTargetTracked(hypotheses, camera, 0, (int)(observation.points.size()), observation.time, 1.0));
+
+    auto fused = pose_core::fuseHypotheses(hypotheses);
+    ASSERT_TRUE(fused.has_value()) << "for pose " << t;
+    EXPECT_LT((fused->first.position - truth.position).norm(), MAX_FUSED_POSITION_ERROR) << "for pose " << t;
+  }
+}
+
+TEST(Hypotheses, WrongHypothesesAreRemoved){
+  const auto camera = loadCamera();
+  const pose_core::Reprojection reprojection(camera, LED_PROJECTION_COEFS, VIEW_ANGLE_MARGIN);
+  const auto markers = loadMarkers();
+  std::mt19937 generator(2);
+
+  pose_core::Pose truth;
+  auto observation = randomObservation(reprojection, markers, generator, truth);
+  pose_core::Hypothesis correct, wrong;
+  correct.pose = truth;
+  wrong.pose = truth;
+  wrong.pose.position.x() += 1.0;
+  pose_core::AssociatedHypotheses hypotheses({correct, wrong}, observation.target);
+
+  auto fitness = pose_core::checkHypothesisFitness(hypotheses, reprojection, observation, 0);
+  EXPECT_EQ(fitness.evaluations, 2);
+  EXPECT_EQ(fitness.verified, 1);
+  EXPECT_EQ(fitness.unfit, 1);
+  hypotheses.removeUnfit();
+  ASSERT_EQ(hypotheses.hypotheses.size(), 1u);
+  EXPECT_EQ(hypotheses.hypotheses.front().unique_id, correct.unique_id);
+  EXPECT_EQ(hypotheses.verified_count, 1);
+
+  // the single verified hypothesis is not refreshed by further observations, so it ages out
+  pose_core::removeOldHypotheses(hypotheses, observation.time + 10.0);
+  EXPECT_TRUE(hypotheses.hypotheses.empty());
+  EXPECT_EQ(hypotheses.verified_count, 0);
+  EXPECT_FALSE(pose_core::fuseHypotheses(hypotheses).has_value());
+}
+//}
+
+/* resampling //{ */
+/**
+ * @brief The 0.999 quantile of the chi-square distribution, by the Wilson-Hilferty approximation
+ */
+static double chiSquareQuantile(int degrees_of_freedom){
+  const double k = degrees_of_freedom;
+  return k*std::pow(1.0 - 2.0/(9.0*k) + CHI_SQUARE_QUANTILE_Z*std::sqrt(2.0/(9.0*k)), 3);
+}
+
+TEST(Hypotheses, SystematicResamplingIsProportionalToWeights){
+  std::mt19937 generator(3);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  std::vector<double> weights(RESAMPLED_ENTRY_COUNT);
+  for (auto &w : weights){
+    w = std::exp(-5.0*uniform(generator)); // spanning two orders of magnitude, as the weights of the hypotheses
+  }
+  weights[RESAMPLED_ENTRY_COUNT/2] = 0; // as the entries outside of the pool
+  double weight_sum = 0;
+  for (auto w : weights){
+    weight_sum += w;
+  }
+
+  std::vector<long> total(RESAMPLED_ENTRY_COUNT, 0);
+  std::vector<int> copies;
+  for (int t = 0; t < RESAMPLING_TRIAL_COUNT; t++){
+    copies.assign(RESAMPLED_ENTRY_COUNT, 0);
+    pose_core::systematicResampling(weights, RESAMPLING_DRAW_COUNT, uniform(generator), copies);
+    int drawn = 0;
+    for (int i = 0; i < RESAMPLED_ENTRY_COUNT; i++){
+      // each entry is drawn the expected number of times, rounded either way
+      double expected = RESAMPLING_DRAW_COUNT*weights[i]/weight_sum;
+      EXPECT_GE(copies[i], std::floor(expected) - 1e-9) << "for entry " << i;
+      EXPECT_LE(copies[i], std::ceil(expected) + 1e-9) << "for entry " << i;
+      total[i] += copies[i];
+      drawn += copies[i];
+    }
+    ASSERT_EQ(drawn, RESAMPLING_DRAW_COUNT);
+  }
+  EXPECT_EQ(total[RESAMPLED_ENTRY_COUNT/2], 0);
+
+  double chi_square = 0;
+  int degrees_of_freedom = -1;
+  for (int i = 0; i < RESAMPLED_ENTRY_COUNT; i++){
+    if (weights[i] <= 0){
+      continue;
+    }
+    double expected = (double)(RESAMPLING_TRIAL_COUNT)*RESAMPLING_DRAW_COUNT*weights[i]/weight_sum;
+    chi_square += (total[i] - expected)*(total[i] - expected)/expected;
+    degrees_of_freedom++;
+  }
+  EXPECT_LT(chi_square, chiSquareQuantile(degrees_of_freedom));
+}
+
+TEST(Hypotheses, SystematicResamplingOfNothing){
+  std::vector<int> copies(3, 0);
+  pose_core::systematicResampling({0.0, 0.0, 0.0}, 10, 0.5, copies);
+  pose_core::systematicResampling({1.0, 1.0, 1.0}, 0, 0.5, copies);
+  EXPECT_EQ(copies, std::vector<int>(3, 0));
+  pose_core::systematicResampling({0.0, 1.0, 0.0}, 4, 0.999999, copies);
+  EXPECT_EQ(copies, std::vector<int>({0, 4, 0}));
+}
+
+TEST(Hypotheses, ResamplingKeepsVerifiedHypothesesFirst){
+  std::vector<pose_core::Hypothesis> initial(50);
+  for (int i = 0; i < (int)(initial.size()); i++){
+    initial[i].fitness_error = 0.02*i;
+  }
+  pose_core::AssociatedHypotheses hypotheses(initial, 0);
+  int k = 0;
+  for (auto it = hypotheses.hypotheses.begin(); it != hypotheses.hypotheses.end(); it++, k++){
+    if (k < 10){
+      hypotheses.setVerified(it);
+    }
+  }
+  ASSERT_EQ(hypotheses.verified_count, 10);
+
+  // fewer verified hypotheses than the count - all of them are kept, the rest is drawn from the others
+  pose_core::resampleHypotheses(hypotheses, 30);
+  EXPECT_EQ(hypotheses.hypotheses.size(), 30u);
+  EXPECT_EQ(hypotheses.verified_count, 10);
+  EXPECT_EQ((int)(hypotheses.getVerified().size()), hypotheses.verified_count);
+
+  // more verified hypotheses than the count - only those are drawn from
+  pose_core::resampleHypotheses(hypotheses, 5);
+  EXPECT_EQ(hypotheses.hypotheses.size(), 5u);
+  EXPECT_EQ(hypotheses.verified_count, 5);
+
+  // drawing more than there are multiplies them, each copy under its own identifier
+  for (auto it = hypotheses.hypotheses.begin(); it != hypotheses.hypotheses.end(); it++){
+    hypotheses.setNeutral(it);
+  }
+  pose_core::resampleHypotheses(hypotheses, 12);
+  EXPECT_EQ(hypotheses.hypotheses.size(), 12u);
+  EXPECT_EQ(hypotheses.verified_count, 0);
+  std::set<int> unique_ids;
+  for (auto &h : hypotheses.hypotheses){
+    unique_ids.insert(h.unique_id);
+  }
+  EXPECT_EQ(unique_ids.size(), hypotheses.hypotheses.size());
+}
+//}
+
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
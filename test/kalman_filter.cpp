@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <cmath>
+#include <cstdlib>
+#include <mrs_lib/lkf.h>
+#include <spatial_index/spatial_index.h>
+
+using namespace uvdar;
+
+#define KALMAN_STATES 6 // as in the filter
+#define KALMAN_STATES_VELOCITY 9
+#define KALMAN_INPUTS 0
+#define KALMAN_MEASUREMENTS 6
+#define TARGET_COUNT 30
+#define SPIN_COUNT 100
+#define MATCH_LEVEL_THRESHOLD_ASSOCIATE 0.3
+#define MATCH_LEVEL_THRESHOLD_REMOVE 0.5
+
+/* allocation counting //{ */
+// every heap allocation of the process, including those of Eigen and of the linked libraries, goes through malloc - it is interposed here to count them (glibc)
+static long allocation_count = 0;
+
+extern "C" void *__libc_malloc(size_t size);
+
+extern "C" void *malloc(size_t size){
+  allocation_count++;
+  return __libc_malloc(size);
+}
+//}
+
+/**
+ * @brief The per-spin arithmetic of the filter with the filter types of the given state length: prediction of every state, the overlap checks between the states, and the association and correction of one measurement per state
+ */
+template <int n_states>
+class SpinHarness {
+  public:
+    using lkf_t = mrs_lib::LKF<n_states, KALMAN_INPUTS, KALMAN_MEASUREMENTS>;
+    using statecov_t = typename lkf_t::statecov_t;
+    using z_t = e::Matrix<double, KALMAN_MEASUREMENTS, 1>;
+    using R_t = e::Matrix<double, KALMAN_MEASUREMENTS, KALMAN_MEASUREMENTS>;
+
+    SpinHarness() : filter_(lkf_t::A_t::Identity(), typename lkf_t::B_t(), lkf_t::H_t::Identity()) {
+      std::mt19937 generator(0);
+      std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+      for (int i = 0; i < TARGET_COUNT; i++){
+        statecov_t state;
+        state.x.setZero();
+        state.x.template head<3>() = e::Vector3d(20.0*uniform(generator), 20.0*uniform(generator), 5.0*uniform(generator));
+        state.P = 0.1*lkf_t::P_t::Identity();
+        states_.push_back(state);
+        measurements_.push_back({state.x.template head<KALMAN_MEASUREMENTS>() + 0.05*z_t::Random(), 0.2*R_t::Identity()});
+      }
+      Q_ = 0.01*lkf_t::Q_t::Identity();
+    }
+
+    /**
+     * @brief Performs one spin
+     *
+     * @return The count of overlapping pairs and corrected states, so that the work is not optimized out
+     */
+    int spin(){
+      for (auto &state : states_){
+        state = filter_.predict(state, typename lkf_t::u_t(), Q_, 0.05);
+      }
+
+      int overlapping = 0;
+      for (int i = 0; i < TARGET_COUNT; i++){
+        for (int j = i+1; j < TARGET_COUNT; j++){
+          if (spatial_index::gaussJointMaxVal(states_[i].P.template topLeftCorner<3,3>(), states_[j].P.template topLeftCorner<3,3>(), states_[i].x.template head<3>(), states_[j].x.template head<3>()) > MATCH_LEVEL_THRESHOLD_REMOVE){
+            overlapping++;
+          }
+        }
+      }
+
+      const double gate = -2.0*std::log(MATCH_LEVEL_THRESHOLD_ASSOCIATE);
+      int corrected = 0;
+      for (int i = 0; i < TARGET_COUNT; i++){
+        auto &[z, R] = measurements_[i];
+        if (spatial_index::mahalanobisSquared(R.template topLeftCorner<3,3>(), states_[i].P.template topLeftCorner<3,3>(), z.template head<3>(), states_[i].x.template head<3>()) < gate){
+          states_[i] = filter_.correct(states_[i], z, R);
+          corrected++;
+        }
+      }
+      return corrected + overlapping;
+    }
+
+  private:
+    lkf_t filter_;
+    typename lkf_t::Q_t Q_;
+    std::vector<statecov_t, e::aligned_allocator<statecov_t>> states_;
+    std::vector<std::pair<z_t, R_t>, e::aligned_allocator<std::pair<z_t, R_t>>> measurements_;
+};
+
+/**
+ * @brief Retrieves the count of heap allocations per spin in the steady state
+ */
+template <int n_states>
+static double allocationsPerSpin(){
+  SpinHarness<n_states> harness;
+  harness.spin(); // any lazy initialization is not part of the steady state
+  long start_count = allocation_count;
+  int result = 0;
+  for (int s = 0; s < SPIN_COUNT; s++){
+    result += harness.spin();
+  }
+  long count = allocation_count - start_count;
+  EXPECT_GT(result, 0);
+  return (double)(count)/SPIN_COUNT;
+}
+
+TEST(KalmanFilter, SpinDoesNotAllocate){
+  EXPECT_EQ(allocationsPerSpin<KALMAN_STATES>(), 0.0);
+}
+
+TEST(KalmanFilter, SpinWithVelocityDoesNotAllocate){
+  EXPECT_EQ(allocationsPerSpin<KALMAN_STATES_VELOCITY>(), 0.0);
+}
+
+TEST(KalmanFilter, HarnessCountsDynamicAllocations){
+  long start_count = allocation_count;
+  e::MatrixXd dynamic = e::MatrixXd::Identity(KALMAN_STATES, KALMAN_STATES);
+  EXPECT_EQ(allocation_count - start_count, 1);
+  EXPECT_EQ(dynamic.trace(), KALMAN_STATES);
+}
+
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
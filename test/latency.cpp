@@ -0,0 +1,154 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <map>
+#include <trace/latency.h>
+
+using namespace uvdar;
+
+#define LATENCY_HISTOGRAM_BIN_WIDTH 0.002 //seconds, as in filter.cpp
+#define LATENCY_HISTOGRAM_BINS 100
+#define STAGE_DURATIONS {{uvdar_core::LatencyStamp::DETECTOR, 0.004}, {uvdar_core::LatencyStamp::BLINK_PROCESSOR, 0.008}, {uvdar_core::LatencyStamp::POSE_CALCULATOR, 0.012}, {uvdar_core::LatencyStamp::FILTER, 0.016}} //s, slept before completing each stage
+#define MESSAGE_COUNT 10
+#define OVERSLEEP_TOLERANCE 0.010 //s
+
+/* helpers //{ */
+static uvdar_core::LatencyTrailer trailer(uint32_t sec, size_t stage_count = 1){
+  uvdar_core::LatencyTrailer output;
+  output.stamp = ros::Time(sec, 0);
+  for (size_t i = 0; i < stage_count; i++){
+    uvdar_core::LatencyStamp stamp;
+    stamp.stage = (uint8_t)(i);
+    stamp.time = (int64_t)(i)*1000;
+    output.stages.push_back(stamp);
+  }
+  return output;
+}
+
+static std::map<uint8_t, uvdar_core::LatencyHistogram> byStage(const uvdar_core::LatencyHistograms &histograms){
+  std::map<uint8_t, uvdar_core::LatencyHistogram> output;
+  for (auto &histogram : histograms.stages){
+    output[histogram.stage] = histogram;
+  }
+  return output;
+}
+//}
+
+/* LatencyCollector //{ */
+TEST(LatencyCollector, HistogramsMatchTheStagesOfThePipeline){
+  const std::vector<std::pair<uint8_t, double>> durations = STAGE_DURATIONS;
+  trace::LatencyCollector collector(uvdar_core::LatencyStamp::FILTER, LATENCY_HISTOGRAM_BIN_WIDTH, LATENCY_HISTOGRAM_BINS);
+  double wall_sum = 0;
+  for (uint32_t m = 1; m <= MESSAGE_COUNT; m++){
+    int64_t wall_start = trace::now();
+    uvdar_core::LatencyTrailer msg;
+    msg.stamp = ros::Time(m, 0);
+    trace::startLatency(msg.stages, uvdar_core::LatencyStamp::DETECTOR_INPUT, trace::now());
+    for (auto &[stage, duration] : durations){
+      std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+      if (stage == uvdar_core::LatencyStamp::FILTER){
+        break;
+      }
+      EXPECT_TRUE(trace::stampLatency(msg.stages, stage));
+    }
+    // the trailer arrives through its own subscription, either before or after its message is applied
+    if (m%2 == 1){
+      collector.add(msg);
+      collector.applied(msg.stamp);
+    }
+    else {
+      collector.applied(msg.stamp);
+      collector.add(msg);
+    }
+    wall_sum += (double)(trace::now() - wall_start)/1e9;
+  }
+
+  auto histograms = byStage(collector.histograms());
+  ASSERT_EQ(histograms.size(), durations.size() + 1);
+  double stage_sum = 0;
+  for (auto &[stage, duration] : durations){
+    ASSERT_EQ(histograms.count(stage), 1u) << "stage " << (int)(stage);
+    auto &histogram = histograms[stage];
+    EXPECT_EQ(histogram.count, (uint32_t)(MESSAGE_COUNT));
+    EXPECT_GE(histogram.mean, duration);
+    EXPECT_LT(histogram.mean, duration + OVERSLEEP_TOLERANCE);
+    EXPECT_GE(histogram.max, histogram.mean);
+    EXPECT_DOUBLE_EQ(histogram.bin_width, LATENCY_HISTOGRAM_BIN_WIDTH);
+    ASSERT_EQ(histogram.bins.size(), (size_t)(LATENCY_HISTOGRAM_BINS));
+    uint32_t binned = 0;
+    for (auto b : histogram.bins){
+      binned += b;
+    }
+    EXPECT_EQ(binned, histogram.count);
+    stage_sum += histogram.mean;
+  }
+
+  ASSERT_EQ(histograms.count(uvdar_core::LatencyHistogram::TOTAL), 1u);
+  auto &total = histograms[uvdar_core::LatencyHistogram::TOTAL];
+  EXPECT_EQ(total.count, (uint32_t)(MESSAGE_COUNT));
+  EXPECT_NEAR(total.mean, stage_sum, 1e-9);
+  // the wall time also covers taking the first stamp and matching the trailer
+  EXPECT_LE(total.mean, wall_sum/MESSAGE_COUNT);
+  EXPECT_GT(total.mean, wall_sum/MESSAGE_COUNT - 0.001);
+  EXPECT_EQ(collector.unmatched(), 0u);
+}
+
+TEST(LatencyCollector, IgnoresUnstampedTrailers){
+  trace::LatencyCollector collector(uvdar_core::LatencyStamp::FILTER, LATENCY_HISTOGRAM_BIN_WIDTH, LATENCY_HISTOGRAM_BINS);
+  collector.add(trailer(1, 0));
+  collector.applied(ros::Time(1, 0));
+  EXPECT_TRUE(collector.histograms().stages.empty());
+  EXPECT_EQ(collector.unmatched(), 0u);
+}
+
+TEST(LatencyCollector, CountsTrailersWithoutTheirMessage){
+  trace::LatencyCollector collector(uvdar_core::LatencyStamp::FILTER, LATENCY_HISTOGRAM_BIN_WIDTH, LATENCY_HISTOGRAM_BINS);
+  for (uint32_t m = 1; m <= LATENCY_MATCH_BUFFER + 3; m++){
+    collector.add(trailer(m));
+  }
+  EXPECT_EQ(collector.unmatched(), 3u);
+  EXPECT_EQ(collector.unmatched(), 0u);
+
+  // the messages of the trailers still kept are matched
+  collector.applied(ros::Time(LATENCY_MATCH_BUFFER + 3, 0));
+  auto histograms = byStage(collector.histograms());
+  EXPECT_EQ(histograms[uvdar_core::LatencyHistogram::TOTAL].count, 1u);
+
+  // messages without a trailer are not counted
+  for (uint32_t m = 1000; m < 1000 + 2*LATENCY_MATCH_BUFFER; m++){
+    collector.applied(ros::Time(m, 0));
+  }
+  EXPECT_EQ(collector.unmatched(), 0u);
+}
+//}
+
+/* LatencyMatcher //{ */
+TEST(LatencyMatcher, CountsSkippedTrailers){
+  trace::LatencyMatcher matcher;
+  matcher.add(trailer(1, 1));
+  matcher.add(trailer(2, 2));
+  matcher.add(trailer(3, 3));
+  EXPECT_EQ(matcher.take(ros::Time(2, 0)).size(), 2u);
+  EXPECT_EQ(matcher.unmatched(), 1u);
+  EXPECT_EQ(matcher.unmatched(), 0u);
+  EXPECT_TRUE(matcher.take(ros::Time(2, 0)).empty());
+  EXPECT_EQ(matcher.take(ros::Time(3, 0)).size(), 3u);
+  EXPECT_EQ(matcher.unmatched(), 0u);
+}
+
+TEST(LatencyMatcher, CountsOverflowingTrailers){
+  trace::LatencyMatcher matcher;
+  for (uint32_t m = 1; m <= LATENCY_TRAILER_BUFFER + 2; m++){
+    matcher.add(trailer(m));
+  }
+  EXPECT_EQ(matcher.unmatched(), 2u);
+  EXPECT_EQ(matcher.take(ros::Time(LATENCY_TRAILER_BUFFER + 2, 0)).size(), 1u);
+  EXPECT_EQ(matcher.unmatched(), (unsigned long)(LATENCY_TRAILER_BUFFER - 1));
+}
+//}
+
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <chrono>
+#include <lazy_publisher/lazy_publisher.h>
+
+using namespace uvdar;
+
+#define MIN_PERIOD 0.2 //s
+#define TIMING_MARGIN 0.02 //s
+
+/**
+ * @brief Stands in for a publisher with the given number of subscribers
+ */
+struct MockPublisher {
+  uint32_t subscribers = 0;
+
+  explicit operator bool() const {
+    return true;
+  }
+
+  uint32_t getNumSubscribers() const {
+    return subscribers;
+  }
+
+  void publish(int){
+  }
+};
+
+static void sleepFor(double duration){
+  std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+}
+
+/* Throttle //{ */
+TEST(Throttle, NothingIsDueWithoutSubscribers){
+  lazy_publisher::Throttle unthrottled;
+  lazy_publisher::Throttle throttled(MIN_PERIOD);
+  for (int k = 0; k < 10; k++){
+    EXPECT_FALSE(unthrottled.claim(0));
+    EXPECT_FALSE(throttled.claim(0));
+  }
+}
+
+TEST(Throttle, EveryClaimIsDueWithoutMinimumPeriod){
+  for (double min_period : {0.0, -1.0}){
+    lazy_publisher::Throttle throttle(min_period);
+    for (int k = 0; k < 10; k++){
+      EXPECT_TRUE(throttle.claim(1));
+    }
+  }
+}
+
+TEST(Throttle, KeepsTheMinimumPeriod){
+  lazy_publisher::Throttle throttle(MIN_PERIOD);
+  EXPECT_TRUE(throttle.claim(1));
+  EXPECT_FALSE(throttle.claim(1));
+  EXPECT_FALSE(throttle.claim(3));
+  sleepFor(MIN_PERIOD/2);
+  EXPECT_FALSE(throttle.claim(1));
+  sleepFor(MIN_PERIOD/2 + TIMING_MARGIN);
+  EXPECT_TRUE(throttle.claim(1));
+  EXPECT_FALSE(throttle.claim(1));
+}
+
+TEST(Throttle, ClaimsWithoutSubscribersDoNotStartThePeriod){
+  lazy_publisher::Throttle throttle(MIN_PERIOD);
+  EXPECT_FALSE(throttle.claim(0));
+  EXPECT_TRUE(throttle.claim(1));
+
+  // the period started by the last publication still holds after the subscribers leave and come back
+  EXPECT_FALSE(throttle.claim(0));
+  EXPECT_FALSE(throttle.claim(1));
+  sleepFor(MIN_PERIOD + TIMING_MARGIN);
+  EXPECT_FALSE(throttle.claim(0));
+  EXPECT_TRUE(throttle.claim(1));
+}
+//}
+
+/* Publisher //{ */
+TEST(Publisher, BuildsOnlyWantedMessages){
+  MockPublisher mock;
+  lazy_publisher::Publisher<MockPublisher> publisher(mock, MIN_PERIOD);
+  int built = 0;
+  auto build = [&built]{
+    built++;
+    return 0;
+  };
+  EXPECT_FALSE(publisher.publishLazy(build));
+  EXPECT_EQ(built, 0);
+
+  mock.subscribers = 1;
+  lazy_publisher::Publisher<MockPublisher> subscribed(mock, MIN_PERIOD);
+  EXPECT_TRUE(subscribed.publishLazy(build));
+  EXPECT_FALSE(subscribed.publishLazy(build));
+  EXPECT_EQ(built, 1);
+}
+//}
+
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <packed_points/packed_points.h>
+
+using namespace uvdar;
+
+/* helpers //{ */
+static uvdar_core::Point2DWithFloat point(double x, double y, double value){
+  uvdar_core::Point2DWithFloat output;
+  output.x = x;
+  output.y = y;
+  output.value = value;
+  return output;
+}
+//}
+
+/* round trip //{ */
+TEST(PackedPoints, RoundTripKeepsIntegerPoints){
+  std::mt19937 generator(0);
+  uvdar_core::ImagePointsWithFloatStamped msg;
+  msg.stamp = ros::Time(1234, 5678);
+  msg.image_width = 752;
+  msg.image_height = 480;
+  for (int i = 0; i < 300; i++){
+    msg.points.push_back(point(generator()%752, generator()%480, (int)(generator()%20)-2)); // -2 marks points with an unknown signal
+  }
+
+  auto packed = packed_points::pack(msg);
+  ASSERT_EQ(packed->x.size(), msg.points.size());
+  ASSERT_EQ(packed->y.size(), msg.points.size());
+  ASSERT_EQ(packed->value.size(), msg.points.size());
+
+  auto unpacked = packed_points::unpack(*packed);
+  EXPECT_EQ(unpacked->stamp, msg.stamp);
+  EXPECT_EQ(unpacked->image_width, msg.image_width);
+  EXPECT_EQ(unpacked->image_height, msg.image_height);
+  ASSERT_EQ(unpacked->points.size(), msg.points.size());
+  for (size_t i = 0; i < msg.points.size(); i++){
+    EXPECT_EQ(unpacked->points[i].x, msg.points[i].x);
+    EXPECT_EQ(unpacked->points[i].y, msg.points[i].y);
+    EXPECT_EQ(unpacked->points[i].value, msg.points[i].value);
+  }
+}
+
+TEST(PackedPoints, EmptyMessage){
+  uvdar_core::ImagePointsWithFloatStamped msg;
+  auto unpacked = packed_points::unpack(*packed_points::pack(msg));
+  EXPECT_TRUE(unpacked->points.empty());
+}
+
+TEST(PackedPoints, UnpackIgnoresUnpairedEntries){
+  uvdar_core::ImagePointsPackedStamped msg;
+  msg.x = {1, 2, 3};
+  msg.y = {4, 5};
+  msg.value = {6, 7, 8};
+  auto unpacked = packed_points::unpack(msg);
+  ASSERT_EQ(unpacked->points.size(), 2u);
+  EXPECT_EQ(unpacked->points[1].x, 2);
+  EXPECT_EQ(unpacked->points[1].y, 5);
+  EXPECT_EQ(unpacked->points[1].value, 7);
+}
+//}
+
+/* rounding and saturation //{ */
+TEST(PackedPoints, RoundsToNearest){
+  EXPECT_EQ(packed_points::toInt16(10.4), 10);
+  EXPECT_EQ(packed_points::toInt16(10.5), 11);
+  EXPECT_EQ(packed_points::toInt16(10.6), 11);
+  EXPECT_EQ(packed_points::toInt16(-10.4), -10);
+  EXPECT_EQ(packed_points::toInt16(-10.6), -11);
+  EXPECT_EQ(packed_points::toInt16(-0.2), 0);
+}
+
+TEST(PackedPoints, SaturatesOutOfRange){
+  EXPECT_EQ(packed_points::toInt16(32767.0), 32767);
+  EXPECT_EQ(packed_points::toInt16(32767.4), 32767); // no overflow from rounding at the bound
+  EXPECT_EQ(packed_points::toInt16(40000.0), 32767);
+  EXPECT_EQ(packed_points::toInt16(1e9), 32767);
+  EXPECT_EQ(packed_points::toInt16(-32768.0), -32768);
+  EXPECT_EQ(packed_points::toInt16(-40000.0), -32768);
+  EXPECT_EQ(packed_points::toInt16(-1e9), -32768);
+}
+
+TEST(PackedPoints, PackRoundsAndSaturatesEachField){
+  uvdar_core::ImagePointsWithFloatStamped msg;
+  msg.points.push_back(point(10.6, -3.4, 4.5));
+  msg.points.push_back(point(-40000, 1e9, -2));
+  auto packed = packed_points::pack(msg);
+  EXPECT_EQ(packed->x[0], 11);
+  EXPECT_EQ(packed->y[0], -3);
+  EXPECT_EQ(packed->value[0], 5);
+  EXPECT_EQ(packed->x[1], -32768);
+  EXPECT_EQ(packed->y[1], 32767);
+  EXPECT_EQ(packed->value[1], -2);
+}
+//}
+
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,380 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <pose_core/pose_core.h>
+
+using namespace uvdar;
+
+#define CALIBRATION_FILE TEST_CONFIG_DIR "/ocamcalib/calib_results_bf_uv_fe.txt"
+#define MODEL_FILE TEST_CONFIG_DIR "/models/quadrotor_foursided.txt"
+#define TEST_POINT_COUNT 1000
+#define FINITE_DIFFERENCE_STEP 1e-6
+#define JACOBIAN_TOLERANCE 1e-4 // relative to the norm of the finite-difference Jacobian
+#define TEST_POSE_COUNT 200
+#define LED_PROJECTION_COEFS {1.3398, 31.4704, 0.0154}
+#define VIEW_ANGLE_MARGIN 0.035
+#define ERROR_THRESHOLD sqr(752/150.0) // per observed point, as the final threshold of the pose calculator for this camera
+#define MAX_P3P_CORRESPONDENCES 64
+#define CLOUD_SIZES {8, 50, 200, 500}
+#define CLOUDS_PER_SIZE 10
+#define CLOUD_CYCLES 5 // consecutive fusions of a moving cloud, each warm-started from the previous one
+#define REFERENCE_MVEE_TOLERANCE 1e-9
+#define REFERENCE_MVEE_MAX_ITERATIONS 1000000
+
+#define sqr(X) ((X) * (X))
+
+/* allocation counting //{ */
+static std::atomic<bool> counting_allocations(false);
+static std::atomic<unsigned long> allocation_count(0);
+
+void *operator new(std::size_t size){
+  if (counting_allocations){
+    allocation_count++;
+  }
+  if (void *output = std::malloc(size > 0 ? size : 1)){
+    return output;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+
+template <class F>
+static unsigned long countAllocations(F &&f){
+  allocation_count = 0;
+  counting_allocations = true;
+  f();
+  counting_allocations = false;
+  return allocation_count;
+}
+//}
+
+/* helpers //{ */
+static pose_core::CameraModel loadCamera(){
+  ocam_model model;
+  get_ocam_model(&model, (char*)(CALIBRATION_FILE));
+  return pose_core::CameraModel(model);
+}
+
+static e::Matrix<double,2,3> finiteDifferenceJacobian(const pose_core::CameraModel &camera, const e::Vector3d &point){
+  e::Matrix<double,2,3> output;
+  for (int i = 0; i < 3; i++){
+    e::Vector3d delta = e::Vector3d::Zero();
+    delta(i) = FINITE_DIFFERENCE_STEP;
+    output.col(i) = (camera.project(point+delta) - camera.project(point-delta))/(2*FINITE_DIFFERENCE_STEP);
+  }
+  return output;
+}
+
+static std::vector<pose_core::Marker> loadMarkers(){
+  auto markers = pose_core::loadModel(MODEL_FILE);
+  EXPECT_TRUE(markers.has_value());
+  return markers.value_or(std::vector<pose_core::Marker>());
+}
+
+/**
+ * @brief Generates a pose of the target in front of the camera, turned such that at least three of its LED groups are observed, and the observed points as their projections
+ */
+static pose_core::Pose randomObservedPose(const pose_core::Reprojection &reprojection, const std::vector<pose_core::Marker> &markers, const pose_core::Pose &fromcam, std::mt19937 &generator, std::vector<pose_core::ObservedPoint> &observed){
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  pose_core::Pose tocam;
+  tocam.orientation = fromcam.orientation.inverse();
+  tocam.position = -(tocam.orientation*fromcam.position);
+  while (true){
+    pose_core::Pose local;
+    local.position = e::Vector3d(uniform(generator), 0.5*uniform(generator), 4+uniform(generator));
+    local.orientation =
+      e::AngleAxisd(M_PI/2, e::Vector3d::UnitY())*
+      e::AngleAxisd(0.4+0.2*uniform(generator), e::Vector3d::UnitY())* // seen from above, otherwise the LEDs project onto a line
+      e::AngleAxisd(M_PI/4+0.5*uniform(generator), e::Vector3d::UnitZ());
+    auto output = pose_core::compose(fromcam, local);
+    reprojection.hypothesisError(markers, output, tocam, {}, std::numeric_limits<double>::max(), false, &observed);
+    if (observed.size() >= 3){
+      return output;
+    }
+  }
+}
+
+static pose_core::Pose perturbed(const pose_core::Pose &pose, double position_step, double angle_step, std::mt19937 &generator){
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  pose_core::Pose output;
+  output.position = pose.position + position_step*e::Vector3d(uniform(generator), uniform(generator), uniform(generator));
+  output.orientation = e::AngleAxisd(angle_step*uniform(generator), e::Vector3d::Random().normalized())*pose.orientation;
+  return output;
+}
+//}
+
+/* CameraModel //{ */
+TEST(CameraModel, ProjectionJacobianMatchesFiniteDifferences){
+  const auto camera = loadCamera();
+  std::mt19937 generator(1);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+  int tested = 0;
+  while (tested < TEST_POINT_COUNT){
+    e::Vector3d point(5*uniform(generator), 5*uniform(generator), 6+5*uniform(generator));
+    if (acos(point.normalized().z()) > camera.maxViewAngle()){
+      continue;
+    }
+    if (point.head<2>().norm() < 1e-3){ // the projection is singular on the optical axis
+      continue;
+    }
+
+    const auto analytic = camera.projectionJacobian(point);
+    const auto numeric = finiteDifferenceJacobian(camera, point);
+    EXPECT_LT((analytic-numeric).norm(), JACOBIAN_TOLERANCE*numeric.norm()) << "at point " << point.transpose();
+    tested++;
+  }
+}
+
+TEST(CameraModel, DirectionInvertsProjection){
+  const auto camera = loadCamera();
+  std::mt19937 generator(2);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+  for (int k = 0; k < TEST_POINT_COUNT; k++){
+    e::Vector3d point(5*uniform(generator), 5*uniform(generator), 6+5*uniform(generator));
+    if (acos(point.normalized().z()) > camera.maxViewAngle()){
+      continue;
+    }
+    EXPECT_NEAR(camera.direction(camera.project(point)).dot(point.normalized()), 1.0, 1e-6);
+  }
+}
+//}
+
+/* Reprojection //{ */
+TEST(Reprojection, TruePoseHasNoError){
+  const pose_core::Reprojection reprojection(loadCamera(), LED_PROJECTION_COEFS, VIEW_ANGLE_MARGIN);
+  const auto markers = loadMarkers();
+  std::mt19937 generator(3);
+
+  for (int k = 0; k < TEST_POSE_COUNT; k++){
+    std::vector<pose_core::ObservedPoint> observed;
+    auto pose = randomObservedPose(reprojection, markers, pose_core::Pose(), generator, observed);
+    EXPECT_NEAR(reprojection.hypothesisError(markers, pose, pose_core::Pose(), observed), 0.0, 1e-9);
+  }
+}
+
+TEST(Reprojection, ErrorBoundKeepsTheDecision){
+  const pose_core::Reprojection reprojection(loadCamera(), LED_PROJECTION_COEFS, VIEW_ANGLE_MARGIN);
+  const auto markers = loadMarkers();
+  std::mt19937 generator(4);
+
+  for (int k = 0; k < TEST_POSE_COUNT; k++){
+    std::vector<pose_core::ObservedPoint> observed;
+    auto pose = randomObservedPose(reprojection, markers, pose_core::Pose(), generator, observed);
+    double threshold = observed.size()*ERROR_THRESHOLD;
+
+    auto hypothesis = perturbed(pose, 0.3, 0.5, generator);
+    double error_full = reprojection.hypothesisError(markers, hypothesis, pose_core::Pose(), observed);
+    double error_bounded = reprojection.hypothesisError(markers, hypothesis, pose_core::Pose(), observed, threshold);
+    EXPECT_EQ(error_full < threshold, error_bounded < threshold);
+    if (error_full < threshold){
+      EXPECT_DOUBLE_EQ(error_full, error_bounded);
+    }
+  }
+}
+
+TEST(Reprojection, P3PRecoversTruePose){
+  const pose_core::Reprojection reprojection(loadCamera(), LED_PROJECTION_COEFS, VIEW_ANGLE_MARGIN);
+  const auto markers = loadMarkers();
+  const auto groups = pose_core::groupMarkers(markers, 0.03);
+  std::mt19937 generator(5);
+
+  // the camera is placed away from the origin of the output frame, to exercise the transformations
+  pose_core::Pose fromcam;
+  fromcam.position = e::Vector3d(1, 2, 3);
+  fromcam.orientation = e::AngleAxisd(0.7, e::Vector3d(1,1,0).normalized());
+  pose_core::Pose tocam;
+  tocam.orientation = fromcam.orientation.inverse();
+  tocam.position = -(tocam.orientation*fromcam.position);
+
+  int recovered = 0;
+  for (int k = 0; k < TEST_POSE_COUNT; k++){
+    std::vector<pose_core::ObservedPoint> observed;
+    auto pose = randomObservedPose(reprojection, markers, fromcam, generator, observed);
+    double threshold = observed.size()*ERROR_THRESHOLD;
+
+    auto poses = reprojection.p3pPoses(markers, groups, observed, fromcam, tocam, threshold, MAX_P3P_CORRESPONDENCES);
+    double closest = std::numeric_limits<double>::max();
+    for (auto &[p3p_pose, error] : poses){
+      EXPECT_LT(error, threshold);
+      closest = std::min(closest, (p3p_pose.position - pose.position).norm());
+    }
+    if (closest < 0.25){ // the observations are rounded to whole pixels, which is significant for a target this small
+      recovered++;
+    }
+  }
+  EXPECT_GT(recovered, 0.95*TEST_POSE_COUNT); // occasionally, an LED seen at a grazing angle is expected to disappear from a pose close to the true one
+}
+
+TEST(Reprojection, RefineConvergesFromPerturbedPose){
+  const pose_core::Reprojection reprojection(loadCamera(), LED_PROJECTION_COEFS, VIEW_ANGLE_MARGIN);
+  const auto markers = loadMarkers();
+  std::mt19937 generator(6);
+
+  int converged = 0;
+  for (int k = 0; k < TEST_POSE_COUNT; k++){
+    std::vector<pose_core::ObservedPoint> observed;
+    auto pose = randomObservedPose(reprojection, markers, pose_core::Pose(), generator, observed);
+    double threshold = observed.size()*ERROR_THRESHOLD;
+
+    auto initial = perturbed(pose, 0.05, 0.05, generator);
+    auto refined = reprojection.refine(markers, initial, pose_core::Pose(), observed, threshold);
+    if (refined){ // the observations are whole pixels, so the refined pose is not expected to approach the true one more closely than the initial one in depth - only to fit better
+      converged++;
+      double error_refined = reprojection.hypothesisError(markers, refined.value(), pose_core::Pose(), observed);
+      EXPECT_LT(error_refined, threshold);
+      EXPECT_LE(error_refined, reprojection.hypothesisError(markers, initial, pose_core::Pose(), observed));
+    }
+  }
+  EXPECT_GT(converged, 0.9*TEST_POSE_COUNT);
+}
+//}
+
+/* enclosingEllipsoid //{ */
+/**
+ * @brief Retrieves the volume of the minimum volume ellipsoid enclosing a set of points, up to a constant factor, by the Khachiyan algorithm with away steps started from uniform weights and iterated to a tight tolerance without a deadline
+ */
+static double referenceEllipsoidVolume(const std::vector<e::Vector3d> &points){
+  const int N = (int)(points.size());
+  const double n = 4.0;
+  std::vector<e::Vector4d> Q(N);
+  for (int i = 0; i < N; i++){
+    Q[i] << points[i], 1.0;
+  }
+  e::VectorXd u = e::VectorXd::Constant(N, 1.0/N);
+  e::Matrix4d X = e::Matrix4d::Zero();
+  for (int i = 0; i < N; i++){
+    X += u(i)*Q[i]*Q[i].transpose();
+  }
+  double eps_plus = 0;
+  for (int k = 0; k < REFERENCE_MVEE_MAX_ITERATIONS; k++){
+    e::Matrix4d X_inv = X.inverse();
+    int jp = 0, jm = 0;
+    double maximum = 0, minimum = std::numeric_limits<double>::max();
+    for (int i = 0; i < N; i++){
+      double m = Q[i].dot(X_inv*Q[i]);
+      if (m > maximum){
+        maximum = m;
+        jp = i;
+      }
+      if ((u(i) > 0) && (m < minimum)){
+        minimum = m;
+        jm = i;
+      }
+    }
+    eps_plus = maximum/n - 1.0;
+    double eps_minus = 1.0 - minimum/n;
+    if (std::max(eps_plus, eps_minus) < REFERENCE_MVEE_TOLERANCE){
+      break;
+    }
+    if (eps_plus >= eps_minus){
+      double step = (maximum - n)/(n*(maximum - 1.0));
+      u *= (1.0 - step);
+      u(jp) += step;
+      X = (1.0 - step)*X + step*Q[jp]*Q[jp].transpose();
+    }
+    else {
+      double step = std::min((n - minimum)/(n*(minimum - 1.0)), u(jm)/(1.0 - u(jm)));
+      u *= (1.0 + step);
+      u(jm) -= step;
+      X = (1.0 + step)*X - step*Q[jm]*Q[jm].transpose();
+    }
+  }
+  e::Vector3d c = e::Vector3d::Zero();
+  e::Matrix3d S = e::Matrix3d::Zero();
+  for (int i = 0; i < N; i++){
+    c += u(i)*points[i];
+    S += u(i)*points[i]*points[i].transpose();
+  }
+  e::Matrix3d C = 3.0*(S - c*c.transpose())*(1.0 + std::max(eps_plus, 0.0)*n/3.0);
+  return std::sqrt(C.determinant());
+}
+
+/**
+ * @brief Generates an anisotropic cloud of points, as the positions of the verified hypotheses of a target
+ */
+static std::vector<e::Vector3d> randomCloud(int size, std::mt19937 &generator){
+  std::normal_distribution<double> normal(0.0, 1.0);
+  e::Vector3d scale(0.5, 0.2, 1.0);
+  e::Matrix3d rotation = e::Quaterniond::UnitRandom().toRotationMatrix();
+  std::vector<e::Vector3d> output(size);
+  for (auto &point : output){
+    point = rotation*scale.cwiseProduct(e::Vector3d(normal(generator), normal(generator), normal(generator)));
+  }
+  return output;
+}
+
+TEST(EnclosingEllipsoid, WarmStartMatchesTightColdSolve){
+  std::mt19937 generator(4);
+  std::normal_distribution<double> normal(0.0, 1.0);
+  for (int size : CLOUD_SIZES){
+    for (int k = 0; k < CLOUDS_PER_SIZE; k++){
+      auto cloud = randomCloud(size, generator);
+      std::vector<double> weights;
+      for (int cycle = 0; cycle < CLOUD_CYCLES; cycle++){
+        pose_core::ellipsoid_statistics statistics;
+        auto [center, shape] = pose_core::enclosingEllipsoid(cloud, &weights, &statistics);
+        const double reference_volume = referenceEllipsoidVolume(cloud);
+        const double volume = std::sqrt(shape.determinant());
+        // scaled to enclose all points, so never below the optimum, and above it at most by the bound given by the reached tolerance - the deadline may stop the iteration before the configured one in slow builds
+        EXPECT_GE(volume, reference_volume*(1.0 - 1e-6)) << "for " << size << " points, cycle " << cycle;
+        EXPECT_LE(volume, reference_volume*std::pow(1.0 + std::max(statistics.eps, 0.0)*4.0/3.0, 1.5)*(1.0 + 1e-6)) << "for " << size << " points, cycle " << cycle;
+        const e::Matrix3d shape_inv = shape.inverse();
+        for (auto &point : cloud){
+          EXPECT_LE((point - center).dot(shape_inv*(point - center)), 1.0 + 1e-6);
+        }
+
+        // the cloud moves on between the fusions, and changes shape a bit
+        e::Vector3d shift(normal(generator), normal(generator), normal(generator));
+        for (auto &point : cloud){
+          point = 1.02*point + 0.1*shift + 0.02*e::Vector3d(normal(generator), normal(generator), normal(generator));
+        }
+      }
+    }
+  }
+}
+//}
+
+/* fixed-size paths //{ */
+TEST(Allocations, ProjectionDoesNotAllocate){
+  const auto camera = loadCamera();
+  const e::Vector3d point(1.0, -0.5, 4.0);
+  e::Vector2d image_point = e::Vector2d::Zero();
+  e::Matrix<double,2,3> jacobian = e::Matrix<double,2,3>::Zero();
+  auto allocations = countAllocations([&]{
+      for (int k = 0; k < TEST_POINT_COUNT; k++){
+        image_point += camera.project(point);
+        jacobian += camera.projectionJacobian(point);
+      }
+      });
+  EXPECT_EQ(allocations, 0u);
+}
+
+TEST(Allocations, AverageOrientationDoesNotAllocate){
+  std::vector<e::Quaterniond> orientations;
+  for (int k = 0; k < 16; k++){
+    orientations.push_back(e::Quaterniond(e::AngleAxisd(0.01*k, e::Vector3d::UnitZ())));
+  }
+  e::Quaterniond average;
+  auto allocations = countAllocations([&]{
+      average = pose_core::averageOrientation(orientations);
+      });
+  EXPECT_EQ(allocations, 0u);
+  EXPECT_LT(average.angularDistance(orientations[8]), 0.01);
+}
+//}
+
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
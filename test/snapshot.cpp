@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <atomic>
+#include <future>
+#include <vector>
+#include <cstdint>
+#include <snapshot/snapshot.h>
+
+using namespace uvdar;
+
+#define STRESS_SNAPSHOT_COUNT 2000000
+#define SNAPSHOT_POINT_COUNT 16
+#define SNAPSHOT_IMAGE_SIZE 64
+#define BLOCKED_PUBLISH_COUNT 1000
+
+/**
+ * @brief A snapshot of the kind handed to the visualization - every field is derived from the sequence number, so that a torn snapshot is detected
+ */
+struct Snapshot {
+  uint64_t sequence = 0;
+  std::vector<int> points;
+  std::vector<uint8_t> image;
+};
+
+static void fill(Snapshot &snapshot, uint64_t sequence){
+  snapshot.sequence = sequence;
+  snapshot.points.assign(SNAPSHOT_POINT_COUNT, (int)(sequence%100000));
+  snapshot.image.assign(SNAPSHOT_IMAGE_SIZE, (uint8_t)(sequence));
+}
+
+static bool consistent(const Snapshot &snapshot){
+  for (auto point : snapshot.points){
+    if (point != (int)(snapshot.sequence%100000)){
+      return false;
+    }
+  }
+  for (auto pixel : snapshot.image){
+    if (pixel != (uint8_t)(snapshot.sequence)){
+      return false;
+    }
+  }
+  return true;
+}
+
+/* single thread //{ */
+TEST(Snapshot, FetchOnlyNewSnapshots){
+  snapshot::TripleBuffer<Snapshot> buffer;
+  EXPECT_FALSE(buffer.fetch());
+
+  fill(buffer.writeSlot(), 1);
+  buffer.publish();
+  ASSERT_TRUE(buffer.fetch());
+  EXPECT_EQ(buffer.readSlot().sequence, 1u);
+  EXPECT_FALSE(buffer.fetch());
+  EXPECT_EQ(buffer.readSlot().sequence, 1u);
+}
+
+TEST(Snapshot, LatestSnapshotOverwritesUnfetched){
+  snapshot::TripleBuffer<Snapshot> buffer;
+  for (uint64_t s = 1; s <= 5; s++){
+    fill(buffer.writeSlot(), s);
+    buffer.publish();
+  }
+  ASSERT_TRUE(buffer.fetch());
+  EXPECT_EQ(buffer.readSlot().sequence, 5u);
+  EXPECT_TRUE(consistent(buffer.readSlot()));
+}
+//}
+
+/* concurrency //{ */
+TEST(Snapshot, ConcurrentSnapshotsAreConsistentAndOrdered){
+  snapshot::TripleBuffer<Snapshot> buffer;
+  std::atomic<bool> writing = true;
+  uint64_t fetched = 0, inconsistent = 0, out_of_order = 0, last = 0;
+  std::thread reader([&]{
+      while (true){
+        bool done = !writing; //checked before the fetch, so that the last snapshot is always fetched
+        if (buffer.fetch()){
+          const Snapshot &snapshot = buffer.readSlot();
+          fetched++;
+          if (!consistent(snapshot)){
+            inconsistent++;
+          }
+          if (snapshot.sequence <= last){
+            out_of_order++;
+          }
+          last = snapshot.sequence;
+        }
+        if (done){
+          return;
+        }
+      }
+    });
+
+  for (uint64_t s = 1; s <= STRESS_SNAPSHOT_COUNT; s++){
+    fill(buffer.writeSlot(), s);
+    buffer.publish();
+  }
+  writing = false;
+  reader.join();
+
+  EXPECT_GT(fetched, 0u);
+  EXPECT_EQ(inconsistent, 0u);
+  EXPECT_EQ(out_of_order, 0u);
+  EXPECT_EQ(last, (uint64_t)(STRESS_SNAPSHOT_COUNT));
+}
+
+TEST(Snapshot, WriterDoesNotWaitForReader){
+  // the reader keeps its slot for the whole time the writer publishes - if publishing waited for the reader, the writer would never finish
+  snapshot::TripleBuffer<Snapshot> buffer;
+  fill(buffer.writeSlot(), 1);
+  buffer.publish();
+
+  std::promise<void> slot_taken, writer_finished;
+  std::thread reader([&]{
+      ASSERT_TRUE(buffer.fetch());
+      slot_taken.set_value();
+      writer_finished.get_future().wait();
+      EXPECT_EQ(buffer.readSlot().sequence, 1u); //not touched by the writer in the meantime
+      EXPECT_TRUE(consistent(buffer.readSlot()));
+      ASSERT_TRUE(buffer.fetch());
+      EXPECT_EQ(buffer.readSlot().sequence, (uint64_t)(1+BLOCKED_PUBLISH_COUNT));
+    });
+
+  slot_taken.get_future().wait();
+  for (uint64_t s = 2; s <= 1+BLOCKED_PUBLISH_COUNT; s++){
+    fill(buffer.writeSlot(), s);
+    buffer.publish();
+  }
+  writer_finished.set_value();
+  reader.join();
+}
+//}
+
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
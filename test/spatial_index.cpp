@@ -0,0 +1,201 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include <Eigen/Dense>
+#include <spatial_index/spatial_index.h>
+
+using namespace uvdar;
+
+#define SCENARIO_COUNT 3000
+#define MATCH_LEVEL_THRESHOLD_ASSOCIATE 0.3 // as in the filter
+#define MATCH_LEVEL_THRESHOLD_REMOVE 0.5
+#define MIN_MEASUREMENTS_TO_VALIDATION 10
+
+/* helpers //{ */
+/**
+ * @brief The position part of a filter state or of a measurement
+ */
+struct State {
+  e::Vector3d x;
+  e::Matrix3d P;
+  int update_count;
+  int id;
+};
+
+/**
+ * @brief Generates position distributions with random elongated covariances, scattered in a slab of the given extent
+ */
+static std::vector<State> generateStates(std::mt19937 &generator, int count, double extent){
+  std::uniform_real_distribution<double> position(-extent, extent), scale(0.05, 3.0), uniform(-1.0, 1.0);
+  std::uniform_int_distribution<int> update_count(0, 2*MIN_MEASUREMENTS_TO_VALIDATION);
+  std::vector<State> output;
+  for (int i = 0; i < count; i++){
+    e::Matrix3d A;
+    for (int k = 0; k < 9; k++){
+      A(k/3,k%3) = uniform(generator);
+    }
+    output.push_back({e::Vector3d(position(generator), position(generator), 0.3*position(generator)), scale(generator)*A*A.transpose() + 0.01*e::Matrix3d::Identity(), update_count(generator), i});
+  }
+  return output;
+}
+
+static void boundingSpheres(const std::vector<State> &states, double gate, std::vector<e::Vector3d> &centers, std::vector<double> &radii){
+  for (auto &state : states){
+    centers.push_back(state.x);
+    radii.push_back(spatial_index::gateRadius(state.P, gate));
+  }
+}
+
+/**
+ * @brief Selects which of two overlapping states is removed, as in the filter - the unvalidated one, or the one with the larger covariance
+ */
+static int removedOfPair(const std::vector<State> &states, int i, int j){
+  double size_i = states[i].P.eigenvalues().norm();
+  double size_j = states[j].P.eigenvalues().norm();
+  bool unvalidated_i = states[i].update_count < MIN_MEASUREMENTS_TO_VALIDATION;
+  bool unvalidated_j = states[j].update_count < MIN_MEASUREMENTS_TO_VALIDATION;
+  if (unvalidated_i == unvalidated_j){
+    return (size_j > size_i)?j:i;
+  }
+  return unvalidated_i?i:j;
+}
+
+/**
+ * @brief The overlap removal of the filter before the index - all pairs are checked, and states are erased as soon as they overlap
+ */
+static void removeOverlapsExhaustive(std::vector<State> &states){
+  for (int i = 0; i < (int)(states.size())-1; i++){
+    bool removed_first = false;
+    for (int j = i+1; j < (int)(states.size()); j++){
+      if (spatial_index::gaussJointMaxVal(states[i].P, states[j].P, states[i].x, states[j].x) > MATCH_LEVEL_THRESHOLD_REMOVE){
+        int n = removedOfPair(states, i, j);
+        states.erase(states.begin()+n);
+        if (n == i){
+          removed_first = true;
+          break;
+        }
+        j--;
+      }
+    }
+    if (removed_first){
+      i--;
+    }
+  }
+}
+
+/**
+ * @brief The overlap removal of the filter - only the pairs found by the index are checked, and the removals are applied at the end
+ */
+static void removeOverlapsIndexed(std::vector<State> &states){
+  const double gate = -2.0*std::log(MATCH_LEVEL_THRESHOLD_REMOVE);
+  std::vector<e::Vector3d> centers;
+  std::vector<double> radii;
+  boundingSpheres(states, gate, centers, radii);
+  std::vector<bool> removed(states.size(), false);
+  for (auto [i, j] : spatial_index::intersectingPairs(centers, radii)){
+    if (removed[i] || removed[j]){
+      continue;
+    }
+    if (spatial_index::gaussJointMaxVal(states[i].P, states[j].P, states[i].x, states[j].x) > MATCH_LEVEL_THRESHOLD_REMOVE){
+      removed[removedOfPair(states, i, j)] = true;
+    }
+  }
+  int kept = 0;
+  for (int i = 0; i < (int)(states.size()); i++){
+    if (!removed[i]){
+      states[kept++] = states[i];
+    }
+  }
+  states.erase(states.begin()+kept, states.end());
+}
+//}
+
+/* narrow phase //{ */
+TEST(SpatialIndex, OverlapLevelMatchesMahalanobisDistance){
+  std::mt19937 generator(3);
+  for (int t = 0; t < SCENARIO_COUNT; t++){
+    auto states = generateStates(generator, 2, 5.0);
+    double level = spatial_index::gaussJointMaxVal(states[0].P, states[1].P, states[0].x, states[1].x);
+    double distance_sq = spatial_index::mahalanobisSquared(states[0].P, states[1].P, states[0].x, states[1].x);
+    if (level > 1e-200){
+      ASSERT_NEAR(level, std::exp(-0.5*distance_sq), 1e-9*level) << "in scenario " << t;
+    }
+  }
+}
+
+TEST(SpatialIndex, NotPositiveDefiniteHasInfiniteRadius){
+  EXPECT_TRUE(std::isinf(spatial_index::gateRadius(e::Matrix3d::Zero(), 1.0)));
+  EXPECT_TRUE(std::isinf(spatial_index::gateRadius(e::Vector3d(1.0, 1.0, -1.0).asDiagonal(), 1.0)));
+  EXPECT_NEAR(spatial_index::gateRadius(e::Vector3d(1.0, 4.0, 9.0).asDiagonal(), 4.0), 6.0, 1e-4);
+}
+//}
+
+/* gating //{ */
+TEST(SpatialIndex, NoGatedPairMissedWithinSet){
+  std::mt19937 generator(1);
+  const double gate = -2.0*std::log(MATCH_LEVEL_THRESHOLD_REMOVE);
+  for (int t = 0; t < SCENARIO_COUNT; t++){
+    auto states = generateStates(generator, 2+t%120, 2.0+(t%7)*5.0);
+    std::vector<e::Vector3d> centers;
+    std::vector<double> radii;
+    boundingSpheres(states, gate, centers, radii);
+    auto pairs = spatial_index::intersectingPairs(centers, radii);
+    ASSERT_TRUE(std::is_sorted(pairs.begin(), pairs.end()));
+    ASSERT_TRUE(std::adjacent_find(pairs.begin(), pairs.end()) == pairs.end());
+    for (int i = 0; i < (int)(states.size()); i++){
+      for (int j = i+1; j < (int)(states.size()); j++){
+        if (spatial_index::mahalanobisSquared(states[i].P, states[j].P, states[i].x, states[j].x) < gate){
+          ASSERT_TRUE(std::binary_search(pairs.begin(), pairs.end(), std::make_pair(i,j))) << "pair (" << i << "," << j << ") missed in scenario " << t;
+        }
+      }
+    }
+  }
+}
+
+TEST(SpatialIndex, NoGatedPairMissedBetweenSets){
+  std::mt19937 generator(2);
+  const double gate = -2.0*std::log(MATCH_LEVEL_THRESHOLD_ASSOCIATE);
+  for (int t = 0; t < SCENARIO_COUNT; t++){
+    auto measurements = generateStates(generator, 1+t%20, 20.0);
+    auto states = generateStates(generator, 1+t%150, 20.0);
+    std::vector<e::Vector3d> centers_m, centers_s;
+    std::vector<double> radii_m, radii_s;
+    boundingSpheres(measurements, gate, centers_m, radii_m);
+    boundingSpheres(states, gate, centers_s, radii_s);
+    auto pairs = spatial_index::intersectingPairs(centers_m, radii_m, centers_s, radii_s);
+    ASSERT_TRUE(std::is_sorted(pairs.begin(), pairs.end()));
+    for (int i = 0; i < (int)(measurements.size()); i++){
+      for (int j = 0; j < (int)(states.size()); j++){
+        if (spatial_index::mahalanobisSquared(measurements[i].P, states[j].P, measurements[i].x, states[j].x) < gate){
+          ASSERT_TRUE(std::binary_search(pairs.begin(), pairs.end(), std::make_pair(i,j))) << "pair (" << i << "," << j << ") missed in scenario " << t;
+        }
+      }
+    }
+  }
+}
+//}
+
+/* overlap removal //{ */
+TEST(SpatialIndex, OverlapRemovalMatchesExhaustive){
+  std::mt19937 generator(1);
+  int removed_count = 0;
+  for (int t = 0; t < SCENARIO_COUNT; t++){
+    auto exhaustive = generateStates(generator, 2+t%120, 2.0+(t%7)*5.0);
+    auto indexed = exhaustive;
+    removeOverlapsExhaustive(exhaustive);
+    removeOverlapsIndexed(indexed);
+    removed_count += (2+t%120) - (int)(exhaustive.size());
+    ASSERT_EQ(indexed.size(), exhaustive.size()) << "in scenario " << t;
+    for (size_t k = 0; k < exhaustive.size(); k++){
+      ASSERT_EQ(indexed[k].id, exhaustive[k].id) << "in scenario " << t;
+    }
+  }
+  EXPECT_GT(removed_count, SCENARIO_COUNT); // the scenarios are dense enough that the removal order matters
+}
+//}
+
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cmath>
+#include <unistd.h>
+#include <trace/trace.h>
+
+using namespace uvdar;
+
+#define TRACE_BUFFER_SIZE 16384 // as in trace.cpp
+#define EXPORT_REPETITIONS 20
+
+/* helpers //{ */
+struct ExportedEvent {
+  std::string name;
+  double start; //us
+  double duration; //us
+};
+
+/**
+ * @brief Exports the trace and parses back the events whose name starts with the given prefix. Relies on the layout of writeChromeTrace - one event per line
+ */
+static std::vector<ExportedEvent> exportEvents(const std::string &prefix){
+  std::string filename = "/tmp/uvdar_test_trace_" + std::to_string(getpid()) + ".json";
+  EXPECT_TRUE(trace::writeChromeTrace(filename));
+  std::vector<ExportedEvent> output;
+  std::ifstream ifs(filename);
+  std::string line;
+  while (getline(ifs, line)){
+    auto name_begin = line.find("{\"name\":\"");
+    if (name_begin == std::string::npos){
+      continue;
+    }
+    name_begin += 9;
+    auto name_end = line.find('"', name_begin);
+    ExportedEvent event;
+    event.name = line.substr(name_begin, name_end-name_begin);
+    if (event.name.compare(0, prefix.size(), prefix) != 0){
+      continue;
+    }
+    event.start = std::stod(line.substr(line.find("\"ts\":")+5));
+    event.duration = std::stod(line.substr(line.find("\"dur\":")+6));
+    output.push_back(event);
+  }
+  std::remove(filename.c_str());
+  return output;
+}
+
+static int eventIndex(const ExportedEvent &event){
+  return std::stoi(event.name.substr(event.name.find(' ')+1));
+}
+//}
+
+/* ring buffer //{ */
+TEST(Trace, KeepsAllEventsBeforeWrapping){
+  trace::enable(true);
+  std::thread([]{
+      for (int k = 0; k < 100; k++){
+        trace::record(("keep " + std::to_string(k)).c_str(), k*1000, 1000);
+      }
+      }).join();
+
+  auto events = exportEvents("keep ");
+  ASSERT_EQ(events.size(), 100u);
+  for (int k = 0; k < 100; k++){
+    EXPECT_EQ(eventIndex(events[k]), k);
+  }
+}
+
+TEST(Trace, DiscardsTheSlotThatMayBeOverwritten){
+  trace::enable(true);
+  const int count = TRACE_BUFFER_SIZE + 10;
+  std::thread([]{
+      for (int k = 0; k < count; k++){
+        trace::record(("wrap " + std::to_string(k)).c_str(), k*1000, 1000);
+      }
+      }).join();
+
+  // the slot of the oldest event is the one the next event would be written to, so it is not exported even though the thread has finished
+  auto events = exportEvents("wrap ");
+  ASSERT_EQ(events.size(), (size_t)(TRACE_BUFFER_SIZE - 1));
+  EXPECT_EQ(eventIndex(events.front()), count - TRACE_BUFFER_SIZE + 1);
+  EXPECT_EQ(eventIndex(events.back()), count - 1);
+}
+
+TEST(Trace, ExportWhileRecordingYieldsNoTornEvents){
+  trace::enable(true);
+  std::atomic<bool> running(true);
+  std::thread writer([&]{
+      for (int64_t k = 0; running; k++){
+        // all fields of an event carry its index, so that a mix of two events is detected
+        trace::record(("torn " + std::to_string(k%1000)).c_str(), k*1000, (k%1000)*1000);
+      }
+      });
+
+  for (int r = 0; r < EXPORT_REPETITIONS; r++){
+    for (auto &event : exportEvents("torn ")){
+      int64_t k = std::llround(event.start);
+      EXPECT_EQ(eventIndex(event), k%1000);
+      EXPECT_EQ(std::llround(event.duration), k%1000);
+    }
+  }
+  running = false;
+  writer.join();
+}
+
+TEST(Trace, DisabledRecordsNothing){
+  trace::enable(false);
+  std::thread([]{
+      UVDAR_TRACE_SCOPE("disabled span");
+      trace::record("disabled record", 0, 0);
+      }).join();
+  EXPECT_TRUE(exportEvents("disabled").empty());
+}
+//}
+
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <visualization_output/visualization_output.h>
+
+using namespace uvdar;
+
+#define IMAGE_WIDTH 752
+#define IMAGE_HEIGHT 480
+
+/* helpers //{ */
+/**
+ * @brief Generates an image in which each pixel encodes its position, or the position of its block of block x block pixels
+ */
+static cv::Mat positionImage(int block = 1){
+  cv::Mat output(IMAGE_HEIGHT, IMAGE_WIDTH, CV_8UC3);
+  for (int y = 0; y < IMAGE_HEIGHT; y++){
+    for (int x = 0; x < IMAGE_WIDTH; x++){
+      int bx = x/block, by = y/block;
+      output.at<cv::Vec3b>(y, x) = cv::Vec3b(bx%256, by%256, (bx/256)*16 + (by/256));
+    }
+  }
+  return output;
+}
+
+static visualization_output::Options options(double scale, int roi_margin){
+  visualization_output::Options output;
+  output.scale = scale;
+  output.roi_margin = roi_margin;
+  return output;
+}
+
+/**
+ * @brief Checks that the output is the region of the image with the given top left corner and size
+ */
+static void expectRegion(const cv::Mat &image, const cv::Mat &output, const cv::Rect &region){
+  ASSERT_EQ(output.cols, region.width);
+  ASSERT_EQ(output.rows, region.height);
+  for (int y = 0; y < region.height; y++){
+    for (int x = 0; x < region.width; x++){
+      ASSERT_EQ(output.at<cv::Vec3b>(y, x), image.at<cv::Vec3b>(region.y + y, region.x + x)) << "at " << x << ", " << y;
+    }
+  }
+}
+//}
+
+/* cropping //{ */
+TEST(VisualizationOutput, FullImageWithoutReductions){
+  auto image = positionImage();
+  cv::Mat output;
+  ASSERT_TRUE(visualization_output::reduce(image, {{100, 100}}, visualization_output::Options(), output));
+  EXPECT_EQ(output.data, image.data);
+  expectRegion(image, output, cv::Rect(0, 0, IMAGE_WIDTH, IMAGE_HEIGHT));
+}
+
+TEST(VisualizationOutput, CropsToTheMarkersWithMargin){
+  auto image = positionImage();
+  cv::Mat output;
+  ASSERT_TRUE(visualization_output::reduce(image, {{100, 120}, {180, 150}, {140, 200}}, options(1.0, 10), output));
+  expectRegion(image, output, cv::Rect(90, 110, 101, 101));
+
+  ASSERT_TRUE(visualization_output::reduce(image, {{300, 300}}, options(1.0, 0), output));
+  expectRegion(image, output, cv::Rect(300, 300, 1, 1));
+}
+
+TEST(VisualizationOutput, ClipsTheRegionAtTheBorders){
+  auto image = positionImage();
+  cv::Mat output;
+  ASSERT_TRUE(visualization_output::reduce(image, {{5, 470}, {30, 478}}, options(1.0, 20), output));
+  expectRegion(image, output, cv::Rect(0, 450, 51, 30));
+
+  // only the margin of a marker outside of the image reaches into it
+  ASSERT_TRUE(visualization_output::reduce(image, {{-5, 100}}, options(1.0, 10), output));
+  expectRegion(image, output, cv::Rect(0, 90, 6, 21));
+}
+
+TEST(VisualizationOutput, NothingToPublishForRegionOffImage){
+  auto image = positionImage();
+  cv::Mat output;
+  EXPECT_FALSE(visualization_output::reduce(image, {{-100, -80}, {-60, -40}}, options(1.0, 10), output));
+  EXPECT_FALSE(visualization_output::reduce(image, {{900, 100}, {950, 120}}, options(1.0, 5), output));
+  EXPECT_FALSE(visualization_output::reduce(image, {{100, IMAGE_HEIGHT + 20}}, options(0.5, 19), output));
+  // the image ends just before the region
+  EXPECT_FALSE(visualization_output::reduce(image, {{IMAGE_WIDTH + 10, 100}}, options(1.0, 10), output));
+  EXPECT_TRUE(visualization_output::reduce(image, {{IMAGE_WIDTH + 10, 100}}, options(1.0, 11), output));
+  expectRegion(image, output, cv::Rect(IMAGE_WIDTH - 1, 89, 1, 23));
+}
+
+TEST(VisualizationOutput, IgnoresTheMarginWithoutMarkers){
+  auto image = positionImage();
+  cv::Mat output;
+  ASSERT_TRUE(visualization_output::reduce(image, {}, options(1.0, 10), output));
+  expectRegion(image, output, cv::Rect(0, 0, IMAGE_WIDTH, IMAGE_HEIGHT));
+}
+//}
+
+/* scaling //{ */
+TEST(VisualizationOutput, DownscalesByArea){
+  // each block of 2x2 pixels has a single color, so that halving the image keeps the colors exactly
+  auto image = positionImage(2);
+  cv::Mat output;
+  ASSERT_TRUE(visualization_output::reduce(image, {}, options(0.5, -1), output));
+  expectRegion(positionImage(), output, cv::Rect(0, 0, IMAGE_WIDTH/2, IMAGE_HEIGHT/2));
+}
+
+TEST(VisualizationOutput, CropsAndDownscales){
+  auto image = positionImage(2);
+  cv::Mat output;
+  ASSERT_TRUE(visualization_output::reduce(image, {{100, 120}, {179, 149}}, options(0.5, 10), output));
+  // the region of 100x50 pixels starts at an even position, so that it covers whole blocks
+  expectRegion(positionImage(), output, cv::Rect(45, 55, 50, 25));
+
+  ASSERT_TRUE(visualization_output::reduce(image, {{100, 120}, {180, 150}}, options(0.5, 10), output));
+  EXPECT_EQ(output.cols, 51); // 50.5 rounded
+  EXPECT_EQ(output.rows, 26); // 25.5 rounded
+}
+
+TEST(VisualizationOutput, KeepsAtLeastOnePixel){
+  auto image = positionImage();
+  cv::Mat output;
+  ASSERT_TRUE(visualization_output::reduce(image, {}, options(0.001, -1), output));
+  EXPECT_EQ(output.cols, 1);
+  EXPECT_EQ(output.rows, 1);
+
+  ASSERT_TRUE(visualization_output::reduce(image, {{300, 300}}, options(0.1, 0), output));
+  EXPECT_EQ(output.cols, 1);
+  EXPECT_EQ(output.rows, 1);
+}
+
+TEST(VisualizationOutput, InvalidScaleKeepsTheSize){
+  auto image = positionImage();
+  cv::Mat output;
+  for (double scale : {0.0, -0.5, 1.5}){
+    ASSERT_TRUE(visualization_output::reduce(image, {}, options(scale, -1), output));
+    EXPECT_EQ(output.cols, IMAGE_WIDTH);
+    EXPECT_EQ(output.rows, IMAGE_HEIGHT);
+  }
+}
+//}
+
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}